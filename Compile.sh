@@ -1,8 +1,35 @@
 glslc shaders/shader.vert -o cmake-build-debug/shaders/shader.vert.spv
 glslc shaders/shader.frag -o cmake-build-debug/shaders/shader.frag.spv
+glslc shaders/shader_compact.vert -o cmake-build-debug/shaders/shader_compact.vert.spv
+glslc shaders/shader_compact_uv.vert -o cmake-build-debug/shaders/shader_compact_uv.vert.spv
+glslc shaders/shader_compact.frag -o cmake-build-debug/shaders/shader_compact.frag.spv
+glslc shaders/shader_compact_uv.frag -o cmake-build-debug/shaders/shader_compact_uv.frag.spv
+glslc shaders/shader_compact_uv_bindless.frag -o cmake-build-debug/shaders/shader_compact_uv_bindless.frag.spv
+glslc shaders/cull.comp -o cmake-build-debug/shaders/cull.comp.spv
+glslc shaders/shape.vert -o cmake-build-debug/shaders/shape.vert.spv
+glslc shaders/shape.frag -o cmake-build-debug/shaders/shape.frag.spv
+glslc shaders/shape_bindless.frag -o cmake-build-debug/shaders/shape_bindless.frag.spv
 
 glslc shaders/shader.vert -o build/shaders/shader.vert.spv
 glslc shaders/shader.frag -o build/shaders/shader.frag.spv
+glslc shaders/shader_compact.vert -o build/shaders/shader_compact.vert.spv
+glslc shaders/shader_compact_uv.vert -o build/shaders/shader_compact_uv.vert.spv
+glslc shaders/shader_compact.frag -o build/shaders/shader_compact.frag.spv
+glslc shaders/shader_compact_uv.frag -o build/shaders/shader_compact_uv.frag.spv
+glslc shaders/shader_compact_uv_bindless.frag -o build/shaders/shader_compact_uv_bindless.frag.spv
+glslc shaders/cull.comp -o build/shaders/cull.comp.spv
+glslc shaders/shape.vert -o build/shaders/shape.vert.spv
+glslc shaders/shape.frag -o build/shaders/shape.frag.spv
+glslc shaders/shape_bindless.frag -o build/shaders/shape_bindless.frag.spv
 
 glslc shaders/shader.vert -o shaders/shader.vert.spv
-glslc shaders/shader.frag -o shaders/shader.frag.spv
\ No newline at end of file
+glslc shaders/shader.frag -o shaders/shader.frag.spv
+glslc shaders/shader_compact.vert -o shaders/shader_compact.vert.spv
+glslc shaders/shader_compact_uv.vert -o shaders/shader_compact_uv.vert.spv
+glslc shaders/shader_compact.frag -o shaders/shader_compact.frag.spv
+glslc shaders/shader_compact_uv.frag -o shaders/shader_compact_uv.frag.spv
+glslc shaders/shader_compact_uv_bindless.frag -o shaders/shader_compact_uv_bindless.frag.spv
+glslc shaders/cull.comp -o shaders/cull.comp.spv
+glslc shaders/shape.vert -o shaders/shape.vert.spv
+glslc shaders/shape.frag -o shaders/shape.frag.spv
+glslc shaders/shape_bindless.frag -o shaders/shape_bindless.frag.spv
\ No newline at end of file
@@ -4,14 +4,43 @@ layout(binding = 0) uniform UniformBufferObject {
     mat4 model;
     mat4 view;
     mat4 proj;
+    vec4 viewport;
+    vec4 pointer;
 } ubo;
 
+// Mirrors transform_world in app.c, draws select their node through firstInstance
+struct Transform {
+    vec4 linear;
+    vec4 translation;
+};
+
+layout(std430, binding = 3) readonly buffer Transforms {
+    Transform transforms[];
+};
+
+vec2 place(vec2 position) {
+    Transform transform = transforms[gl_InstanceIndex];
+    vec2 translation = transform.translation.xy + transform.translation.z * ubo.pointer.xy;
+    return mat2(transform.linear.xy, transform.linear.zw) * position + translation;
+}
+
+// Mirrors layer_push_constants in app.c, cached layers are drawn with clip in place of the view
+layout(push_constant) uniform Layer {
+    mat4 clip;
+    uint active;
+} layer;
+
+vec4 toClip(vec2 position) {
+    vec4 p = vec4(position, 0.0, 1.0);
+    return layer.active != 0u ? layer.clip * p : ubo.proj * ubo.view * ubo.model * p;
+}
+
 layout(location = 0) in vec2 inPosition;
 layout(location = 1) in vec3 inColor;
 
 layout(location = 0) out vec3 fragColor;
 
 void main() {
-    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPosition, 0.0, 1.0);
+    gl_Position = toClip(place(inPosition));
     fragColor = inColor;
 }
\ No newline at end of file
@@ -0,0 +1,29 @@
+#version 450
+
+layout(location = 0) in vec4 fragColor;
+layout(location = 0) out vec4 outColor;
+
+// Mirrors mask_push_constants in app.c, placed after the vertex shader's block. The rows map framebuffer
+// pixels into the space of a rounded or transformed clip, whose rect is centered on the origin there.
+layout(push_constant) uniform Mask {
+    layout(offset = 80) vec4 row0;
+    vec4 row1;
+    vec2 halfSize;
+    float radius;
+    uint active;
+} mask;
+
+float roundedRect(vec2 p, vec2 halfSize, float radius) {
+    vec2 q = abs(p) - halfSize + radius;
+    return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - radius;
+}
+
+void main() {
+    if (mask.active != 0u) {
+        vec3 pixel = vec3(gl_FragCoord.xy, 1.0);
+        if (roundedRect(vec2(dot(mask.row0.xyz, pixel), dot(mask.row1.xyz, pixel)), mask.halfSize, mask.radius) > 0.0) {
+            discard;
+        }
+    }
+    outColor = fragColor;
+}
@@ -0,0 +1,55 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    vec4 viewport;
+    vec4 pointer;
+} ubo;
+
+// Mirrors transform_world in app.c, draws select their node through firstInstance
+struct Transform {
+    vec4 linear;
+    vec4 translation;
+};
+
+layout(std430, binding = 3) readonly buffer Transforms {
+    Transform transforms[];
+};
+
+vec2 place(vec2 position) {
+    Transform transform = transforms[gl_InstanceIndex];
+    vec2 translation = transform.translation.xy + transform.translation.z * ubo.pointer.xy;
+    return mat2(transform.linear.xy, transform.linear.zw) * position + translation;
+}
+
+// Matches STRS_VERTEX_COMPACT_SUBPIXEL_BITS
+const float SUBPIXEL_SCALE = 1.0 / 8.0;
+
+// Mirrors layer_push_constants in app.c, cached layers are drawn with clip in place of the view
+layout(push_constant) uniform Layer {
+    mat4 clip;
+    uint active;
+    uint texture;
+} layer;
+
+vec4 toClip(vec2 position) {
+    vec4 p = vec4(position, 0.0, 1.0);
+    return layer.active != 0u ? layer.clip * p : ubo.proj * ubo.view * ubo.model * p;
+}
+
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec4 inColor;
+layout(location = 2) in vec2 inUV;
+
+layout(location = 0) out vec4 fragColor;
+layout(location = 1) out vec2 fragUV;
+layout(location = 2) flat out uint fragTexture;
+
+void main() {
+    gl_Position = toClip(place(inPosition * SUBPIXEL_SCALE));
+    fragColor = inColor;
+    fragUV = inUV;
+    fragTexture = layer.texture;
+}
@@ -0,0 +1,197 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+    vec4 viewport;
+    vec4 pointer;
+    float time;
+} ubo;
+
+// Mirrors animation_keyframe and animation_track in app.c
+struct Keyframe {
+    vec4 value;
+    float time;
+    uint easing;
+    uint padding0;
+    uint padding1;
+};
+
+struct Track {
+    uint next;
+    uint property;
+    uint keyframeCount;
+    uint flags;
+    float startTime;
+    uint shape;
+    uint padding0;
+    uint padding1;
+    // STRS_ANIMATION_MAX_KEYFRAMES
+    Keyframe keyframes[8];
+};
+
+// First track of every shape
+layout(std430, binding = 1) readonly buffer AnimationHeads {
+    uint heads[];
+};
+
+layout(std430, binding = 2) readonly buffer AnimationTracks {
+    Track tracks[];
+};
+
+// Mirrors transform_world in app.c
+struct Transform {
+    vec4 linear;
+    vec4 translation;
+};
+
+layout(std430, binding = 3) readonly buffer Transforms {
+    Transform transforms[];
+};
+
+// Mirrors layer_push_constants in app.c, active while drawing the composites of cached layers
+layout(push_constant) uniform Layer {
+    mat4 clip;
+    uint active;
+} layer;
+
+const uint NONE = 0xFFFFFFFFu;
+const uint LOOP = 1u;
+
+// Matches strs_easing
+const uint EASING_LINEAR = 0u;
+const uint EASING_EASE_IN = 1u;
+const uint EASING_EASE_OUT = 2u;
+const uint EASING_EASE_IN_OUT = 3u;
+const uint EASING_STEP = 4u;
+
+// Matches strs_animation_property
+const uint PROPERTY_OFFSET = 0u;
+const uint PROPERTY_SIZE = 1u;
+const uint PROPERTY_FILL_COLOR = 2u;
+const uint PROPERTY_BORDER_COLOR = 3u;
+const uint PROPERTY_CORNER_RADIUS = 4u;
+const uint PROPERTY_OPACITY = 5u;
+
+// One strs_shape per instance, the quad corners come from the vertex index
+layout(location = 0) in vec4 inRect;
+layout(location = 1) in vec4 inFillColor;
+layout(location = 2) in vec4 inBorderColor;
+layout(location = 3) in vec4 inShadowColor;
+layout(location = 4) in vec4 inShape;
+layout(location = 5) in float inShadowBlur;
+layout(location = 6) in uint inTransform;
+layout(location = 7) in uint inTexture;
+layout(location = 8) in vec4 inUV;
+
+layout(location = 0) out vec2 fragLocal;
+layout(location = 1) flat out vec2 fragHalfSize;
+layout(location = 2) flat out vec4 fragShape;
+layout(location = 3) flat out float fragShadowBlur;
+layout(location = 4) flat out vec4 fragFillColor;
+layout(location = 5) flat out vec4 fragBorderColor;
+layout(location = 6) flat out vec4 fragShadowColor;
+layout(location = 7) flat out uint fragTexture;
+layout(location = 8) out vec2 fragUV;
+
+float ease(float t, uint easing) {
+    switch (easing) {
+        case EASING_EASE_IN:
+            return t * t * t;
+        case EASING_EASE_OUT:
+            return 1.0 - pow(1.0 - t, 3.0);
+        case EASING_EASE_IN_OUT:
+            return t < 0.5 ? 4.0 * t * t * t : 1.0 - pow(2.0 - 2.0 * t, 3.0) * 0.5;
+        case EASING_STEP:
+            return 0.0;
+        default:
+            return t;
+    }
+}
+
+vec4 evaluate(uint track) {
+    uint count = tracks[track].keyframeCount;
+    float t = ubo.time - tracks[track].startTime;
+    float end = tracks[track].keyframes[count - 1u].time;
+
+    if ((tracks[track].flags & LOOP) != 0u && end > 0.0 && t > 0.0) {
+        t = mod(t, end);
+    }
+    if (t <= tracks[track].keyframes[0].time) {
+        return tracks[track].keyframes[0].value;
+    }
+    for (uint i = 1u; i < count; i++) {
+        Keyframe next = tracks[track].keyframes[i];
+        if (t < next.time) {
+            Keyframe previous = tracks[track].keyframes[i - 1u];
+            float f = (t - previous.time) / max(next.time - previous.time, 1e-6);
+            return mix(previous.value, next.value, ease(f, previous.easing));
+        }
+    }
+    return tracks[track].keyframes[count - 1u].value;
+}
+
+void main() {
+    vec4 rect = inRect;
+    vec4 fillColor = inFillColor;
+    vec4 borderColor = inBorderColor;
+    vec4 shadowColor = inShadowColor;
+    float radius = inShape.z;
+    float opacity = 1.0;
+
+    uint instance = uint(gl_InstanceIndex);
+    // Composites are not the shapes the animations index
+    uint track = layer.active == 0u && instance < uint(heads.length()) ? heads[instance] : NONE;
+    while (track != NONE) {
+        vec4 value = evaluate(track);
+        switch (tracks[track].property) {
+            case PROPERTY_OFFSET:
+                rect.xy += value.xy;
+                break;
+            case PROPERTY_SIZE:
+                rect.xy += (rect.zw - value.xy) * 0.5;
+                rect.zw = value.xy;
+                break;
+            case PROPERTY_FILL_COLOR:
+                fillColor = value;
+                break;
+            case PROPERTY_BORDER_COLOR:
+                borderColor = value;
+                break;
+            case PROPERTY_CORNER_RADIUS:
+                radius = value.x;
+                break;
+            case PROPERTY_OPACITY:
+                opacity *= value.x;
+                break;
+        }
+        track = tracks[track].next;
+    }
+
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+    vec2 halfSize = rect.zw * 0.5;
+    vec2 center = rect.xy + halfSize;
+    vec2 shadowOffset = inShape.xy;
+
+    // Grow the quad so the shadow and one unit of antialiasing fit
+    vec2 margin = abs(shadowOffset) + vec2(inShadowBlur + 1.0);
+    vec2 local = mix(-halfSize - margin, halfSize + margin, corner);
+
+    Transform transform = transforms[inTransform];
+    vec2 translation = transform.translation.xy + transform.translation.z * ubo.pointer.xy;
+    vec2 position = mat2(transform.linear.xy, transform.linear.zw) * (center + local) + translation;
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(position, 0.0, 1.0);
+    fragLocal = local;
+    fragHalfSize = halfSize;
+    fragShape = vec4(shadowOffset, clamp(radius, 0.0, min(halfSize.x, halfSize.y)), inShape.w);
+    fragShadowBlur = inShadowBlur;
+    fragFillColor = vec4(fillColor.rgb, fillColor.a * opacity);
+    fragBorderColor = vec4(borderColor.rgb, borderColor.a * opacity);
+    fragShadowColor = vec4(shadowColor.rgb, shadowColor.a * opacity);
+
+    // The margin maps past the uv rect, the fragment shader clamps it
+    vec4 uvRect = inUV == vec4(0.0) ? vec4(0.0, 0.0, 1.0, 1.0) : inUV;
+    fragTexture = inTexture;
+    fragUV = mix(uvRect.xy, uvRect.zw, (local + halfSize) / max(rect.zw, vec2(1e-6)));
+}
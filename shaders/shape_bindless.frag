@@ -0,0 +1,53 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec2 fragLocal;
+layout(location = 1) flat in vec2 fragHalfSize;
+// Shadow offset, corner radius, border width
+layout(location = 2) flat in vec4 fragShape;
+layout(location = 3) flat in float fragShadowBlur;
+layout(location = 4) flat in vec4 fragFillColor;
+layout(location = 5) flat in vec4 fragBorderColor;
+layout(location = 6) flat in vec4 fragShadowColor;
+layout(location = 7) flat in uint fragTexture;
+layout(location = 8) in vec2 fragUV;
+
+layout(location = 0) out vec4 outColor;
+
+// Every texture handle indexes the array, handle 0 and textures that are not ready are white
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+vec4 sampleTexture() {
+    return texture(textures[nonuniformEXT(fragTexture)], fragUV);
+}
+
+// Signed distance to a rounded box centered on the origin, negative inside
+float roundedBox(vec2 p, vec2 halfSize, float radius) {
+    vec2 q = abs(p) - halfSize + radius;
+    return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - radius;
+}
+
+vec4 premultiply(vec4 color) {
+    return vec4(color.rgb * color.a, color.a);
+}
+
+void main() {
+    float radius = fragShape.z;
+    float borderWidth = fragShape.w;
+
+    float d = roundedBox(fragLocal, fragHalfSize, radius);
+    // Width of one pixel in shape units, keeps the edge one pixel wide under any transform
+    float aa = max(fwidth(d), 1e-4);
+    float coverage = clamp(0.5 - d / aa, 0.0, 1.0);
+    float border = borderWidth > 0.0 ? clamp(0.5 + (d + borderWidth) / aa, 0.0, 1.0) : 0.0;
+    vec4 fill = fragFillColor * sampleTexture();
+    vec4 shape = premultiply(mix(fill, fragBorderColor, border)) * coverage;
+
+    float shadowDistance = roundedBox(fragLocal - fragShape.xy, fragHalfSize, radius);
+    float blur = max(fragShadowBlur, aa);
+    float shadow = 1.0 - smoothstep(-blur, blur, shadowDistance);
+    vec4 shadowColor = premultiply(fragShadowColor) * shadow;
+
+    // Premultiplied alpha, the shape over its shadow
+    outColor = shape + shadowColor * (1.0 - shape.a);
+}
@@ -1,18 +1,27 @@
 // STD
 #include <pthread.h>
+#include <sched.h>
 #include <stdlib.h>
 #include <assert.h>
 #include <stdio.h>
 #include <sys/stat.h>
+#include <unistd.h>
 #include <string.h>
+#include <float.h>
+#include <math.h>
 
 // LIB
 #include "app.h"
+#include "capture.h"
 #include "ntd/string.h"
 
 #define IMPL_OPTION_DEF
 #include "helper/option.h"
 #include "helper/arrays.h"
+#include "helper/clock.h"
+#include "helper/alloc.h"
+#include "helper/scene.h"
+#include "helper/input_ring.h"
 
 // Vendor
 #define STB_IMAGE_IMPLEMENTATION
@@ -30,17 +39,430 @@ static bool enable_validation_layers = false;
 typedef struct {
   void *data;
   VkDeviceSize bufferSize;
+  VkDeviceSize contentsSize;
   VkBuffer buffer;
   VkDeviceMemory bufferMemory;
   VkBuffer stagingBuffer;
   VkDeviceMemory stagingBufferMemory;
   bool contentsChanged;
+  // Byte range of the contents that changed since the last upload
+  VkDeviceSize dirtyBegin;
+  VkDeviceSize dirtyEnd;
 } vulkan_buffer;
 
+typedef struct {
+  option_uint graphics_family;
+  option_uint present_family;
+} QueueFamilyIndices;
+
+// Driver host allocations are prefixed with their size and the offset back to what malloc returned
+typedef struct {
+  size_t size;
+  size_t offset;
+} host_allocation;
+
+// Device memory allocated by the app, freed through free_memory
+typedef struct {
+  VkDeviceMemory memory;
+  VkDeviceSize size;
+  strs_memory_category category;
+} memory_allocation;
+
+// VK_EXT_memory_budget is read this often, the values only change at queue submissions anyway
+#define MEMORY_BUDGET_POLL_FRAMES 32
+
+#define MAX_VERTEX_ATTRIBUTES 7
+#define CULL_WORKGROUP_SIZE 64
+// strs_push_rects splits its batch into draw items of this many rects so they are still culled
+#define RECTS_PER_DRAW_ITEM 256
+
+// A contiguous index range pushed by one widget, the unit of culling.
+// Bounds are in the space of the transform node, bounds and clip are min x, min y, max x, max y.
+typedef struct {
+  uint32_t first_index;
+  uint32_t index_count;
+  float bounds[4];
+  float clip[4];
+  uint32_t transform;
+  // strs_push_clip, 1 based into the clip regions, 0 when unclipped
+  uint32_t clip_region;
+  // The vertices the indices reference, so writes to them find the items whose bounds they move
+  uint32_t first_vertex;
+  uint32_t vertex_end;
+} draw_item;
+
+// A clip of strs_push_clip intersected with the ones it is nested in, bounds are in framebuffer pixels.
+// The mask maps framebuffer pixels into the space of the innermost rounded or transformed clip,
+// {xx, yx, xy, yy, x0, y0} like the transform nodes, with its rect centered on the origin.
+typedef struct {
+  float bounds[4];
+  bool masked;
+  float mask_inverse[6];
+  float mask_half_size[2];
+  float mask_radius;
+} clip_region;
+
+// Batches are only moved ahead of this many runs of other clips
+#define CLIP_REORDER_WINDOW 16
+
+// What build_draw_commands knows about a batch beyond its command
+typedef struct {
+  uint32_t clip_region;
+  // The cull records cut from the batch start here
+  uint32_t first_record;
+} draw_batch;
+
+// Consecutive batches drawn with the same scissor and mask, mask_region is 0 without one
+typedef struct {
+  VkRect2D scissor;
+  uint32_t mask_region;
+  uint32_t first_draw;
+  uint32_t draw_count;
+} scissor_run;
+
+// Mirrors Record in cull.comp (std430), a draw item clipped to one batch
+typedef struct {
+  float bounds[4];
+  float clip[4];
+  uint32_t first_index;
+  uint32_t index_count;
+  int32_t vertex_offset;
+  uint32_t transform;
+} cull_record;
+
+typedef struct {
+  uint32_t record_count;
+  uint32_t compact;
+} cull_push_constants;
+
+#define ANIMATION_LOOP 1u
+
+// Mirrors Keyframe and Track in shape.vert (std430)
+typedef struct {
+  float value[4];
+  float time;
+  uint32_t easing;
+  uint32_t padding[2];
+} animation_keyframe;
+
+typedef struct {
+  // Next track of the same shape, links the free list once the track is stopped
+  uint32_t next;
+  uint32_t property;
+  // 0 while the track is free
+  uint32_t keyframe_count;
+  uint32_t flags;
+  float start_time;
+  uint32_t shape;
+  uint32_t padding[2];
+  animation_keyframe keyframes[STRS_ANIMATION_MAX_KEYFRAMES];
+} animation_track;
+
+typedef struct {
+  strs_tree_links links;
+  float local[6];
+  bool used;
+  bool dirty;
+  bool follow_pointer;
+  // strs_transform_set_layer, bounds as x0, y0, x1, y1 in the node's space
+  bool layer;
+  float layer_bounds[4];
+  float opacity;
+} transform_node;
+
+// Mirrors Transform in the vertex shaders (std430), the columns of the world affine.
+// translation[2] is 1 when the latched pointer position is added to the translation.
+typedef struct {
+  float linear[4];
+  float translation[4];
+} transform_world;
+
+// Handles are the type in the top 16 bits, then the generation of the slot and the slot
+#define WIDGET_HANDLE(type, slot, generation) ((uint64_t) (type) << 48 | (uint64_t) (generation) << 32 | (slot))
+
+// The widgets of one type. The dense arrays are indexed by entry and stay packed, the last widget
+// moves into the hole a destroyed one leaves. Slots map the stable handles to the entries.
+typedef struct {
+  strs_widget_type_info info;
+  char *name;
+  uint32_t count;
+  uint64_t capacity;
+  strs_rect *rects;
+  vec3 *colors;
+  uint32_t *flags;
+  uint8_t *data;
+  uint32_t *entry_slots;
+  // The entry of every slot, or the next free slot once its widget is destroyed
+  uint32_t *slot_entries;
+  // Starts at 1 and is bumped on destroy, so handles of destroyed widgets never match
+  uint16_t *slot_generations;
+  uint32_t slot_count;
+  uint64_t slot_capacity;
+  uint32_t free_slot;
+  // Some widget is STRS_WIDGET_DIRTY
+  bool dirty;
+} widget_pool;
+
+// With manual_publish the app thread builds the next scene while the render thread draws the last snapshot
+// it was handed. Snapshots split every stream into chunks and share the ones nothing touched in between,
+// so a publish only copies what changed since the one before.
+#define SNAPSHOT_CHUNK_SIZE 65536
+
+typedef enum {
+  SCENE_VERTICES,
+  SCENE_INDICES,
+  SCENE_DRAW_ITEMS,
+  SCENE_SHAPES,
+  SCENE_CLIPS,
+  SCENE_STREAM_COUNT
+} scene_stream;
+
+typedef struct {
+  // Every snapshot holding the chunk and the builder's copy of the last publish
+  uint32_t references;
+  uint8_t data[SNAPSHOT_CHUNK_SIZE];
+} snapshot_chunk;
+
+typedef struct {
+  snapshot_chunk **chunks;
+  uint64_t chunk_count;
+  uint64_t size;
+} snapshot_stream;
+
+typedef struct {
+  snapshot_stream streams[SCENE_STREAM_COUNT];
+  uint64_t published_ns;
+} scene_snapshot;
+
+// The scene the render thread draws, either the arrays being built or its copy of the last snapshot
+typedef struct {
+  const uint8_t *vertices;
+  uint64_t vertex_count;
+  uint64_t vertex_capacity;
+  const uint32_t *indices;
+  uint64_t index_count;
+  uint64_t index_capacity;
+  const draw_item *draw_items;
+  uint64_t draw_item_count;
+  const strs_shape *shapes;
+  uint64_t shape_count;
+  uint64_t shape_capacity;
+  const clip_region *clip_regions;
+  uint64_t clip_region_count;
+} scene_view;
+
+#define LATENCY_QUEUE_SIZE 64
+// Frames that are not presented by then are dropped from the statistics
+#define LATENCY_PRESENT_TIMEOUT_NS 100000000ull
+
+// A presented frame that showed new input, waiting for VK_KHR_present_wait
+typedef struct {
+  VkSwapchainKHR swap_chain;
+  uint64_t present_id;
+  uint64_t input_ns;
+} latency_frame;
+
+#define TEXTURE_MAX_LEVELS 16
+
+typedef struct {
+  VkImage image;
+  VkDeviceMemory memory;
+  VkImageView view;
+  strs_texture_info info;
+  bool used;
+  // strs_texture_free was called, the image goes once the render thread gets to it
+  bool released;
+  uint32_t next_free;
+  // Where the texture sits when textures share the atlas
+  uint32_t atlas_x;
+  uint32_t atlas_y;
+} texture;
+
+#define TEXTURE_ATLAS_SIZE 2048
+// The white block in the corner the placeholder samples
+#define TEXTURE_ATLAS_WHITE_SIZE 4
+
+// Stands in for the texture array without descriptor indexing. Textures are packed into shelves of one
+// image, the space is only reclaimed once every texture in it was freed.
+typedef struct {
+  VkImage image;
+  VkDeviceMemory memory;
+  VkImageView view;
+  bool written;
+  uint32_t shelf_y;
+  uint32_t shelf_height;
+  uint32_t cursor_x;
+  uint32_t texture_count;
+  // Offset and scale of every handle in the atlas, mapped for as long as the atlas lives
+  VkBuffer rect_buffer;
+  VkDeviceMemory rect_memory;
+  float (*rects)[4];
+} texture_atlas;
+
+// Texels on their way from a job to the render thread. data holds the levels back to back, or a whole
+// KTX2 file whose level index gives the offsets.
+typedef struct texture_upload texture_upload;
+
+struct texture_upload {
+  void *app;
+  char *path;
+  uint32_t slot;
+  uint32_t width;
+  uint32_t height;
+  VkFormat format;
+  uint32_t level_count;
+  uint64_t level_offsets[TEXTURE_MAX_LEVELS];
+  uint64_t level_sizes[TEXTURE_MAX_LEVELS];
+  bool generate_mips;
+  bool cached;
+  bool failed;
+  uint8_t *data;
+  uint64_t size;
+  texture_upload *next;
+};
+
+// A decoded image in the texture cache, followed by width * height RGBA8 pixels. The source's size and
+// modification time tell whether it is still current.
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t width;
+  uint32_t height;
+  uint64_t source_size;
+  int64_t source_mtime;
+} texture_cache_header;
+
+#define TEXTURE_CACHE_MAGIC 0x43585453u
+#define TEXTURE_CACHE_VERSION 1
+
+// A subtree drawn into an image of its own and composited as one textured quad while nothing in it
+// changes. Explicit layers come from strs_transform_set_layer, automatic ones are children of the root
+// that are only cached after layer_promote_frames frames without a change.
+typedef struct {
+  uint32_t transform;
+  bool automatic;
+  bool promoted;
+  // The subtree's draws were left out of the main pass by the last index rebuild
+  bool drawn;
+  // Something in the subtree changed since the image was drawn
+  bool dirty;
+  // The subtree follows the pointer, the image could not keep up with it
+  bool follows;
+  uint32_t stable_frames;
+  // Hash of the indices the subtree draws, and the vertices they reach
+  uint64_t signature;
+  uint32_t first_vertex;
+  uint32_t vertex_end;
+  // x0, y0, x1, y1 in the space of the layer's node
+  float bounds[4];
+  // World scale of the node when the image was drawn
+  float render_scale;
+  uint32_t width;
+  uint32_t height;
+  VkImage image;
+  VkDeviceMemory memory;
+  VkImageView view;
+  VkFramebuffer framebuffer;
+  uint32_t texture_slot;
+  uint64_t bytes;
+  // Opacity of the node when the composites were last written
+  float composite_opacity;
+} cached_layer;
+
+#define LAYER_NONE UINT32_MAX
+#define LAYER_MAX_SIZE 4096
+// The image is drawn again once the node is scaled further than this from the scale it was drawn at
+#define LAYER_RESCALE_RATIO 1.25f
+
+// Mirrors the push constants of the vertex shaders. Layers draw their subtree with clip in place of the
+// view, shapes drawn with active are layer composites and skip the animations. texture is the one
+// STRS_VERTEX_FORMAT_COMPACT_UV vertices sample.
+typedef struct {
+  float clip[16];
+  uint32_t active;
+  strs_texture texture;
+} layer_push_constants;
+
+// Mirrors the push constants of the vertex geometry's fragment shaders, placed after the vertex ones.
+// The rows map gl_FragCoord into the mask's space, fragments outside its rounded rect are discarded.
+#define MASK_PUSH_OFFSET 80
+
+typedef struct {
+  float rows[8];
+  float half_size[2];
+  float radius;
+  uint32_t active;
+} mask_push_constants;
+
+// A strs_app_spawn task, queued on the app once it finished
+typedef struct app_task app_task;
+
+struct app_task {
+  void *app;
+  PFN_strs_app_task task;
+  void *data;
+  PFN_strs_app_complete complete;
+  void *user_data;
+  void *result;
+  app_task *next;
+};
+
+#define VERTEX_FORMAT_COUNT 3
+
+// Everything the windows of a context share. The handles are copied into every app that adopts them.
+typedef struct {
+  VkAllocationCallbacks host_allocator;
+  uint64_t host_bytes;
+  uint64_t host_allocations;
+  uint64_t host_allocation_calls;
+
+  VkInstance instance;
+  VkPhysicalDevice physical_device;
+  strs_device_capabilities capabilities;
+  QueueFamilyIndices queue_families;
+  VkDevice logical_device;
+  VkQueue graphics_queue;
+  VkQueue present_queue;
+  // Queues are externally synchronized, every window submits, presents and waits for idle under this lock
+  pthread_mutex_t queue_lock;
+  VkPipelineCache pipeline_cache;
+  PFN_vkWaitForPresentKHR wait_for_present;
+  bool multi_draw_indirect;
+  bool draw_indirect_count;
+  bool draw_indirect_first_instance;
+  bool present_wait;
+  bool memory_budget_ext;
+  bool bindless_textures;
+  uint32_t max_draw_indexed_index_value;
+  uint32_t max_draw_indirect_count;
+  VkDeviceSize min_storage_buffer_offset_alignment;
+
+  // Created by the first window that needs them, the vertex shaders once per vertex format
+  VkShaderModule vert_shader_modules[VERTEX_FORMAT_COUNT];
+  VkShaderModule frag_shader_modules[VERTEX_FORMAT_COUNT];
+  VkShaderModule shape_vert_shader_module;
+  VkShaderModule shape_frag_shader_module;
+  VkShaderModule cull_shader_module;
+
+  // Every app of the context, apps_cond is signalled when the render thread stops drawing one
+  pthread_mutex_t apps_lock;
+  pthread_cond_t apps_cond;
+  void **apps;
+  uint64_t app_count;
+  uint64_t app_capacity;
+  pthread_t thread;
+  bool started;
+  bool running;
+  // Created for an app that was given no context
+  bool implicit;
+  strs_jobs jobs;
+} internal_strs_context;
+
 typedef struct {
   VkPipelineShaderStageCreateInfo shader_stages[2];
   VkVertexInputBindingDescription binding_description;
-  vk_vertex_input_attribute_description_array attribute_descriptions;
+  VkVertexInputAttributeDescription attribute_descriptions[MAX_VERTEX_ATTRIBUTES];
+  uint32_t attribute_description_count;
   VkPipelineVertexInputStateCreateInfo vertex_input_info;
   VkPipelineInputAssemblyStateCreateInfo input_assembly;
   VkPipelineViewportStateCreateInfo viewport_state;
@@ -54,18 +476,37 @@ typedef struct {
 } pipeline_config_info;
 
 typedef struct  {
-  strs_vertex *vertices;
+  uint8_t *vertices;
   uint64_t vertex_count;
-  uint16_t *indices;
+  uint64_t vertex_capacity;
+  strs_vertex_format vertex_format;
+  size_t vertex_stride;
+  uint32_t *indices;
   uint64_t index_count;
+  uint64_t index_capacity;
+  strs_index_width index_width;
 
   strs_widget *widgets;
+  widget_pool *widget_pools;
+  uint64_t widget_pool_count;
+  uint64_t widget_pool_capacity;
 
   strs_window window;
 
+  internal_strs_context *context;
+  // Drawn by its own thread from strs_app_run, otherwise by the context's
+  bool own_thread;
+  // Set by the context's render thread once it stopped drawing the closed window
+  bool closed;
+  // strs_app_close, read by the render thread
+  bool close_requested;
+  // strs_app_options.device, only read while the app is created
+  const char *preferred_device;
+
   VkInstance instance;
   VkSurfaceKHR surface;
   VkPhysicalDevice physical_device;
+  QueueFamilyIndices queue_families;
 
   VkDevice logical_device;
   VkQueue present_queue;
@@ -81,12 +522,17 @@ typedef struct  {
 
   VkShaderModule vert_shader_module;
   VkShaderModule frag_shader_module;
+  VkShaderModule shape_vert_shader_module;
+  VkShaderModule shape_frag_shader_module;
 
   VkDescriptorSetLayout descriptor_set_layout;
 
   pipeline_config_info pipeline_config;
   VkPipelineLayout pipeline_layout;
+  VkPipelineCache pipeline_cache;
   VkPipeline pipeline;
+  pipeline_config_info shape_pipeline_config;
+  VkPipeline shape_pipeline;
   VkFramebuffer *swap_chain_frame_buffers;
   VkCommandPool command_pool;
 
@@ -94,6 +540,10 @@ typedef struct  {
   VkDescriptorSet *descriptor_sets;
 
   VkCommandBuffer *command_buffers;
+  bool command_buffers_dirty;
+  // Set by strs_set_vertex_texture from any thread, the render thread records the buffers with the other
+  strs_texture vertex_texture;
+  strs_texture drawn_vertex_texture;
 
   VkSemaphore *image_available_semaphores;
   VkSemaphore *render_finished_semaphores;
@@ -102,24 +552,258 @@ typedef struct  {
 
   vulkan_buffer vertex_buffer;
   vulkan_buffer index_buffer;
+  VkIndexType index_type;
+
+  // SDF shapes, one instance each
+  strs_shape *shapes;
+  uint64_t shape_count;
+  uint64_t shape_capacity;
+  vulkan_buffer shape_buffer;
+
+  // Animations, every shape heads a list of tracks that the shape vertex shader walks
+  animation_track *animation_tracks;
+  uint64_t animation_track_count;
+  uint64_t animation_track_capacity;
+  uint32_t animation_free;
+  uint32_t *animation_heads;
+  uint64_t animation_head_capacity;
+  vulkan_buffer animation_track_buffer;
+  vulkan_buffer animation_head_buffer;
+
+  // Transform hierarchy, node 0 is the root. Draws pick their node through firstInstance.
+  transform_node *transform_nodes;
+  uint64_t transform_count;
+  uint64_t transform_capacity;
+  transform_world *transform_worlds;
+  uint64_t transform_world_capacity;
+  uint32_t transform_free;
+  uint32_t *transform_dirty;
+  uint64_t transform_dirty_count;
+  uint64_t transform_dirty_capacity;
+  uint32_t current_transform;
+  vulkan_buffer transform_buffer;
+
+  // One command per batch of indices that shares a base vertex
+  VkDrawIndexedIndirectCommand *draw_commands;
+  uint64_t draw_command_count;
+  uint64_t draw_command_capacity;
+  VkBuffer indirect_buffer;
+  VkDeviceMemory indirect_buffer_memory;
+  void *indirect_data;
+  uint64_t indirect_capacity;
+
+  bool multi_draw_indirect;
+  bool draw_indirect_count;
+  bool draw_indirect_first_instance;
+  bool present_wait;
+  bool bindless_textures;
+  uint32_t max_draw_indexed_index_value;
+  uint32_t max_draw_indirect_count;
+  VkDeviceSize min_storage_buffer_offset_alignment;
+
+  draw_item *draw_items;
+  uint64_t draw_item_count;
+  uint64_t draw_item_capacity;
+  bool draw_item_open;
+
+  // Every distinct clip pushed so far, the stack holds the 1 based regions of the open ones
+  clip_region *clip_regions;
+  uint64_t clip_region_count;
+  uint64_t clip_region_capacity;
+  uint32_t *clip_stack;
+  uint64_t clip_stack_count;
+  uint64_t clip_stack_capacity;
+  // In step with draw_commands
+  draw_batch *draw_batches;
+  uint64_t draw_batch_capacity;
+  scissor_run *scissor_runs;
+  uint64_t scissor_run_count;
+  uint64_t scissor_run_capacity;
+  strs_clip_stats clip_stats;
+
+  // Scene snapshots, only with manual_publish. The ranges in bytes were changed since the last publish.
+  bool manual_publish;
+  strs_capture capture;
+  scene_view scene;
+  bool scene_changed[SCENE_STREAM_COUNT];
+  uint64_t scene_dirty_begin[SCENE_STREAM_COUNT];
+  uint64_t scene_dirty_end[SCENE_STREAM_COUNT];
+  // The chunks of the last publish, the next one shares those outside the dirty ranges
+  snapshot_stream published_streams[SCENE_STREAM_COUNT];
+  // Scratch memory of strs_app_publish, in place of the frame arena
+  strs_arena publish_arena;
+  scene_snapshot *pending_snapshot;
+  // Render thread only, the snapshot it draws copied into contiguous arrays
+  scene_snapshot *drawn_snapshot;
+  uint8_t *scene_copies[SCENE_STREAM_COUNT];
+  uint64_t scene_copy_capacities[SCENE_STREAM_COUNT];
+  strs_snapshot_stats snapshot_stats;
+
+  // GPU culling
+  bool gpu_culling;
+  float cull_viewport[4];
+  strs_cull_stats cull_stats;
+  cull_record *cull_records;
+  uint64_t cull_record_count;
+  uint64_t cull_record_capacity;
+  VkShaderModule cull_shader_module;
+  VkDescriptorSetLayout cull_descriptor_set_layout;
+  VkPipelineLayout cull_pipeline_layout;
+  VkPipeline cull_pipeline;
+  VkDescriptorSet *cull_descriptor_sets;
+  uint64_t cull_buffer_capacity;
+  uint32_t cull_buffer_images;
+  VkBuffer cull_record_buffer;
+  VkDeviceMemory cull_record_memory;
+  void *cull_record_data;
+  VkBuffer culled_draw_buffer;
+  VkDeviceMemory culled_draw_memory;
+  VkDeviceSize culled_draw_stride;
+  VkBuffer cull_count_buffer;
+  VkDeviceMemory cull_count_memory;
+  VkDeviceSize cull_count_stride;
+  uint8_t *cull_counts;
 
   VkBuffer *uniform_buffers;
   VkDeviceMemory *uniform_buffers_memory;
 
-  VkImage texture_image;
-  VkDeviceMemory texture_image_memory;
+  // Device memory by category, the swap chain images are estimated
+  memory_allocation *memory_allocations;
+  uint64_t memory_allocation_count;
+  uint64_t memory_allocation_capacity;
+  uint64_t memory_bytes[STRS_MEMORY_CATEGORY_COUNT];
+  uint64_t memory_evicted;
+  uint64_t memory_budget;
+  PFN_strs_memory_pressure memory_pressure_callback;
+  void *memory_pressure_data;
+  bool memory_pressure;
+  bool memory_budget_ext;
+  uint32_t memory_poll_frame;
+  uint64_t device_budget_bytes;
+  uint64_t device_usage_bytes;
+
+  // Host memory. Every Vulkan object is created with the context's allocator so the driver's allocations are
+  // counted, the counters are updated atomically because drivers allocate from any thread.
+  VkAllocationCallbacks host_allocator;
+  // Transient allocations of each frame in flight, reset once its fence was waited on
+  strs_arena *frame_arenas;
+  // The arrays with one entry per swap chain image, reset when the swap chain is recreated
+  strs_arena swap_chain_arena;
+
+  // Textures, handles are the slot + 1. texture_lock guards the slots and what waits for the render thread.
+  pthread_mutex_t texture_lock;
+  texture *textures;
+  uint64_t texture_count;
+  uint64_t texture_capacity;
+  uint32_t texture_free;
+  texture_upload *texture_uploads;
+  strs_pool texture_upload_pool;
+  uint32_t *texture_releases;
+  uint64_t texture_release_count;
+  uint64_t texture_release_capacity;
+  VkSampler texture_sampler;
+  char *texture_cache;
+  // Set 1 of the pipeline layout, what shapes sample. Bindless it holds the view of every handle, otherwise
+  // the atlas and the rect of every handle in it.
+  VkDescriptorSetLayout texture_set_layout;
+  VkDescriptorPool texture_descriptor_pool;
+  VkDescriptorSet texture_set;
+  // White, sampled through handle 0 and by textures that are not ready
+  texture placeholder_texture;
+  texture_atlas atlas;
+
+  // Cached layers, render thread only but for the counters the builder keeps of its layer nodes
+  cached_layer *layers;
+  uint64_t layer_count;
+  uint64_t layer_capacity;
+  // The layer every node is drawn into, LAYER_NONE outside of layers
+  uint32_t *transform_layers;
+  uint64_t transform_layer_count;
+  uint64_t transform_layer_capacity;
+  bool layers_changed;
+  uint32_t layer_nodes;
+  uint32_t layer_promote_frames;
+  // Compatible with render_pass, the image ends up ready to be sampled
+  VkRenderPass layer_render_pass;
+  // One strs_shape per cached layer, drawn between the shapes and the geometry. Every swap chain image has
+  // a buffer of its own that is written once its fence signaled, so a fade never waits for the queue.
+  VkBuffer *layer_composite_buffers;
+  VkDeviceMemory *layer_composite_memories;
+  uint32_t layer_composite_images;
+  uint64_t layer_composite_capacity;
+  uint32_t layer_composite_count;
+  bool layer_composites_dirty;
+  // Bumped when the composites change, images whose buffer is behind write it again
+  uint64_t layer_composite_version;
+  uint64_t *layer_composite_image_versions;
+  strs_layer_stats layer_stats;
 
   size_t current_frame;
   bool frame_buffer_resized;
 
+  // Input latency, latency_lock guards the pointer, the queue, the samples and the input handlers.
+  // present_lock keeps the swap chain alive while the latency thread waits on it.
+  pthread_mutex_t latency_lock;
+  pthread_cond_t latency_cond;
+  pthread_mutex_t present_lock;
+  pthread_t latency_thread;
+  bool latency_stop;
+  PFN_vkWaitForPresentKHR wait_for_present;
+  uint64_t present_id;
+  float pointer[2];
+  uint64_t pending_input_ns;
+  PFN_strs_sample_pointer sample_pointer;
+  void *sample_pointer_data;
+  // Only the render thread pops
+  strs_input_ring input;
+  PFN_strs_input_handler input_handler;
+  PFN_strs_input_history input_history;
+  void *input_data;
+  // Tasks that finished wait here in order until the thread that builds the scene completes them
+  pthread_mutex_t task_lock;
+  app_task *finished_tasks;
+  app_task *finished_tasks_last;
+  uint64_t running_tasks;
+  // Input shown by the frame that last used each fence, when present_wait is missing
+  uint64_t *frame_input_ns;
+  latency_frame latency_frames[LATENCY_QUEUE_SIZE];
+  uint32_t latency_frame_first;
+  uint32_t latency_frame_count;
+  uint64_t latency_samples[STRS_LATENCY_SAMPLE_COUNT];
+  uint64_t latency_sample_count;
+
   // PThread
   pthread_t thread;
+
+  // Startup
+  strs_startup_timings startup_timings;
+  uint64_t startup_begin;
+  strs_job shader_loader;
+  char *vert_shader_code;
+  long vert_shader_size;
+  char *frag_shader_code;
+  long frag_shader_size;
+  char *frag_bindless_shader_code;
+  long frag_bindless_shader_size;
+  char *cull_shader_code;
+  long cull_shader_size;
+  char *shape_vert_shader_code;
+  long shape_vert_shader_size;
+  char *shape_frag_shader_code;
+  long shape_frag_shader_size;
+  char *shape_bindless_frag_shader_code;
+  long shape_bindless_frag_shader_size;
 } internal_strs_app;
 
 typedef struct {
   mat4 model;
   mat4 view;
   mat4 proj;
+  vec4 viewport;
+  // x, y, written right before submit
+  vec4 pointer;
+  // Seconds since the app was created
+  float time;
 } UniformBufferObject;
 
 typedef struct {
@@ -130,21 +814,25 @@ typedef struct {
   uint32_t presentModesSize;
 } SwapChainSupportDetails;
 
-typedef struct {
-  option_uint graphics_family;
-  option_uint present_family;
-} QueueFamilyIndices;
-
 static bool init = false;
 static const char *validation_layers[] = {"VK_LAYER_KHRONOS_validation"};
 static const char *device_extensions[] = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
-static float time_passed;
 
 STRS_INTERN void *multithread_create_app(void *data);
 
+typedef void (*startup_step)(internal_strs_app *app);
+STRS_INTERN void run_startup_stage(internal_strs_app *app, strs_startup_stage stage, startup_step step);
+STRS_INTERN void load_shader_code(void *data);
+STRS_INTERN void create_presentation_chain(void *data);
+
 STRS_INTERN void draw_frame(internal_strs_app *app);
+STRS_INTERN void dispatch_input(internal_strs_app *app);
+STRS_INTERN void run_widget_passes(internal_strs_app *app);
+STRS_INTERN void complete_tasks(internal_strs_app *app);
+STRS_INTERN void take_snapshot(internal_strs_app *app);
+STRS_INTERN void view_building_scene(internal_strs_app *app);
 STRS_INTERN void recreate_swap_chain(internal_strs_app *app);
 STRS_INTERN void cleanup_swap_chain(internal_strs_app *app);
 STRS_INTERN void create_instance(internal_strs_app *app);
@@ -154,14 +842,46 @@ STRS_INTERN void create_logical_device(internal_strs_app *app);
 STRS_INTERN void create_swap_chain(internal_strs_app *app);
 STRS_INTERN void create_image_views(internal_strs_app *app);
 STRS_INTERN void create_render_pass(internal_strs_app *app);
+STRS_INTERN VkShaderModule create_shader_module(internal_strs_app *app, char **code, size_t size);
 STRS_INTERN void create_shader_modules(internal_strs_app *app);
 STRS_INTERN void create_descriptor_set_layout(internal_strs_app *app);
 STRS_INTERN void create_graphics_pipeline(internal_strs_app *app);
 STRS_INTERN void create_frame_buffers(internal_strs_app *app);
 STRS_INTERN void create_command_pool(internal_strs_app *app);
-STRS_INTERN void create_texture_image(internal_strs_app *app);
+STRS_INTERN void upload_textures(internal_strs_app *app);
+STRS_INTERN void create_texture_set(internal_strs_app *app);
+STRS_INTERN bool drawn_from_layer(internal_strs_app *app, uint32_t transform);
+STRS_INTERN void release_layer_images(internal_strs_app *app);
+STRS_INTERN void rebuild_layers(internal_strs_app *app);
+STRS_INTERN void mark_layers_transforms(internal_strs_app *app);
+STRS_INTERN void update_layers(internal_strs_app *app, uint32_t image);
 STRS_INTERN void create_vertex_buffer(internal_strs_app *app);
+STRS_INTERN void create_staged_buffer(internal_strs_app *app, vulkan_buffer *buffer, VkBufferUsageFlags usage,
+                                      const void *src, VkDeviceSize contents_size, VkDeviceSize buffer_size);
+STRS_INTERN void create_animation_buffers(internal_strs_app *app);
+STRS_INTERN void write_animation_descriptor_sets(internal_strs_app *app);
+STRS_INTERN void update_animation_buffers(internal_strs_app *app);
+STRS_INTERN void create_transform_buffer(internal_strs_app *app);
+STRS_INTERN void write_transform_descriptor_sets(internal_strs_app *app);
+STRS_INTERN void flatten_transforms(internal_strs_app *app);
+STRS_INTERN void update_transform_buffer(internal_strs_app *app);
+STRS_INTERN void *latency_waiter(void *data);
+STRS_INTERN uint64_t latch_input(internal_strs_app *app, uint32_t image);
+STRS_INTERN void record_latency(internal_strs_app *app, uint64_t latency_ns);
+STRS_INTERN bool has_extension(const VkExtensionProperties *extensions, uint32_t count, const char *name);
+STRS_INTERN double app_seconds(internal_strs_app *app);
 STRS_INTERN void create_index_buffer(internal_strs_app *app);
+STRS_INTERN void create_indirect_buffer(internal_strs_app *app);
+STRS_INTERN void create_cull_pipeline(internal_strs_app *app);
+STRS_INTERN void create_cull_buffers(internal_strs_app *app);
+STRS_INTERN void destroy_cull_buffers(internal_strs_app *app);
+STRS_INTERN void write_cull_descriptor_sets(internal_strs_app *app);
+STRS_INTERN void record_cull_pass(internal_strs_app *app, VkCommandBuffer command_buffer, size_t image);
+STRS_INTERN void build_cull_records(internal_strs_app *app, uint64_t index_count);
+STRS_INTERN draw_item *current_draw_item(internal_strs_app *app);
+STRS_INTERN void close_draw_item(internal_strs_app *app);
+STRS_INTERN void remove_item_indices(internal_strs_app *app, uint64_t first, uint64_t count);
+STRS_INTERN void vertex_position(internal_strs_app *app, uint64_t index, float *position);
 STRS_INTERN void create_uniform_buffers(internal_strs_app *app);
 STRS_INTERN void create_descriptor_pool(internal_strs_app *app);
 STRS_INTERN void create_descriptor_sets(internal_strs_app *app);
@@ -170,63 +890,119 @@ STRS_INTERN void create_sync_objects(internal_strs_app *app);
 
 STRS_INTERN void update_uniform_buffers(internal_strs_app *app, uint32_t current_image);
 STRS_INTERN void update_vertex_buffer(internal_strs_app *app);
+STRS_INTERN void update_shape_buffer(internal_strs_app *app);
+STRS_INTERN void upload_dirty_range(internal_strs_app *app, vulkan_buffer *buffer, const uint8_t *src, VkDeviceSize size);
 STRS_INTERN void update_index_buffer(internal_strs_app *app);
 
 STRS_INTERN void destroy_buffer(internal_strs_app *app, vulkan_buffer* buffer);
+STRS_INTERN void destroy_indirect_buffer(internal_strs_app *app);
+STRS_INTERN uint64_t build_draw_commands(internal_strs_app *app, uint64_t index_count, uint32_t limit, void *dst);
 
-STRS_INTERN VkVertexInputBindingDescription get_binding_description();
-STRS_INTERN inline vk_vertex_input_attribute_description_array get_attribute_descriptions();
+STRS_INTERN VkVertexInputBindingDescription get_binding_description(strs_vertex_format format);
+STRS_INTERN uint32_t get_attribute_descriptions(strs_vertex_format format,
+                                                VkVertexInputAttributeDescription *attribute_descriptions);
 
 STRS_INTERN uint32_t find_memory_type(VkPhysicalDevice physical_device,
                                       uint32_t type_filter,
                                       VkMemoryPropertyFlags properties);
 
 STRS_INTERN char *read_shader(const char *filename, long *size);
-STRS_INTERN void swap_chain_support_details_free(SwapChainSupportDetails *ptr);
 STRS_INTERN uint32_t clamp_uint(uint32_t d, uint32_t min, uint32_t max);
-STRS_INTERN QueueFamilyIndices find_queue_family_indices(VkPhysicalDevice physical_device, VkSurfaceKHR surface);
+STRS_INTERN QueueFamilyIndices find_queue_family_indices(strs_arena *arena, VkPhysicalDevice physical_device,
+                                                         VkSurfaceKHR surface);
 STRS_INTERN bool queue_family_indices_is_complete(QueueFamilyIndices *indices);
-STRS_INTERN bool check_device_extension_support(VkPhysicalDevice device);
-STRS_INTERN SwapChainSupportDetails query_swap_chain_support(VkPhysicalDevice device, VkSurfaceKHR surface);
-STRS_INTERN void create_buffer(internal_strs_app *app, VkDeviceSize size,
+STRS_INTERN bool query_device_capabilities(strs_arena *arena, VkPhysicalDevice device, VkSurfaceKHR surface,
+                                           strs_device_capabilities *capabilities);
+STRS_INTERN SwapChainSupportDetails query_swap_chain_support(strs_arena *arena, VkPhysicalDevice device,
+                                                             VkSurfaceKHR surface);
+STRS_INTERN strs_arena *frame_arena(internal_strs_app *app);
+STRS_INTERN strs_arena *build_arena(internal_strs_app *app);
+STRS_INTERN void adopt_device(internal_strs_app *app);
+STRS_INTERN void queue_submit(internal_strs_app *app, const VkSubmitInfo *submit_info, VkFence fence);
+STRS_INTERN void device_wait_idle(internal_strs_app *app);
+STRS_INTERN void create_buffer(internal_strs_app *app, strs_memory_category category, VkDeviceSize size,
                                VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
                                VkBuffer *buffer, VkDeviceMemory *bufferMemory);
+STRS_INTERN VkDeviceMemory allocate_memory(internal_strs_app *app, strs_memory_category category,
+                                           VkMemoryRequirements requirements, VkMemoryPropertyFlags properties);
+STRS_INTERN void free_memory(internal_strs_app *app, VkDeviceMemory memory);
+STRS_INTERN void release_staging(internal_strs_app *app, vulkan_buffer *buffer);
+STRS_INTERN void query_memory_budget(internal_strs_app *app);
+STRS_INTERN void check_memory_pressure(internal_strs_app *app);
+STRS_INTERN void *VKAPI_PTR host_allocate(void *user_data, size_t size, size_t alignment,
+                                          VkSystemAllocationScope scope);
+STRS_INTERN void *VKAPI_PTR host_reallocate(void *user_data, void *original, size_t size, size_t alignment,
+                                            VkSystemAllocationScope scope);
+STRS_INTERN void VKAPI_PTR host_free(void *user_data, void *memory);
 STRS_INTERN void copy_buffer(internal_strs_app *app, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+STRS_INTERN void copy_buffer_region(internal_strs_app *app, VkBuffer srcBuffer, VkBuffer dstBuffer,
+                                    VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize size);
+STRS_INTERN void mark_buffer_dirty(vulkan_buffer *buffer, VkDeviceSize begin, VkDeviceSize end);
+STRS_INTERN void mark_scene_dirty(internal_strs_app *app, scene_stream stream, uint64_t begin, uint64_t end);
+STRS_INTERN void capture_call(internal_strs_app *app, strs_call call, const uint64_t *args, uint32_t arg_count,
+                              const void *data, uint64_t size);
 STRS_INTERN void fill_config_info(internal_strs_app *app);
+STRS_INTERN void fill_shape_config_info(internal_strs_app *app);
 void endSingleTimeCommands(internal_strs_app *app, VkCommandBuffer commandBuffer);
 VkCommandBuffer beginSingleTimeCommands(internal_strs_app *app);
-void createImage(internal_strs_app *app, uint32_t width, uint32_t height,
+void createImage(internal_strs_app *app, uint32_t width, uint32_t height, uint32_t mipLevels,
                  VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
                  VkMemoryPropertyFlags properties, VkImage *image,
                  VkDeviceMemory *imageMemory);
 
-STRS_INTERN inline double degrees_to_radians(double degrees) {
-  return degrees * M_PI / 180.0;
-}
-
-STRS_INTERN inline vk_vertex_input_attribute_description_array get_attribute_descriptions() {
-  vk_vertex_input_attribute_description_array attribute_descriptions;
-  attribute_descriptions = (vk_vertex_input_attribute_description_array){
-    .array = {
-      {.binding = 0,
+STRS_INTERN uint32_t get_attribute_descriptions(strs_vertex_format format,
+                                                VkVertexInputAttributeDescription *attribute_descriptions) {
+  switch (format) {
+    case STRS_VERTEX_FORMAT_COMPACT:
+      attribute_descriptions[0] = (VkVertexInputAttributeDescription){
+        .binding = 0,
+        .location = 0,
+        .format = VK_FORMAT_R16G16_SSCALED,
+        .offset = offsetof(strs_vertex_compact, pos)};
+      attribute_descriptions[1] = (VkVertexInputAttributeDescription){
+        .binding = 0,
+        .location = 1,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .offset = offsetof(strs_vertex_compact, color)};
+      return 2;
+    case STRS_VERTEX_FORMAT_COMPACT_UV:
+      attribute_descriptions[0] = (VkVertexInputAttributeDescription){
+        .binding = 0,
+        .location = 0,
+        .format = VK_FORMAT_R16G16_SSCALED,
+        .offset = offsetof(strs_vertex_compact_uv, pos)};
+      attribute_descriptions[1] = (VkVertexInputAttributeDescription){
+        .binding = 0,
+        .location = 1,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .offset = offsetof(strs_vertex_compact_uv, color)};
+      attribute_descriptions[2] = (VkVertexInputAttributeDescription){
+        .binding = 0,
+        .location = 2,
+        .format = VK_FORMAT_R16G16_UNORM,
+        .offset = offsetof(strs_vertex_compact_uv, uv)};
+      return 3;
+    default:
+      attribute_descriptions[0] = (VkVertexInputAttributeDescription){
+        .binding = 0,
         .location = 0,
         .format = VK_FORMAT_R32G32_SFLOAT,
-        .offset = offsetof(strs_vertex, pos)},
-      {.binding = 0,
+        .offset = offsetof(strs_vertex, pos)};
+      attribute_descriptions[1] = (VkVertexInputAttributeDescription){
+        .binding = 0,
         .location = 1,
         .format = VK_FORMAT_R32G32B32_SFLOAT,
-        .offset = offsetof(strs_vertex, color)}},
-    .size = 2};
-
-  return attribute_descriptions;
+        .offset = offsetof(strs_vertex, color)};
+      return 2;
+  }
 }
 
-STRS_INTERN VkVertexInputBindingDescription get_binding_description() {
+STRS_INTERN VkVertexInputBindingDescription get_binding_description(strs_vertex_format format) {
   VkVertexInputBindingDescription bindingDescription;
 
   bindingDescription = (VkVertexInputBindingDescription){
     .binding = 0,
-    .stride = sizeof(strs_vertex),
+    .stride = strs_vertex_format_size(format),
     .inputRate = VK_VERTEX_INPUT_RATE_VERTEX};
 
   return bindingDescription;
@@ -276,17 +1052,12 @@ STRS_INTERN char *read_shader(const char *filename, long *size) {
   return file_contents;
 }
 
-STRS_INTERN void swap_chain_support_details_free(SwapChainSupportDetails *ptr) {
-  free(ptr->presentModes);
-  assert(ptr->formats != NULL);
-  free(ptr->formats);
-}
-
 STRS_INTERN bool queue_family_indices_is_complete(QueueFamilyIndices *indices) {
   return indices->graphics_family.has_value && indices->present_family.has_value;
 }
 
-STRS_INTERN QueueFamilyIndices find_queue_family_indices(VkPhysicalDevice physical_device, VkSurfaceKHR surface) {
+STRS_INTERN QueueFamilyIndices find_queue_family_indices(strs_arena *arena, VkPhysicalDevice physical_device,
+                                                         VkSurfaceKHR surface) {
   QueueFamilyIndices queue_family_indices;
   uint32_t queue_family_count;
   VkQueueFamilyProperties *queue_families;
@@ -297,7 +1068,7 @@ STRS_INTERN QueueFamilyIndices find_queue_family_indices(VkPhysicalDevice physic
   queue_family_count = 0;
   vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, NULL);
 
-  queue_families = malloc(sizeof(VkQueueFamilyProperties) * queue_family_count);
+  queue_families = strs_arena_alloc(arena, sizeof(VkQueueFamilyProperties) * queue_family_count);
   vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_families);
 
   for (int i = 0; i < queue_family_count; i++) {
@@ -316,32 +1087,22 @@ STRS_INTERN QueueFamilyIndices find_queue_family_indices(VkPhysicalDevice physic
       break;
     }
   }
-  free(queue_families);
   return queue_family_indices;
 }
 
-STRS_INTERN bool check_device_extension_support(VkPhysicalDevice device) { // TODO: Finish this function
-  /*uint32_t extensionCount;
-  vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, NULL);
-
-  VkExtensionProperties *availableExtensions = malloc(extensionCount);
-  vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, availableExtensions);
-
-  for(int i = 0; i < extensionCount; i++) {
-      if (device_extensions[0] == availableExtensions[i].extensionName) {
-          free(availableExtensions);
-          return true;
-      }
+STRS_INTERN bool has_extension(const VkExtensionProperties *extensions, uint32_t count, const char *name) {
+  for (uint32_t i = 0; i < count; i++) {
+    if (strcmp(extensions[i].extensionName, name) == 0) {
+      return true;
+    }
   }
-
-  free(availableExtensions);
-  return false;*/
-
-  return true;
+  return false;
 }
 
-STRS_INTERN SwapChainSupportDetails query_swap_chain_support(VkPhysicalDevice device, VkSurfaceKHR surface) {
-  SwapChainSupportDetails details;
+// The format and present mode lists live in arena
+STRS_INTERN SwapChainSupportDetails query_swap_chain_support(strs_arena *arena, VkPhysicalDevice device,
+                                                             VkSurfaceKHR surface) {
+  SwapChainSupportDetails details = {0};
   vkGetPhysicalDeviceSurfaceCapabilitiesKHR(device, surface, &details.capabilities);
 
   uint32_t formatCount;
@@ -349,7 +1110,7 @@ STRS_INTERN SwapChainSupportDetails query_swap_chain_support(VkPhysicalDevice de
 
   if (formatCount != 0) {
     details.formatsSize = formatCount;
-    details.formats = malloc(sizeof(VkSurfaceFormatKHR) * formatCount);
+    details.formats = strs_arena_alloc(arena, sizeof(VkSurfaceFormatKHR) * formatCount);
     vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &formatCount, details.formats);
   }
 
@@ -358,28 +1119,135 @@ STRS_INTERN SwapChainSupportDetails query_swap_chain_support(VkPhysicalDevice de
 
   if (presentModeCount != 0) {
     details.presentModesSize = presentModeCount;
-    details.presentModes = malloc(sizeof(uint32_t) * presentModeCount);
+    details.presentModes = strs_arena_alloc(arena, sizeof(uint32_t) * presentModeCount);
     vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &presentModeCount, details.presentModes);
   }
 
   return details;
 }
 
-STRS_INTERN bool is_device_suitable(VkPhysicalDevice physical_device, VkSurfaceKHR surface) {
-  QueueFamilyIndices queueFamilyIndices = find_queue_family_indices(physical_device, surface);
+// Fills in what the device supports and scores it, returns false when it can not draw to the surface at all
+STRS_INTERN bool query_device_capabilities(strs_arena *arena, VkPhysicalDevice device, VkSurfaceKHR surface,
+                                           strs_device_capabilities *capabilities) {
+  VkPhysicalDeviceProperties properties;
+  VkPhysicalDeviceFeatures features;
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  vkGetPhysicalDeviceProperties(device, &properties);
+  vkGetPhysicalDeviceFeatures(device, &features);
+  vkGetPhysicalDeviceMemoryProperties(device, &memoryProperties);
+
+  *capabilities = (strs_device_capabilities){
+    .vendor_id = properties.vendorID,
+    .device_id = properties.deviceID,
+    .type = (strs_device_type) properties.deviceType,
+    .api_version = properties.apiVersion,
+    .multi_draw_indirect = features.multiDrawIndirect,
+    .draw_indirect_first_instance = features.drawIndirectFirstInstance,
+    .texture_compression_bc = features.textureCompressionBC};
+  memcpy(capabilities->name, properties.deviceName, sizeof(capabilities->name));
+  capabilities->name[sizeof(capabilities->name) - 1] = '\0';
+
+  for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+    if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      capabilities->device_local_bytes += memoryProperties.memoryHeaps[i].size;
+    }
+  }
+
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, NULL);
+  VkQueueFamilyProperties *families = strs_arena_alloc(arena, sizeof(VkQueueFamilyProperties) * familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, families);
+  for (uint32_t i = 0; i < familyCount; i++) {
+    VkQueueFlags flags = families[i].queueFlags;
+    capabilities->dedicated_transfer_queue |=
+      (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+  }
+
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, NULL);
+  VkExtensionProperties *extensions = strs_arena_alloc(arena, sizeof(VkExtensionProperties) * extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, NULL, &extensionCount, extensions);
+
+  bool extensionsSupported = true;
+  for (size_t i = 0; i < sizeof(device_extensions) / sizeof(const char *); i++) {
+    extensionsSupported = extensionsSupported && has_extension(extensions, extensionCount, device_extensions[i]);
+  }
+  capabilities->incremental_present =
+    has_extension(extensions, extensionCount, VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME);
+  capabilities->memory_budget = properties.apiVersion >= VK_API_VERSION_1_1 &&
+                                has_extension(extensions, extensionCount, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+  if (properties.apiVersion >= VK_API_VERSION_1_2) {
+    VkPhysicalDeviceVulkan12Features features12 = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceFeatures2 features2 = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext = &features12};
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+    capabilities->draw_indirect_count = features12.drawIndirectCount;
+    capabilities->timeline_semaphore = features12.timelineSemaphore;
+    // What an unbounded, partially bound array of sampled images indexed per draw needs
+    capabilities->descriptor_indexing = features12.descriptorIndexing && features12.runtimeDescriptorArray &&
+                                        features12.shaderSampledImageArrayNonUniformIndexing &&
+                                        features12.descriptorBindingPartiallyBound &&
+                                        features12.descriptorBindingVariableDescriptorCount &&
+                                        features12.descriptorBindingSampledImageUpdateAfterBind;
+  }
 
-  bool extensionsSupported = check_device_extension_support(physical_device);
+  if (properties.apiVersion >= VK_API_VERSION_1_1 &&
+      has_extension(extensions, extensionCount, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+      has_extension(extensions, extensionCount, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR};
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+      .pNext = &presentWaitFeatures};
+    VkPhysicalDeviceFeatures2 features2 = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+      .pNext = &presentIdFeatures};
+    vkGetPhysicalDeviceFeatures2(device, &features2);
+    capabilities->present_wait = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+  }
 
+  // The device type decides, a discrete GPU always wins over an integrated one on hybrid laptops.
+  // Among the same type more device local memory wins, then the optional features.
+  static const uint64_t typeScores[] = {
+    [VK_PHYSICAL_DEVICE_TYPE_OTHER] = 1,
+    [VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU] = 3,
+    [VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU] = 4,
+    [VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU] = 2,
+    [VK_PHYSICAL_DEVICE_TYPE_CPU] = 0};
+  uint64_t score = properties.deviceType <= VK_PHYSICAL_DEVICE_TYPE_CPU ? typeScores[properties.deviceType] : 0;
+  score = score << 48;
+  // In MiB, far below the device type for any real heap
+  score += (capabilities->device_local_bytes >> 20) << 8;
+  score += capabilities->dedicated_transfer_queue ? 16 : 0;
+  score += capabilities->multi_draw_indirect + capabilities->draw_indirect_count +
+           capabilities->draw_indirect_first_instance + capabilities->present_wait + capabilities->memory_budget +
+           capabilities->timeline_semaphore + capabilities->descriptor_indexing +
+           capabilities->texture_compression_bc;
+  capabilities->score = score;
+
+  QueueFamilyIndices queueFamilyIndices = find_queue_family_indices(arena, device, surface);
   bool swapChainAdequate = false;
   if (extensionsSupported) {
-    SwapChainSupportDetails swapChainSupport = query_swap_chain_support(physical_device, surface);
+    SwapChainSupportDetails swapChainSupport = query_swap_chain_support(arena, device, surface);
     swapChainAdequate = swapChainSupport.formats != NULL && swapChainSupport.presentModes != NULL;
-    swap_chain_support_details_free(&swapChainSupport);
   }
 
   return queue_family_indices_is_complete(&queueFamilyIndices) && swapChainAdequate;
 }
 
+// preferred is either the index of the device or a part of its name
+STRS_INTERN bool device_matches(const char *preferred, uint32_t index, const char *name) {
+  char *end;
+  unsigned long preferredIndex = strtoul(preferred, &end, 10);
+  if (end != preferred && *end == '\0') {
+    return preferredIndex == index;
+  }
+  return strstr(name, preferred) != NULL;
+}
+
 STRS_INTERN VkSurfaceFormatKHR chooseSwapSurfaceFormat(VkSurfaceFormatKHR *formats, uint32_t sizeOfArray) {
   for (uint32_t i = 0; i < sizeOfArray; i++) {
     if (formats[i].format == VK_FORMAT_B8G8R8A8_SRGB && formats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
@@ -420,7 +1288,8 @@ STRS_INTERN VkExtent2D chooseSwapExtent(VkSurfaceCapabilitiesKHR capabilities, s
   }
 }
 
-STRS_INTERN void create_buffer(internal_strs_app *app, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+STRS_INTERN void create_buffer(internal_strs_app *app, strs_memory_category category, VkDeviceSize size,
+                               VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
                                VkBuffer *buffer, VkDeviceMemory *bufferMemory) {
   VkBufferCreateInfo bufferInfo = {
     .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
@@ -428,24 +1297,201 @@ STRS_INTERN void create_buffer(internal_strs_app *app, VkDeviceSize size, VkBuff
     .usage = usage,
     .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
 
-  VkResult result = vkCreateBuffer(app->logical_device, &bufferInfo, NULL, buffer);
+  VkResult result = vkCreateBuffer(app->logical_device, &bufferInfo, &app->host_allocator, buffer);
   dbg_assert(result == VK_SUCCESS);
 
   VkMemoryRequirements memRequirements;
   vkGetBufferMemoryRequirements(app->logical_device, *buffer, &memRequirements);
 
+  *bufferMemory = allocate_memory(app, category, memRequirements, properties);
+
+  vkBindBufferMemory(app->logical_device, *buffer, *bufferMemory, 0);
+}
+
+STRS_INTERN VkDeviceMemory allocate_memory(internal_strs_app *app, strs_memory_category category,
+                                           VkMemoryRequirements requirements, VkMemoryPropertyFlags properties) {
   VkMemoryAllocateInfo allocInfo = {
     .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-    .allocationSize = memRequirements.size,
-    .memoryTypeIndex = find_memory_type(app->physical_device, memRequirements.memoryTypeBits, properties)};
+    .allocationSize = requirements.size,
+    .memoryTypeIndex = find_memory_type(app->physical_device, requirements.memoryTypeBits, properties)};
 
-  result = vkAllocateMemory(app->logical_device, &allocInfo, NULL, bufferMemory);
+  VkDeviceMemory memory;
+  VkResult result = vkAllocateMemory(app->logical_device, &allocInfo, &app->host_allocator, &memory);
   dbg_assert(result == VK_SUCCESS);
 
-  vkBindBufferMemory(app->logical_device, *buffer, *bufferMemory, 0);
+  app->memory_allocations = strs_grow_array(app->memory_allocations, &app->memory_allocation_capacity,
+                                       app->memory_allocation_count + 1, sizeof(memory_allocation));
+  app->memory_allocations[app->memory_allocation_count++] = (memory_allocation){
+    .memory = memory,
+    .size = requirements.size,
+    .category = category};
+  app->memory_bytes[category] += requirements.size;
+  return memory;
+}
+
+STRS_INTERN void free_memory(internal_strs_app *app, VkDeviceMemory memory) {
+  if (memory == VK_NULL_HANDLE) {
+    return;
+  }
+  for (uint64_t i = 0; i < app->memory_allocation_count; i++) {
+    memory_allocation *allocation = &app->memory_allocations[i];
+    if (allocation->memory == memory) {
+      app->memory_bytes[allocation->category] -= allocation->size;
+      *allocation = app->memory_allocations[--app->memory_allocation_count];
+      break;
+    }
+  }
+  vkFreeMemory(app->logical_device, memory, &app->host_allocator);
+}
+
+// The staging buffer only mirrors the CPU copy, uploads go through a temporary one until it is created again
+STRS_INTERN void release_staging(internal_strs_app *app, vulkan_buffer *buffer) {
+  if (buffer->stagingBuffer == VK_NULL_HANDLE) {
+    return;
+  }
+  app->memory_evicted += buffer->bufferSize;
+  vkUnmapMemory(app->logical_device, buffer->stagingBufferMemory);
+  vkDestroyBuffer(app->logical_device, buffer->stagingBuffer, &app->host_allocator);
+  free_memory(app, buffer->stagingBufferMemory);
+  buffer->stagingBuffer = VK_NULL_HANDLE;
+  buffer->stagingBufferMemory = VK_NULL_HANDLE;
+  buffer->data = NULL;
+}
+
+STRS_INTERN void query_memory_budget(internal_strs_app *app) {
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+  VkPhysicalDeviceMemoryProperties2 properties = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+    .pNext = &budget};
+  vkGetPhysicalDeviceMemoryProperties2(app->physical_device, &properties);
+
+  app->device_budget_bytes = 0;
+  app->device_usage_bytes = 0;
+  for (uint32_t i = 0; i < properties.memoryProperties.memoryHeapCount; i++) {
+    if (properties.memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      app->device_budget_bytes += budget.heapBudget[i];
+      app->device_usage_bytes += budget.heapUsage[i];
+    }
+  }
+}
+
+// Runs after the uploads of a frame, when no staging buffer is in use
+STRS_INTERN void check_memory_pressure(internal_strs_app *app) {
+  if (app->memory_budget_ext && app->memory_poll_frame++ % MEMORY_BUDGET_POLL_FRAMES == 0) {
+    query_memory_budget(app);
+  }
+
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < STRS_MEMORY_CATEGORY_COUNT; i++) {
+    total += app->memory_bytes[i];
+  }
+  bool pressure = (app->memory_budget != 0 && total > app->memory_budget) ||
+                  (app->memory_budget_ext && app->device_usage_bytes > app->device_budget_bytes);
+  bool began = pressure && !app->memory_pressure;
+  app->memory_pressure = pressure;
+  if (!pressure) {
+    return;
+  }
+
+  // Staging buffers of grown buffers come back, keep evicting while the pressure lasts.
+  // The index buffer is built in its staging buffer and stays.
+  release_staging(app, &app->vertex_buffer);
+  release_staging(app, &app->shape_buffer);
+  release_staging(app, &app->animation_head_buffer);
+  release_staging(app, &app->animation_track_buffer);
+  release_staging(app, &app->transform_buffer);
+
+  if (began && app->memory_pressure_callback != NULL) {
+    strs_memory_stats stats;
+    strs_app_get_memory_stats((strs_app)app, &stats);
+    app->memory_pressure_callback((strs_app)app, &stats, app->memory_pressure_data);
+  }
+}
+
+STRS_INTERN void *VKAPI_PTR host_allocate(void *user_data, size_t size, size_t alignment,
+                                          VkSystemAllocationScope scope) {
+  internal_strs_context *context = user_data;
+  alignment = alignment < sizeof(host_allocation) ? sizeof(host_allocation) : alignment;
+  uint8_t *memory = malloc(sizeof(host_allocation) + alignment + size);
+  if (memory == NULL) {
+    return NULL;
+  }
+
+  uint8_t *aligned = (uint8_t*) strs_align_up((uintptr_t) memory + sizeof(host_allocation), alignment);
+  ((host_allocation*)aligned)[-1] = (host_allocation){
+    .size = size,
+    .offset = aligned - memory};
+  __atomic_add_fetch(&context->host_bytes, size, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&context->host_allocations, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch(&context->host_allocation_calls, 1, __ATOMIC_RELAXED);
+  return aligned;
+}
+
+STRS_INTERN void *VKAPI_PTR host_reallocate(void *user_data, void *original, size_t size, size_t alignment,
+                                            VkSystemAllocationScope scope) {
+  if (original == NULL) {
+    return host_allocate(user_data, size, alignment, scope);
+  }
+  if (size == 0) {
+    host_free(user_data, original);
+    return NULL;
+  }
+
+  void *memory = host_allocate(user_data, size, alignment, scope);
+  if (memory == NULL) {
+    return NULL;
+  }
+  size_t originalSize = ((host_allocation*)original)[-1].size;
+  memcpy(memory, original, originalSize < size ? originalSize : size);
+  host_free(user_data, original);
+  return memory;
+}
+
+STRS_INTERN void VKAPI_PTR host_free(void *user_data, void *memory) {
+  internal_strs_context *context = user_data;
+  if (memory == NULL) {
+    return;
+  }
+  host_allocation allocation = ((host_allocation*)memory)[-1];
+  __atomic_sub_fetch(&context->host_bytes, allocation.size, __ATOMIC_RELAXED);
+  __atomic_sub_fetch(&context->host_allocations, 1, __ATOMIC_RELAXED);
+  free((uint8_t*)memory - allocation.offset);
+}
+
+// Only the thread that draws may use it, during startup the thread that creates the swap chain
+STRS_INTERN strs_arena *frame_arena(internal_strs_app *app) {
+  return &app->frame_arenas[app->current_frame];
+}
+
+// Input dispatch and the widget passes run in strs_app_publish with manual_publish
+STRS_INTERN strs_arena *build_arena(internal_strs_app *app) {
+  return app->manual_publish ? &app->publish_arena : frame_arena(app);
+}
+
+// Without a fence the submission is waited for before the lock is released
+STRS_INTERN void queue_submit(internal_strs_app *app, const VkSubmitInfo *submit_info, VkFence fence) {
+  pthread_mutex_lock(&app->context->queue_lock);
+  VkResult result = vkQueueSubmit(app->graphics_queue, 1, submit_info, fence);
+  dbg_assert(result == VK_SUCCESS);
+  if (fence == VK_NULL_HANDLE) {
+    vkQueueWaitIdle(app->graphics_queue);
+  }
+  pthread_mutex_unlock(&app->context->queue_lock);
+}
+
+STRS_INTERN void device_wait_idle(internal_strs_app *app) {
+  pthread_mutex_lock(&app->context->queue_lock);
+  vkDeviceWaitIdle(app->logical_device);
+  pthread_mutex_unlock(&app->context->queue_lock);
 }
 
 STRS_INTERN void copy_buffer(internal_strs_app *app, VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
+  copy_buffer_region(app, srcBuffer, dstBuffer, 0, 0, size);
+}
+
+STRS_INTERN void copy_buffer_region(internal_strs_app *app, VkBuffer srcBuffer, VkBuffer dstBuffer,
+                                    VkDeviceSize srcOffset, VkDeviceSize dstOffset, VkDeviceSize size) {
   VkCommandBufferAllocateInfo allocInfo = {
     .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
     .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
@@ -462,6 +1508,8 @@ STRS_INTERN void copy_buffer(internal_strs_app *app, VkBuffer srcBuffer, VkBuffe
   vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
   VkBufferCopy copyRegion = {
+    .srcOffset = srcOffset,
+    .dstOffset = dstOffset,
     .size = size};
 
   vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
@@ -473,8 +1521,7 @@ STRS_INTERN void copy_buffer(internal_strs_app *app, VkBuffer srcBuffer, VkBuffe
     .commandBufferCount = 1,
     .pCommandBuffers = &commandBuffer};
 
-  vkQueueSubmit(app->graphics_queue, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(app->graphics_queue);
+  queue_submit(app, &submitInfo, VK_NULL_HANDLE);
 
   vkFreeCommandBuffers(app->logical_device, app->command_pool, 1, &commandBuffer);
 }
@@ -484,6 +1531,7 @@ STRS_INTERN void create_sync_objects(internal_strs_app *app) {
   app->render_finished_semaphores = malloc(sizeof(VkSemaphore *) * MAX_FRAMES_IN_FLIGHT);
   app->in_flight_fences = malloc(sizeof(VkFence *) * MAX_FRAMES_IN_FLIGHT);
   app->images_in_flight = malloc(sizeof(VkFence *) * app->number_of_images);
+  app->frame_input_ns = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(uint64_t));
 
   VkSemaphoreCreateInfo semaphoreInfo = {
     .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
@@ -495,13 +1543,13 @@ STRS_INTERN void create_sync_objects(internal_strs_app *app) {
   VkResult result;
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
     result = vkCreateSemaphore(app->logical_device,
-                               &semaphoreInfo, NULL, &app->image_available_semaphores[i]);
+                               &semaphoreInfo, &app->host_allocator, &app->image_available_semaphores[i]);
     dbg_assert(result == VK_SUCCESS);
     result = vkCreateSemaphore(app->logical_device,
-                               &semaphoreInfo, NULL, &app->render_finished_semaphores[i]);
+                               &semaphoreInfo, &app->host_allocator, &app->render_finished_semaphores[i]);
     dbg_assert(result == VK_SUCCESS);
     result = vkCreateFence(app->logical_device,
-                           &fenceInfo, NULL, &app->in_flight_fences[i]);
+                           &fenceInfo, &app->host_allocator, &app->in_flight_fences[i]);
     dbg_assert(result == VK_SUCCESS);
   }
   for (int i = 0; i < app->number_of_images; i++) {
@@ -509,8 +1557,192 @@ STRS_INTERN void create_sync_objects(internal_strs_app *app) {
   }
 }
 
+STRS_INTERN const clip_region *batch_region(internal_strs_app *app, uint64_t draw) {
+  uint32_t region = app->draw_batches[draw].clip_region;
+  return region > 0 && region <= app->scene.clip_region_count ? &app->scene.clip_regions[region - 1] : NULL;
+}
+
+// The first draw item that ends after first_index, the items are in index order
+STRS_INTERN uint64_t item_at_index(internal_strs_app *app, uint64_t first_index) {
+  const draw_item *items = app->scene.draw_items;
+  uint64_t low = 0;
+  uint64_t high = app->scene.draw_item_count;
+  while (low < high) {
+    uint64_t middle = (low + high) / 2;
+    if ((uint64_t) items[middle].first_index + items[middle].index_count <= first_index) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+// World space is framebuffer pixels with y down, the space clips, masks and the pointer are given in
+STRS_INTERN void world_projection(internal_strs_app *app, mat4 proj) {
+  glm_ortho(0.0f, (float) app->swap_chain_extent.width, 0.0f, (float) app->swap_chain_extent.height,
+            -1.0f, 1.0f, proj);
+}
+
+#ifndef NDEBUG
+// Scissors and masks are set in framebuffer pixels, so the items drawn inside a clip have to land inside
+// its scissor once the shaders projected them. Items crossing the clip edge are cut by it and not checked.
+STRS_INTERN bool batch_inside_scissor(internal_strs_app *app, uint64_t draw, const clip_region *region,
+                                      VkRect2D scissor) {
+  mat4 proj;
+  world_projection(app, proj);
+  const VkDrawIndexedIndirectCommand *command = &app->draw_commands[draw];
+  uint64_t batch_end = (uint64_t) command->firstIndex + command->indexCount;
+  for (uint64_t i = item_at_index(app, command->firstIndex);
+       i < app->scene.draw_item_count && app->scene.draw_items[i].first_index < batch_end; i++) {
+    const draw_item *item = &app->scene.draw_items[i];
+    const transform_world *world = &app->transform_worlds[item->transform];
+    // Pointer following nodes move after the scene was built
+    if (item->bounds[0] > item->bounds[2] || world->translation[2] != 0.0f || drawn_from_layer(app, item->transform)) {
+      continue;
+    }
+    float world_bounds[4] = {FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX};
+    float pixels[4] = {FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX};
+    for (uint32_t c = 0; c < 4; c++) {
+      float x = item->bounds[c & 1 ? 2 : 0];
+      float y = item->bounds[c & 2 ? 3 : 1];
+      vec4 p = {world->linear[0] * x + world->linear[2] * y + world->translation[0],
+                world->linear[1] * x + world->linear[3] * y + world->translation[1], 0.0f, 1.0f};
+      vec4 clip;
+      glm_mat4_mulv(proj, p, clip);
+      float px = (clip[0] / clip[3] + 1.0f) * 0.5f * (float) app->swap_chain_extent.width;
+      float py = (clip[1] / clip[3] + 1.0f) * 0.5f * (float) app->swap_chain_extent.height;
+      world_bounds[0] = fminf(world_bounds[0], p[0]);
+      world_bounds[1] = fminf(world_bounds[1], p[1]);
+      world_bounds[2] = fmaxf(world_bounds[2], p[0]);
+      world_bounds[3] = fmaxf(world_bounds[3], p[1]);
+      pixels[0] = fminf(pixels[0], px);
+      pixels[1] = fminf(pixels[1], py);
+      pixels[2] = fmaxf(pixels[2], px);
+      pixels[3] = fmaxf(pixels[3], py);
+    }
+    if (world_bounds[0] < region->bounds[0] || world_bounds[1] < region->bounds[1] ||
+        world_bounds[2] > region->bounds[2] || world_bounds[3] > region->bounds[3]) {
+      continue;
+    }
+    // A pixel of slack for the rounding of the scissor
+    if (pixels[0] < (float) scissor.offset.x - 1.0f || pixels[1] < (float) scissor.offset.y - 1.0f ||
+        pixels[2] > (float) scissor.offset.x + (float) scissor.extent.width + 1.0f ||
+        pixels[3] > (float) scissor.offset.y + (float) scissor.extent.height + 1.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+#endif
+
+// Splits the batches into runs of one scissor and mask, clamped to the framebuffer. Batches clipped to
+// nothing are left out.
+STRS_INTERN void build_scissor_runs(internal_strs_app *app) {
+  VkRect2D previous = {.extent = app->swap_chain_extent};
+  app->scissor_run_count = 0;
+  app->clip_stats.batches = app->draw_command_count;
+  app->clip_stats.scissor_changes = 0;
+  app->clip_stats.masked_runs = 0;
+  app->clip_stats.clipped = 0;
+
+  for (uint64_t d = 0; d < app->draw_command_count; d++) {
+    const clip_region *region = batch_region(app, d);
+    VkRect2D scissor = {.extent = app->swap_chain_extent};
+    if (region != NULL) {
+      float x0 = fmaxf(floorf(region->bounds[0]), 0.0f);
+      float y0 = fmaxf(floorf(region->bounds[1]), 0.0f);
+      float x1 = fminf(ceilf(region->bounds[2]), (float) app->swap_chain_extent.width);
+      float y1 = fminf(ceilf(region->bounds[3]), (float) app->swap_chain_extent.height);
+      if (x1 <= x0 || y1 <= y0) {
+        app->clip_stats.clipped++;
+        continue;
+      }
+      scissor = (VkRect2D){{(int32_t) x0, (int32_t) y0}, {(uint32_t) (x1 - x0), (uint32_t) (y1 - y0)}};
+#ifndef NDEBUG
+      dbg_assert(batch_inside_scissor(app, d, region, scissor));
+#endif
+    }
+
+    uint32_t mask = region != NULL && region->masked ? app->draw_batches[d].clip_region : 0;
+    scissor_run *run = app->scissor_run_count > 0 ? &app->scissor_runs[app->scissor_run_count - 1] : NULL;
+    if (run != NULL && run->first_draw + run->draw_count == d && run->mask_region == mask &&
+        memcmp(&run->scissor, &scissor, sizeof(scissor)) == 0) {
+      run->draw_count++;
+      continue;
+    }
+    app->scissor_runs = strs_grow_array(app->scissor_runs, &app->scissor_run_capacity, app->scissor_run_count + 1,
+                                   sizeof(scissor_run));
+    app->scissor_runs[app->scissor_run_count++] = (scissor_run){scissor, mask, (uint32_t) d, 1};
+    app->clip_stats.scissor_changes += memcmp(&previous, &scissor, sizeof(scissor)) != 0;
+    app->clip_stats.masked_runs += mask != 0;
+    previous = scissor;
+  }
+}
+
+// The cull pass only packs the visible draws together when nothing has to be set between them
+STRS_INTERN bool cull_compacts(internal_strs_app *app) {
+  return app->draw_indirect_count && app->scissor_run_count <= 1 && app->clip_stats.clipped == 0;
+}
+
+STRS_INTERN mask_push_constants region_mask(internal_strs_app *app, uint32_t region) {
+  if (region == 0) {
+    return (mask_push_constants){0};
+  }
+  const clip_region *clip = &app->scene.clip_regions[region - 1];
+  const float *m = clip->mask_inverse;
+  return (mask_push_constants){
+    .rows = {m[0], m[2], m[4], 0.0f, m[1], m[3], m[5], 0.0f},
+    .half_size = {clip->mask_half_size[0], clip->mask_half_size[1]},
+    .radius = clip->mask_radius,
+    .active = 1};
+}
+
+STRS_INTERN void draw_indirect_range(internal_strs_app *app, VkCommandBuffer command_buffer, VkBuffer buffer,
+                                     VkDeviceSize offset, uint64_t count) {
+  uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+  uint64_t most = app->multi_draw_indirect ? app->max_draw_indirect_count : 1;
+  for (uint64_t first = 0; first < count; first += most) {
+    uint64_t n = count - first < most ? count - first : most;
+    vkCmdDrawIndexedIndirect(command_buffer, buffer, offset + first * stride, (uint32_t) n, stride);
+  }
+}
+
+STRS_INTERN void record_run_draws(internal_strs_app *app, VkCommandBuffer command_buffer, size_t image,
+                                  const scissor_run *run, bool culling) {
+  uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+  uint64_t end = (uint64_t) run->first_draw + run->draw_count;
+  if (culling && cull_compacts(app)) {
+    vkCmdDrawIndexedIndirectCount(command_buffer,
+                                  app->culled_draw_buffer, app->culled_draw_stride * image,
+                                  app->cull_count_buffer, app->cull_count_stride * image,
+                                  (uint32_t) app->cull_record_count, stride);
+  } else if (culling) {
+    // Hidden records were written with zero instances
+    uint64_t first = app->draw_batches[run->first_draw].first_record;
+    uint64_t last = end < app->draw_command_count ? app->draw_batches[end].first_record : app->cull_record_count;
+    draw_indirect_range(app, command_buffer, app->culled_draw_buffer,
+                        app->culled_draw_stride * image + first * stride, last - first);
+  } else if (!app->draw_indirect_first_instance) {
+    // Without drawIndirectFirstInstance only direct draws can pick the transform node
+    for (uint64_t draw = run->first_draw; draw < end; draw++) {
+      VkDrawIndexedIndirectCommand *command = &app->draw_commands[draw];
+      if (drawn_from_layer(app, command->firstInstance)) {
+        continue;
+      }
+      vkCmdDrawIndexed(command_buffer, command->indexCount, 1, command->firstIndex,
+                       command->vertexOffset, command->firstInstance);
+    }
+  } else {
+    draw_indirect_range(app, command_buffer, app->indirect_buffer, run->first_draw * stride, run->draw_count);
+  }
+}
+
+// Also reruns whenever the geometry changed, the array is kept until the swap chain is recreated
 STRS_INTERN void create_command_buffers(internal_strs_app *app) {
-  app->command_buffers = malloc(sizeof(VkCommandBuffer *) * app->number_of_images);
+  if (app->command_buffers == NULL) {
+    app->command_buffers = strs_arena_alloc(&app->swap_chain_arena, sizeof(VkCommandBuffer) * app->number_of_images);
+  }
 
   VkCommandBufferAllocateInfo allocInfo = {
     .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -520,6 +1752,7 @@ STRS_INTERN void create_command_buffers(internal_strs_app *app) {
 
   VkResult result = vkAllocateCommandBuffers(app->logical_device, &allocInfo, app->command_buffers);
   dbg_assert(result == VK_SUCCESS);
+  build_scissor_runs(app);
 
   for (size_t i = 0; i < app->number_of_images; i++) {
     VkCommandBufferBeginInfo beginInfo = {
@@ -528,6 +1761,11 @@ STRS_INTERN void create_command_buffers(internal_strs_app *app) {
     result = vkBeginCommandBuffer(app->command_buffers[i], &beginInfo);
     dbg_assert(result == VK_SUCCESS);
 
+    bool culling = app->gpu_culling && app->cull_record_count > 0 && app->vertex_buffer.buffer != VK_NULL_HANDLE;
+    if (culling) {
+      record_cull_pass(app, app->command_buffers[i], i);
+    }
+
     VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
 
     VkRenderPassBeginInfo renderPassInfo = {
@@ -556,22 +1794,70 @@ STRS_INTERN void create_command_buffers(internal_strs_app *app) {
     vkCmdSetViewport(app->command_buffers[i], 0, 1, &viewport);
     vkCmdSetScissor(app->command_buffers[i], 0, 1, &scissor);
 
-    vkCmdBindPipeline(app->command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, app->pipeline);
-
-    VkBuffer vertexBuffers[] = {app->vertex_buffer.buffer};
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(app->command_buffers[i], 0, 1, vertexBuffers, offsets);
-
-    vkCmdBindIndexBuffer(app->command_buffers[i], app->index_buffer.buffer, 0, VK_INDEX_TYPE_UINT16);
-
     vkCmdBindDescriptorSets(app->command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS,
                             app->pipeline_layout,
                             0,
                             1,
                             &app->descriptor_sets[i], 0, NULL);
-    vkCmdDrawIndexed(app->command_buffers[i],
-                     app->index_buffer.bufferSize / sizeof(uint16_t),
-                     1, 0, 0, 0);
+    vkCmdBindDescriptorSets(app->command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, app->pipeline_layout,
+                            1, 1, &app->texture_set, 0, NULL);
+    layer_push_constants push = {.texture = app->drawn_vertex_texture};
+    vkCmdPushConstants(app->command_buffers[i], app->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT,
+                       0, sizeof(push), &push);
+
+    // Shapes are backgrounds, the vertex geometry is drawn on top of them, every texture in the same draw
+    if (app->shape_buffer.buffer != VK_NULL_HANDLE && app->scene.shape_count > 0) {
+      VkDeviceSize offset = 0;
+      vkCmdBindPipeline(app->command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, app->shape_pipeline);
+      vkCmdBindVertexBuffers(app->command_buffers[i], 0, 1, &app->shape_buffer.buffer, &offset);
+      vkCmdDraw(app->command_buffers[i], 4, (uint32_t) app->scene.shape_count, 0, 0);
+    }
+
+    // Cached layers go over the shapes and under the geometry that is drawn directly
+    if (app->layer_composite_count > 0 && i < app->layer_composite_images) {
+      VkDeviceSize offset = 0;
+      push.active = 1;
+      vkCmdBindPipeline(app->command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, app->shape_pipeline);
+      vkCmdPushConstants(app->command_buffers[i], app->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT,
+                         0, sizeof(push), &push);
+      vkCmdBindVertexBuffers(app->command_buffers[i], 0, 1, &app->layer_composite_buffers[i], &offset);
+      vkCmdDraw(app->command_buffers[i], 4, app->layer_composite_count, 0, 0);
+      push.active = 0;
+      vkCmdPushConstants(app->command_buffers[i], app->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT,
+                         0, sizeof(push), &push);
+    }
+
+    vkCmdBindPipeline(app->command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, app->pipeline);
+    mask_push_constants mask = {0};
+    vkCmdPushConstants(app->command_buffers[i], app->pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT,
+                       MASK_PUSH_OFFSET, sizeof(mask), &mask);
+
+    // Geometry buffers are created lazily, until then the pass only clears
+    if (app->vertex_buffer.buffer != VK_NULL_HANDLE && app->draw_command_count > 0) {
+      VkBuffer vertexBuffers[] = {app->vertex_buffer.buffer};
+      VkDeviceSize offsets[] = {0};
+      vkCmdBindVertexBuffers(app->command_buffers[i], 0, 1, vertexBuffers, offsets);
+
+      vkCmdBindIndexBuffer(app->command_buffers[i], app->index_buffer.buffer, 0, app->index_type);
+
+      // Scissors and masks are only set where they change from one run to the next
+      VkRect2D current = scissor;
+      uint32_t current_mask = 0;
+      for (uint64_t r = 0; r < app->scissor_run_count; r++) {
+        const scissor_run *run = &app->scissor_runs[r];
+        if (memcmp(&run->scissor, &current, sizeof(current)) != 0) {
+          vkCmdSetScissor(app->command_buffers[i], 0, 1, &run->scissor);
+          current = run->scissor;
+        }
+        if (run->mask_region != current_mask) {
+          mask = region_mask(app, run->mask_region);
+          vkCmdPushConstants(app->command_buffers[i], app->pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT,
+                             MASK_PUSH_OFFSET, sizeof(mask), &mask);
+          current_mask = run->mask_region;
+        }
+        record_run_draws(app, app->command_buffers[i], i, run, culling);
+      }
+    }
 
     vkCmdEndRenderPass(app->command_buffers[i]);
 
@@ -583,11 +1869,12 @@ STRS_INTERN void create_command_buffers(internal_strs_app *app) {
 STRS_INTERN void create_uniform_buffers(internal_strs_app *app) {
   VkDeviceSize bufferSize = sizeof(UniformBufferObject);
 
-  app->uniform_buffers = malloc(sizeof(VkBuffer *) * app->number_of_images);
-  app->uniform_buffers_memory = malloc(sizeof(VkDeviceMemory *) * app->number_of_images);
+  app->uniform_buffers = strs_arena_alloc(&app->swap_chain_arena, sizeof(VkBuffer) * app->number_of_images);
+  app->uniform_buffers_memory = strs_arena_alloc(&app->swap_chain_arena,
+                                                 sizeof(VkDeviceMemory) * app->number_of_images);
 
   for (size_t i = 0; i < app->number_of_images; i++) {
-    create_buffer(app, bufferSize,
+    create_buffer(app, STRS_MEMORY_UNIFORMS, bufferSize,
                   VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
@@ -595,63 +1882,341 @@ STRS_INTERN void create_uniform_buffers(internal_strs_app *app) {
   }
 }
 
+// Sized for 32 bit indices so switching the index width never needs a new buffer
 STRS_INTERN void create_index_buffer(internal_strs_app *app) {
-  app->index_buffer.bufferSize = sizeof(uint16_t) * app->index_count;
+  app->index_buffer.bufferSize = sizeof(uint32_t) * app->scene.index_capacity;
 
-  create_buffer(app, app->index_buffer.bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+  create_buffer(app, STRS_MEMORY_STAGING, app->index_buffer.bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                 &app->index_buffer.stagingBuffer, &app->index_buffer.stagingBufferMemory);
 
   vkMapMemory(app->logical_device,
               app->index_buffer.stagingBufferMemory,
               0, app->index_buffer.bufferSize, 0, &app->index_buffer.data);
-  memcpy(app->index_buffer.data, app->indices, (size_t) app->index_buffer.bufferSize);
 
-  create_buffer(app, app->index_buffer.bufferSize,
+  create_buffer(app, STRS_MEMORY_GEOMETRY, app->index_buffer.bufferSize,
                 VK_BUFFER_USAGE_TRANSFER_DST_BIT |
                 VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                 &app->index_buffer.buffer, &app->index_buffer.bufferMemory);
-
-  copy_buffer(app, app->index_buffer.stagingBuffer, app->index_buffer.buffer, app->index_buffer.bufferSize);
 }
 
-STRS_INTERN void create_vertex_buffer(internal_strs_app *app) {
-  app->vertex_buffer.bufferSize = sizeof(strs_vertex) * app->vertex_count;
-
-  create_buffer(app, app->vertex_buffer.bufferSize,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                &app->vertex_buffer.stagingBuffer, &app->vertex_buffer.stagingBufferMemory);
+STRS_INTERN void create_indirect_buffer(internal_strs_app *app) {
+  create_buffer(app, STRS_MEMORY_GEOMETRY, sizeof(VkDrawIndexedIndirectCommand) * app->draw_command_capacity,
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &app->indirect_buffer, &app->indirect_buffer_memory);
 
   vkMapMemory(app->logical_device,
-              app->vertex_buffer.stagingBufferMemory,
-              0, app->vertex_buffer.bufferSize, 0, &app->vertex_buffer.data);
-  memcpy(app->vertex_buffer.data, app->vertices, (size_t) app->vertex_buffer.bufferSize);
+              app->indirect_buffer_memory,
+              0, sizeof(VkDrawIndexedIndirectCommand) * app->draw_command_capacity, 0, &app->indirect_data);
+  app->indirect_capacity = app->draw_command_capacity;
+}
 
-  create_buffer(app, app->vertex_buffer.bufferSize,
-                VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                &app->vertex_buffer.buffer, &app->vertex_buffer.bufferMemory);
+STRS_INTERN void destroy_indirect_buffer(internal_strs_app *app) {
+  if (app->indirect_buffer == VK_NULL_HANDLE) {
+    return;
+  }
+  vkUnmapMemory(app->logical_device, app->indirect_buffer_memory);
+  vkDestroyBuffer(app->logical_device, app->indirect_buffer, &app->host_allocator);
+  free_memory(app, app->indirect_buffer_memory);
+  app->indirect_buffer = VK_NULL_HANDLE;
+  app->indirect_buffer_memory = VK_NULL_HANDLE;
+  app->indirect_data = NULL;
+  app->indirect_capacity = 0;
+}
 
-  copy_buffer(app, app->vertex_buffer.stagingBuffer, app->vertex_buffer.buffer, app->vertex_buffer.bufferSize);
+STRS_INTERN VkDeviceSize align_size(VkDeviceSize size, VkDeviceSize alignment) {
+  if (alignment == 0) {
+    return size;
+  }
+  return (size + alignment - 1) / alignment * alignment;
 }
 
-STRS_INTERN void create_command_pool(internal_strs_app *app) {
-  QueueFamilyIndices queueFamilyIndices = find_queue_family_indices(app->physical_device, app->surface);
+STRS_INTERN void create_cull_pipeline(internal_strs_app *app) {
+  internal_strs_context *context = app->context;
+  if (context->cull_shader_module == VK_NULL_HANDLE) {
+    context->cull_shader_module = create_shader_module(app, &app->cull_shader_code, app->cull_shader_size);
+  }
+  app->cull_shader_module = context->cull_shader_module;
 
-  VkCommandPoolCreateInfo poolInfo = {
-    .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-    .queueFamilyIndex = queueFamilyIndices.graphics_family.value};
+  VkDescriptorSetLayoutBinding bindings[5] = {
+    {.binding = 0,
+      .descriptorCount = 1,
+      .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+      .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT}};
+  for (uint32_t i = 1; i < 5; i++) {
+    bindings[i] = (VkDescriptorSetLayoutBinding){
+      .binding = i,
+      .descriptorCount = 1,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT};
+  }
 
-  VkResult result = vkCreateCommandPool(app->logical_device, &poolInfo, NULL, &app->command_pool);
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+    .bindingCount = 5,
+    .pBindings = bindings};
+
+  VkResult result = vkCreateDescriptorSetLayout(app->logical_device, &layoutInfo, &app->host_allocator,
+                                                &app->cull_descriptor_set_layout);
   dbg_assert(result == VK_SUCCESS);
-}
+
+  VkPushConstantRange pushConstantRange = {
+    .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+    .offset = 0,
+    .size = sizeof(cull_push_constants)};
+
+  VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+    .setLayoutCount = 1,
+    .pSetLayouts = &app->cull_descriptor_set_layout,
+    .pushConstantRangeCount = 1,
+    .pPushConstantRanges = &pushConstantRange};
+
+  result = vkCreatePipelineLayout(app->logical_device, &pipelineLayoutInfo, &app->host_allocator,
+                                  &app->cull_pipeline_layout);
+  dbg_assert(result == VK_SUCCESS);
+
+  VkComputePipelineCreateInfo pipelineInfo = {
+    .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+    .stage = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+      .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+      .module = app->cull_shader_module,
+      .pName = "main"},
+    .layout = app->cull_pipeline_layout};
+
+  result = vkCreateComputePipelines(app->logical_device, app->pipeline_cache, 1, &pipelineInfo, &app->host_allocator,
+                                    &app->cull_pipeline);
+  dbg_assert(result == VK_SUCCESS);
+}
+
+// Every swap chain image gets its own slice of the output and count buffers
+STRS_INTERN void create_cull_buffers(internal_strs_app *app) {
+  app->cull_buffer_capacity = app->cull_record_capacity;
+  app->cull_buffer_images = app->number_of_images;
+  app->culled_draw_stride = align_size(sizeof(VkDrawIndexedIndirectCommand) * app->cull_buffer_capacity,
+                                       app->min_storage_buffer_offset_alignment);
+  app->cull_count_stride = align_size(sizeof(uint32_t), app->min_storage_buffer_offset_alignment);
+
+  create_buffer(app, STRS_MEMORY_GEOMETRY, sizeof(cull_record) * app->cull_buffer_capacity,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &app->cull_record_buffer, &app->cull_record_memory);
+  vkMapMemory(app->logical_device, app->cull_record_memory,
+              0, sizeof(cull_record) * app->cull_buffer_capacity, 0, &app->cull_record_data);
+
+  create_buffer(app, STRS_MEMORY_GEOMETRY, app->culled_draw_stride * app->cull_buffer_images,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                &app->culled_draw_buffer, &app->culled_draw_memory);
+
+  create_buffer(app, STRS_MEMORY_GEOMETRY, app->cull_count_stride * app->cull_buffer_images,
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &app->cull_count_buffer, &app->cull_count_memory);
+  vkMapMemory(app->logical_device, app->cull_count_memory,
+              0, app->cull_count_stride * app->cull_buffer_images, 0, (void **) &app->cull_counts);
+  memset(app->cull_counts, 0, app->cull_count_stride * app->cull_buffer_images);
+}
+
+STRS_INTERN void destroy_cull_buffers(internal_strs_app *app) {
+  if (app->cull_record_buffer == VK_NULL_HANDLE) {
+    return;
+  }
+  vkUnmapMemory(app->logical_device, app->cull_record_memory);
+  vkUnmapMemory(app->logical_device, app->cull_count_memory);
+  vkDestroyBuffer(app->logical_device, app->cull_record_buffer, &app->host_allocator);
+  free_memory(app, app->cull_record_memory);
+  vkDestroyBuffer(app->logical_device, app->culled_draw_buffer, &app->host_allocator);
+  free_memory(app, app->culled_draw_memory);
+  vkDestroyBuffer(app->logical_device, app->cull_count_buffer, &app->host_allocator);
+  free_memory(app, app->cull_count_memory);
+  app->cull_record_buffer = VK_NULL_HANDLE;
+  app->culled_draw_buffer = VK_NULL_HANDLE;
+  app->cull_count_buffer = VK_NULL_HANDLE;
+  app->cull_record_data = NULL;
+  app->cull_counts = NULL;
+  app->cull_buffer_capacity = 0;
+}
+
+STRS_INTERN void write_cull_descriptor_sets(internal_strs_app *app) {
+  for (size_t i = 0; i < app->number_of_images; i++) {
+    VkDescriptorBufferInfo bufferInfos[5] = {
+      {.buffer = app->uniform_buffers[i],
+        .offset = 0,
+        .range = sizeof(UniformBufferObject)},
+      {.buffer = app->cull_record_buffer,
+        .offset = 0,
+        .range = sizeof(cull_record) * app->cull_buffer_capacity},
+      {.buffer = app->culled_draw_buffer,
+        .offset = app->culled_draw_stride * i,
+        .range = sizeof(VkDrawIndexedIndirectCommand) * app->cull_buffer_capacity},
+      {.buffer = app->cull_count_buffer,
+        .offset = app->cull_count_stride * i,
+        .range = sizeof(uint32_t)},
+      {.buffer = app->transform_buffer.buffer,
+        .offset = 0,
+        .range = app->transform_buffer.bufferSize}};
+
+    VkWriteDescriptorSet descriptorWrites[5];
+    for (uint32_t binding = 0; binding < 5; binding++) {
+      descriptorWrites[binding] = (VkWriteDescriptorSet){
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = app->cull_descriptor_sets[i],
+        .dstBinding = binding,
+        .dstArrayElement = 0,
+        .descriptorType = binding == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .pBufferInfo = &bufferInfos[binding]};
+    }
+
+    vkUpdateDescriptorSets(app->logical_device, 5, descriptorWrites, 0, NULL);
+  }
+}
+
+STRS_INTERN void record_cull_pass(internal_strs_app *app, VkCommandBuffer command_buffer, size_t image) {
+  vkCmdFillBuffer(command_buffer, app->cull_count_buffer, app->cull_count_stride * image, sizeof(uint32_t), 0);
+
+  VkMemoryBarrier fillBarrier = {
+    .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+    .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+    .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+  vkCmdPipelineBarrier(command_buffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 1, &fillBarrier, 0, NULL, 0, NULL);
+
+  cull_push_constants pushConstants = {
+    .record_count = (uint32_t) app->cull_record_count,
+    .compact = cull_compacts(app)};
+
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, app->cull_pipeline);
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          app->cull_pipeline_layout, 0, 1, &app->cull_descriptor_sets[image], 0, NULL);
+  vkCmdPushConstants(command_buffer, app->cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT,
+                     0, sizeof(pushConstants), &pushConstants);
+  vkCmdDispatch(command_buffer,
+                (uint32_t) ((app->cull_record_count + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE), 1, 1);
+
+  VkMemoryBarrier cullBarrier = {
+    .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+    .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+    .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT};
+  vkCmdPipelineBarrier(command_buffer,
+                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                       0, 1, &cullBarrier, 0, NULL, 0, NULL);
+}
+
+// Draw items can straddle the batches made by build_draw_commands, so they are cut at batch edges.
+// The records follow the batches, which order_clipped_batches may have moved out of index order.
+STRS_INTERN void build_cull_records(internal_strs_app *app, uint64_t index_count) {
+  const draw_item *items = app->scene.draw_items;
+  uint64_t item_count = app->scene.draw_item_count;
+
+  app->cull_record_count = 0;
+  for (uint64_t batch = 0; batch < app->draw_command_count; batch++) {
+    const VkDrawIndexedIndirectCommand *command = &app->draw_commands[batch];
+    uint64_t batch_end = (uint64_t) command->firstIndex + command->indexCount;
+    app->draw_batches[batch].first_record = (uint32_t) app->cull_record_count;
+
+    uint64_t first_item = item_at_index(app, command->firstIndex);
+    for (uint64_t i = first_item; i < item_count && items[i].first_index < batch_end; i++) {
+      const draw_item *item = &items[i];
+      if (drawn_from_layer(app, item->transform)) {
+        continue;
+      }
+      uint64_t first = item->first_index > command->firstIndex ? item->first_index : command->firstIndex;
+      uint64_t end = (uint64_t) item->first_index + item->index_count;
+      end = end < batch_end ? end : batch_end;
+      end = end < index_count ? end : index_count;
+      if (first >= end) {
+        continue;
+      }
+
+      app->cull_records = strs_grow_array(app->cull_records, &app->cull_record_capacity,
+                                     app->cull_record_count + 1, sizeof(cull_record));
+      cull_record *record = &app->cull_records[app->cull_record_count++];
+      // An item that only indexes earlier vertices has no bounds of its own and is never culled
+      if (item->bounds[0] > item->bounds[2]) {
+        memcpy(record->bounds, item->clip, sizeof(record->bounds));
+      } else {
+        memcpy(record->bounds, item->bounds, sizeof(record->bounds));
+      }
+      memcpy(record->clip, item->clip, sizeof(record->clip));
+      record->first_index = (uint32_t) first;
+      record->index_count = (uint32_t) (end - first);
+      record->vertex_offset = command->vertexOffset;
+      record->transform = item->transform;
+    }
+  }
+}
+
+STRS_INTERN void create_vertex_buffer(internal_strs_app *app) {
+  app->vertex_buffer.contentsSize = app->vertex_stride * app->scene.vertex_count;
+  app->vertex_buffer.bufferSize = app->vertex_stride * app->scene.vertex_capacity;
+
+  create_buffer(app, STRS_MEMORY_STAGING, app->vertex_buffer.bufferSize,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &app->vertex_buffer.stagingBuffer, &app->vertex_buffer.stagingBufferMemory);
+
+  vkMapMemory(app->logical_device,
+              app->vertex_buffer.stagingBufferMemory,
+              0, app->vertex_buffer.bufferSize, 0, &app->vertex_buffer.data);
+  memcpy(app->vertex_buffer.data, app->scene.vertices, (size_t) app->vertex_buffer.contentsSize);
+
+  create_buffer(app, STRS_MEMORY_GEOMETRY, app->vertex_buffer.bufferSize,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                &app->vertex_buffer.buffer, &app->vertex_buffer.bufferMemory);
+
+  copy_buffer(app, app->vertex_buffer.stagingBuffer, app->vertex_buffer.buffer, app->vertex_buffer.contentsSize);
+}
+
+// Device local buffer filled through a persistently mapped staging buffer of the same size
+STRS_INTERN void create_staged_buffer(internal_strs_app *app, vulkan_buffer *buffer, VkBufferUsageFlags usage,
+                                      const void *src, VkDeviceSize contents_size, VkDeviceSize buffer_size) {
+  buffer->contentsSize = contents_size;
+  buffer->bufferSize = buffer_size;
+
+  create_buffer(app, STRS_MEMORY_STAGING, buffer->bufferSize,
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &buffer->stagingBuffer, &buffer->stagingBufferMemory);
+
+  vkMapMemory(app->logical_device, buffer->stagingBufferMemory, 0, buffer->bufferSize, 0, &buffer->data);
+  memcpy(buffer->data, src, (size_t) contents_size);
+
+  create_buffer(app, STRS_MEMORY_GEOMETRY, buffer->bufferSize,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                &buffer->buffer, &buffer->bufferMemory);
+
+  if (contents_size > 0) {
+    copy_buffer(app, buffer->stagingBuffer, buffer->buffer, contents_size);
+  }
+}
+
+STRS_INTERN void create_command_pool(internal_strs_app *app) {
+  QueueFamilyIndices queueFamilyIndices = app->queue_families;
+
+  VkCommandPoolCreateInfo poolInfo = {
+    .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+    .queueFamilyIndex = queueFamilyIndices.graphics_family.value};
+
+  VkResult result = vkCreateCommandPool(app->logical_device, &poolInfo, &app->host_allocator, &app->command_pool);
+  dbg_assert(result == VK_SUCCESS);
+}
 
 STRS_INTERN void create_frame_buffers(internal_strs_app *app) {
-  app->swap_chain_frame_buffers = malloc(sizeof(VkFramebuffer *) * app->number_of_images);
+  app->swap_chain_frame_buffers = strs_arena_alloc(&app->swap_chain_arena,
+                                                   sizeof(VkFramebuffer) * app->number_of_images);
 
   for (size_t i = 0; i < app->number_of_images; i++) {
     VkImageView attachments[] = {
@@ -669,7 +2234,7 @@ STRS_INTERN void create_frame_buffers(internal_strs_app *app) {
     VkResult result =
       vkCreateFramebuffer(app->logical_device,
                           &framebufferInfo,
-                          NULL,
+                          &app->host_allocator,
                           &app->swap_chain_frame_buffers[i]);
     dbg_assert(result == VK_SUCCESS);
   }
@@ -677,17 +2242,28 @@ STRS_INTERN void create_frame_buffers(internal_strs_app *app) {
 
 STRS_INTERN void create_graphics_pipeline(internal_strs_app *app) {
 
+  VkDescriptorSetLayout setLayouts[] = {app->descriptor_set_layout, app->texture_set_layout};
+  VkPushConstantRange pushConstantRanges[] = {
+    {
+      .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+      .offset = 0,
+      .size = sizeof(layer_push_constants)},
+    {
+      .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+      .offset = MASK_PUSH_OFFSET,
+      .size = sizeof(mask_push_constants)}};
   VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
     .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-    .setLayoutCount = 1,
-    .pSetLayouts = &app->descriptor_set_layout,
-    .pushConstantRangeCount = 0,
+    .setLayoutCount = 2,
+    .pSetLayouts = setLayouts,
+    .pushConstantRangeCount = 2,
+    .pPushConstantRanges = pushConstantRanges,
   };
 
   VkResult result =
     vkCreatePipelineLayout(app->logical_device,
                            &pipelineLayoutInfo,
-                           NULL, &app->pipeline_layout);
+                           &app->host_allocator, &app->pipeline_layout);
   dbg_assert(result == VK_SUCCESS);
 
   VkGraphicsPipelineCreateInfo pipelineInfo = {
@@ -710,12 +2286,23 @@ STRS_INTERN void create_graphics_pipeline(internal_strs_app *app) {
   result =
     vkCreateGraphicsPipelines(
       app->logical_device,
-      NULL,
+      app->pipeline_cache,
       1,
       &pipelineInfo,
-      NULL,
+      &app->host_allocator,
       &app->pipeline);
   dbg_assert(result == VK_SUCCESS);
+
+  // Shapes share the layout, only the fixed function state differs
+  pipelineInfo.pStages = app->shape_pipeline_config.shader_stages;
+  pipelineInfo.pVertexInputState = &app->shape_pipeline_config.vertex_input_info;
+  pipelineInfo.pInputAssemblyState = &app->shape_pipeline_config.input_assembly;
+  pipelineInfo.pRasterizationState = &app->shape_pipeline_config.rasterizer;
+  pipelineInfo.pColorBlendState = &app->shape_pipeline_config.color_blending;
+
+  result = vkCreateGraphicsPipelines(app->logical_device, app->pipeline_cache, 1, &pipelineInfo, &app->host_allocator,
+                                     &app->shape_pipeline);
+  dbg_assert(result == VK_SUCCESS);
 }
 
 STRS_INTERN void fill_config_info(internal_strs_app *app) {
@@ -730,15 +2317,16 @@ STRS_INTERN void fill_config_info(internal_strs_app *app) {
     .module = app->frag_shader_module,
     .pName = "main"};
 
-  app->pipeline_config.binding_description = get_binding_description();
-  app->pipeline_config.attribute_descriptions = get_attribute_descriptions();
+  app->pipeline_config.binding_description = get_binding_description(app->vertex_format);
+  app->pipeline_config.attribute_description_count =
+    get_attribute_descriptions(app->vertex_format, app->pipeline_config.attribute_descriptions);
 
   app->pipeline_config.vertex_input_info = (VkPipelineVertexInputStateCreateInfo) {
     .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
     .vertexBindingDescriptionCount = 1,
     .pVertexBindingDescriptions = &app->pipeline_config.binding_description,
-    .vertexAttributeDescriptionCount = app->pipeline_config.attribute_descriptions.size,
-    .pVertexAttributeDescriptions = app->pipeline_config.attribute_descriptions.array};
+    .vertexAttributeDescriptionCount = app->pipeline_config.attribute_description_count,
+    .pVertexAttributeDescriptions = app->pipeline_config.attribute_descriptions};
 
   app->pipeline_config.input_assembly = (VkPipelineInputAssemblyStateCreateInfo) {
     .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
@@ -795,49 +2383,190 @@ STRS_INTERN void fill_config_info(internal_strs_app *app) {
   };
 }
 
-STRS_INTERN void create_descriptor_set_layout(internal_strs_app *app) {
-  VkDescriptorSetLayoutBinding uboLayoutBinding = {
+STRS_INTERN void fill_shape_config_info(internal_strs_app *app) {
+  pipeline_config_info *config = &app->shape_pipeline_config;
+  *config = app->pipeline_config;
+
+  config->shader_stages[0].module = app->shape_vert_shader_module;
+  config->shader_stages[1].module = app->shape_frag_shader_module;
+
+  config->binding_description = (VkVertexInputBindingDescription) {
     .binding = 0,
-    .descriptorCount = 1,
-    .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-    .pImmutableSamplers = NULL,
-    .stageFlags = VK_SHADER_STAGE_VERTEX_BIT};
+    .stride = sizeof(strs_shape),
+    .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE};
+
+  const struct {
+    VkFormat format;
+    uint32_t offset;
+  } attributes[] = {
+    {VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(strs_shape, x)},
+    {VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(strs_shape, fill_color)},
+    {VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(strs_shape, border_color)},
+    {VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(strs_shape, shadow_color)},
+    // shadow_offset, corner_radius and border_width are adjacent
+    {VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(strs_shape, shadow_offset)},
+    {VK_FORMAT_R32_SFLOAT, offsetof(strs_shape, shadow_blur)},
+    {VK_FORMAT_R32_UINT, offsetof(strs_shape, transform)},
+    {VK_FORMAT_R32_UINT, offsetof(strs_shape, texture)},
+    {VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(strs_shape, uv)}};
+
+  config->attribute_description_count = sizeof(attributes) / sizeof(attributes[0]);
+  for (uint32_t i = 0; i < config->attribute_description_count; i++) {
+    config->attribute_descriptions[i] = (VkVertexInputAttributeDescription) {
+      .binding = 0,
+      .location = i,
+      .format = attributes[i].format,
+      .offset = attributes[i].offset};
+  }
+
+  config->vertex_input_info.pVertexBindingDescriptions = &config->binding_description;
+  config->vertex_input_info.vertexAttributeDescriptionCount = config->attribute_description_count;
+  config->vertex_input_info.pVertexAttributeDescriptions = config->attribute_descriptions;
+
+  // Four corners per instance from gl_VertexIndex
+  config->input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP;
+  config->rasterizer.cullMode = VK_CULL_MODE_NONE;
+
+  // The fragment shader writes premultiplied alpha
+  config->color_blend_attachment.blendEnable = VK_TRUE;
+  config->color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
+  config->color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  config->color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+  config->color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  config->color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  config->color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+  config->color_blending.pAttachments = &config->color_blend_attachment;
+
+  config->dynamic_state_info.pDynamicStates = config->dynamic_state_enables;
+}
+
+STRS_INTERN void create_descriptor_set_layout(internal_strs_app *app) {
+  // The storage buffers hold the animation heads and tracks and the world transforms
+  VkDescriptorSetLayoutBinding layoutBindings[4] = {
+    {.binding = 0,
+      .descriptorCount = 1,
+      .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+      .pImmutableSamplers = NULL,
+      .stageFlags = VK_SHADER_STAGE_VERTEX_BIT},
+    {.binding = 1,
+      .descriptorCount = 1,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .stageFlags = VK_SHADER_STAGE_VERTEX_BIT},
+    {.binding = 2,
+      .descriptorCount = 1,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .stageFlags = VK_SHADER_STAGE_VERTEX_BIT},
+    {.binding = 3,
+      .descriptorCount = 1,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .stageFlags = VK_SHADER_STAGE_VERTEX_BIT}};
 
   VkDescriptorSetLayoutCreateInfo layoutInfo = {
     .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
-    .bindingCount = 1,
-    .pBindings = &uboLayoutBinding};
+    .bindingCount = 4,
+    .pBindings = layoutBindings};
 
   VkResult result = vkCreateDescriptorSetLayout(app->logical_device,
                                                 &layoutInfo,
-                                                NULL,
+                                                &app->host_allocator,
                                                 &app->descriptor_set_layout);
   dbg_assert(result == VK_SUCCESS);
 }
 
-STRS_INTERN void create_shader_modules(internal_strs_app *app) {
-  long vertSize = 0;
-  long fragSize = 0;
-  char *vertShaderCode = read_shader("shaders/shader.vert.spv", &vertSize);
-  char *fragShaderCode = read_shader("shaders/shader.frag.spv", &fragSize);
+// Runs as a job while the instance and device are created, it only touches the disk
+STRS_INTERN void load_shader_code(void *data) {
+  internal_strs_app *app = (internal_strs_app*)data;
+  internal_strs_context *context = app->context;
+  uint64_t begin = strs_clock_now_ns();
+
+  // Modules an earlier window of the context created are not read again
+  if (context->vert_shader_modules[app->vertex_format] == VK_NULL_HANDLE) {
+    switch (app->vertex_format) {
+      case STRS_VERTEX_FORMAT_COMPACT:
+        app->vert_shader_code = read_shader("shaders/shader_compact.vert.spv", &app->vert_shader_size);
+        app->frag_shader_code = read_shader("shaders/shader_compact.frag.spv", &app->frag_shader_size);
+        break;
+      case STRS_VERTEX_FORMAT_COMPACT_UV:
+        // The UVs sample a texture, like the shapes both variants are read
+        app->vert_shader_code = read_shader("shaders/shader_compact_uv.vert.spv", &app->vert_shader_size);
+        app->frag_shader_code = read_shader("shaders/shader_compact_uv.frag.spv", &app->frag_shader_size);
+        app->frag_bindless_shader_code =
+          read_shader("shaders/shader_compact_uv_bindless.frag.spv", &app->frag_bindless_shader_size);
+        break;
+      default:
+        app->vert_shader_code = read_shader("shaders/shader.vert.spv", &app->vert_shader_size);
+        app->frag_shader_code = read_shader("shaders/shader.frag.spv", &app->frag_shader_size);
+        break;
+    }
+  }
+  if (app->gpu_culling && context->cull_shader_module == VK_NULL_HANDLE) {
+    app->cull_shader_code = read_shader("shaders/cull.comp.spv", &app->cull_shader_size);
+  }
+  if (context->shape_vert_shader_module == VK_NULL_HANDLE) {
+    app->shape_vert_shader_code = read_shader("shaders/shape.vert.spv", &app->shape_vert_shader_size);
+    // The device is not picked yet, both are read and the one it can not run is dropped
+    app->shape_frag_shader_code = read_shader("shaders/shape.frag.spv", &app->shape_frag_shader_size);
+    app->shape_bindless_frag_shader_code =
+      read_shader("shaders/shape_bindless.frag.spv", &app->shape_bindless_frag_shader_size);
+  }
 
-  VkShaderModuleCreateInfo vertModuleCreateInfo = {
-    .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-    .codeSize = vertSize,
-    .pCode = (const uint32_t *) vertShaderCode};
-  VkShaderModuleCreateInfo fragModuleCreateInfo = {
+  app->startup_timings.stage_ns[STRS_STARTUP_STAGE_SHADER_LOAD] = strs_clock_now_ns() - begin;
+}
+
+STRS_INTERN VkShaderModule create_shader_module(internal_strs_app *app, char **code, size_t size) {
+  dbg_assert(*code != NULL);
+  VkShaderModuleCreateInfo moduleCreateInfo = {
     .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-    .codeSize = fragSize,
-    .pCode = (const uint32_t *) fragShaderCode};
+    .codeSize = size,
+    .pCode = (const uint32_t *) *code};
 
-  VkResult result;
-  result = vkCreateShaderModule(app->logical_device, &vertModuleCreateInfo, NULL, &app->vert_shader_module);
-  dbg_assert(result == VK_SUCCESS);
-  result = vkCreateShaderModule(app->logical_device, &fragModuleCreateInfo, NULL, &app->frag_shader_module);
+  VkShaderModule module;
+  VkResult result = vkCreateShaderModule(app->logical_device, &moduleCreateInfo, &app->host_allocator, &module);
   dbg_assert(result == VK_SUCCESS);
+  free(*code);
+  *code = NULL;
+  return module;
+}
+
+STRS_INTERN void create_shader_modules(internal_strs_app *app) {
+  internal_strs_context *context = app->context;
+  strs_jobs_wait(context->jobs, app->shader_loader);
+
+  if (context->vert_shader_modules[app->vertex_format] == VK_NULL_HANDLE) {
+    context->vert_shader_modules[app->vertex_format] =
+      create_shader_module(app, &app->vert_shader_code, app->vert_shader_size);
+    if (app->bindless_textures && app->frag_bindless_shader_code != NULL) {
+      context->frag_shader_modules[app->vertex_format] =
+        create_shader_module(app, &app->frag_bindless_shader_code, app->frag_bindless_shader_size);
+    } else {
+      context->frag_shader_modules[app->vertex_format] =
+        create_shader_module(app, &app->frag_shader_code, app->frag_shader_size);
+    }
+    free(app->frag_shader_code);
+    free(app->frag_bindless_shader_code);
+    app->frag_shader_code = NULL;
+    app->frag_bindless_shader_code = NULL;
+  }
+  if (context->shape_vert_shader_module == VK_NULL_HANDLE) {
+    context->shape_vert_shader_module =
+      create_shader_module(app, &app->shape_vert_shader_code, app->shape_vert_shader_size);
+    if (app->bindless_textures) {
+      context->shape_frag_shader_module =
+        create_shader_module(app, &app->shape_bindless_frag_shader_code, app->shape_bindless_frag_shader_size);
+    } else {
+      context->shape_frag_shader_module =
+        create_shader_module(app, &app->shape_frag_shader_code, app->shape_frag_shader_size);
+    }
+    free(app->shape_frag_shader_code);
+    free(app->shape_bindless_frag_shader_code);
+    app->shape_frag_shader_code = NULL;
+    app->shape_bindless_frag_shader_code = NULL;
+  }
 
-  free(vertShaderCode);
-  free(fragShaderCode);
+  app->vert_shader_module = context->vert_shader_modules[app->vertex_format];
+  app->frag_shader_module = context->frag_shader_modules[app->vertex_format];
+  app->shape_vert_shader_module = context->shape_vert_shader_module;
+  app->shape_frag_shader_module = context->shape_frag_shader_module;
 }
 
 STRS_INTERN void create_render_pass(internal_strs_app *app) {
@@ -878,12 +2607,33 @@ STRS_INTERN void create_render_pass(internal_strs_app *app) {
     .pDependencies = &dependency};
 
   VkResult result =
-    vkCreateRenderPass(app->logical_device, &renderPassInfo, NULL, &app->render_pass);
+    vkCreateRenderPass(app->logical_device, &renderPassInfo, &app->host_allocator, &app->render_pass);
+  dbg_assert(result == VK_SUCCESS);
+
+  // Layers are drawn with the same pipelines, their pass clears to transparent and leaves the image ready
+  // for the frames that composite it
+  VkSubpassDependency layerDependencies[] = {
+    {.srcSubpass = VK_SUBPASS_EXTERNAL,
+      .dstSubpass = 0,
+      .srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+      .srcAccessMask = 0,
+      .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT},
+    {.srcSubpass = 0,
+      .dstSubpass = VK_SUBPASS_EXTERNAL,
+      .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+      .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+      .dstAccessMask = VK_ACCESS_SHADER_READ_BIT}};
+  colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  renderPassInfo.dependencyCount = 2;
+  renderPassInfo.pDependencies = layerDependencies;
+  result = vkCreateRenderPass(app->logical_device, &renderPassInfo, &app->host_allocator, &app->layer_render_pass);
   dbg_assert(result == VK_SUCCESS);
 }
 
 STRS_INTERN void create_image_views(internal_strs_app *app) {
-  app->swap_chain_image_views = malloc(sizeof(VkImageView *) * app->number_of_images);
+  app->swap_chain_image_views = strs_arena_alloc(&app->swap_chain_arena, sizeof(VkImageView) * app->number_of_images);
 
   for (size_t i = 0; i < app->number_of_images; i++) {
     VkImageViewCreateInfo createInfo = {
@@ -902,13 +2652,14 @@ STRS_INTERN void create_image_views(internal_strs_app *app) {
       .subresourceRange.layerCount = 1};
 
     VkResult result =
-      vkCreateImageView(app->logical_device, &createInfo, NULL, &app->swap_chain_image_views[i]);
+      vkCreateImageView(app->logical_device, &createInfo, &app->host_allocator, &app->swap_chain_image_views[i]);
     dbg_assert(result == VK_SUCCESS);
   }
 }
 
 STRS_INTERN void create_swap_chain(internal_strs_app *app) {
-  SwapChainSupportDetails swapChainSupport = query_swap_chain_support(app->physical_device, app->surface);
+  SwapChainSupportDetails swapChainSupport = query_swap_chain_support(frame_arena(app), app->physical_device,
+                                                                      app->surface);
 
   VkSurfaceFormatKHR surfaceFormat =
     chooseSwapSurfaceFormat(swapChainSupport.formats, swapChainSupport.formatsSize);
@@ -931,7 +2682,7 @@ STRS_INTERN void create_swap_chain(internal_strs_app *app) {
     .imageArrayLayers = 1,
     .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT};
 
-  QueueFamilyIndices familyIndices = find_queue_family_indices(app->physical_device, app->surface);
+  QueueFamilyIndices familyIndices = app->queue_families;
   uint32_t queueFamilyIndices[] = {familyIndices.graphics_family.value, familyIndices.present_family.value};
 
   if (familyIndices.graphics_family.value != familyIndices.present_family.value) {
@@ -949,22 +2700,26 @@ STRS_INTERN void create_swap_chain(internal_strs_app *app) {
 
   createInfo.oldSwapchain = app->swap_chain == NULL ? VK_NULL_HANDLE : app->swap_chain;
 
-  VkResult result = vkCreateSwapchainKHR(app->logical_device, &createInfo, NULL, &app->swap_chain);
+  VkResult result = vkCreateSwapchainKHR(app->logical_device, &createInfo, &app->host_allocator, &app->swap_chain);
   dbg_assert(result == VK_SUCCESS);
 
   vkGetSwapchainImagesKHR(app->logical_device, app->swap_chain, &imageCount, NULL);
-  app->swap_chain_images = malloc(sizeof(VkImage *) * imageCount);
+  app->swap_chain_images = strs_arena_alloc(&app->swap_chain_arena, sizeof(VkImage) * imageCount);
   vkGetSwapchainImagesKHR(app->logical_device, app->swap_chain, &imageCount, app->swap_chain_images);
 
   app->swap_chain_image_format = surfaceFormat.format;
   app->swap_chain_extent = extent;
   app->number_of_images = imageCount;
-
-  swap_chain_support_details_free(&swapChainSupport);
+  // Every surface format the swap chain picks is 32 bits per pixel
+  app->memory_bytes[STRS_MEMORY_SWAPCHAIN] = (uint64_t) extent.width * extent.height * 4 * imageCount;
 }
 
 STRS_INTERN void create_logical_device(internal_strs_app *app) {
-  QueueFamilyIndices queueFamilyIndices = find_queue_family_indices(app->physical_device, app->surface);
+  if (app->context->logical_device != VK_NULL_HANDLE) {
+    adopt_device(app);
+    return;
+  }
+  QueueFamilyIndices queueFamilyIndices = app->queue_families;
 
   VkDeviceQueueCreateInfo *queueCreateInfos;
 
@@ -982,7 +2737,7 @@ STRS_INTERN void create_logical_device(internal_strs_app *app) {
   } else {
     VkDeviceQueueCreateInfo graphicsQueueCreateInfo = {
       .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-      .queueFamilyIndex = queueFamilyIndices.present_family.value,
+      .queueFamilyIndex = queueFamilyIndices.graphics_family.value,
       .queueCount = 1,
       .pQueuePriorities = &queuePriority};
     VkDeviceQueueCreateInfo presentQueueCreateInfo = {
@@ -996,7 +2751,50 @@ STRS_INTERN void create_logical_device(internal_strs_app *app) {
     queueCreateInfos[1] = presentQueueCreateInfo;
   }
 
-  VkPhysicalDeviceFeatures deviceFeatures = {0};
+  VkPhysicalDeviceFeatures supportedFeatures;
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceFeatures(app->physical_device, &supportedFeatures);
+  vkGetPhysicalDeviceProperties(app->physical_device, &properties);
+
+  VkPhysicalDeviceFeatures deviceFeatures = {
+    .multiDrawIndirect = supportedFeatures.multiDrawIndirect,
+    .drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance,
+    .fullDrawIndexUint32 = supportedFeatures.fullDrawIndexUint32,
+    .textureCompressionBC = supportedFeatures.textureCompressionBC};
+
+  internal_strs_context *context = app->context;
+  const strs_device_capabilities *capabilities = &context->capabilities;
+  // Only what the capability record says is supported is enabled
+  VkPhysicalDeviceVulkan12Features deviceFeatures12 = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+    .drawIndirectCount = capabilities->draw_indirect_count,
+    .timelineSemaphore = capabilities->timeline_semaphore,
+    .descriptorIndexing = capabilities->descriptor_indexing,
+    .runtimeDescriptorArray = capabilities->descriptor_indexing,
+    .shaderSampledImageArrayNonUniformIndexing = capabilities->descriptor_indexing,
+    .descriptorBindingPartiallyBound = capabilities->descriptor_indexing,
+    .descriptorBindingVariableDescriptorCount = capabilities->descriptor_indexing,
+    .descriptorBindingSampledImageUpdateAfterBind = capabilities->descriptor_indexing};
+
+  // Lets the latency thread wait for the frames to reach the display
+  VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR};
+  VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {
+    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+    .pNext = &presentWaitFeatures};
+  bool presentWait = capabilities->present_wait;
+  presentWaitFeatures.presentWait = presentWait;
+  presentIdFeatures.presentId = presentWait;
+
+  context->multi_draw_indirect = capabilities->multi_draw_indirect;
+  context->draw_indirect_first_instance = capabilities->draw_indirect_first_instance;
+  context->draw_indirect_count = capabilities->draw_indirect_count;
+  // Descriptor indexing guarantees far more update after bind images than STRS_TEXTURE_CAPACITY
+  context->bindless_textures = capabilities->descriptor_indexing;
+  context->min_storage_buffer_offset_alignment = properties.limits.minStorageBufferOffsetAlignment;
+  context->max_draw_indirect_count = properties.limits.maxDrawIndirectCount;
+  context->max_draw_indexed_index_value =
+    supportedFeatures.fullDrawIndexUint32 ? UINT32_MAX : properties.limits.maxDrawIndexedIndexValue;
 
   VkDeviceCreateInfo createInfo = {
     .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
@@ -1004,23 +2802,97 @@ STRS_INTERN void create_logical_device(internal_strs_app *app) {
     .pQueueCreateInfos = queueCreateInfos,
     .pEnabledFeatures = &deviceFeatures};
 
-  createInfo.enabledExtensionCount = sizeof(device_extensions) / sizeof(const char *);
-  createInfo.ppEnabledExtensionNames = device_extensions;
+  bool memoryBudget = capabilities->memory_budget;
+
+  const char *extensions[sizeof(device_extensions) / sizeof(const char *) + 3];
+  uint32_t extensionCount = sizeof(device_extensions) / sizeof(const char *);
+  memcpy(extensions, device_extensions, sizeof(device_extensions));
+
+  void *next = NULL;
+  if (presentWait) {
+    extensions[extensionCount++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+    extensions[extensionCount++] = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+    next = &presentIdFeatures;
+  }
+  if (memoryBudget) {
+    extensions[extensionCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+  }
+  if (capabilities->api_version >= VK_API_VERSION_1_2) {
+    deviceFeatures12.pNext = next;
+    next = &deviceFeatures12;
+  }
+  createInfo.pNext = next;
+
+  createInfo.enabledExtensionCount = extensionCount;
+  createInfo.ppEnabledExtensionNames = extensions;
 
   if (enable_validation_layers) {
     createInfo.enabledLayerCount = 1;
     createInfo.ppEnabledLayerNames = validation_layers;
   }
 
-  VkResult result = vkCreateDevice(app->physical_device, &createInfo, NULL, &app->logical_device);
+  VkResult result = vkCreateDevice(app->physical_device, &createInfo, &context->host_allocator,
+                                   &context->logical_device);
+  dbg_assert(result == VK_SUCCESS);
+  vkGetDeviceQueue(context->logical_device, queueFamilyIndices.graphics_family.value, 0, &context->graphics_queue);
+  vkGetDeviceQueue(context->logical_device, queueFamilyIndices.present_family.value, 0, &context->present_queue);
+
+  if (presentWait) {
+    context->wait_for_present =
+      (PFN_vkWaitForPresentKHR) vkGetDeviceProcAddr(context->logical_device, "vkWaitForPresentKHR");
+    context->present_wait = context->wait_for_present != NULL;
+  }
+  context->memory_budget_ext = memoryBudget;
+
+  VkPipelineCacheCreateInfo cacheInfo = {
+    .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+  result = vkCreatePipelineCache(context->logical_device, &cacheInfo, &context->host_allocator,
+                                 &context->pipeline_cache);
   dbg_assert(result == VK_SUCCESS);
-  vkGetDeviceQueue(app->logical_device, queueFamilyIndices.graphics_family.value, 0, &app->graphics_queue);
-  vkGetDeviceQueue(app->logical_device, queueFamilyIndices.present_family.value, 0, &app->present_queue);
 
   free(queueCreateInfos);
+  adopt_device(app);
+}
+
+STRS_INTERN void adopt_device(internal_strs_app *app) {
+  internal_strs_context *context = app->context;
+  app->logical_device = context->logical_device;
+  app->graphics_queue = context->graphics_queue;
+  app->present_queue = context->present_queue;
+  app->pipeline_cache = context->pipeline_cache;
+  app->wait_for_present = context->wait_for_present;
+  app->present_wait = context->present_wait;
+  app->memory_budget_ext = context->memory_budget_ext;
+  app->multi_draw_indirect = context->multi_draw_indirect;
+  app->draw_indirect_first_instance = context->draw_indirect_first_instance;
+  // The culled draws carry the transform node in firstInstance
+  app->gpu_culling = app->gpu_culling && app->draw_indirect_first_instance;
+  app->draw_indirect_count = context->draw_indirect_count;
+  app->bindless_textures = context->bindless_textures;
+  app->min_storage_buffer_offset_alignment = context->min_storage_buffer_offset_alignment;
+  app->max_draw_indirect_count = context->max_draw_indirect_count;
+  app->max_draw_indexed_index_value = context->max_draw_indexed_index_value;
+  if (app->memory_budget_ext) {
+    query_memory_budget(app);
+  }
 }
 
 STRS_INTERN void pick_physical_device(internal_strs_app *app) {
+  internal_strs_context *context = app->context;
+  if (context->physical_device != VK_NULL_HANDLE) {
+    // The device was picked for the first window, later ones only have to be able to present with it
+    VkBool32 presentSupport = false;
+    vkGetPhysicalDeviceSurfaceSupportKHR(context->physical_device, context->queue_families.present_family.value,
+                                         app->surface, &presentSupport);
+    if (!presentSupport) {
+      printf("The GPU of the context can not present to this window\n");
+      exit(-1);
+    }
+    app->physical_device = context->physical_device;
+    app->queue_families = context->queue_families;
+    return;
+  }
+
   uint32_t deviceCount = 0;
   vkEnumeratePhysicalDevices(app->instance, &deviceCount, NULL);
   dbg_assert(deviceCount != 0);
@@ -1028,23 +2900,51 @@ STRS_INTERN void pick_physical_device(internal_strs_app *app) {
   VkPhysicalDevice *physicalDevices = malloc(sizeof(VkPhysicalDevice) * deviceCount);
   vkEnumeratePhysicalDevices(app->instance, &deviceCount, physicalDevices);
 
-  for (int i = 0; i < deviceCount; i++) {
-    if (is_device_suitable(physicalDevices[i], app->surface)) {
+  const char *preferred = getenv("STRS_DEVICE");
+  if (preferred == NULL || preferred[0] == '\0') {
+    preferred = app->preferred_device;
+  }
+
+  strs_device_capabilities capabilities;
+  bool found = false;
+  bool matched = false;
+  for (uint32_t i = 0; i < deviceCount && !matched; i++) {
+    if (!query_device_capabilities(frame_arena(app), physicalDevices[i], app->surface, &capabilities)) {
+      continue;
+    }
+    matched = preferred != NULL && device_matches(preferred, i, capabilities.name);
+    if (matched || !found || capabilities.score > context->capabilities.score) {
+      found = true;
       app->physical_device = physicalDevices[i];
-      free(physicalDevices);
-      return;
+      context->capabilities = capabilities;
     }
   }
+  free(physicalDevices);
 
-  printf("No suitable GPU found, sorry\n");
-  exit(-1);
+  if (!found) {
+    printf("No suitable GPU found, sorry\n");
+    exit(-1);
+  }
+  if (preferred != NULL && !matched) {
+    printf("No suitable GPU matches \"%s\", using %s\n", preferred, context->capabilities.name);
+  }
+
+  app->queue_families = find_queue_family_indices(frame_arena(app), app->physical_device, app->surface);
+  context->physical_device = app->physical_device;
+  context->queue_families = app->queue_families;
 }
 
 STRS_INTERN void create_surface(internal_strs_app *app) {
-  strs_window_create_vulkan_surface(app->window, app->instance, &app->surface, NULL);
+  strs_window_create_vulkan_surface(app->window, app->instance, &app->surface, &app->host_allocator);
 }
 
 STRS_INTERN void create_instance(internal_strs_app *app) {
+  internal_strs_context *context = app->context;
+  if (context->instance != VK_NULL_HANDLE) {
+    app->instance = context->instance;
+    return;
+  }
+
   VkApplicationInfo appInfo = {
     .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
     .pNext = NULL,
@@ -1072,37 +2972,44 @@ STRS_INTERN void create_instance(internal_strs_app *app) {
     instanceInfo.ppEnabledLayerNames = validation_layers;
   }
 
-  VkResult result = vkCreateInstance(&instanceInfo, NULL, &app->instance);
+  VkResult result = vkCreateInstance(&instanceInfo, &context->host_allocator, &context->instance);
   dbg_assert(result == VK_SUCCESS);
+  app->instance = context->instance;
 }
 
 STRS_INTERN void cleanup_swap_chain(internal_strs_app *app) {
   for (size_t i = 0; i < app->number_of_images; i++) {
-    vkDestroyFramebuffer(app->logical_device, app->swap_chain_frame_buffers[i], NULL);
-    vkDestroyBuffer(app->logical_device, app->uniform_buffers[i], NULL);
-    vkFreeMemory(app->logical_device, app->uniform_buffers_memory[i], NULL);
+    vkDestroyFramebuffer(app->logical_device, app->swap_chain_frame_buffers[i], &app->host_allocator);
+    vkDestroyBuffer(app->logical_device, app->uniform_buffers[i], &app->host_allocator);
+    free_memory(app, app->uniform_buffers_memory[i]);
   }
 
-  vkDestroyDescriptorPool(app->logical_device, app->descriptor_pool, NULL);
+  vkDestroyDescriptorPool(app->logical_device, app->descriptor_pool, &app->host_allocator);
 
   vkFreeCommandBuffers(app->logical_device, app->command_pool, app->number_of_images, app->command_buffers);
 
-  vkDestroyPipeline(app->logical_device, app->pipeline, NULL);
-  vkDestroyPipelineLayout(app->logical_device, app->pipeline_layout, NULL);
-  vkDestroyRenderPass(app->logical_device, app->render_pass, NULL);
+  vkDestroyPipeline(app->logical_device, app->pipeline, &app->host_allocator);
+  vkDestroyPipeline(app->logical_device, app->shape_pipeline, &app->host_allocator);
+  vkDestroyPipelineLayout(app->logical_device, app->pipeline_layout, &app->host_allocator);
+  vkDestroyRenderPass(app->logical_device, app->render_pass, &app->host_allocator);
+  release_layer_images(app);
+  vkDestroyRenderPass(app->logical_device, app->layer_render_pass, &app->host_allocator);
 
   for (size_t i = 0; i < app->number_of_images; i++) {
-    vkDestroyImageView(app->logical_device, app->swap_chain_image_views[i], NULL);
+    vkDestroyImageView(app->logical_device, app->swap_chain_image_views[i], &app->host_allocator);
   }
 
-  vkDestroySwapchainKHR(app->logical_device, app->swap_chain, NULL);
+  vkDestroySwapchainKHR(app->logical_device, app->swap_chain, &app->host_allocator);
 
-  free(app->swap_chain_frame_buffers);
-  free(app->swap_chain_image_views);
-  free(app->swap_chain_images);
-
-  free(app->uniform_buffers_memory);
-  free(app->uniform_buffers);
+  strs_arena_reset(&app->swap_chain_arena);
+  app->swap_chain_frame_buffers = NULL;
+  app->swap_chain_image_views = NULL;
+  app->swap_chain_images = NULL;
+  app->uniform_buffers = NULL;
+  app->uniform_buffers_memory = NULL;
+  app->command_buffers = NULL;
+  app->descriptor_sets = NULL;
+  app->cull_descriptor_sets = NULL;
 
   app->swap_chain = NULL;
 }
@@ -1114,11 +3021,13 @@ STRS_INTERN void recreate_swap_chain(internal_strs_app *app) {
     strs_window_get_size(app->window, &width, &height);
     strs_window_wait_events(app->window);
   }
-  vkDeviceWaitIdle(app->logical_device);
+  device_wait_idle(app);
 
+  pthread_mutex_lock(&app->present_lock);
   cleanup_swap_chain(app);
 
   create_swap_chain(app);
+  pthread_mutex_unlock(&app->present_lock);
   create_image_views(app);
   create_render_pass(app);
   create_graphics_pipeline(app);
@@ -1131,6 +3040,25 @@ STRS_INTERN void recreate_swap_chain(internal_strs_app *app) {
 
 STRS_INTERN void draw_frame(internal_strs_app *app) {
   vkWaitForFences(app->logical_device, 1, &app->in_flight_fences[app->current_frame], VK_TRUE, UINT64_MAX);
+  strs_arena_reset(frame_arena(app));
+  if (app->manual_publish) {
+    take_snapshot(app);
+  } else {
+    dispatch_input(app);
+    complete_tasks(app);
+    run_widget_passes(app);
+    view_building_scene(app);
+    capture_call(app, STRS_CALL_FRAME, NULL, 0, NULL, 0);
+  }
+  upload_textures(app);
+
+  // Without present_wait the frame that used this fence before is measured up to its completion
+  if (app->frame_input_ns[app->current_frame] != 0) {
+    pthread_mutex_lock(&app->latency_lock);
+    record_latency(app, strs_clock_now_ns() - app->frame_input_ns[app->current_frame]);
+    pthread_mutex_unlock(&app->latency_lock);
+    app->frame_input_ns[app->current_frame] = 0;
+  }
 
   uint32_t imageIndex = 0;
   VkResult result = vkAcquireNextImageKHR(
@@ -1151,6 +3079,10 @@ STRS_INTERN void draw_frame(internal_strs_app *app) {
   if (app->images_in_flight[imageIndex] != VK_NULL_HANDLE) {
     vkWaitForFences(app->logical_device, 1, &app->images_in_flight[imageIndex], VK_TRUE, UINT64_MAX);
   }
+  if (app->cull_counts != NULL && imageIndex < app->cull_buffer_images) {
+    app->cull_stats.total_draws = app->cull_record_count;
+    app->cull_stats.visible_draws = *(uint32_t*)(app->cull_counts + app->cull_count_stride * imageIndex);
+  }
   app->images_in_flight[imageIndex] = app->in_flight_fences[app->current_frame];
 
   VkSemaphore waitSemaphores[] = {app->image_available_semaphores[app->current_frame]};
@@ -1158,8 +3090,37 @@ STRS_INTERN void draw_frame(internal_strs_app *app) {
   VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
 
   update_uniform_buffers(app, imageIndex);
-  update_vertex_buffer(app);
-  update_index_buffer(app);
+
+  if (app->layers_changed) {
+    rebuild_layers(app);
+  }
+  mark_layers_transforms(app);
+  flatten_transforms(app);
+
+  // The other frame in flight may still read the geometry and the indirect commands
+  if (app->vertex_buffer.contentsChanged || app->index_buffer.contentsChanged || app->shape_buffer.contentsChanged ||
+      app->animation_head_buffer.contentsChanged || app->animation_track_buffer.contentsChanged ||
+      app->transform_buffer.contentsChanged) {
+    device_wait_idle(app);
+    update_vertex_buffer(app);
+    update_index_buffer(app);
+    update_shape_buffer(app);
+    update_animation_buffers(app);
+    update_transform_buffer(app);
+  }
+  check_memory_pressure(app);
+  strs_texture vertex_texture = __atomic_load_n(&app->vertex_texture, __ATOMIC_RELAXED);
+  if (vertex_texture != app->drawn_vertex_texture) {
+    app->drawn_vertex_texture = vertex_texture;
+    app->command_buffers_dirty = true;
+  }
+  update_layers(app, imageIndex);
+
+  if (app->command_buffers_dirty) {
+    vkFreeCommandBuffers(app->logical_device, app->command_pool, app->number_of_images, app->command_buffers);
+    create_command_buffers(app);
+    app->command_buffers_dirty = false;
+  }
 
   VkSubmitInfo submitInfo = {
     .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
@@ -1171,10 +3132,11 @@ STRS_INTERN void draw_frame(internal_strs_app *app) {
     .signalSemaphoreCount = 1,
     .pSignalSemaphores = signalSemaphores};
 
+  uint64_t inputNs = latch_input(app, imageIndex);
+
   vkResetFences(app->logical_device, 1, &app->in_flight_fences[app->current_frame]);
 
-  result = vkQueueSubmit(app->graphics_queue, 1, &submitInfo, app->in_flight_fences[app->current_frame]);
-  dbg_assert(result == VK_SUCCESS);
+  queue_submit(app, &submitInfo, app->in_flight_fences[app->current_frame]);
 
   VkSwapchainKHR swapChains[] = {app->swap_chain};
 
@@ -1186,7 +3148,37 @@ STRS_INTERN void draw_frame(internal_strs_app *app) {
     .pSwapchains = swapChains,
     .pImageIndices = &imageIndex};
 
+  uint64_t presentId = ++app->present_id;
+  VkPresentIdKHR presentIdInfo = {
+    .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+    .swapchainCount = 1,
+    .pPresentIds = &presentId};
+  if (app->present_wait) {
+    presentInfo.pNext = &presentIdInfo;
+  }
+
+  pthread_mutex_lock(&app->context->queue_lock);
   result = vkQueuePresentKHR(app->present_queue, &presentInfo);
+  pthread_mutex_unlock(&app->context->queue_lock);
+  if (app->startup_timings.first_frame_ns == 0 && (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)) {
+    app->startup_timings.first_frame_ns = strs_clock_now_ns() - app->startup_begin;
+  }
+  if (inputNs != 0 && (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)) {
+    if (app->present_wait) {
+      pthread_mutex_lock(&app->latency_lock);
+      if (app->latency_frame_count < LATENCY_QUEUE_SIZE) {
+        uint32_t slot = (app->latency_frame_first + app->latency_frame_count++) % LATENCY_QUEUE_SIZE;
+        app->latency_frames[slot] = (latency_frame){
+          .swap_chain = app->swap_chain,
+          .present_id = presentId,
+          .input_ns = inputNs};
+        pthread_cond_signal(&app->latency_cond);
+      }
+      pthread_mutex_unlock(&app->latency_lock);
+    } else {
+      app->frame_input_ns[app->current_frame] = inputNs;
+    }
+  }
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || app->frame_buffer_resized) {
     app->frame_buffer_resized = false;
     recreate_swap_chain(app);
@@ -1198,19 +3190,14 @@ STRS_INTERN void draw_frame(internal_strs_app *app) {
 }
 
 void update_uniform_buffers(internal_strs_app *app, uint32_t current_image) {
-  time_passed += 0.01f;
+  float time = (float) app_seconds(app);
 
   UniformBufferObject ubo = {0};
-  ubo.model[0][0] = 1.0f;
-  ubo.model[1][1] = 1.0f;
-  ubo.model[2][2] = 1.0f;
-  ubo.model[3][3] = 1.0f;
-  glm_rotate(ubo.model, (float) (time_passed * degrees_to_radians(90.0f)), (vec3) {0.0f, 0.0f, 1.0f});
-  glm_lookat((vec3) {2.0f, 2.0f, 2.0f}, (vec3) {0.0f, 0.0f, 0.0f}, (vec3) {0.0f, 0.0f, 1.0f}, ubo.view);
-  glm_perspective((float) degrees_to_radians(45.0f),
-                  (float) app->swap_chain_extent.width / (float) app->swap_chain_extent.height,
-                  0.1f, 10.0f, ubo.proj);
-  ubo.proj[1][1] *= -1;
+  glm_mat4_identity(ubo.model);
+  glm_mat4_identity(ubo.view);
+  world_projection(app, ubo.proj);
+  memcpy(ubo.viewport, app->cull_viewport, sizeof(ubo.viewport));
+  ubo.time = time;
 
   void *data;
   vkMapMemory(app->logical_device, app->uniform_buffers_memory[current_image], 0, sizeof(ubo), 0, &data);
@@ -1219,22 +3206,26 @@ void update_uniform_buffers(internal_strs_app *app, uint32_t current_image) {
 }
 
 STRS_INTERN void create_descriptor_pool(internal_strs_app *app) {
-  VkDescriptorPoolSize poolSize = {
-    .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-    .descriptorCount = app->number_of_images};
+  // The cull pass gets its own set per image with the uniform buffer and four storage buffers
+  VkDescriptorPoolSize poolSizes[] = {
+    {.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+      .descriptorCount = app->number_of_images * 2},
+    {.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = app->number_of_images * (app->gpu_culling ? 7 : 3)}};
 
   VkDescriptorPoolCreateInfo poolInfo = {
     .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-    .poolSizeCount = 1,
-    .pPoolSizes = &poolSize,
-    .maxSets = app->number_of_images};
+    .poolSizeCount = 2,
+    .pPoolSizes = poolSizes,
+    .maxSets = app->number_of_images * (app->gpu_culling ? 2 : 1)};
 
-  VkResult result = vkCreateDescriptorPool(app->logical_device, &poolInfo, NULL, &app->descriptor_pool);
+  VkResult result = vkCreateDescriptorPool(app->logical_device, &poolInfo, &app->host_allocator, &app->descriptor_pool);
   dbg_assert(result == VK_SUCCESS);
 }
 
 STRS_INTERN void create_descriptor_sets(internal_strs_app *app) {
-  VkDescriptorSetLayout *layouts = malloc(sizeof(VkDescriptorSetLayout) * app->number_of_images);
+  VkDescriptorSetLayout *layouts = strs_arena_alloc(frame_arena(app),
+                                                    sizeof(VkDescriptorSetLayout) * app->number_of_images);
   for (int i = 0; i < app->number_of_images; i++) {
     layouts[i] = app->descriptor_set_layout;
   }
@@ -1244,7 +3235,7 @@ STRS_INTERN void create_descriptor_sets(internal_strs_app *app) {
     .descriptorSetCount = app->number_of_images,
     .pSetLayouts = layouts};
 
-  app->descriptor_sets = malloc(sizeof(VkDescriptorSet) * app->number_of_images);
+  app->descriptor_sets = strs_arena_alloc(&app->swap_chain_arena, sizeof(VkDescriptorSet) * app->number_of_images);
   VkResult result = vkAllocateDescriptorSets(app->logical_device, &allocInfo, app->descriptor_sets);
   dbg_assert(result == VK_SUCCESS);
 
@@ -1268,6 +3259,34 @@ STRS_INTERN void create_descriptor_sets(internal_strs_app *app) {
                            &descriptorWrite,
                            0, NULL);
   }
+
+  if (app->animation_head_buffer.buffer == VK_NULL_HANDLE) {
+    create_animation_buffers(app);
+  }
+  write_animation_descriptor_sets(app);
+
+  if (app->transform_buffer.buffer == VK_NULL_HANDLE) {
+    create_transform_buffer(app);
+  }
+  write_transform_descriptor_sets(app);
+
+  if (app->gpu_culling) {
+    for (int i = 0; i < app->number_of_images; i++) {
+      layouts[i] = app->cull_descriptor_set_layout;
+    }
+    app->cull_descriptor_sets = strs_arena_alloc(&app->swap_chain_arena,
+                                                 sizeof(VkDescriptorSet) * app->number_of_images);
+    result = vkAllocateDescriptorSets(app->logical_device, &allocInfo, app->cull_descriptor_sets);
+    dbg_assert(result == VK_SUCCESS);
+
+    if (app->cull_record_buffer != VK_NULL_HANDLE) {
+      if (app->cull_buffer_images != app->number_of_images) {
+        destroy_cull_buffers(app);
+        create_cull_buffers(app);
+      }
+      write_cull_descriptor_sets(app);
+    }
+  }
 }
 
 void endSingleTimeCommands(internal_strs_app *app, VkCommandBuffer commandBuffer) {
@@ -1278,8 +3297,7 @@ void endSingleTimeCommands(internal_strs_app *app, VkCommandBuffer commandBuffer
     .commandBufferCount = 1,
     .pCommandBuffers = &commandBuffer};
 
-  vkQueueSubmit(app->graphics_queue, 1, &submitInfo, VK_NULL_HANDLE);
-  vkQueueWaitIdle(app->graphics_queue);
+  queue_submit(app, &submitInfo, VK_NULL_HANDLE);
 
   vkFreeCommandBuffers(app->logical_device, app->command_pool, 1, &commandBuffer);
 }
@@ -1373,7 +3391,7 @@ void transitionImageLayout(internal_strs_app *app, VkImage image,
   endSingleTimeCommands(app, commandBuffer);
 }
 
-void createImage(internal_strs_app *app, uint32_t width, uint32_t height,
+void createImage(internal_strs_app *app, uint32_t width, uint32_t height, uint32_t mipLevels,
                  VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
   							 VkMemoryPropertyFlags properties, VkImage *image,
                  VkDeviceMemory *imageMemory) {
@@ -1383,7 +3401,7 @@ void createImage(internal_strs_app *app, uint32_t width, uint32_t height,
     .extent.width = width,
     .extent.height = height,
     .extent.depth = 1,
-    .mipLevels = 1,
+    .mipLevels = mipLevels,
     .arrayLayers = 1,
     .format = format,
     .tiling = tiling,
@@ -1392,235 +3410,3847 @@ void createImage(internal_strs_app *app, uint32_t width, uint32_t height,
     .samples = VK_SAMPLE_COUNT_1_BIT,
     .sharingMode = VK_SHARING_MODE_EXCLUSIVE};
 
-  VkResult result = vkCreateImage(app->logical_device, &imageInfo, NULL, image);
+  VkResult result = vkCreateImage(app->logical_device, &imageInfo, &app->host_allocator, image);
 
   VkMemoryRequirements memRequirements;
   vkGetImageMemoryRequirements(app->logical_device, *image, &memRequirements);
 
-  VkMemoryAllocateInfo allocInfo = {
-    .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-    .allocationSize = memRequirements.size,
-    .memoryTypeIndex = find_memory_type(app->physical_device, memRequirements.memoryTypeBits, properties)};
-
-  result = vkAllocateMemory(app->logical_device, &allocInfo, NULL, imageMemory);
+  *imageMemory = allocate_memory(app, STRS_MEMORY_TEXTURES, memRequirements, properties);
 
   vkBindImageMemory(app->logical_device, *image, *imageMemory, 0);
 }
 
-void create_texture_image(internal_strs_app *app) {
-  int texWidth, texHeight, texChannels;
-  stbi_uc *pixels = stbi_load("texture.jpg", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-  VkDeviceSize imageSize = texWidth * texHeight * 4;
-
-  dbg_assert(pixels != NULL);
+static const uint8_t KTX2_IDENTIFIER[12] = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+// The header and the index before it, then 24 bytes per level
+#define KTX2_LEVEL_INDEX_OFFSET 80
 
-  VkBuffer stagingBuffer;
-  VkDeviceMemory stagingBufferMemory;
-  create_buffer(app, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                &stagingBuffer, &stagingBufferMemory);
+STRS_INTERN bool is_block_compressed(VkFormat format) {
+  return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+}
 
-  void *data;
-  vkMapMemory(app->logical_device, stagingBufferMemory, 0, imageSize, 0, &data);
-  memcpy(data, pixels, imageSize);
-  vkUnmapMemory(app->logical_device, stagingBufferMemory);
+// BC1 and BC4 pack a 4x4 block into 8 bytes, the others into 16
+STRS_INTERN uint32_t block_bytes(VkFormat format) {
+  return format <= VK_FORMAT_BC1_RGBA_SRGB_BLOCK || format == VK_FORMAT_BC4_UNORM_BLOCK ||
+         format == VK_FORMAT_BC4_SNORM_BLOCK ? 8 : 16;
+}
 
-  stbi_image_free(pixels);
+STRS_INTERN uint32_t read_u32(const uint8_t *src) {
+  uint32_t value;
+  memcpy(&value, src, sizeof(value));
+  return value;
+}
 
-  createImage(app, texWidth, texHeight,
-              VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-              VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &app->texture_image, &app->texture_image_memory);
+STRS_INTERN uint64_t read_u64(const uint8_t *src) {
+  uint64_t value;
+  memcpy(&value, src, sizeof(value));
+  return value;
+}
 
-  transitionImageLayout(app, app->texture_image,
-                        VK_FORMAT_R8G8B8A8_SRGB,
-                        VK_IMAGE_LAYOUT_UNDEFINED,
-                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-  copyBufferToImage(app, stagingBuffer, app->texture_image, texWidth, texHeight);
-  transitionImageLayout(app, app->texture_image,
-                        VK_FORMAT_R8G8B8A8_SRGB,
-                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+// 2D textures without supercompression, the level data is uploaded straight from the file
+STRS_INTERN bool parse_ktx2(texture_upload *upload) {
+  const uint8_t *file = upload->data;
+  if (upload->size < KTX2_LEVEL_INDEX_OFFSET || memcmp(file, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0) {
+    return false;
+  }
 
-  vkDestroyBuffer(app->logical_device, stagingBuffer, NULL);
-  vkFreeMemory(app->logical_device, stagingBufferMemory, NULL);
-}
+  VkFormat format = (VkFormat) read_u32(file + 12);
+  uint32_t width = read_u32(file + 20);
+  uint32_t height = read_u32(file + 24);
+  uint32_t depth = read_u32(file + 28);
+  uint32_t layers = read_u32(file + 32);
+  uint32_t faces = read_u32(file + 36);
+  uint32_t levels = read_u32(file + 40);
+  uint32_t supercompression = read_u32(file + 44);
+  bool compressed = is_block_compressed(format);
+  if (!compressed && format != VK_FORMAT_R8G8B8A8_UNORM && format != VK_FORMAT_R8G8B8A8_SRGB) {
+    return false;
+  }
+  if (width == 0 || height == 0 || depth > 0 || layers > 1 || faces != 1 || supercompression != 0) {
+    return false;
+  }
 
-void update_index_buffer(internal_strs_app *app) {
-  if (app->index_buffer.bufferSize <= app->index_count) {
-    destroy_buffer(app, &app->index_buffer);
-    create_index_buffer(app);
+  // No levels asks for the mips to be generated, blits can not write compressed formats
+  upload->generate_mips = levels == 0 && !compressed;
+  levels = levels == 0 ? 1 : levels;
+  if (levels > TEXTURE_MAX_LEVELS || KTX2_LEVEL_INDEX_OFFSET + 24 * levels > upload->size) {
+    return false;
   }
-  if (app->index_buffer.contentsChanged) {
-    memcpy(app->index_buffer.data, app->indices, app->index_buffer.bufferSize);
+  for (uint32_t i = 0; i < levels; i++) {
+    const uint8_t *entry = file + KTX2_LEVEL_INDEX_OFFSET + 24 * i;
+    uint64_t offset = read_u64(entry);
+    uint64_t length = read_u64(entry + 8);
+    uint64_t levelWidth = width >> i > 0 ? width >> i : 1;
+    uint64_t levelHeight = height >> i > 0 ? height >> i : 1;
+    uint64_t expected = compressed ? ((levelWidth + 3) / 4) * ((levelHeight + 3) / 4) * block_bytes(format)
+                                   : levelWidth * levelHeight * 4;
+    if (length < expected || offset > upload->size || length > upload->size - offset) {
+      return false;
+    }
+    upload->level_offsets[i] = offset;
+    upload->level_sizes[i] = length;
   }
-  copy_buffer(app, app->index_buffer.stagingBuffer, app->index_buffer.buffer, app->index_buffer.bufferSize);
 
-  vkDeviceWaitIdle(app->logical_device);
+  upload->width = width;
+  upload->height = height;
+  upload->format = format;
+  upload->level_count = levels;
+  return true;
+}
 
-  vkFreeCommandBuffers(app->logical_device, app->command_pool, app->number_of_images, app->command_buffers);
-  create_command_buffers(app);
+STRS_INTERN bool is_ktx2_file(const char *path) {
+  uint8_t identifier[sizeof(KTX2_IDENTIFIER)];
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL) {
+    return false;
+  }
+  bool ktx2 = fread(identifier, sizeof(identifier), 1, fp) == 1 &&
+              memcmp(identifier, KTX2_IDENTIFIER, sizeof(identifier)) == 0;
+  fclose(fp);
+  return ktx2;
 }
 
-void destroy_buffer(internal_strs_app *app, vulkan_buffer* buffer) {
-  vkDeviceWaitIdle(app->logical_device);
+STRS_INTERN uint8_t *read_file(const char *path, uint64_t size) {
+  FILE *fp = fopen(path, "rb");
+  if (fp == NULL) {
+    return NULL;
+  }
+  uint8_t *data = malloc(size > 0 ? size : 1);
+  if (size > 0 && fread(data, size, 1, fp) != 1) {
+    free(data);
+    data = NULL;
+  }
+  fclose(fp);
+  return data;
+}
 
-  vkDestroyBuffer(app->logical_device, buffer->stagingBuffer, NULL);
-  vkFreeMemory(app->logical_device, buffer->stagingBufferMemory, NULL);
+// Named after a hash of the source's absolute path
+STRS_INTERN char *texture_cache_path(internal_strs_app *app, const char *path) {
+  char *absolute = realpath(path, NULL);
+  const char *key = absolute != NULL ? absolute : path;
+  uint64_t hash = 14695981039346656037ull;
+  for (const char *c = key; *c != '\0'; c++) {
+    hash = (hash ^ (uint8_t) *c) * 1099511628211ull;
+  }
+  free(absolute);
 
-  vkDestroyBuffer(app->logical_device, buffer->buffer, NULL);
-  vkFreeMemory(app->logical_device, buffer->bufferMemory, NULL);
+  size_t length = strlen(app->texture_cache) + 32;
+  char *cache_path = malloc(length);
+  snprintf(cache_path, length, "%s/%016llx.rgba", app->texture_cache, (unsigned long long) hash);
+  return cache_path;
 }
 
-void strs_push_indices(strs_app app, const uint16_t *indices, uint64_t count) {
-  internal_strs_app *intern_app = (internal_strs_app*)intern_app;
-  uint32_t a = 0;
-  for (uint32_t i = intern_app->index_count; i < intern_app->index_count + count; i++) {
-    intern_app->indices[i] = indices[a];
-    a++;
+STRS_INTERN bool read_texture_cache(const char *cache_path, const struct stat *source, texture_upload *upload) {
+  FILE *fp = fopen(cache_path, "rb");
+  if (fp == NULL) {
+    return false;
   }
-  intern_app->index_count += count;
-  intern_app->index_buffer.contentsChanged = true;
-}
 
-void strs_push_vertices(strs_app app, const strs_vertex *vertices, uint64_t count) {
-  internal_strs_app *intern_app = (internal_strs_app*)intern_app;
-  uint32_t a = 0;
-  for (uint32_t i = intern_app->vertex_count; i < intern_app->vertex_count + count; i++) {
-    intern_app->vertices[i] = vertices[a];
-    a++;
+  texture_cache_header header;
+  bool current = fread(&header, sizeof(header), 1, fp) == 1 && header.magic == TEXTURE_CACHE_MAGIC &&
+                 header.version == TEXTURE_CACHE_VERSION && header.source_size == (uint64_t) source->st_size &&
+                 header.source_mtime == (int64_t) source->st_mtime && header.width > 0 && header.height > 0;
+  if (current) {
+    upload->width = header.width;
+    upload->height = header.height;
+    upload->size = (uint64_t) header.width * header.height * 4;
+    upload->data = malloc(upload->size);
+    current = fread(upload->data, upload->size, 1, fp) == 1;
+    if (!current) {
+      free(upload->data);
+      upload->data = NULL;
+    }
   }
-  intern_app->vertex_count += count;
-  intern_app->vertex_buffer.contentsChanged = true;
+  fclose(fp);
+  return current;
 }
 
-void update_vertex_buffer(internal_strs_app *app) {
-  if (app->vertex_buffer.bufferSize <= app->vertex_count) {
-    destroy_buffer(app, &app->vertex_buffer);
-    create_index_buffer(app);
+// Written next to the entry and renamed over it, so other processes never read half an entry
+STRS_INTERN void write_texture_cache(internal_strs_app *app, const char *cache_path, const struct stat *source,
+                                     const texture_upload *upload) {
+  mkdir(app->texture_cache, 0755);
+  size_t length = strlen(cache_path) + 24;
+  char *temporary = malloc(length);
+  snprintf(temporary, length, "%s.%ld", cache_path, (long) getpid());
+
+  texture_cache_header header = {
+    .magic = TEXTURE_CACHE_MAGIC,
+    .version = TEXTURE_CACHE_VERSION,
+    .width = upload->width,
+    .height = upload->height,
+    .source_size = (uint64_t) source->st_size,
+    .source_mtime = (int64_t) source->st_mtime};
+  FILE *fp = fopen(temporary, "wb");
+  if (fp != NULL) {
+    bool written = fwrite(&header, sizeof(header), 1, fp) == 1 && fwrite(upload->data, upload->size, 1, fp) == 1;
+    written = fclose(fp) == 0 && written;
+    if (!written || rename(temporary, cache_path) != 0) {
+      remove(temporary);
+    }
   }
-  if (app->vertex_buffer.contentsChanged) {
-    memcpy(app->vertex_buffer.data, app->indices, app->vertex_buffer.bufferSize);
+  free(temporary);
+}
+
+STRS_INTERN void queue_texture_upload(internal_strs_app *app, texture_upload *upload) {
+  pthread_mutex_lock(&app->texture_lock);
+  upload->next = app->texture_uploads;
+  app->texture_uploads = upload;
+  pthread_mutex_unlock(&app->texture_lock);
+}
+
+// Runs on the job system, the render thread uploads the result
+STRS_INTERN void *decode_texture(void *data) {
+  texture_upload *upload = (texture_upload*)data;
+  internal_strs_app *app = (internal_strs_app*)upload->app;
+  struct stat source;
+
+  if (stat(upload->path, &source) != 0) {
+    upload->failed = true;
+  } else if (is_ktx2_file(upload->path)) {
+    upload->size = (uint64_t) source.st_size;
+    upload->data = read_file(upload->path, upload->size);
+    upload->failed = upload->data == NULL || !parse_ktx2(upload);
+  } else {
+    char *cache_path = app->texture_cache != NULL ? texture_cache_path(app, upload->path) : NULL;
+    upload->cached = cache_path != NULL && read_texture_cache(cache_path, &source, upload);
+    if (!upload->cached) {
+      int width, height, channels;
+      // stb_image allocates with malloc, so the pixels are freed like every other upload
+      upload->data = stbi_load(upload->path, &width, &height, &channels, STBI_rgb_alpha);
+      upload->failed = upload->data == NULL;
+      if (!upload->failed) {
+        upload->width = (uint32_t) width;
+        upload->height = (uint32_t) height;
+        upload->size = (uint64_t) width * height * 4;
+        if (cache_path != NULL) {
+          write_texture_cache(app, cache_path, &source, upload);
+        }
+      }
+    }
+    free(cache_path);
+    upload->format = VK_FORMAT_R8G8B8A8_SRGB;
+    upload->level_count = 1;
+    upload->level_sizes[0] = upload->size;
+    upload->generate_mips = true;
   }
-  copy_buffer(app, app->vertex_buffer.stagingBuffer, app->vertex_buffer.buffer, app->vertex_buffer.bufferSize);
 
-  vkDeviceWaitIdle(app->logical_device);
+  queue_texture_upload(app, upload);
+  return NULL;
+}
 
-  vkFreeCommandBuffers(app->logical_device, app->command_pool, app->number_of_images, app->command_buffers);
-  create_command_buffers(app);
+// Called with texture_lock held
+STRS_INTERN uint32_t alloc_texture(internal_strs_app *app) {
+  uint32_t slot;
+  if (app->texture_free != UINT32_MAX) {
+    slot = app->texture_free;
+    app->texture_free = app->textures[slot].next_free;
+  } else {
+    dbg_assert(app->texture_count < STRS_TEXTURE_CAPACITY);
+    app->textures = strs_grow_array(app->textures, &app->texture_capacity, app->texture_count + 1, sizeof(texture));
+    slot = (uint32_t) app->texture_count++;
+  }
+  app->textures[slot] = (texture){
+    .used = true,
+    .info.state = STRS_TEXTURE_LOADING};
+  return slot;
 }
 
-static void resize_callback(strs_window window, uint32_t width, uint32_t height) {
-  internal_strs_app *app = strs_window_get_user_pointer(window);
-  app->frame_buffer_resized = true;
+// Called with texture_lock held
+STRS_INTERN void free_texture_slot(internal_strs_app *app, uint32_t slot) {
+  app->textures[slot] = (texture){.next_free = app->texture_free};
+  app->texture_free = slot;
 }
 
-STRS_LIB strs_app strs_app_create(int width, int height, strs_string *title) {
-  internal_strs_app *app = malloc(sizeof(internal_strs_app*));
+// Called with texture_lock held
+STRS_INTERN texture_upload *alloc_texture_upload(internal_strs_app *app) {
+  texture_upload *upload = strs_pool_alloc(&app->texture_upload_pool);
+  *upload = (texture_upload){
+    .app = app,
+    .slot = alloc_texture(app)};
+  return upload;
+}
 
-  app->window = strs_window_create(width, height, title);
-  strs_window_set_user_pointer(app->window, app);
-  strs_window_set_resize_callback(app->window, resize_callback);
+STRS_LIB strs_texture strs_texture_load(strs_app app, const char *path) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  pthread_mutex_lock(&intern_app->texture_lock);
+  texture_upload *upload = alloc_texture_upload(intern_app);
+  pthread_mutex_unlock(&intern_app->texture_lock);
+  upload->path = strdup(path);
 
-  create_instance(app);
-  create_surface(app);
-  pick_physical_device(app);
-  create_logical_device(app);
-  create_swap_chain(app);
-  create_image_views(app);
-  create_render_pass(app);
-  create_shader_modules(app);
-  create_descriptor_set_layout(app);
-  fill_config_info(app);
-  create_graphics_pipeline(app);
-  create_frame_buffers(app);
-  create_command_pool(app);
-  create_vertex_buffer(app);
-  create_index_buffer(app);
-  create_uniform_buffers(app);
-  create_descriptor_pool(app);
-  create_descriptor_sets(app);
-  create_command_buffers(app);
-  create_sync_objects(app);
+  strs_app_spawn(app, decode_texture, upload, NULL, 0, NULL, NULL);
+  return upload->slot + 1;
+}
+
+STRS_LIB strs_texture strs_texture_create(strs_app app, uint32_t width, uint32_t height, const uint8_t *rgba,
+                                          bool mipmaps) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  pthread_mutex_lock(&intern_app->texture_lock);
+  texture_upload *upload = alloc_texture_upload(intern_app);
+  pthread_mutex_unlock(&intern_app->texture_lock);
+  upload->width = width;
+  upload->height = height;
+  upload->format = VK_FORMAT_R8G8B8A8_SRGB;
+  upload->level_count = 1;
+  upload->size = (uint64_t) width * height * 4;
+  upload->level_sizes[0] = upload->size;
+  upload->generate_mips = mipmaps;
+  upload->data = malloc(upload->size);
+  memcpy(upload->data, rgba, upload->size);
+
+  strs_texture handle = upload->slot + 1;
+  queue_texture_upload(intern_app, upload);
+  return handle;
+}
+
+// A texture that is still loading is dropped once its upload arrives
+STRS_LIB void strs_texture_free(strs_app app, strs_texture handle) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  if (handle == STRS_TEXTURE_NONE) {
+    return;
+  }
+  pthread_mutex_lock(&intern_app->texture_lock);
+  texture *tex = &intern_app->textures[handle - 1];
+  dbg_assert(tex->used && !tex->released);
+  tex->released = true;
+  if (tex->info.state != STRS_TEXTURE_LOADING) {
+    intern_app->texture_releases = strs_grow_array(intern_app->texture_releases, &intern_app->texture_release_capacity,
+                                              intern_app->texture_release_count + 1, sizeof(uint32_t));
+    intern_app->texture_releases[intern_app->texture_release_count++] = handle - 1;
+  }
+  pthread_mutex_unlock(&intern_app->texture_lock);
+}
+
+STRS_LIB void strs_set_vertex_texture(strs_app app, strs_texture texture) {
+  __atomic_store_n(&((internal_strs_app*)app)->vertex_texture, texture, __ATOMIC_RELAXED);
+}
+
+STRS_LIB void strs_texture_get_info(strs_app app, strs_texture handle, strs_texture_info *info) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  dbg_assert(handle != STRS_TEXTURE_NONE);
+  pthread_mutex_lock(&intern_app->texture_lock);
+  *info = intern_app->textures[handle - 1].info;
+  pthread_mutex_unlock(&intern_app->texture_lock);
+}
+
+STRS_INTERN void texture_barrier(VkCommandBuffer command_buffer, VkImage image, uint32_t first_level,
+                                 uint32_t level_count, VkImageLayout old_layout, VkImageLayout new_layout,
+                                 VkAccessFlags src_access, VkAccessFlags dst_access,
+                                 VkPipelineStageFlags src_stage, VkPipelineStageFlags dst_stage) {
+  VkImageMemoryBarrier barrier = {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+    .srcAccessMask = src_access,
+    .dstAccessMask = dst_access,
+    .oldLayout = old_layout,
+    .newLayout = new_layout,
+    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    .image = image,
+    .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+    .subresourceRange.baseMipLevel = first_level,
+    .subresourceRange.levelCount = level_count,
+    .subresourceRange.baseArrayLayer = 0,
+    .subresourceRange.layerCount = 1};
+  vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1, &barrier);
+}
+
+// Shared by every texture, trilinear over however many mips a texture has
+STRS_INTERN void create_texture_sampler(internal_strs_app *app) {
+  VkSamplerCreateInfo samplerInfo = {
+    .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+    .magFilter = VK_FILTER_LINEAR,
+    .minFilter = VK_FILTER_LINEAR,
+    .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+    .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+    .minLod = 0.0f,
+    .maxLod = VK_LOD_CLAMP_NONE};
+  VkResult result = vkCreateSampler(app->logical_device, &samplerInfo, &app->host_allocator, &app->texture_sampler);
+  dbg_assert(result == VK_SUCCESS);
+}
+
+STRS_INTERN VkImageView create_texture_view(internal_strs_app *app, VkImage image, VkFormat format,
+                                            uint32_t levels) {
+  VkImageViewCreateInfo viewInfo = {
+    .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+    .image = image,
+    .viewType = VK_IMAGE_VIEW_TYPE_2D,
+    .format = format,
+    .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+    .subresourceRange.baseMipLevel = 0,
+    .subresourceRange.levelCount = levels,
+    .subresourceRange.baseArrayLayer = 0,
+    .subresourceRange.layerCount = 1};
+  VkImageView view;
+  VkResult result = vkCreateImageView(app->logical_device, &viewInfo, &app->host_allocator, &view);
+  dbg_assert(result == VK_SUCCESS);
+  return view;
+}
+
+// Shelf packing, a shelf grows to its tallest texture and the next one starts below it
+STRS_INTERN bool atlas_allocate(texture_atlas *atlas, uint32_t width, uint32_t height, uint32_t *x, uint32_t *y) {
+  if (width > TEXTURE_ATLAS_SIZE) {
+    return false;
+  }
+  if (atlas->cursor_x + width > TEXTURE_ATLAS_SIZE) {
+    atlas->shelf_y += atlas->shelf_height;
+    atlas->shelf_height = 0;
+    atlas->cursor_x = 0;
+  }
+  if (atlas->shelf_y + height > TEXTURE_ATLAS_SIZE) {
+    return false;
+  }
+  *x = atlas->cursor_x;
+  *y = atlas->shelf_y;
+  atlas->cursor_x += width;
+  atlas->shelf_height = height > atlas->shelf_height ? height : atlas->shelf_height;
+  return true;
+}
+
+// Everything but the white block is free again
+STRS_INTERN void reset_atlas(texture_atlas *atlas) {
+  atlas->shelf_y = 0;
+  atlas->shelf_height = TEXTURE_ATLAS_WHITE_SIZE;
+  atlas->cursor_x = TEXTURE_ATLAS_WHITE_SIZE;
+}
+
+STRS_INTERN void copy_to_atlas(internal_strs_app *app, uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                               const uint8_t *rgba) {
+  VkDeviceSize size = (VkDeviceSize) width * height * 4;
+  VkBuffer stagingBuffer;
+  VkDeviceMemory stagingBufferMemory;
+  void *data;
+  create_buffer(app, STRS_MEMORY_STAGING, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &stagingBuffer, &stagingBufferMemory);
+  vkMapMemory(app->logical_device, stagingBufferMemory, 0, size, 0, &data);
+  memcpy(data, rgba, size);
+  vkUnmapMemory(app->logical_device, stagingBufferMemory);
+
+  // Frames still in flight finish sampling before the copy
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands(app);
+  texture_barrier(commandBuffer, app->atlas.image, 0, 1,
+                  app->atlas.written ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                  VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+  VkBufferImageCopy region = {
+    .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+    .imageOffset = {(int32_t) x, (int32_t) y, 0},
+    .imageExtent = {width, height, 1}};
+  vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, app->atlas.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         1, &region);
+  texture_barrier(commandBuffer, app->atlas.image, 0, 1,
+                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                  VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                  VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  endSingleTimeCommands(app, commandBuffer);
+  app->atlas.written = true;
+
+  vkDestroyBuffer(app->logical_device, stagingBuffer, &app->host_allocator);
+  free_memory(app, stagingBufferMemory);
+}
+
+// Only the first level, the atlas is sRGB and has no mips
+STRS_INTERN bool place_in_atlas(internal_strs_app *app, const texture_upload *upload, texture *tex) {
+  if (upload->format != VK_FORMAT_R8G8B8A8_SRGB ||
+      !atlas_allocate(&app->atlas, upload->width, upload->height, &tex->atlas_x, &tex->atlas_y)) {
+    return false;
+  }
+  copy_to_atlas(app, tex->atlas_x, tex->atlas_y, upload->width, upload->height,
+                upload->data + upload->level_offsets[0]);
+  app->atlas.texture_count++;
+  tex->info = (strs_texture_info){
+    .state = STRS_TEXTURE_READY,
+    .width = upload->width,
+    .height = upload->height,
+    .mip_levels = 1,
+    .format = upload->format,
+    .cached = upload->cached,
+    .bytes = (uint64_t) upload->width * upload->height * 4};
+  return true;
+}
+
+// Uploads the levels the source has. Uncompressed sources with a single level get the rest of the
+// chain blitted from it when the format allows linear blits.
+STRS_INTERN bool create_texture(internal_strs_app *app, const texture_upload *upload, texture *tex) {
+  if (!app->bindless_textures) {
+    return place_in_atlas(app, upload, tex);
+  }
+
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(app->physical_device, upload->format, &properties);
+  VkFormatFeatureFlags features = properties.optimalTilingFeatures;
+  if (!(features & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+    return false;
+  }
+
+  VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                      VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  bool generate = upload->generate_mips && (features & blitFeatures) == blitFeatures;
+  uint32_t levels = upload->level_count;
+  if (generate) {
+    levels = 1;
+    while ((upload->width | upload->height) >> levels) {
+      levels++;
+    }
+  }
+
+  VkBuffer stagingBuffer;
+  VkDeviceMemory stagingBufferMemory;
+  void *data;
+  create_buffer(app, STRS_MEMORY_STAGING, upload->size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &stagingBuffer, &stagingBufferMemory);
+  vkMapMemory(app->logical_device, stagingBufferMemory, 0, upload->size, 0, &data);
+  memcpy(data, upload->data, upload->size);
+  vkUnmapMemory(app->logical_device, stagingBufferMemory);
+
+  VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  usage |= generate ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0;
+  createImage(app, upload->width, upload->height, levels, upload->format, VK_IMAGE_TILING_OPTIMAL, usage,
+              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &tex->image, &tex->memory);
+
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands(app);
+  texture_barrier(commandBuffer, tex->image, 0, levels,
+                  VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                  0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                  VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+  VkBufferImageCopy regions[TEXTURE_MAX_LEVELS];
+  for (uint32_t i = 0; i < upload->level_count; i++) {
+    regions[i] = (VkBufferImageCopy){
+      .bufferOffset = upload->level_offsets[i],
+      .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1},
+      .imageExtent = {upload->width >> i > 0 ? upload->width >> i : 1,
+                      upload->height >> i > 0 ? upload->height >> i : 1, 1}};
+  }
+  vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, tex->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         upload->level_count, regions);
+
+  // Each level is read by the blit into the next one, then handed to the shaders
+  uint32_t readyLevels = 0;
+  if (generate) {
+    for (uint32_t i = 1; i < levels; i++) {
+      int32_t srcWidth = (int32_t) (upload->width >> (i - 1) > 0 ? upload->width >> (i - 1) : 1);
+      int32_t srcHeight = (int32_t) (upload->height >> (i - 1) > 0 ? upload->height >> (i - 1) : 1);
+      VkImageBlit blit = {
+        .srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 0, 1},
+        .srcOffsets = {{0, 0, 0}, {srcWidth, srcHeight, 1}},
+        .dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1},
+        .dstOffsets = {{0, 0, 0}, {srcWidth > 1 ? srcWidth / 2 : 1, srcHeight > 1 ? srcHeight / 2 : 1, 1}}};
+
+      texture_barrier(commandBuffer, tex->image, i - 1, 1,
+                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                      VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+      vkCmdBlitImage(commandBuffer,
+                     tex->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                     tex->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                     1, &blit, VK_FILTER_LINEAR);
+      texture_barrier(commandBuffer, tex->image, i - 1, 1,
+                      VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                      VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+                      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    }
+    readyLevels = levels - 1;
+  }
+  texture_barrier(commandBuffer, tex->image, readyLevels, levels - readyLevels,
+                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                  VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+                  VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+  endSingleTimeCommands(app, commandBuffer);
+
+  vkDestroyBuffer(app->logical_device, stagingBuffer, &app->host_allocator);
+  free_memory(app, stagingBufferMemory);
+
+  tex->view = create_texture_view(app, tex->image, upload->format, levels);
+
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(app->logical_device, tex->image, &requirements);
+  tex->info = (strs_texture_info){
+    .state = STRS_TEXTURE_READY,
+    .width = upload->width,
+    .height = upload->height,
+    .mip_levels = levels,
+    .format = upload->format,
+    .compressed = is_block_compressed(upload->format),
+    .cached = upload->cached,
+    .bytes = requirements.size};
+  return true;
+}
+
+// Points a handle at a texture or back at the placeholder. Only between frames after the queue went idle,
+// so no frame in flight sees the slot change. The set is update after bind, recorded frames stay valid.
+STRS_INTERN void bind_texture_slot(internal_strs_app *app, uint32_t index, const texture *tex) {
+  if (!app->bindless_textures) {
+    // Texel centers, bilinear filtering never reaches a neighbour
+    app->atlas.rects[index][0] = (tex->atlas_x + 0.5f) / TEXTURE_ATLAS_SIZE;
+    app->atlas.rects[index][1] = (tex->atlas_y + 0.5f) / TEXTURE_ATLAS_SIZE;
+    app->atlas.rects[index][2] = (tex->info.width - 1.0f) / TEXTURE_ATLAS_SIZE;
+    app->atlas.rects[index][3] = (tex->info.height - 1.0f) / TEXTURE_ATLAS_SIZE;
+    return;
+  }
+  VkDescriptorImageInfo imageInfo = {
+    .sampler = app->texture_sampler,
+    .imageView = tex->view,
+    .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  VkWriteDescriptorSet descriptorWrite = {
+    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+    .dstSet = app->texture_set,
+    .dstBinding = 0,
+    .dstArrayElement = index,
+    .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+    .descriptorCount = 1,
+    .pImageInfo = &imageInfo};
+  vkUpdateDescriptorSets(app->logical_device, 1, &descriptorWrite, 0, NULL);
+}
+
+STRS_INTERN void create_texture_atlas(internal_strs_app *app) {
+  texture_atlas *atlas = &app->atlas;
+  createImage(app, TEXTURE_ATLAS_SIZE, TEXTURE_ATLAS_SIZE, 1, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
+              VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+              &atlas->image, &atlas->memory);
+  atlas->view = create_texture_view(app, atlas->image, VK_FORMAT_R8G8B8A8_SRGB, 1);
+
+  VkDeviceSize rectSize = sizeof(float[4]) * (STRS_TEXTURE_CAPACITY + 1);
+  create_buffer(app, STRS_MEMORY_TEXTURES, rectSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &atlas->rect_buffer, &atlas->rect_memory);
+  vkMapMemory(app->logical_device, atlas->rect_memory, 0, rectSize, 0, (void**)&atlas->rects);
+
+  uint8_t white[TEXTURE_ATLAS_WHITE_SIZE * TEXTURE_ATLAS_WHITE_SIZE * 4];
+  memset(white, 0xFF, sizeof(white));
+  copy_to_atlas(app, 0, 0, TEXTURE_ATLAS_WHITE_SIZE, TEXTURE_ATLAS_WHITE_SIZE, white);
+  reset_atlas(atlas);
+  app->placeholder_texture.info.width = TEXTURE_ATLAS_WHITE_SIZE;
+  app->placeholder_texture.info.height = TEXTURE_ATLAS_WHITE_SIZE;
+  for (uint32_t i = 0; i <= STRS_TEXTURE_CAPACITY; i++) {
+    bind_texture_slot(app, i, &app->placeholder_texture);
+  }
+}
+
+// Every shape samples the set, textures are told apart by their handle alone so one draw covers them all
+STRS_INTERN void create_texture_set(internal_strs_app *app) {
+  create_texture_sampler(app);
+
+  bool bindless = app->bindless_textures;
+  uint32_t imageCount = bindless ? STRS_TEXTURE_CAPACITY + 1 : 1;
+  VkDescriptorSetLayoutBinding layoutBindings[2] = {
+    {.binding = 0,
+      .descriptorCount = imageCount,
+      .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT},
+    {.binding = 1,
+      .descriptorCount = 1,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT}};
+  VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                          VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT;
+  VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+    .bindingCount = 1,
+    .pBindingFlags = &bindingFlags};
+  VkDescriptorSetLayoutCreateInfo layoutInfo = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+    .pNext = bindless ? &bindingFlagsInfo : NULL,
+    .flags = bindless ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT : 0,
+    .bindingCount = bindless ? 1 : 2,
+    .pBindings = layoutBindings};
+  VkResult result = vkCreateDescriptorSetLayout(app->logical_device, &layoutInfo, &app->host_allocator,
+                                                &app->texture_set_layout);
+  dbg_assert(result == VK_SUCCESS);
+
+  VkDescriptorPoolSize poolSizes[2] = {
+    {.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+      .descriptorCount = imageCount},
+    {.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = 1}};
+  VkDescriptorPoolCreateInfo poolInfo = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+    .flags = bindless ? VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT : 0,
+    .poolSizeCount = bindless ? 1 : 2,
+    .pPoolSizes = poolSizes,
+    .maxSets = 1};
+  result = vkCreateDescriptorPool(app->logical_device, &poolInfo, &app->host_allocator,
+                                  &app->texture_descriptor_pool);
+  dbg_assert(result == VK_SUCCESS);
+
+  VkDescriptorSetAllocateInfo allocInfo = {
+    .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+    .descriptorPool = app->texture_descriptor_pool,
+    .descriptorSetCount = 1,
+    .pSetLayouts = &app->texture_set_layout};
+  result = vkAllocateDescriptorSets(app->logical_device, &allocInfo, &app->texture_set);
+  dbg_assert(result == VK_SUCCESS);
+
+  if (!bindless) {
+    create_texture_atlas(app);
+    VkDescriptorImageInfo imageInfo = {
+      .sampler = app->texture_sampler,
+      .imageView = app->atlas.view,
+      .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    VkDescriptorBufferInfo bufferInfo = {
+      .buffer = app->atlas.rect_buffer,
+      .offset = 0,
+      .range = VK_WHOLE_SIZE};
+    VkWriteDescriptorSet descriptorWrites[2] = {
+      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = app->texture_set,
+        .dstBinding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = 1,
+        .pImageInfo = &imageInfo},
+      {.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = app->texture_set,
+        .dstBinding = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .pBufferInfo = &bufferInfo}};
+    vkUpdateDescriptorSets(app->logical_device, 2, descriptorWrites, 0, NULL);
+    return;
+  }
+
+  static const uint8_t white[4] = {0xFF, 0xFF, 0xFF, 0xFF};
+  texture_upload placeholder = {
+    .width = 1,
+    .height = 1,
+    .format = VK_FORMAT_R8G8B8A8_UNORM,
+    .level_count = 1,
+    .level_sizes = {sizeof(white)},
+    .data = (uint8_t*)white,
+    .size = sizeof(white)};
+  bool created = create_texture(app, &placeholder, &app->placeholder_texture);
+  dbg_assert(created);
+
+  // Runs while the swap chain is created on the jobs, the frame arena is that thread's until then
+  VkDescriptorImageInfo *imageInfos = malloc(sizeof(VkDescriptorImageInfo) * imageCount);
+  for (uint32_t i = 0; i < imageCount; i++) {
+    imageInfos[i] = (VkDescriptorImageInfo){
+      .sampler = app->texture_sampler,
+      .imageView = app->placeholder_texture.view,
+      .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  }
+  VkWriteDescriptorSet descriptorWrite = {
+    .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+    .dstSet = app->texture_set,
+    .dstBinding = 0,
+    .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+    .descriptorCount = imageCount,
+    .pImageInfo = imageInfos};
+  vkUpdateDescriptorSets(app->logical_device, 1, &descriptorWrite, 0, NULL);
+  free(imageInfos);
+}
+
+STRS_INTERN void destroy_texture_objects(internal_strs_app *app, const texture *tex) {
+  if (tex->image == VK_NULL_HANDLE) {
+    return;
+  }
+  vkDestroyImageView(app->logical_device, tex->view, &app->host_allocator);
+  vkDestroyImage(app->logical_device, tex->image, &app->host_allocator);
+  free_memory(app, tex->memory);
+}
+
+// Called with texture_lock held
+STRS_INTERN void free_texture_upload(internal_strs_app *app, texture_upload *upload) {
+  free(upload->data);
+  free(upload->path);
+  strs_pool_release(&app->texture_upload_pool, upload);
+}
+
+// On the render thread, which owns the command pool. The images are created without holding the lock.
+STRS_INTERN void upload_textures(internal_strs_app *app) {
+  pthread_mutex_lock(&app->texture_lock);
+  texture_upload *upload = app->texture_uploads;
+  app->texture_uploads = NULL;
+  pthread_mutex_unlock(&app->texture_lock);
+
+  while (upload != NULL) {
+    texture_upload *next = upload->next;
+    texture created = {0};
+
+    pthread_mutex_lock(&app->texture_lock);
+    bool released = app->textures[upload->slot].released;
+    pthread_mutex_unlock(&app->texture_lock);
+    bool ready = !released && !upload->failed && create_texture(app, upload, &created);
+
+    pthread_mutex_lock(&app->texture_lock);
+    texture *tex = &app->textures[upload->slot];
+    tex->image = created.image;
+    tex->memory = created.memory;
+    tex->view = created.view;
+    tex->info = created.info;
+    tex->info.state = ready ? STRS_TEXTURE_READY : STRS_TEXTURE_FAILED;
+    if (ready) {
+      bind_texture_slot(app, upload->slot + 1, &created);
+    }
+    if (tex->released && ready) {
+      app->texture_releases = strs_grow_array(app->texture_releases, &app->texture_release_capacity,
+                                         app->texture_release_count + 1, sizeof(uint32_t));
+      app->texture_releases[app->texture_release_count++] = upload->slot;
+    } else if (tex->released) {
+      free_texture_slot(app, upload->slot);
+    }
+    free_texture_upload(app, upload);
+    pthread_mutex_unlock(&app->texture_lock);
+
+    upload = next;
+  }
+
+  pthread_mutex_lock(&app->texture_lock);
+  uint64_t releaseCount = app->texture_release_count;
+  texture *released = NULL;
+  uint32_t *releasedSlots = NULL;
+  if (releaseCount > 0) {
+    released = strs_arena_alloc(frame_arena(app), sizeof(texture) * releaseCount);
+    releasedSlots = strs_arena_alloc(frame_arena(app), sizeof(uint32_t) * releaseCount);
+    for (uint64_t i = 0; i < releaseCount; i++) {
+      released[i] = app->textures[app->texture_releases[i]];
+      releasedSlots[i] = app->texture_releases[i];
+      free_texture_slot(app, app->texture_releases[i]);
+    }
+    app->texture_release_count = 0;
+  }
+  pthread_mutex_unlock(&app->texture_lock);
+
+  if (releaseCount > 0) {
+    device_wait_idle(app);
+    for (uint64_t i = 0; i < releaseCount; i++) {
+      bind_texture_slot(app, releasedSlots[i] + 1, &app->placeholder_texture);
+      destroy_texture_objects(app, &released[i]);
+    }
+    if (!app->bindless_textures) {
+      app->atlas.texture_count -= (uint32_t) releaseCount;
+      if (app->atlas.texture_count == 0) {
+        reset_atlas(&app->atlas);
+      }
+    }
+  }
+}
+
+STRS_INTERN void destroy_textures(internal_strs_app *app) {
+  pthread_mutex_lock(&app->texture_lock);
+  while (app->texture_uploads != NULL) {
+    texture_upload *next = app->texture_uploads->next;
+    free_texture_upload(app, app->texture_uploads);
+    app->texture_uploads = next;
+  }
+  pthread_mutex_unlock(&app->texture_lock);
+  for (uint64_t i = 0; i < app->texture_count; i++) {
+    destroy_texture_objects(app, &app->textures[i]);
+  }
+  destroy_texture_objects(app, &app->placeholder_texture);
+  if (app->atlas.image != VK_NULL_HANDLE) {
+    vkDestroyImageView(app->logical_device, app->atlas.view, &app->host_allocator);
+    vkDestroyImage(app->logical_device, app->atlas.image, &app->host_allocator);
+    free_memory(app, app->atlas.memory);
+    vkUnmapMemory(app->logical_device, app->atlas.rect_memory);
+    vkDestroyBuffer(app->logical_device, app->atlas.rect_buffer, &app->host_allocator);
+    free_memory(app, app->atlas.rect_memory);
+  }
+  vkDestroyDescriptorPool(app->logical_device, app->texture_descriptor_pool, &app->host_allocator);
+  vkDestroyDescriptorSetLayout(app->logical_device, app->texture_set_layout, &app->host_allocator);
+  vkDestroySampler(app->logical_device, app->texture_sampler, &app->host_allocator);
+  free(app->textures);
+  free(app->texture_releases);
+  free(app->texture_cache);
+}
+
+STRS_INTERN uint32_t layer_of(internal_strs_app *app, uint32_t transform) {
+  return transform < app->transform_layer_count ? app->transform_layers[transform] : LAYER_NONE;
+}
+
+// The draws of the node come from its layer's image instead of the main pass
+STRS_INTERN bool drawn_from_layer(internal_strs_app *app, uint32_t transform) {
+  uint32_t layer = layer_of(app, transform);
+  return layer != LAYER_NONE && app->layers[layer].drawn;
+}
+
+STRS_INTERN float world_scale(const transform_world *world) {
+  const float *l = world->linear;
+  float x = l[0] * l[0] + l[1] * l[1];
+  float y = l[2] * l[2] + l[3] * l[3];
+  return sqrtf(x > y ? x : y);
+}
+
+// {a, b, c, d, x, y} with x' = a * x + c * y + x, false when the world transform is singular
+STRS_INTERN bool invert_world(const transform_world *world, float inverse[6]) {
+  const float *l = world->linear;
+  const float *t = world->translation;
+  float determinant = l[0] * l[3] - l[2] * l[1];
+  if (fabsf(determinant) < 1e-12f) {
+    return false;
+  }
+  inverse[0] = l[3] / determinant;
+  inverse[1] = -l[1] / determinant;
+  inverse[2] = -l[2] / determinant;
+  inverse[3] = l[0] / determinant;
+  inverse[4] = -(inverse[0] * t[0] + inverse[2] * t[1]);
+  inverse[5] = -(inverse[1] * t[0] + inverse[3] * t[1]);
+  return true;
+}
+
+// Waits for the frames that may still sample the image, the layer is drawn again before it is composited
+STRS_INTERN void release_layer_image(internal_strs_app *app, cached_layer *layer) {
+  if (layer->image == VK_NULL_HANDLE) {
+    return;
+  }
+  device_wait_idle(app);
+  bind_texture_slot(app, layer->texture_slot + 1, &app->placeholder_texture);
+  pthread_mutex_lock(&app->texture_lock);
+  free_texture_slot(app, layer->texture_slot);
+  pthread_mutex_unlock(&app->texture_lock);
+
+  vkDestroyFramebuffer(app->logical_device, layer->framebuffer, &app->host_allocator);
+  vkDestroyImageView(app->logical_device, layer->view, &app->host_allocator);
+  vkDestroyImage(app->logical_device, layer->image, &app->host_allocator);
+  free_memory(app, layer->memory);
+  layer->image = VK_NULL_HANDLE;
+  layer->bytes = 0;
+  layer->dirty = true;
+  app->layer_composites_dirty = true;
+}
+
+STRS_INTERN void release_layer_images(internal_strs_app *app) {
+  for (uint64_t i = 0; i < app->layer_count; i++) {
+    release_layer_image(app, &app->layers[i]);
+  }
+}
+
+// In the swap chain's format so the main pipeline draws into it, sampled through a texture handle
+STRS_INTERN void create_layer_image(internal_strs_app *app, cached_layer *layer, uint32_t width, uint32_t height) {
+  createImage(app, width, height, 1, app->swap_chain_image_format, VK_IMAGE_TILING_OPTIMAL,
+              VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+              &layer->image, &layer->memory);
+  layer->view = create_texture_view(app, layer->image, app->swap_chain_image_format, 1);
+  layer->width = width;
+  layer->height = height;
+
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(app->logical_device, layer->image, &requirements);
+  layer->bytes = requirements.size;
+
+  VkFramebufferCreateInfo framebufferInfo = {
+    .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+    .renderPass = app->layer_render_pass,
+    .attachmentCount = 1,
+    .pAttachments = &layer->view,
+    .width = width,
+    .height = height,
+    .layers = 1};
+  VkResult result = vkCreateFramebuffer(app->logical_device, &framebufferInfo, &app->host_allocator,
+                                        &layer->framebuffer);
+  dbg_assert(result == VK_SUCCESS);
+
+  pthread_mutex_lock(&app->texture_lock);
+  layer->texture_slot = alloc_texture(app);
+  app->textures[layer->texture_slot].info = (strs_texture_info){
+    .state = STRS_TEXTURE_READY,
+    .width = width,
+    .height = height,
+    .mip_levels = 1,
+    .format = app->swap_chain_image_format,
+    .bytes = layer->bytes};
+  pthread_mutex_unlock(&app->texture_lock);
+
+  texture view = {.view = layer->view};
+  bind_texture_slot(app, layer->texture_slot + 1, &view);
+  app->layer_composites_dirty = true;
+}
+
+// Finds the subtrees to cache after layer nodes changed. Layers never nest, a layer node inside another
+// layer is drawn into the outer one, and automatic layers are the children of the root without one.
+STRS_INTERN void rebuild_layers(internal_strs_app *app) {
+  const transform_node *nodes = app->transform_nodes;
+  uint64_t count = app->transform_count;
+  strs_arena *arena = frame_arena(app);
+  uint32_t *entries = strs_arena_alloc(arena, sizeof(uint32_t) * count);
+  bool *contains_layer = strs_arena_alloc(arena, sizeof(bool) * count);
+  bool *keep = strs_arena_alloc(arena, sizeof(bool) * (app->layer_count + count));
+  memset(contains_layer, 0, sizeof(bool) * count);
+  memset(keep, 0, sizeof(bool) * (app->layer_count + count));
+  app->layers_changed = false;
+
+  for (uint64_t n = 0; n < count; n++) {
+    entries[n] = LAYER_NONE;
+    if (nodes[n].used && nodes[n].layer) {
+      for (uint32_t p = (uint32_t) n; p != STRS_TRANSFORM_NONE && !contains_layer[p]; p = nodes[p].links.parent) {
+        contains_layer[p] = true;
+      }
+    }
+  }
+
+  for (uint32_t n = 1; n < count; n++) {
+    if (!nodes[n].used) {
+      continue;
+    }
+    bool outermost = nodes[n].layer;
+    for (uint32_t p = nodes[n].links.parent; outermost && p != STRS_TRANSFORM_NONE; p = nodes[p].links.parent) {
+      outermost = !nodes[p].layer;
+    }
+    bool automatic = !outermost && app->layer_promote_frames > 0 && nodes[n].links.parent == STRS_TRANSFORM_ROOT &&
+                     !contains_layer[n];
+    if (!outermost && !automatic) {
+      continue;
+    }
+
+    uint64_t e = 0;
+    while (e < app->layer_count && app->layers[e].transform != n) {
+      e++;
+    }
+    if (e == app->layer_count) {
+      app->layers = strs_grow_array(app->layers, &app->layer_capacity, app->layer_count + 1, sizeof(cached_layer));
+      app->layers[app->layer_count++] = (cached_layer){.transform = n, .automatic = automatic, .dirty = true};
+    } else if (app->layers[e].automatic != automatic) {
+      release_layer_image(app, &app->layers[e]);
+      app->layers[e] = (cached_layer){.transform = n, .automatic = automatic, .dirty = true};
+    }
+
+    cached_layer *layer = &app->layers[e];
+    if (!automatic) {
+      const float *b = nodes[n].layer_bounds;
+      if (memcmp(layer->bounds, b, sizeof(layer->bounds)) != 0) {
+        memcpy(layer->bounds, b, sizeof(layer->bounds));
+        layer->dirty = true;
+      }
+      layer->promoted = app->bindless_textures && b[2] > b[0] && b[3] > b[1];
+    }
+    layer->follows = false;
+    keep[e] = true;
+    entries[n] = (uint32_t) e;
+  }
+
+  uint32_t *moved = strs_arena_alloc(arena, sizeof(uint32_t) * (app->layer_count + 1));
+  uint64_t kept = 0;
+  for (uint64_t e = 0; e < app->layer_count; e++) {
+    if (!keep[e]) {
+      release_layer_image(app, &app->layers[e]);
+      continue;
+    }
+    moved[e] = (uint32_t) kept;
+    app->layers[kept++] = app->layers[e];
+  }
+  app->layer_count = kept;
+
+  // The split of the draws changes when a node moves to another layer or one starts or stops being cached
+  bool split = app->transform_layer_count != count;
+  app->transform_layers = strs_grow_array(app->transform_layers, &app->transform_layer_capacity, count, sizeof(uint32_t));
+  for (uint32_t n = 0; n < count; n++) {
+    uint32_t layer = LAYER_NONE;
+    bool follows = false;
+    for (uint32_t p = n; nodes[n].used && p != STRS_TRANSFORM_NONE; p = nodes[p].links.parent) {
+      layer = layer == LAYER_NONE && entries[p] != LAYER_NONE ? moved[entries[p]] : layer;
+      follows = follows || nodes[p].follow_pointer;
+    }
+    if (layer != LAYER_NONE && follows) {
+      app->layers[layer].follows = true;
+    }
+    split = split || app->transform_layers[n] != layer;
+    app->transform_layers[n] = layer;
+  }
+  app->transform_layer_count = count;
+
+  for (uint64_t e = 0; e < app->layer_count; e++) {
+    split = split || app->layers[e].drawn != (app->layers[e].promoted && !app->layers[e].follows);
+  }
+  if (split) {
+    app->index_buffer.contentsChanged = true;
+  }
+  app->layer_composites_dirty = true;
+}
+
+// A node that moved inside a layer changes what the layer shows, the layer's own node only moves the image
+STRS_INTERN void mark_layers_transforms(internal_strs_app *app) {
+  for (uint64_t i = 0; i < app->transform_dirty_count; i++) {
+    uint32_t transform = app->transform_dirty[i];
+    uint32_t layer = layer_of(app, transform);
+    if (layer != LAYER_NONE && app->layers[layer].transform != transform) {
+      app->layers[layer].dirty = true;
+    }
+  }
+}
+
+STRS_INTERN void mark_layers_vertices(internal_strs_app *app, uint64_t begin, uint64_t end) {
+  for (uint64_t i = 0; i < app->layer_count; i++) {
+    cached_layer *layer = &app->layers[i];
+    if (layer->first_vertex < end && begin < layer->vertex_end) {
+      layer->dirty = true;
+    }
+  }
+}
+
+// A layer is drawn again when the indices of its subtree changed, the vertices they reach are watched
+// by update_vertex_buffer
+STRS_INTERN void hash_layer_contents(internal_strs_app *app) {
+  if (app->layer_count == 0) {
+    return;
+  }
+  uint64_t *hashes = strs_arena_alloc(frame_arena(app), sizeof(uint64_t) * app->layer_count);
+  for (uint64_t i = 0; i < app->layer_count; i++) {
+    hashes[i] = 14695981039346656037ull;
+    app->layers[i].first_vertex = UINT32_MAX;
+    app->layers[i].vertex_end = 0;
+  }
+
+  for (uint64_t d = 0; d < app->draw_command_count; d++) {
+    const VkDrawIndexedIndirectCommand *command = &app->draw_commands[d];
+    uint32_t index = layer_of(app, command->firstInstance);
+    if (index == LAYER_NONE) {
+      continue;
+    }
+    cached_layer *layer = &app->layers[index];
+    uint64_t hash = (hashes[index] ^ command->firstInstance) * 1099511628211ull;
+    for (uint64_t k = command->firstIndex; k < (uint64_t) command->firstIndex + command->indexCount; k++) {
+      uint32_t vertex = app->scene.indices[k];
+      hash = (hash ^ vertex) * 1099511628211ull;
+      layer->first_vertex = vertex < layer->first_vertex ? vertex : layer->first_vertex;
+      layer->vertex_end = vertex + 1 > layer->vertex_end ? vertex + 1 : layer->vertex_end;
+    }
+    hashes[index] = hash;
+  }
+
+  for (uint64_t i = 0; i < app->layer_count; i++) {
+    if (app->layers[i].signature != hashes[i]) {
+      app->layers[i].signature = hashes[i];
+      app->layers[i].dirty = true;
+    }
+  }
+}
+
+// The union of the draw item bounds in the subtree, in the space of the layer's node. An item without
+// bounds keeps the subtree from being cached.
+STRS_INTERN bool automatic_layer_bounds(internal_strs_app *app, uint32_t index, float bounds[4]) {
+  float inverse[6];
+  float result[4] = {FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX};
+  if (!invert_world(&app->transform_worlds[app->layers[index].transform], inverse)) {
+    return false;
+  }
+
+  for (uint64_t i = 0; i < app->scene.draw_item_count; i++) {
+    const draw_item *item = &app->scene.draw_items[i];
+    if (layer_of(app, item->transform) != index) {
+      continue;
+    }
+    if (item->bounds[0] > item->bounds[2]) {
+      return false;
+    }
+    const float *l = app->transform_worlds[item->transform].linear;
+    const float *t = app->transform_worlds[item->transform].translation;
+    for (uint32_t c = 0; c < 4; c++) {
+      float x = item->bounds[c & 1 ? 2 : 0];
+      float y = item->bounds[c & 2 ? 3 : 1];
+      float wx = l[0] * x + l[2] * y + t[0];
+      float wy = l[1] * x + l[3] * y + t[1];
+      x = inverse[0] * wx + inverse[2] * wy + inverse[4];
+      y = inverse[1] * wx + inverse[3] * wy + inverse[5];
+      result[0] = x < result[0] ? x : result[0];
+      result[1] = y < result[1] ? y : result[1];
+      result[2] = x > result[2] ? x : result[2];
+      result[3] = y > result[3] ? y : result[3];
+    }
+  }
+  if (result[2] <= result[0] || result[3] <= result[1]) {
+    return false;
+  }
+  memcpy(bounds, result, sizeof(result));
+  return true;
+}
+
+// Draws the layer's subtree into its image, sized to its bounds at the node's world scale
+STRS_INTERN void render_layer(internal_strs_app *app, uint32_t index, uint32_t image, float scale) {
+  cached_layer *layer = &app->layers[index];
+  const float *b = layer->bounds;
+  uint32_t width = clamp_uint((uint32_t) ceilf((b[2] - b[0]) * scale), 1, LAYER_MAX_SIZE);
+  uint32_t height = clamp_uint((uint32_t) ceilf((b[3] - b[1]) * scale), 1, LAYER_MAX_SIZE);
+  if (layer->image == VK_NULL_HANDLE || width != layer->width || height != layer->height) {
+    release_layer_image(app, layer);
+    create_layer_image(app, layer, width, height);
+  }
+  layer->render_scale = scale;
+
+  // Column major, world positions into the node's space, then its bounds onto the image
+  layer_push_constants push = {.active = 1, .texture = app->drawn_vertex_texture};
+  float inverse[6];
+  if (invert_world(&app->transform_worlds[layer->transform], inverse)) {
+    float sx = 2.0f / (b[2] - b[0]);
+    float sy = 2.0f / (b[3] - b[1]);
+    const float clip[16] = {
+      sx * inverse[0], sy * inverse[1], 0.0f, 0.0f,
+      sx * inverse[2], sy * inverse[3], 0.0f, 0.0f,
+      0.0f, 0.0f, 1.0f, 0.0f,
+      sx * (inverse[4] - b[0]) - 1.0f, sy * (inverse[5] - b[1]) - 1.0f, 0.0f, 1.0f};
+    memcpy(push.clip, clip, sizeof(clip));
+  }
+
+  VkCommandBuffer commandBuffer = beginSingleTimeCommands(app);
+  VkClearValue clearColor = {{{0.0f, 0.0f, 0.0f, 0.0f}}};
+  VkRenderPassBeginInfo renderPassInfo = {
+    .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+    .renderPass = app->layer_render_pass,
+    .framebuffer = layer->framebuffer,
+    .renderArea.offset = {0, 0},
+    .renderArea.extent = {width, height},
+    .clearValueCount = 1,
+    .pClearValues = &clearColor};
+  vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+  VkViewport viewport = {
+    .width = (float) width,
+    .height = (float) height};
+  VkRect2D scissor = {
+    .extent = {width, height}};
+  vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+  vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+  if (app->vertex_buffer.buffer != VK_NULL_HANDLE && app->draw_command_count > 0) {
+    VkDeviceSize offset = 0;
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app->pipeline_layout,
+                            0, 1, &app->descriptor_sets[image], 0, NULL);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app->pipeline_layout,
+                            1, 1, &app->texture_set, 0, NULL);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, app->pipeline);
+    vkCmdPushConstants(commandBuffer, app->pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+    mask_push_constants mask = {0};
+    vkCmdPushConstants(commandBuffer, app->pipeline_layout, VK_SHADER_STAGE_FRAGMENT_BIT,
+                       MASK_PUSH_OFFSET, sizeof(mask), &mask);
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &app->vertex_buffer.buffer, &offset);
+    vkCmdBindIndexBuffer(commandBuffer, app->index_buffer.buffer, 0, app->index_type);
+    for (uint64_t draw = 0; draw < app->draw_command_count; draw++) {
+      const VkDrawIndexedIndirectCommand *command = &app->draw_commands[draw];
+      if (layer_of(app, command->firstInstance) == index) {
+        vkCmdDrawIndexed(commandBuffer, command->indexCount, 1, command->firstIndex,
+                         command->vertexOffset, command->firstInstance);
+      }
+    }
+  }
+
+  vkCmdEndRenderPass(commandBuffer);
+  endSingleTimeCommands(app, commandBuffer);
+}
+
+// One shape per cached layer, textured with its image and placed in its node
+STRS_INTERN void destroy_layer_composites(internal_strs_app *app) {
+  for (uint32_t i = 0; i < app->layer_composite_images; i++) {
+    vkDestroyBuffer(app->logical_device, app->layer_composite_buffers[i], &app->host_allocator);
+    free_memory(app, app->layer_composite_memories[i]);
+  }
+  free(app->layer_composite_buffers);
+  free(app->layer_composite_memories);
+  free(app->layer_composite_image_versions);
+  app->layer_composite_buffers = NULL;
+  app->layer_composite_memories = NULL;
+  app->layer_composite_image_versions = NULL;
+  app->layer_composite_images = 0;
+  app->layer_composite_capacity = 0;
+}
+
+// Writes the composites into the buffer of image, whose fence has signaled. Only growing the buffers or a
+// new swap chain waits for the queue, and only a change in the number of layers records the commands again.
+STRS_INTERN void write_layer_composites(internal_strs_app *app, uint32_t image) {
+  if (app->layer_composites_dirty) {
+    app->layer_composite_version++;
+    app->layer_composites_dirty = false;
+  }
+  if (image < app->layer_composite_images &&
+      app->layer_composite_image_versions[image] == app->layer_composite_version) {
+    return;
+  }
+
+  uint32_t count = 0;
+  for (uint64_t i = 0; i < app->layer_count; i++) {
+    count += app->layers[i].drawn && app->layers[i].image != VK_NULL_HANDLE;
+  }
+  if (count != app->layer_composite_count) {
+    app->layer_composite_count = count;
+    app->command_buffers_dirty = true;
+  }
+  if (count == 0) {
+    return;
+  }
+
+  if (app->layer_composite_capacity < count || app->layer_composite_images != app->number_of_images) {
+    // The frames in flight draw from the buffers that are replaced
+    device_wait_idle(app);
+    uint64_t capacity = count * 2 > app->layer_composite_capacity ? count * 2 : app->layer_composite_capacity;
+    destroy_layer_composites(app);
+    app->layer_composite_images = app->number_of_images;
+    app->layer_composite_capacity = capacity;
+    app->layer_composite_buffers = calloc(app->number_of_images, sizeof(VkBuffer));
+    app->layer_composite_memories = calloc(app->number_of_images, sizeof(VkDeviceMemory));
+    app->layer_composite_image_versions = malloc(sizeof(uint64_t) * app->number_of_images);
+    for (uint32_t i = 0; i < app->number_of_images; i++) {
+      create_buffer(app, STRS_MEMORY_GEOMETRY, sizeof(strs_shape) * capacity, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                    &app->layer_composite_buffers[i], &app->layer_composite_memories[i]);
+      app->layer_composite_image_versions[i] = app->layer_composite_version - 1;
+    }
+    app->command_buffers_dirty = true;
+  }
+
+  strs_shape *shapes;
+  uint32_t written = 0;
+  vkMapMemory(app->logical_device, app->layer_composite_memories[image], 0, sizeof(strs_shape) * count, 0,
+              (void**)&shapes);
+  for (uint64_t i = 0; i < app->layer_count; i++) {
+    const cached_layer *layer = &app->layers[i];
+    if (!layer->drawn || layer->image == VK_NULL_HANDLE) {
+      continue;
+    }
+    shapes[written++] = (strs_shape){
+      .x = layer->bounds[0],
+      .y = layer->bounds[1],
+      .width = layer->bounds[2] - layer->bounds[0],
+      .height = layer->bounds[3] - layer->bounds[1],
+      .fill_color = {1.0f, 1.0f, 1.0f, layer->composite_opacity},
+      .transform = layer->transform,
+      .texture = layer->texture_slot + 1};
+  }
+  vkUnmapMemory(app->logical_device, app->layer_composite_memories[image]);
+  app->layer_composite_image_versions[image] = app->layer_composite_version;
+}
+
+// Caches the automatic layers that stayed unchanged and draws the layers whose subtree changed into their
+// images. Runs once the geometry is uploaded, every layer drawn again waits for the queue.
+STRS_INTERN void update_layers(internal_strs_app *app, uint32_t image) {
+  bool split = false;
+  for (uint64_t i = 0; i < app->layer_count; i++) {
+    cached_layer *layer = &app->layers[i];
+    if (layer->automatic && layer->dirty) {
+      layer->stable_frames = 0;
+      layer->promoted = false;
+      release_layer_image(app, layer);
+      layer->dirty = false;
+    } else if (layer->automatic && !layer->promoted && app->bindless_textures && !layer->follows &&
+               ++layer->stable_frames >= app->layer_promote_frames) {
+      layer->promoted = automatic_layer_bounds(app, (uint32_t) i, layer->bounds);
+      layer->stable_frames = 0;
+    }
+    split = split || layer->drawn != (layer->promoted && !layer->follows);
+  }
+  if (split) {
+    device_wait_idle(app);
+    app->index_buffer.contentsChanged = true;
+    update_index_buffer(app);
+    app->layer_composites_dirty = true;
+  }
+
+  app->layer_stats.layer_count = 0;
+  app->layer_stats.bytes = 0;
+  for (uint64_t i = 0; i < app->layer_count; i++) {
+    cached_layer *layer = &app->layers[i];
+    if (!layer->drawn) {
+      layer->dirty = false;
+      continue;
+    }
+    float scale = world_scale(&app->transform_worlds[layer->transform]);
+    if (scale > layer->render_scale * LAYER_RESCALE_RATIO || scale * LAYER_RESCALE_RATIO < layer->render_scale) {
+      layer->dirty = true;
+    }
+    if (layer->dirty || layer->image == VK_NULL_HANDLE) {
+      render_layer(app, (uint32_t) i, image, scale);
+      layer->dirty = false;
+      app->layer_stats.misses++;
+    } else {
+      app->layer_stats.hits++;
+    }
+    app->layer_stats.layer_count++;
+    app->layer_stats.bytes += layer->bytes;
+  }
+
+  // Opacity is applied when compositing, only a change on a node that owns a drawn layer rewrites them
+  for (uint64_t i = 0; i < app->layer_count; i++) {
+    cached_layer *layer = &app->layers[i];
+    float opacity = app->transform_nodes[layer->transform].opacity;
+    if (layer->drawn && layer->composite_opacity != opacity) {
+      layer->composite_opacity = opacity;
+      app->layer_composites_dirty = true;
+    }
+  }
+  write_layer_composites(app, image);
+}
+
+// Splits the triangle list into batches whose vertex span fits in limit and writes
+// the indices relative to each batch's base vertex, 16 bit wide when limit allows it
+// Batches are also cut where the transform node or the clip of the draw items changes
+// A triangle that spans more than limit by itself fits no base vertex, it is written degenerate
+STRS_INTERN uint64_t build_draw_commands(internal_strs_app *app, uint64_t index_count, uint32_t limit, void *dst) {
+  uint16_t *dst16 = (uint16_t*)dst;
+  uint32_t *dst32 = (uint32_t*)dst;
+  const uint32_t *indices = app->scene.indices;
+  const draw_item *items = app->scene.draw_items;
+  uint64_t item_count = app->scene.draw_item_count;
+  uint64_t batch_first = 0;
+  uint32_t batch_transform = STRS_TRANSFORM_ROOT;
+  uint32_t batch_region = 0;
+  uint64_t item = 0;
+  uint32_t low = UINT32_MAX;
+  uint32_t high = 0;
+
+  app->draw_command_count = 0;
+
+  for (uint64_t i = 0; i <= index_count; i += 3) {
+    bool last = i + 3 > index_count;
+    uint32_t triangle_low = UINT32_MAX;
+    uint32_t triangle_high = 0;
+    uint32_t triangle_transform = batch_transform;
+    uint32_t triangle_region = batch_region;
+
+    if (!last) {
+      for (uint64_t k = i; k < i + 3; k++) {
+        triangle_low = indices[k] < triangle_low ? indices[k] : triangle_low;
+        triangle_high = indices[k] > triangle_high ? indices[k] : triangle_high;
+      }
+
+      while (item < item_count &&
+             (uint64_t) items[item].first_index + items[item].index_count <= i) {
+        item++;
+      }
+      bool in_item = item < item_count && items[item].first_index <= i;
+      triangle_transform = in_item ? items[item].transform : STRS_TRANSFORM_ROOT;
+      triangle_region = in_item ? items[item].clip_region : 0;
+    }
+
+    uint32_t new_low = triangle_low < low ? triangle_low : low;
+    uint32_t new_high = triangle_high > high ? triangle_high : high;
+
+    bool cut = triangle_transform != batch_transform || triangle_region != batch_region;
+    if ((last || new_high - new_low > limit || cut) && i > batch_first) {
+      app->draw_commands = strs_grow_array(app->draw_commands, &app->draw_command_capacity,
+                                      app->draw_command_count + 1, sizeof(VkDrawIndexedIndirectCommand));
+      app->draw_commands[app->draw_command_count++] = (VkDrawIndexedIndirectCommand){
+        .indexCount = (uint32_t) (i - batch_first),
+        .instanceCount = 1,
+        .firstIndex = (uint32_t) batch_first,
+        .vertexOffset = (int32_t) low,
+        .firstInstance = batch_transform};
+      app->draw_batches = strs_grow_array(app->draw_batches, &app->draw_batch_capacity,
+                                     app->draw_command_count, sizeof(draw_batch));
+      app->draw_batches[app->draw_command_count - 1] = (draw_batch){.clip_region = batch_region};
+
+      for (uint64_t k = batch_first; k < i; k += 3) {
+        uint32_t relative[3] = {indices[k] - low, indices[k + 1] - low, indices[k + 2] - low};
+        if (relative[0] > limit || relative[1] > limit || relative[2] > limit) {
+          memset(relative, 0, sizeof(relative));
+        }
+        for (uint32_t j = 0; j < 3; j++) {
+          if (app->index_type == VK_INDEX_TYPE_UINT16) {
+            dst16[k + j] = (uint16_t) relative[j];
+          } else {
+            dst32[k + j] = relative[j];
+          }
+        }
+      }
+
+      batch_first = i;
+      new_low = triangle_low;
+      new_high = triangle_high;
+    }
+
+    if (i == batch_first) {
+      batch_transform = triangle_transform;
+      batch_region = triangle_region;
+    }
+    low = new_low;
+    high = new_high;
+  }
+
+  return app->draw_command_count;
+}
+
+STRS_INTERN bool bounds_overlap(const float *a, const float *b) {
+  return a[0] < b[2] && b[0] < a[2] && a[1] < b[3] && b[1] < a[3];
+}
+
+// The pixels a batch may touch as far as ordering goes. Batches of cached layers are drawn unclipped
+// into their image, so they keep their place among everything.
+STRS_INTERN const clip_region *ordering_region(internal_strs_app *app, uint64_t draw, float *bounds) {
+  const clip_region *region = batch_region(app, draw);
+  if (region == NULL || layer_of(app, app->draw_commands[draw].firstInstance) != LAYER_NONE) {
+    const float unclipped[] = {-FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX};
+    memcpy(bounds, unclipped, sizeof(unclipped));
+    return NULL;
+  }
+  bounds[0] = floorf(region->bounds[0]);
+  bounds[1] = floorf(region->bounds[1]);
+  bounds[2] = ceilf(region->bounds[2]);
+  bounds[3] = ceilf(region->bounds[3]);
+  return region;
+}
+
+// Moves batches ahead of earlier ones to join the last run of their scissor, as long as every batch they
+// pass is clipped to pixels theirs can not touch. Whatever could overlap keeps the order it was pushed in.
+STRS_INTERN void order_clipped_batches(internal_strs_app *app) {
+  uint64_t count = app->draw_command_count;
+  bool clipped = false;
+  app->clip_stats.reordered = 0;
+  for (uint64_t d = 0; d < count && !clipped; d++) {
+    clipped = app->draw_batches[d].clip_region != 0;
+  }
+  if (!clipped) {
+    return;
+  }
+
+  strs_arena *arena = frame_arena(app);
+  uint32_t *next = strs_arena_alloc(arena, sizeof(uint32_t) * count);
+  uint32_t *group_first = strs_arena_alloc(arena, sizeof(uint32_t) * count);
+  uint32_t *group_last = strs_arena_alloc(arena, sizeof(uint32_t) * count);
+  const clip_region **group_regions = strs_arena_alloc(arena, sizeof(clip_region*) * count);
+  float *group_bounds = strs_arena_alloc(arena, sizeof(float) * 4 * count);
+  uint64_t group_count = 0;
+
+  for (uint64_t d = 0; d < count; d++) {
+    float bounds[4];
+    const clip_region *region = ordering_region(app, d, bounds);
+    uint64_t target = group_count;
+    for (uint64_t g = group_count; g > 0 && group_count - g < CLIP_REORDER_WINDOW; g--) {
+      const clip_region *other = group_regions[g - 1];
+      bool unmasked = region != NULL && other != NULL && !region->masked && !other->masked;
+      if (other == region || (unmasked && memcmp(&group_bounds[(g - 1) * 4], bounds, sizeof(bounds)) == 0)) {
+        target = g - 1;
+        break;
+      }
+      if (bounds_overlap(&group_bounds[(g - 1) * 4], bounds)) {
+        break;
+      }
+    }
+
+    next[d] = UINT32_MAX;
+    if (target == group_count) {
+      group_first[group_count] = (uint32_t) d;
+      group_last[group_count] = (uint32_t) d;
+      group_regions[group_count] = region;
+      memcpy(&group_bounds[group_count * 4], bounds, sizeof(bounds));
+      group_count++;
+    } else {
+      next[group_last[target]] = (uint32_t) d;
+      group_last[target] = (uint32_t) d;
+      app->clip_stats.reordered += target + 1 < group_count;
+    }
+  }
+
+  VkDrawIndexedIndirectCommand *commands = strs_arena_alloc(arena, sizeof(VkDrawIndexedIndirectCommand) * count);
+  draw_batch *batches = strs_arena_alloc(arena, sizeof(draw_batch) * count);
+  uint64_t k = 0;
+  for (uint64_t g = 0; g < group_count; g++) {
+    for (uint32_t d = group_first[g]; d != UINT32_MAX; d = next[d]) {
+      commands[k] = app->draw_commands[d];
+      batches[k++] = app->draw_batches[d];
+    }
+  }
+  memcpy(app->draw_commands, commands, sizeof(VkDrawIndexedIndirectCommand) * count);
+  memcpy(app->draw_batches, batches, sizeof(draw_batch) * count);
+}
+
+void update_index_buffer(internal_strs_app *app) {
+  uint64_t usable_count = app->scene.index_count - app->scene.index_count % 3;
+  if (!app->index_buffer.contentsChanged) {
+    return;
+  }
+  for (uint64_t i = 0; i < app->layer_count; i++) {
+    app->layers[i].drawn = app->layers[i].promoted && !app->layers[i].follows;
+  }
+  if (usable_count == 0) {
+    app->draw_command_count = 0;
+    app->cull_record_count = 0;
+    app->index_buffer.contentsChanged = false;
+    app->command_buffers_dirty = true;
+    return;
+  }
+
+  uint32_t max_index = 0;
+  uint32_t max_span = 0;
+  for (uint64_t i = 0; i < usable_count; i += 3) {
+    const uint32_t *triangle = &app->scene.indices[i];
+    uint32_t low = triangle[0] < triangle[1] ? triangle[0] : triangle[1];
+    uint32_t high = triangle[0] > triangle[1] ? triangle[0] : triangle[1];
+    low = triangle[2] < low ? triangle[2] : low;
+    high = triangle[2] > high ? triangle[2] : high;
+    max_index = high > max_index ? high : max_index;
+    max_span = high - low > max_span ? high - low : max_span;
+  }
+
+  // No base vertex brings a triangle spanning more than 16 bits into their range, it takes 32 bit indices
+  // even with STRS_INDEX_WIDTH_16. Devices that can't address them draw it degenerate.
+  uint32_t limit;
+  bool wide = app->index_width == STRS_INDEX_WIDTH_32 ||
+              (app->index_width == STRS_INDEX_WIDTH_AUTO && max_index > UINT16_MAX &&
+               app->max_draw_indexed_index_value > UINT16_MAX) ||
+              (max_span > UINT16_MAX && app->max_draw_indexed_index_value > UINT16_MAX);
+  if (wide) {
+    app->index_type = VK_INDEX_TYPE_UINT32;
+    limit = app->max_draw_indexed_index_value;
+  } else {
+    app->index_type = VK_INDEX_TYPE_UINT16;
+    limit = UINT16_MAX;
+  }
+
+  VkDeviceSize requiredSize = (wide ? sizeof(uint32_t) : sizeof(uint16_t)) * usable_count;
+  if (app->index_buffer.bufferSize < requiredSize) {
+    bool firstCreation = app->index_buffer.buffer == VK_NULL_HANDLE;
+    uint64_t begin = strs_clock_now_ns();
+    if (!firstCreation) {
+      destroy_buffer(app, &app->index_buffer);
+    }
+    create_index_buffer(app);
+    if (firstCreation) {
+      app->startup_timings.stage_ns[STRS_STARTUP_STAGE_GEOMETRY_BUFFERS] += strs_clock_now_ns() - begin;
+    }
+  }
+
+  build_draw_commands(app, usable_count, limit, app->index_buffer.data);
+  order_clipped_batches(app);
+
+  app->index_buffer.contentsSize = requiredSize;
+  copy_buffer(app, app->index_buffer.stagingBuffer, app->index_buffer.buffer, requiredSize);
+
+  if (app->indirect_capacity < app->draw_command_count) {
+    destroy_indirect_buffer(app);
+    create_indirect_buffer(app);
+  }
+  memcpy(app->indirect_data, app->draw_commands, sizeof(VkDrawIndexedIndirectCommand) * app->draw_command_count);
+  // Cached layers draw these themselves
+  for (uint64_t i = 0; app->layer_count > 0 && i < app->draw_command_count; i++) {
+    if (drawn_from_layer(app, app->draw_commands[i].firstInstance)) {
+      ((VkDrawIndexedIndirectCommand*)app->indirect_data)[i].instanceCount = 0;
+    }
+  }
+
+  if (app->gpu_culling) {
+    build_cull_records(app, usable_count);
+    if (app->cull_buffer_capacity < app->cull_record_count) {
+      destroy_cull_buffers(app);
+      create_cull_buffers(app);
+      write_cull_descriptor_sets(app);
+    }
+    memcpy(app->cull_record_data, app->cull_records, sizeof(cull_record) * app->cull_record_count);
+  }
+  hash_layer_contents(app);
+
+  app->index_buffer.contentsChanged = false;
+  app->command_buffers_dirty = true;
+}
+
+void destroy_buffer(internal_strs_app *app, vulkan_buffer* buffer) {
+  device_wait_idle(app);
+
+  vkDestroyBuffer(app->logical_device, buffer->stagingBuffer, &app->host_allocator);
+  free_memory(app, buffer->stagingBufferMemory);
+
+  vkDestroyBuffer(app->logical_device, buffer->buffer, &app->host_allocator);
+  free_memory(app, buffer->bufferMemory);
+
+  buffer->data = NULL;
+  buffer->stagingBuffer = VK_NULL_HANDLE;
+  buffer->stagingBufferMemory = VK_NULL_HANDLE;
+  buffer->buffer = VK_NULL_HANDLE;
+  buffer->bufferMemory = VK_NULL_HANDLE;
+  buffer->bufferSize = 0;
+  buffer->contentsSize = 0;
+}
+
+// Geometry pushed outside of strs_app_add lands in an implicit item that is closed by the next widget
+STRS_INTERN draw_item *current_draw_item(internal_strs_app *app) {
+  if (!app->draw_item_open) {
+    app->draw_items = strs_grow_array(app->draw_items, &app->draw_item_capacity,
+                                 app->draw_item_count + 1, sizeof(draw_item));
+    app->draw_items[app->draw_item_count++] = (draw_item){
+      .first_index = (uint32_t) app->index_count,
+      .index_count = 0,
+      .bounds = {FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX},
+      .clip = {-FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX},
+      .transform = app->current_transform,
+      .clip_region = app->clip_stack_count > 0 ? app->clip_stack[app->clip_stack_count - 1] : 0,
+      .first_vertex = UINT32_MAX,
+      .vertex_end = 0};
+    app->draw_item_open = true;
+  }
+  mark_scene_dirty(app, SCENE_DRAW_ITEMS, sizeof(draw_item) * (app->draw_item_count - 1),
+                   sizeof(draw_item) * app->draw_item_count);
+  return &app->draw_items[app->draw_item_count - 1];
+}
+
+STRS_INTERN void close_draw_item(internal_strs_app *app) {
+  if (app->draw_item_open && app->draw_items[app->draw_item_count - 1].index_count == 0) {
+    app->draw_item_count--;
+  }
+  app->draw_item_open = false;
+}
+
+// Keeps the items in step with removed indices, the open item stays open while it still ends the index list
+STRS_INTERN void remove_item_indices(internal_strs_app *app, uint64_t first, uint64_t count) {
+  uint64_t last = first + count;
+  uint64_t kept = 0;
+  bool open = false;
+
+  for (uint64_t i = 0; i < app->draw_item_count; i++) {
+    draw_item item = app->draw_items[i];
+    uint64_t item_first = item.first_index;
+    uint64_t item_last = item_first + item.index_count;
+    uint64_t overlap_first = item_first > first ? item_first : first;
+    uint64_t overlap_last = item_last < last ? item_last : last;
+
+    if (overlap_last > overlap_first) {
+      item.index_count -= (uint32_t) (overlap_last - overlap_first);
+    }
+    if (item_first >= last) {
+      item.first_index -= (uint32_t) count;
+    } else if (item_first > first) {
+      item.first_index = (uint32_t) first;
+    }
+
+    bool is_open = app->draw_item_open && i == app->draw_item_count - 1;
+    if (item.index_count > 0 || is_open) {
+      app->draw_items[kept++] = item;
+      open = is_open;
+    }
+  }
+  app->draw_item_count = kept;
+  app->draw_item_open = open;
+  mark_scene_dirty(app, SCENE_DRAW_ITEMS, 0, sizeof(draw_item) * kept);
+}
+
+STRS_INTERN void reference_vertices(draw_item *item, const uint32_t *indices, uint64_t count) {
+  for (uint64_t i = 0; i < count; i++) {
+    item->first_vertex = indices[i] < item->first_vertex ? indices[i] : item->first_vertex;
+    item->vertex_end = indices[i] + 1 > item->vertex_end ? indices[i] + 1 : item->vertex_end;
+  }
+}
+
+void strs_push_indices(strs_app app, const uint16_t *indices, uint64_t count) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_PUSH_INDICES, NULL, 0, indices, sizeof(uint16_t) * count);
+  draw_item *item = current_draw_item(intern_app);
+  item->index_count += count;
+  intern_app->indices = strs_grow_array(intern_app->indices, &intern_app->index_capacity,
+                                   intern_app->index_count + count, sizeof(uint32_t));
+  for (uint64_t i = 0; i < count; i++) {
+    intern_app->indices[intern_app->index_count + i] = indices[i];
+  }
+  reference_vertices(item, intern_app->indices + intern_app->index_count, count);
+  mark_scene_dirty(intern_app, SCENE_INDICES, sizeof(uint32_t) * intern_app->index_count,
+                   sizeof(uint32_t) * (intern_app->index_count + count));
+  intern_app->index_count += count;
+}
+
+void strs_push_indices32(strs_app app, const uint32_t *indices, uint64_t count) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_PUSH_INDICES32, NULL, 0, indices, sizeof(uint32_t) * count);
+  draw_item *item = current_draw_item(intern_app);
+  item->index_count += count;
+  intern_app->indices = strs_grow_array(intern_app->indices, &intern_app->index_capacity,
+                                   intern_app->index_count + count, sizeof(uint32_t));
+  memcpy(intern_app->indices + intern_app->index_count, indices, sizeof(uint32_t) * count);
+  reference_vertices(item, indices, count);
+  mark_scene_dirty(intern_app, SCENE_INDICES, sizeof(uint32_t) * intern_app->index_count,
+                   sizeof(uint32_t) * (intern_app->index_count + count));
+  intern_app->index_count += count;
+}
+
+void strs_pop_back_indices(strs_app app, uint64_t count) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_POP_BACK_INDICES, (uint64_t[]){count}, 1, NULL, 0);
+  count = count < intern_app->index_count ? count : intern_app->index_count;
+  remove_item_indices(intern_app, intern_app->index_count - count, count);
+  strs_stream_pop_back(&intern_app->index_count, count);
+  mark_scene_dirty(intern_app, SCENE_INDICES, sizeof(uint32_t) * intern_app->index_count,
+                   sizeof(uint32_t) * intern_app->index_count);
+}
+
+void strs_pop_front_indices(strs_app app, uint64_t count) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_POP_FRONT_INDICES, (uint64_t[]){count}, 1, NULL, 0);
+  count = count < intern_app->index_count ? count : intern_app->index_count;
+  remove_item_indices(intern_app, 0, count);
+  strs_stream_erase(intern_app->indices, &intern_app->index_count, sizeof(uint32_t), 0, count);
+  mark_scene_dirty(intern_app, SCENE_INDICES, 0, sizeof(uint32_t) * intern_app->index_count);
+}
+
+void strs_erase_indices(strs_app app, uint64_t index) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_ERASE_INDICES, (uint64_t[]){index}, 1, NULL, 0);
+  if (index >= intern_app->index_count) {
+    return;
+  }
+  remove_item_indices(intern_app, index, 1);
+  strs_stream_erase(intern_app->indices, &intern_app->index_count, sizeof(uint32_t), index, 1);
+  mark_scene_dirty(intern_app, SCENE_INDICES, sizeof(uint32_t) * index, sizeof(uint32_t) * intern_app->index_count);
+}
+
+STRS_INTERN void vertex_position(internal_strs_app *app, uint64_t index, float *position) {
+  const uint8_t *vertex = app->vertices + app->vertex_stride * index;
+  if (app->vertex_format == STRS_VERTEX_FORMAT_DEFAULT) {
+    memcpy(position, ((const strs_vertex*)vertex)->pos, sizeof(float) * 2);
+  } else {
+    // Both compact layouts start with the fixed point position
+    const int16_t *pos = ((const strs_vertex_compact*)vertex)->pos;
+    position[0] = pos[0] / STRS_VERTEX_COMPACT_SCALE;
+    position[1] = pos[1] / STRS_VERTEX_COMPACT_SCALE;
+  }
+}
+
+// True when a vertex lies outside the bounds the item had
+STRS_INTERN bool widen_item_bounds(internal_strs_app *app, draw_item *item, uint64_t begin, uint64_t end) {
+  bool widened = false;
+  for (uint64_t i = begin; i < end; i++) {
+    float position[2];
+    vertex_position(app, i, position);
+    widened |= position[0] < item->bounds[0] || position[1] < item->bounds[1] ||
+               position[0] > item->bounds[2] || position[1] > item->bounds[3];
+    item->bounds[0] = position[0] < item->bounds[0] ? position[0] : item->bounds[0];
+    item->bounds[1] = position[1] < item->bounds[1] ? position[1] : item->bounds[1];
+    item->bounds[2] = position[0] > item->bounds[2] ? position[0] : item->bounds[2];
+    item->bounds[3] = position[1] > item->bounds[3] ? position[1] : item->bounds[3];
+  }
+  return widened;
+}
+
+STRS_INTERN uint32_t store_vertices(internal_strs_app *app, strs_vertex_format format, const void *vertices, uint64_t count) {
+  uint32_t first = (uint32_t) app->vertex_count;
+  capture_call(app, STRS_CALL_PUSH_VERTICES, (uint64_t[]){format}, 1, vertices,
+               strs_vertex_format_size(format) * count);
+  app->vertices = strs_grow_array(app->vertices, &app->vertex_capacity,
+                             app->vertex_count + count, app->vertex_stride);
+  strs_vertex_convert(format, vertices,
+                      app->vertex_format, app->vertices + app->vertex_stride * app->vertex_count,
+                      count);
+
+  widen_item_bounds(app, current_draw_item(app), app->vertex_count, app->vertex_count + count);
+
+  app->vertex_count += count;
+  mark_scene_dirty(app, SCENE_VERTICES, app->vertex_stride * first, app->vertex_stride * app->vertex_count);
+  return first;
+}
+
+STRS_INTERN void mark_buffer_dirty(vulkan_buffer *buffer, VkDeviceSize begin, VkDeviceSize end) {
+  if (!buffer->contentsChanged) {
+    buffer->dirtyBegin = begin;
+    buffer->dirtyEnd = end;
+  } else {
+    buffer->dirtyBegin = begin < buffer->dirtyBegin ? begin : buffer->dirtyBegin;
+    buffer->dirtyEnd = end > buffer->dirtyEnd ? end : buffer->dirtyEnd;
+  }
+  buffer->contentsChanged = true;
+}
+
+// The index buffer is rebuilt from the indices and the draw items together
+STRS_INTERN void mark_stream_buffer(internal_strs_app *app, scene_stream stream, uint64_t begin, uint64_t end) {
+  if (stream == SCENE_VERTICES) {
+    mark_buffer_dirty(&app->vertex_buffer, begin, end);
+  } else if (stream == SCENE_SHAPES) {
+    mark_buffer_dirty(&app->shape_buffer, begin, end);
+  } else {
+    app->index_buffer.contentsChanged = true;
+  }
+}
+
+// Without manual_publish the buffers are marked right away, otherwise the range waits for strs_app_publish
+STRS_INTERN void mark_scene_dirty(internal_strs_app *app, scene_stream stream, uint64_t begin, uint64_t end) {
+  if (!app->manual_publish) {
+    mark_stream_buffer(app, stream, begin, end);
+    return;
+  }
+  if (!app->scene_changed[stream]) {
+    app->scene_dirty_begin[stream] = begin;
+    app->scene_dirty_end[stream] = end;
+  } else {
+    app->scene_dirty_begin[stream] = begin < app->scene_dirty_begin[stream] ? begin : app->scene_dirty_begin[stream];
+    app->scene_dirty_end[stream] = end > app->scene_dirty_end[stream] ? end : app->scene_dirty_end[stream];
+  }
+  app->scene_changed[stream] = true;
+}
+
+STRS_INTERN void capture_call(internal_strs_app *app, strs_call call, const uint64_t *args, uint32_t arg_count,
+                              const void *data, uint64_t size) {
+  if (app->capture != NULL) {
+    strs_capture_call(app->capture, call, args, arg_count, data, size);
+  }
+}
+
+uint32_t strs_push_rects(strs_app app, const strs_rect *rects, const vec3 *colors, uint64_t count) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  uint32_t first_vertex = (uint32_t) intern_app->vertex_count;
+  uint64_t first_index = intern_app->index_count;
+  uint64_t vertex_count = count * STRS_RECT_VERTEX_COUNT;
+  if (count == 0) {
+    return first_vertex;
+  }
+  if (intern_app->capture != NULL) {
+    // The colors follow the rects in one record
+    uint64_t size = sizeof(strs_rect) * count + (colors != NULL ? sizeof(vec3) * count : 0);
+    uint8_t *data = malloc(size);
+    memcpy(data, rects, sizeof(strs_rect) * count);
+    if (colors != NULL) {
+      memcpy(data + sizeof(strs_rect) * count, colors, sizeof(vec3) * count);
+    }
+    capture_call(intern_app, STRS_CALL_PUSH_RECTS, (uint64_t[]){count, colors != NULL}, 2, data, size);
+    free(data);
+  }
+
+  intern_app->vertices = strs_grow_array(intern_app->vertices, &intern_app->vertex_capacity,
+                                    intern_app->vertex_count + vertex_count, intern_app->vertex_stride);
+  intern_app->indices = strs_grow_array(intern_app->indices, &intern_app->index_capacity,
+                                   intern_app->index_count + count * STRS_RECT_INDEX_COUNT, sizeof(uint32_t));
+
+  strs_rects_fill_vertices(intern_app->vertex_format, rects, colors, count,
+                           intern_app->vertices + intern_app->vertex_stride * intern_app->vertex_count);
+  strs_rects_fill_indices(first_vertex, count, intern_app->indices + intern_app->index_count);
+
+  close_draw_item(intern_app);
+  for (uint64_t i = 0; i < count; i += RECTS_PER_DRAW_ITEM) {
+    uint64_t chunk = count - i < RECTS_PER_DRAW_ITEM ? count - i : RECTS_PER_DRAW_ITEM;
+    draw_item *item = current_draw_item(intern_app);
+    item->index_count = (uint32_t) (chunk * STRS_RECT_INDEX_COUNT);
+    item->first_vertex = (uint32_t) (first_vertex + i * STRS_RECT_VERTEX_COUNT);
+    item->vertex_end = (uint32_t) (item->first_vertex + chunk * STRS_RECT_VERTEX_COUNT);
+    strs_rects_bounds(rects + i, chunk, item->bounds);
+    intern_app->index_count += chunk * STRS_RECT_INDEX_COUNT;
+    close_draw_item(intern_app);
+  }
+
+  intern_app->vertex_count += vertex_count;
+  mark_scene_dirty(intern_app, SCENE_VERTICES, intern_app->vertex_stride * first_vertex,
+                   intern_app->vertex_stride * intern_app->vertex_count);
+  mark_scene_dirty(intern_app, SCENE_INDICES, sizeof(uint32_t) * first_index,
+                   sizeof(uint32_t) * intern_app->index_count);
+  return first_vertex;
+}
+
+uint32_t strs_push_vertices(strs_app app, const strs_vertex *vertices, uint64_t count) {
+  return store_vertices((internal_strs_app*)app, STRS_VERTEX_FORMAT_DEFAULT, vertices, count);
+}
+
+uint32_t strs_push_vertices_compact(strs_app app, const strs_vertex_compact *vertices, uint64_t count) {
+  return store_vertices((internal_strs_app*)app, STRS_VERTEX_FORMAT_COMPACT, vertices, count);
+}
+
+uint32_t strs_push_vertices_compact_uv(strs_app app, const strs_vertex_compact_uv *vertices, uint64_t count) {
+  return store_vertices((internal_strs_app*)app, STRS_VERTEX_FORMAT_COMPACT_UV, vertices, count);
+}
+
+uint64_t strs_app_vertex_count(strs_app app) {
+  return ((internal_strs_app*)app)->vertex_count;
+}
+
+uint64_t strs_app_index_count(strs_app app) {
+  return ((internal_strs_app*)app)->index_count;
+}
+
+void strs_write_vertices(strs_app app, uint64_t first, const strs_vertex *vertices, uint64_t count) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_WRITE_VERTICES, (uint64_t[]){first}, 1, vertices, sizeof(strs_vertex) * count);
+  dbg_assert(first + count <= intern_app->vertex_count);
+  strs_vertex_convert(STRS_VERTEX_FORMAT_DEFAULT, vertices,
+                      intern_app->vertex_format, intern_app->vertices + intern_app->vertex_stride * first,
+                      count);
+  mark_scene_dirty(intern_app, SCENE_VERTICES, intern_app->vertex_stride * first,
+                   intern_app->vertex_stride * (first + count));
+
+  // Moved or grown geometry would be culled by the bounds it had when it was pushed. Items without bounds
+  // of their own are never culled.
+  for (uint64_t i = 0; i < intern_app->draw_item_count; i++) {
+    draw_item *item = &intern_app->draw_items[i];
+    uint64_t begin = first > item->first_vertex ? first : item->first_vertex;
+    uint64_t end = first + count < item->vertex_end ? first + count : item->vertex_end;
+    if (begin < end && item->bounds[0] <= item->bounds[2] && widen_item_bounds(intern_app, item, begin, end)) {
+      mark_scene_dirty(intern_app, SCENE_DRAW_ITEMS, sizeof(draw_item) * i, sizeof(draw_item) * (i + 1));
+    }
+  }
+}
+
+void strs_write_indices32(strs_app app, uint64_t first, const uint32_t *indices, uint64_t count) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_WRITE_INDICES32, (uint64_t[]){first}, 1, indices, sizeof(uint32_t) * count);
+  dbg_assert(first + count <= intern_app->index_count);
+  memcpy(intern_app->indices + first, indices, sizeof(uint32_t) * count);
+  mark_scene_dirty(intern_app, SCENE_INDICES, sizeof(uint32_t) * first, sizeof(uint32_t) * (first + count));
+
+  for (uint64_t i = 0; i < intern_app->draw_item_count; i++) {
+    draw_item *item = &intern_app->draw_items[i];
+    uint64_t begin = first > item->first_index ? first : item->first_index;
+    uint64_t end = (uint64_t) item->first_index + item->index_count;
+    end = first + count < end ? first + count : end;
+    if (begin >= end) {
+      continue;
+    }
+    reference_vertices(item, intern_app->indices + begin, end - begin);
+    for (uint64_t j = begin; j < end && item->bounds[0] <= item->bounds[2]; j++) {
+      uint64_t vertex = intern_app->indices[j];
+      if (vertex < intern_app->vertex_count) {
+        widen_item_bounds(intern_app, item, vertex, vertex + 1);
+      }
+    }
+    mark_scene_dirty(intern_app, SCENE_DRAW_ITEMS, sizeof(draw_item) * i, sizeof(draw_item) * (i + 1));
+  }
+}
+
+// Removing vertices does not touch the indices, callers rewrite the ones that moved
+void strs_pop_back_vertices(strs_app app, uint64_t count) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_POP_BACK_VERTICES, (uint64_t[]){count}, 1, NULL, 0);
+  strs_stream_pop_back(&intern_app->vertex_count, count);
+  mark_scene_dirty(intern_app, SCENE_VERTICES, intern_app->vertex_stride * intern_app->vertex_count,
+                   intern_app->vertex_stride * intern_app->vertex_count);
+}
+
+void strs_pop_front_vertices(strs_app app, uint64_t count) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_POP_FRONT_VERTICES, (uint64_t[]){count}, 1, NULL, 0);
+  uint64_t previous_count = intern_app->vertex_count;
+  strs_stream_erase(intern_app->vertices, &intern_app->vertex_count, intern_app->vertex_stride, 0, count);
+  mark_scene_dirty(intern_app, SCENE_VERTICES, 0, intern_app->vertex_stride * previous_count);
+}
+
+void strs_erase_vertices(strs_app app, uint64_t index) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_ERASE_VERTICES, (uint64_t[]){index}, 1, NULL, 0);
+  uint64_t previous_count = intern_app->vertex_count;
+  if (strs_stream_erase(intern_app->vertices, &intern_app->vertex_count, intern_app->vertex_stride, index, 1) > 0) {
+    mark_scene_dirty(intern_app, SCENE_VERTICES, intern_app->vertex_stride * index,
+                     intern_app->vertex_stride * previous_count);
+  }
+}
+
+void update_vertex_buffer(internal_strs_app *app) {
+  VkDeviceSize requiredSize = app->vertex_stride * app->scene.vertex_count;
+  if (!app->vertex_buffer.contentsChanged || requiredSize == 0) {
+    return;
+  }
+
+  if (app->vertex_buffer.bufferSize < requiredSize) {
+    bool firstCreation = app->vertex_buffer.buffer == VK_NULL_HANDLE;
+    uint64_t begin = strs_clock_now_ns();
+    if (!firstCreation) {
+      destroy_buffer(app, &app->vertex_buffer);
+    }
+    create_vertex_buffer(app);
+    if (firstCreation) {
+      app->startup_timings.stage_ns[STRS_STARTUP_STAGE_GEOMETRY_BUFFERS] += strs_clock_now_ns() - begin;
+    }
+    mark_layers_vertices(app, 0, UINT64_MAX);
+  } else {
+    mark_layers_vertices(app, app->vertex_buffer.dirtyBegin / app->vertex_stride,
+                         (app->vertex_buffer.dirtyEnd + app->vertex_stride - 1) / app->vertex_stride);
+    upload_dirty_range(app, &app->vertex_buffer, app->scene.vertices, requiredSize);
+  }
+
+  app->vertex_buffer.contentsChanged = false;
+  app->command_buffers_dirty = true;
+}
+
+// The staging buffer mirrors src, only the range that changed is copied
+STRS_INTERN void upload_dirty_range(internal_strs_app *app, vulkan_buffer *buffer, const uint8_t *src, VkDeviceSize size) {
+  VkDeviceSize begin = buffer->dirtyBegin;
+  VkDeviceSize end = buffer->dirtyEnd < size ? buffer->dirtyEnd : size;
+  buffer->contentsSize = size;
+  if (end <= begin) {
+    return;
+  }
+  if (buffer->stagingBuffer != VK_NULL_HANDLE) {
+    memcpy((uint8_t*)buffer->data + begin, src + begin, end - begin);
+    copy_buffer_region(app, buffer->stagingBuffer, buffer->buffer, begin, begin, end - begin);
+    return;
+  }
+
+  // Evicted under memory pressure, the range goes through a staging buffer of its own size
+  VkBuffer stagingBuffer;
+  VkDeviceMemory stagingBufferMemory;
+  void *data;
+  create_buffer(app, STRS_MEMORY_STAGING, end - begin, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &stagingBuffer, &stagingBufferMemory);
+  vkMapMemory(app->logical_device, stagingBufferMemory, 0, end - begin, 0, &data);
+  memcpy(data, src + begin, end - begin);
+  copy_buffer_region(app, stagingBuffer, buffer->buffer, 0, begin, end - begin);
+  vkDestroyBuffer(app->logical_device, stagingBuffer, &app->host_allocator);
+  free_memory(app, stagingBufferMemory);
+}
+
+void update_shape_buffer(internal_strs_app *app) {
+  VkDeviceSize requiredSize = sizeof(strs_shape) * app->scene.shape_count;
+  if (!app->shape_buffer.contentsChanged) {
+    return;
+  }
+
+  if (app->shape_buffer.bufferSize < requiredSize) {
+    if (app->shape_buffer.buffer != VK_NULL_HANDLE) {
+      destroy_buffer(app, &app->shape_buffer);
+    }
+    create_staged_buffer(app, &app->shape_buffer, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                         app->scene.shapes, requiredSize, sizeof(strs_shape) * app->scene.shape_capacity);
+  } else {
+    upload_dirty_range(app, &app->shape_buffer, (const uint8_t*)app->scene.shapes, requiredSize);
+  }
+
+  app->shape_buffer.contentsChanged = false;
+  app->command_buffers_dirty = true;
+}
+
+uint32_t strs_push_shapes(strs_app app, const strs_shape *shapes, uint64_t count) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_PUSH_SHAPES, NULL, 0, shapes, sizeof(strs_shape) * count);
+  uint32_t first = (uint32_t) intern_app->shape_count;
+  intern_app->shapes = strs_grow_array(intern_app->shapes, &intern_app->shape_capacity,
+                                  intern_app->shape_count + count, sizeof(strs_shape));
+  memcpy(intern_app->shapes + intern_app->shape_count, shapes, sizeof(strs_shape) * count);
+  intern_app->shape_count += count;
+  mark_scene_dirty(intern_app, SCENE_SHAPES, sizeof(strs_shape) * first,
+                   sizeof(strs_shape) * intern_app->shape_count);
+  return first;
+}
+
+void strs_write_shapes(strs_app app, uint64_t first, const strs_shape *shapes, uint64_t count) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_WRITE_SHAPES, (uint64_t[]){first}, 1, shapes, sizeof(strs_shape) * count);
+  dbg_assert(first + count <= intern_app->shape_count);
+  memcpy(intern_app->shapes + first, shapes, sizeof(strs_shape) * count);
+  mark_scene_dirty(intern_app, SCENE_SHAPES, sizeof(strs_shape) * first,
+                   sizeof(strs_shape) * (first + count));
+}
+
+void strs_pop_back_shapes(strs_app app, uint64_t count) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_POP_BACK_SHAPES, (uint64_t[]){count}, 1, NULL, 0);
+  strs_stream_pop_back(&intern_app->shape_count, count);
+  mark_scene_dirty(intern_app, SCENE_SHAPES, sizeof(strs_shape) * intern_app->shape_count,
+                   sizeof(strs_shape) * intern_app->shape_count);
+}
+
+uint64_t strs_app_shape_count(strs_app app) {
+  return ((internal_strs_app*)app)->shape_count;
+}
+
+STRS_INTERN void view_building_scene(internal_strs_app *app) {
+  app->scene = (scene_view){
+    .vertices = app->vertices,
+    .vertex_count = app->vertex_count,
+    .vertex_capacity = app->vertex_capacity,
+    .indices = app->indices,
+    .index_count = app->index_count,
+    .index_capacity = app->index_capacity,
+    .draw_items = app->draw_items,
+    .draw_item_count = app->draw_item_count,
+    .shapes = app->shapes,
+    .shape_count = app->shape_count,
+    .shape_capacity = app->shape_capacity,
+    .clip_regions = app->clip_regions,
+    .clip_region_count = app->clip_region_count};
+}
+
+STRS_INTERN void release_stream(snapshot_stream *stream) {
+  for (uint64_t i = 0; i < stream->chunk_count; i++) {
+    if (__atomic_sub_fetch(&stream->chunks[i]->references, 1, __ATOMIC_ACQ_REL) == 0) {
+      free(stream->chunks[i]);
+    }
+  }
+  free(stream->chunks);
+  *stream = (snapshot_stream){0};
+}
+
+STRS_INTERN void release_snapshot(scene_snapshot *snapshot) {
+  if (snapshot == NULL) {
+    return;
+  }
+  for (uint32_t i = 0; i < SCENE_STREAM_COUNT; i++) {
+    release_stream(&snapshot->streams[i]);
+  }
+  free(snapshot);
+}
+
+STRS_INTERN void copy_stream_refs(const snapshot_stream *src, snapshot_stream *dst) {
+  dst->chunk_count = src->chunk_count;
+  dst->size = src->size;
+  dst->chunks = malloc(sizeof(snapshot_chunk*) * (src->chunk_count + 1));
+  for (uint64_t i = 0; i < src->chunk_count; i++) {
+    dst->chunks[i] = src->chunks[i];
+    __atomic_add_fetch(&dst->chunks[i]->references, 1, __ATOMIC_RELAXED);
+  }
+}
+
+// Chunks outside the range changed since the last publish are shared with it, the rest are copied
+STRS_INTERN void publish_stream(internal_strs_app *app, scene_stream stream, const void *src, uint64_t size,
+                                snapshot_stream *dst) {
+  snapshot_stream *published = &app->published_streams[stream];
+  uint64_t dirty_first = 0;
+  uint64_t dirty_end = 0;
+  if (app->scene_changed[stream]) {
+    dirty_first = app->scene_dirty_begin[stream] / SNAPSHOT_CHUNK_SIZE;
+    dirty_end = (app->scene_dirty_end[stream] + SNAPSHOT_CHUNK_SIZE - 1) / SNAPSHOT_CHUNK_SIZE;
+  }
+
+  dst->chunk_count = (size + SNAPSHOT_CHUNK_SIZE - 1) / SNAPSHOT_CHUNK_SIZE;
+  dst->size = size;
+  dst->chunks = malloc(sizeof(snapshot_chunk*) * (dst->chunk_count + 1));
+  for (uint64_t i = 0; i < dst->chunk_count; i++) {
+    uint64_t offset = i * SNAPSHOT_CHUNK_SIZE;
+    uint64_t length = size - offset < SNAPSHOT_CHUNK_SIZE ? size - offset : SNAPSHOT_CHUNK_SIZE;
+    if (i < published->chunk_count && (i < dirty_first || i >= dirty_end)) {
+      dst->chunks[i] = published->chunks[i];
+      __atomic_add_fetch(&dst->chunks[i]->references, 1, __ATOMIC_RELAXED);
+      __atomic_add_fetch(&app->snapshot_stats.shared_bytes, length, __ATOMIC_RELAXED);
+    } else {
+      dst->chunks[i] = malloc(sizeof(snapshot_chunk));
+      dst->chunks[i]->references = 1;
+      memcpy(dst->chunks[i]->data, (const uint8_t*)src + offset, length);
+      __atomic_add_fetch(&app->snapshot_stats.copied_bytes, length, __ATOMIC_RELAXED);
+    }
+  }
+
+  release_stream(published);
+  copy_stream_refs(dst, published);
+  app->scene_changed[stream] = false;
+}
+
+typedef struct {
+  internal_strs_app *app;
+  scene_stream stream;
+  const void *src;
+  uint64_t size;
+  snapshot_stream *dst;
+} stream_publish;
+
+STRS_INTERN void publish_stream_job(void *data) {
+  stream_publish *publish = (stream_publish*)data;
+  publish_stream(publish->app, publish->stream, publish->src, publish->size, publish->dst);
+}
+
+STRS_LIB void strs_app_publish(strs_app app) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  if (!intern_app->manual_publish) {
+    return;
+  }
+  strs_arena_reset(&intern_app->publish_arena);
+  dispatch_input(intern_app);
+  complete_tasks(intern_app);
+  run_widget_passes(intern_app);
+  capture_call(intern_app, STRS_CALL_FRAME, NULL, 0, NULL, 0);
+
+  // The streams are copied in parallel, the vertices on the calling thread
+  scene_snapshot *snapshot = calloc(1, sizeof(scene_snapshot));
+  stream_publish publishes[SCENE_STREAM_COUNT] = {
+    {intern_app, SCENE_VERTICES, intern_app->vertices, intern_app->vertex_stride * intern_app->vertex_count},
+    {intern_app, SCENE_INDICES, intern_app->indices, sizeof(uint32_t) * intern_app->index_count},
+    {intern_app, SCENE_DRAW_ITEMS, intern_app->draw_items, sizeof(draw_item) * intern_app->draw_item_count},
+    {intern_app, SCENE_SHAPES, intern_app->shapes, sizeof(strs_shape) * intern_app->shape_count},
+    {intern_app, SCENE_CLIPS, intern_app->clip_regions, sizeof(clip_region) * intern_app->clip_region_count}};
+  strs_job stream_jobs[SCENE_STREAM_COUNT];
+  for (uint32_t i = 0; i < SCENE_STREAM_COUNT; i++) {
+    publishes[i].dst = &snapshot->streams[i];
+    if (i != SCENE_VERTICES) {
+      stream_jobs[i] = strs_jobs_spawn(intern_app->context->jobs, publish_stream_job, &publishes[i], NULL, 0);
+    }
+  }
+  publish_stream_job(&publishes[SCENE_VERTICES]);
+  for (uint32_t i = 0; i < SCENE_STREAM_COUNT; i++) {
+    if (i != SCENE_VERTICES) {
+      strs_jobs_wait(intern_app->context->jobs, stream_jobs[i]);
+    }
+  }
+  snapshot->published_ns = strs_clock_now_ns();
+
+  __atomic_add_fetch(&intern_app->snapshot_stats.published, 1, __ATOMIC_RELAXED);
+  scene_snapshot *replaced = __atomic_exchange_n(&intern_app->pending_snapshot, snapshot, __ATOMIC_ACQ_REL);
+  if (replaced != NULL) {
+    __atomic_add_fetch(&intern_app->snapshot_stats.dropped, 1, __ATOMIC_RELAXED);
+    release_snapshot(replaced);
+  }
+}
+
+// Only the chunks that are not shared with the snapshot drawn so far are copied. It is released after
+// the comparison, so a chunk address can not have been reused by a different chunk in between.
+STRS_INTERN void take_snapshot(internal_strs_app *app) {
+  scene_snapshot *snapshot = __atomic_exchange_n(&app->pending_snapshot, NULL, __ATOMIC_ACQ_REL);
+  if (snapshot == NULL) {
+    return;
+  }
+
+  for (uint32_t s = 0; s < SCENE_STREAM_COUNT; s++) {
+    const snapshot_stream *stream = &snapshot->streams[s];
+    const snapshot_stream *drawn = app->drawn_snapshot != NULL ? &app->drawn_snapshot->streams[s] : NULL;
+    uint64_t begin = UINT64_MAX;
+    uint64_t end = 0;
+
+    app->scene_copies[s] = strs_grow_array(app->scene_copies[s], &app->scene_copy_capacities[s], stream->size, 1);
+    for (uint64_t i = 0; i < stream->chunk_count; i++) {
+      if (drawn != NULL && i < drawn->chunk_count && drawn->chunks[i] == stream->chunks[i]) {
+        continue;
+      }
+      uint64_t offset = i * SNAPSHOT_CHUNK_SIZE;
+      uint64_t length = stream->size - offset < SNAPSHOT_CHUNK_SIZE ? stream->size - offset : SNAPSHOT_CHUNK_SIZE;
+      memcpy(app->scene_copies[s] + offset, stream->chunks[i]->data, length);
+      begin = offset < begin ? offset : begin;
+      end = offset + length;
+    }
+
+    if (end > begin) {
+      mark_stream_buffer(app, (scene_stream) s, begin, end);
+    } else if (drawn == NULL || drawn->size != stream->size) {
+      mark_stream_buffer(app, (scene_stream) s, stream->size, stream->size);
+    }
+  }
+
+  app->scene = (scene_view){
+    .vertices = app->scene_copies[SCENE_VERTICES],
+    .vertex_count = snapshot->streams[SCENE_VERTICES].size / app->vertex_stride,
+    .vertex_capacity = app->scene_copy_capacities[SCENE_VERTICES] / app->vertex_stride,
+    .indices = (const uint32_t*)app->scene_copies[SCENE_INDICES],
+    .index_count = snapshot->streams[SCENE_INDICES].size / sizeof(uint32_t),
+    .index_capacity = app->scene_copy_capacities[SCENE_INDICES] / sizeof(uint32_t),
+    .draw_items = (const draw_item*)app->scene_copies[SCENE_DRAW_ITEMS],
+    .draw_item_count = snapshot->streams[SCENE_DRAW_ITEMS].size / sizeof(draw_item),
+    .shapes = (const strs_shape*)app->scene_copies[SCENE_SHAPES],
+    .shape_count = snapshot->streams[SCENE_SHAPES].size / sizeof(strs_shape),
+    .shape_capacity = app->scene_copy_capacities[SCENE_SHAPES] / sizeof(strs_shape),
+    .clip_regions = (const clip_region*)app->scene_copies[SCENE_CLIPS],
+    .clip_region_count = snapshot->streams[SCENE_CLIPS].size / sizeof(clip_region)};
+
+  uint64_t latency = strs_clock_now_ns() - snapshot->published_ns;
+  __atomic_add_fetch(&app->snapshot_stats.taken, 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&app->snapshot_stats.last_latency_ns, latency, __ATOMIC_RELAXED);
+  if (latency > __atomic_load_n(&app->snapshot_stats.max_latency_ns, __ATOMIC_RELAXED)) {
+    __atomic_store_n(&app->snapshot_stats.max_latency_ns, latency, __ATOMIC_RELAXED);
+  }
+
+  release_snapshot(app->drawn_snapshot);
+  app->drawn_snapshot = snapshot;
+}
+
+STRS_LIB void strs_app_get_snapshot_stats(strs_app app, strs_snapshot_stats *stats) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  *stats = (strs_snapshot_stats){
+    .published = __atomic_load_n(&intern_app->snapshot_stats.published, __ATOMIC_RELAXED),
+    .dropped = __atomic_load_n(&intern_app->snapshot_stats.dropped, __ATOMIC_RELAXED),
+    .taken = __atomic_load_n(&intern_app->snapshot_stats.taken, __ATOMIC_RELAXED),
+    .last_latency_ns = __atomic_load_n(&intern_app->snapshot_stats.last_latency_ns, __ATOMIC_RELAXED),
+    .max_latency_ns = __atomic_load_n(&intern_app->snapshot_stats.max_latency_ns, __ATOMIC_RELAXED),
+    .copied_bytes = __atomic_load_n(&intern_app->snapshot_stats.copied_bytes, __ATOMIC_RELAXED),
+    .shared_bytes = __atomic_load_n(&intern_app->snapshot_stats.shared_bytes, __ATOMIC_RELAXED)};
+}
+
+STRS_LIB strs_jobs strs_app_jobs(strs_app app) {
+  return ((internal_strs_app*)app)->context->jobs;
+}
+
+STRS_INTERN void run_app_task(void *data) {
+  app_task *task = (app_task*)data;
+  internal_strs_app *app = (internal_strs_app*)task->app;
+  task->result = task->task(task->data);
+
+  pthread_mutex_lock(&app->task_lock);
+  if (app->finished_tasks == NULL) {
+    app->finished_tasks = task;
+  } else {
+    app->finished_tasks_last->next = task;
+  }
+  app->finished_tasks_last = task;
+  pthread_mutex_unlock(&app->task_lock);
+  // Last, strs_app_free may free the app as soon as no task is running
+  __atomic_sub_fetch(&app->running_tasks, 1, __ATOMIC_RELEASE);
+}
+
+STRS_LIB strs_job strs_app_spawn(strs_app app, PFN_strs_app_task task, void *data,
+                                 const strs_job *dependencies, uint32_t dependency_count,
+                                 PFN_strs_app_complete complete, void *user_data) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  app_task *entry = malloc(sizeof(app_task));
+  *entry = (app_task){
+    .app = intern_app,
+    .task = task,
+    .data = data,
+    .complete = complete,
+    .user_data = user_data};
+  __atomic_add_fetch(&intern_app->running_tasks, 1, __ATOMIC_RELAXED);
+  return strs_jobs_spawn(intern_app->context->jobs, run_app_task, entry, dependencies, dependency_count);
+}
+
+// In the order the tasks finished
+STRS_INTERN void complete_tasks(internal_strs_app *app) {
+  pthread_mutex_lock(&app->task_lock);
+  app_task *task = app->finished_tasks;
+  app->finished_tasks = NULL;
+  app->finished_tasks_last = NULL;
+  pthread_mutex_unlock(&app->task_lock);
+
+  while (task != NULL) {
+    app_task *next = task->next;
+    if (task->complete != NULL) {
+      task->complete((strs_app)app, task->result, task->user_data);
+    }
+    free(task);
+    task = next;
+  }
+}
+
+STRS_INTERN double app_seconds(internal_strs_app *app) {
+  return (double) (strs_clock_now_ns() - app->startup_begin) / 1e9;
+}
+
+// New heads start out empty
+STRS_INTERN void grow_animation_heads(internal_strs_app *app, uint64_t required) {
+  uint64_t old_capacity = app->animation_head_capacity;
+  app->animation_heads = strs_grow_array(app->animation_heads, &app->animation_head_capacity,
+                                    required, sizeof(uint32_t));
+  memset(app->animation_heads + old_capacity, 0xFF,
+         sizeof(uint32_t) * (app->animation_head_capacity - old_capacity));
+}
+
+// The descriptors need real buffers before the first animation starts
+STRS_INTERN void create_animation_buffers(internal_strs_app *app) {
+  grow_animation_heads(app, 1);
+  app->animation_tracks = strs_grow_array(app->animation_tracks, &app->animation_track_capacity,
+                                     1, sizeof(animation_track));
+
+  create_staged_buffer(app, &app->animation_head_buffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                       app->animation_heads, sizeof(uint32_t) * app->animation_head_capacity,
+                       sizeof(uint32_t) * app->animation_head_capacity);
+  create_staged_buffer(app, &app->animation_track_buffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                       app->animation_tracks, sizeof(animation_track) * app->animation_track_count,
+                       sizeof(animation_track) * app->animation_track_capacity);
+}
+
+STRS_INTERN void write_animation_descriptor_sets(internal_strs_app *app) {
+  for (size_t i = 0; i < app->number_of_images; i++) {
+    VkDescriptorBufferInfo bufferInfos[2] = {
+      {.buffer = app->animation_head_buffer.buffer,
+        .offset = 0,
+        .range = app->animation_head_buffer.bufferSize},
+      {.buffer = app->animation_track_buffer.buffer,
+        .offset = 0,
+        .range = app->animation_track_buffer.bufferSize}};
+
+    VkWriteDescriptorSet descriptorWrites[2];
+    for (uint32_t k = 0; k < 2; k++) {
+      descriptorWrites[k] = (VkWriteDescriptorSet){
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = app->descriptor_sets[i],
+        .dstBinding = k + 1,
+        .dstArrayElement = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .pBufferInfo = &bufferInfos[k]};
+    }
+
+    vkUpdateDescriptorSets(app->logical_device, 2, descriptorWrites, 0, NULL);
+  }
+}
+
+// Returns true when the buffer was recreated and the descriptors have to be written again
+STRS_INTERN bool update_storage_buffer(internal_strs_app *app, vulkan_buffer *buffer,
+                                         const void *src, VkDeviceSize size) {
+  bool recreate = buffer->bufferSize < size;
+  if (!buffer->contentsChanged) {
+    return false;
+  }
+
+  if (recreate) {
+    destroy_buffer(app, buffer);
+    create_staged_buffer(app, buffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, src, size, size);
+  } else {
+    upload_dirty_range(app, buffer, (const uint8_t*)src, size);
+  }
+  buffer->contentsChanged = false;
+  return recreate;
+}
+
+void update_animation_buffers(internal_strs_app *app) {
+  bool heads = update_storage_buffer(app, &app->animation_head_buffer, app->animation_heads,
+                                       sizeof(uint32_t) * app->animation_head_capacity);
+  bool tracks = update_storage_buffer(app, &app->animation_track_buffer, app->animation_tracks,
+                                        sizeof(animation_track) * app->animation_track_capacity);
+  if (heads || tracks) {
+    write_animation_descriptor_sets(app);
+    app->command_buffers_dirty = true;
+  }
+}
+
+strs_animation strs_animation_start(strs_app app, const strs_animation_info *info) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  animation_track *track;
+  uint32_t index;
+
+  if (info->keyframe_count == 0 || info->keyframe_count > STRS_ANIMATION_MAX_KEYFRAMES) {
+    return STRS_ANIMATION_NONE;
+  }
+
+  if (intern_app->animation_free != STRS_ANIMATION_NONE) {
+    index = intern_app->animation_free;
+    intern_app->animation_free = intern_app->animation_tracks[index].next;
+  } else {
+    intern_app->animation_tracks = strs_grow_array(intern_app->animation_tracks, &intern_app->animation_track_capacity,
+                                              intern_app->animation_track_count + 1, sizeof(animation_track));
+    index = (uint32_t) intern_app->animation_track_count++;
+  }
+  grow_animation_heads(intern_app, (uint64_t) info->shape + 1);
+
+  track = &intern_app->animation_tracks[index];
+  memset(track, 0, sizeof(animation_track));
+  track->next = intern_app->animation_heads[info->shape];
+  track->property = info->property;
+  track->keyframe_count = info->keyframe_count;
+  track->flags = info->loop ? ANIMATION_LOOP : 0;
+  track->start_time = (float) app_seconds(intern_app) + info->delay;
+  track->shape = info->shape;
+  for (uint32_t i = 0; i < info->keyframe_count; i++) {
+    memcpy(track->keyframes[i].value, info->keyframes[i].value, sizeof(track->keyframes[i].value));
+    track->keyframes[i].time = info->keyframes[i].time;
+    track->keyframes[i].easing = info->keyframes[i].easing;
+  }
+  intern_app->animation_heads[info->shape] = index;
+
+  mark_buffer_dirty(&intern_app->animation_track_buffer, sizeof(animation_track) * index,
+                    sizeof(animation_track) * (index + 1));
+  mark_buffer_dirty(&intern_app->animation_head_buffer, sizeof(uint32_t) * info->shape,
+                    sizeof(uint32_t) * (info->shape + 1));
+  return index;
+}
+
+void strs_animation_stop(strs_app app, strs_animation animation) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  animation_track *track;
+  uint32_t previous = STRS_ANIMATION_NONE;
+  uint32_t current;
+
+  if (animation >= intern_app->animation_track_count ||
+      intern_app->animation_tracks[animation].keyframe_count == 0) {
+    return;
+  }
+  track = &intern_app->animation_tracks[animation];
+
+  current = intern_app->animation_heads[track->shape];
+  while (current != animation) {
+    previous = current;
+    current = intern_app->animation_tracks[current].next;
+  }
+
+  // Unlink, only the link that pointed at the track has to reach the GPU
+  if (previous == STRS_ANIMATION_NONE) {
+    intern_app->animation_heads[track->shape] = track->next;
+    mark_buffer_dirty(&intern_app->animation_head_buffer, sizeof(uint32_t) * track->shape,
+                      sizeof(uint32_t) * (track->shape + 1));
+  } else {
+    intern_app->animation_tracks[previous].next = track->next;
+    mark_buffer_dirty(&intern_app->animation_track_buffer, sizeof(animation_track) * previous,
+                      sizeof(animation_track) * (previous + 1));
+  }
+
+  track->keyframe_count = 0;
+  track->next = intern_app->animation_free;
+  intern_app->animation_free = animation;
+}
+
+double strs_app_time(strs_app app) {
+  return app_seconds((internal_strs_app*)app);
+}
+
+// The root is the identity and is never destroyed
+STRS_INTERN void create_root_transform(internal_strs_app *app) {
+  app->transform_nodes = strs_grow_array(app->transform_nodes, &app->transform_capacity, 1, sizeof(transform_node));
+  app->transform_worlds = strs_grow_array(app->transform_worlds, &app->transform_world_capacity,
+                                     1, sizeof(transform_world));
+  app->transform_nodes[STRS_TRANSFORM_ROOT] = (transform_node){
+    .links = {STRS_TRANSFORM_NONE, STRS_TRANSFORM_NONE, STRS_TRANSFORM_NONE},
+    .local = {1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f},
+    .used = true,
+    .opacity = 1.0f};
+  app->transform_worlds[STRS_TRANSFORM_ROOT] = (transform_world){.linear = {1.0f, 0.0f, 0.0f, 1.0f}};
+  app->transform_count = 1;
+  app->transform_free = STRS_TRANSFORM_NONE;
+  app->current_transform = STRS_TRANSFORM_ROOT;
+}
+
+STRS_INTERN void create_transform_buffer(internal_strs_app *app) {
+  create_staged_buffer(app, &app->transform_buffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                       app->transform_worlds, sizeof(transform_world) * app->transform_count,
+                       sizeof(transform_world) * app->transform_world_capacity);
+}
+
+STRS_INTERN void write_transform_descriptor_sets(internal_strs_app *app) {
+  for (size_t i = 0; i < app->number_of_images; i++) {
+    VkDescriptorBufferInfo bufferInfo = {
+      .buffer = app->transform_buffer.buffer,
+      .offset = 0,
+      .range = app->transform_buffer.bufferSize};
+
+    VkWriteDescriptorSet descriptorWrite = {
+      .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+      .dstSet = app->descriptor_sets[i],
+      .dstBinding = 3,
+      .dstArrayElement = 0,
+      .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = 1,
+      .pBufferInfo = &bufferInfo};
+
+    vkUpdateDescriptorSets(app->logical_device, 1, &descriptorWrite, 0, NULL);
+  }
+}
+
+// Changes to the hierarchy only matter to the layers when there can be any
+STRS_INTERN void mark_layers_changed(internal_strs_app *app) {
+  if (app->layer_nodes > 0 || app->layer_promote_frames > 0) {
+    app->layers_changed = true;
+  }
+}
+
+STRS_INTERN void mark_transform_dirty(internal_strs_app *app, uint32_t transform) {
+  if (app->transform_nodes[transform].dirty) {
+    return;
+  }
+  app->transform_nodes[transform].dirty = true;
+  app->transform_dirty = strs_grow_array(app->transform_dirty, &app->transform_dirty_capacity,
+                                    app->transform_dirty_count + 1, sizeof(uint32_t));
+  app->transform_dirty[app->transform_dirty_count++] = transform;
+}
+
+// world = parent world * local
+STRS_INTERN void compose_transform(internal_strs_app *app, uint32_t transform) {
+  const transform_node *node = &app->transform_nodes[transform];
+  const float *l = node->local;
+
+  float follow = node->follow_pointer ? 1.0f : 0.0f;
+
+  if (node->links.parent == STRS_TRANSFORM_NONE) {
+    app->transform_worlds[transform] = (transform_world){
+      .linear = {l[0], l[1], l[2], l[3]},
+      .translation = {l[4], l[5], follow, 0.0f}};
+    return;
+  }
+
+  const float *p = app->transform_worlds[node->links.parent].linear;
+  const float *t = app->transform_worlds[node->links.parent].translation;
+  app->transform_worlds[transform] = (transform_world){
+    .linear = {p[0] * l[0] + p[2] * l[1], p[1] * l[0] + p[3] * l[1],
+               p[0] * l[2] + p[2] * l[3], p[1] * l[2] + p[3] * l[3]},
+    .translation = {p[0] * l[4] + p[2] * l[5] + t[0], p[1] * l[4] + p[3] * l[5] + t[1],
+                    t[2] > follow ? t[2] : follow, 0.0f}};
+}
+
+// Only the subtrees below changed nodes are recomputed, each of them once even when
+// several of its nodes changed, and only the range they cover is uploaded
+STRS_INTERN void flatten_transforms(internal_strs_app *app) {
+  transform_node *nodes = app->transform_nodes;
+  uint64_t low = UINT64_MAX;
+  uint64_t high = 0;
+
+  for (uint64_t i = 0; i < app->transform_dirty_count; i++) {
+    uint32_t root = app->transform_dirty[i];
+    bool ancestor_dirty = false;
+    if (!nodes[root].dirty) {
+      continue;
+    }
+    for (uint32_t parent = nodes[root].links.parent; parent != STRS_TRANSFORM_NONE;
+         parent = nodes[parent].links.parent) {
+      if (nodes[parent].dirty) {
+        ancestor_dirty = true;
+        break;
+      }
+    }
+    if (ancestor_dirty) {
+      continue;
+    }
+
+    uint32_t node = root;
+    while (true) {
+      compose_transform(app, node);
+      nodes[node].dirty = false;
+      low = node < low ? node : low;
+      high = node + 1 > high ? node + 1 : high;
+
+      if (nodes[node].links.first_child != STRS_TRANSFORM_NONE) {
+        node = nodes[node].links.first_child;
+        continue;
+      }
+      while (node != root && nodes[node].links.next_sibling == STRS_TRANSFORM_NONE) {
+        node = nodes[node].links.parent;
+      }
+      if (node == root) {
+        break;
+      }
+      node = nodes[node].links.next_sibling;
+    }
+  }
+
+  app->transform_dirty_count = 0;
+  if (high > low) {
+    mark_buffer_dirty(&app->transform_buffer, sizeof(transform_world) * low, sizeof(transform_world) * high);
+  }
+}
+
+void update_transform_buffer(internal_strs_app *app) {
+  if (update_storage_buffer(app, &app->transform_buffer, app->transform_worlds,
+                            sizeof(transform_world) * app->transform_world_capacity)) {
+    write_transform_descriptor_sets(app);
+    if (app->cull_record_buffer != VK_NULL_HANDLE) {
+      write_cull_descriptor_sets(app);
+    }
+    app->command_buffers_dirty = true;
+  }
+}
+
+strs_transform strs_transform_create(strs_app app, strs_transform parent) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  uint32_t transform;
+
+  dbg_assert(parent < intern_app->transform_count && intern_app->transform_nodes[parent].used);
+  if (intern_app->transform_free != STRS_TRANSFORM_NONE) {
+    transform = intern_app->transform_free;
+    intern_app->transform_free = intern_app->transform_nodes[transform].links.next_sibling;
+  } else {
+    intern_app->transform_nodes = strs_grow_array(intern_app->transform_nodes, &intern_app->transform_capacity,
+                                             intern_app->transform_count + 1, sizeof(transform_node));
+    intern_app->transform_worlds = strs_grow_array(intern_app->transform_worlds, &intern_app->transform_world_capacity,
+                                              intern_app->transform_count + 1, sizeof(transform_world));
+    transform = (uint32_t) intern_app->transform_count++;
+  }
+
+  intern_app->transform_nodes[transform] = (transform_node){
+    .links = {.first_child = STRS_TRANSFORM_NONE},
+    .local = {1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f},
+    .used = true,
+    .opacity = 1.0f};
+  strs_tree_attach(intern_app->transform_nodes, sizeof(transform_node), transform, parent);
+  mark_transform_dirty(intern_app, transform);
+  mark_layers_changed(intern_app);
+  capture_call(intern_app, STRS_CALL_TRANSFORM_CREATE, (uint64_t[]){parent, transform}, 2, NULL, 0);
+  return transform;
+}
+
+void strs_transform_destroy(strs_app app, strs_transform transform) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  transform_node *nodes = intern_app->transform_nodes;
+
+  if (transform == STRS_TRANSFORM_ROOT || transform >= intern_app->transform_count || !nodes[transform].used) {
+    return;
+  }
+  capture_call(intern_app, STRS_CALL_TRANSFORM_DESTROY, (uint64_t[]){transform}, 1, NULL, 0);
+  uint32_t parent = nodes[transform].links.parent;
+  for (uint32_t child = nodes[transform].links.first_child; child != STRS_TRANSFORM_NONE;
+       child = nodes[child].links.next_sibling) {
+    mark_transform_dirty(intern_app, child);
+  }
+  strs_tree_detach(nodes, sizeof(transform_node), transform);
+
+  if (nodes[transform].layer) {
+    nodes[transform].layer = false;
+    intern_app->layer_nodes--;
+  }
+  mark_layers_changed(intern_app);
+  nodes[transform].used = false;
+  nodes[transform].dirty = false;
+  nodes[transform].links.next_sibling = intern_app->transform_free;
+  intern_app->transform_free = transform;
+  if (intern_app->current_transform == transform) {
+    intern_app->current_transform = parent;
+  }
+}
+
+void strs_transform_set(strs_app app, strs_transform transform, const float affine[6]) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  dbg_assert(transform < intern_app->transform_count && intern_app->transform_nodes[transform].used);
+  capture_call(intern_app, STRS_CALL_TRANSFORM_SET, (uint64_t[]){transform}, 1, affine, sizeof(float) * 6);
+  memcpy(intern_app->transform_nodes[transform].local, affine, sizeof(float) * 6);
+  mark_transform_dirty(intern_app, transform);
+}
+
+void strs_transform_set_translate_scale(strs_app app, strs_transform transform, float x, float y, float scale) {
+  const float affine[6] = {scale, 0.0f, 0.0f, scale, x, y};
+  strs_transform_set(app, transform, affine);
+}
+
+void strs_transform_get(strs_app app, strs_transform transform, float affine[6]) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  memcpy(affine, intern_app->transform_nodes[transform].local, sizeof(float) * 6);
+}
+
+void strs_transform_follow_pointer(strs_app app, strs_transform transform, bool follow) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  dbg_assert(transform < intern_app->transform_count && intern_app->transform_nodes[transform].used);
+  capture_call(intern_app, STRS_CALL_TRANSFORM_FOLLOW_POINTER, (uint64_t[]){transform, follow}, 2, NULL, 0);
+  if (intern_app->transform_nodes[transform].follow_pointer != follow) {
+    intern_app->transform_nodes[transform].follow_pointer = follow;
+    mark_transform_dirty(intern_app, transform);
+    mark_layers_changed(intern_app);
+  }
+}
+
+void strs_transform_set_layer(strs_app app, strs_transform transform, const strs_rect *bounds) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  dbg_assert(transform != STRS_TRANSFORM_ROOT && transform < intern_app->transform_count &&
+             intern_app->transform_nodes[transform].used);
+  capture_call(intern_app, STRS_CALL_TRANSFORM_SET_LAYER, (uint64_t[]){transform}, 1, bounds,
+               bounds != NULL ? sizeof(strs_rect) : 0);
+  transform_node *node = &intern_app->transform_nodes[transform];
+  if (!node->layer && bounds != NULL) {
+    intern_app->layer_nodes++;
+  } else if (node->layer && bounds == NULL) {
+    intern_app->layer_nodes--;
+  }
+  node->layer = bounds != NULL;
+  if (bounds != NULL) {
+    node->layer_bounds[0] = bounds->x;
+    node->layer_bounds[1] = bounds->y;
+    node->layer_bounds[2] = bounds->x + bounds->width;
+    node->layer_bounds[3] = bounds->y + bounds->height;
+  }
+  intern_app->layers_changed = true;
+}
+
+void strs_transform_set_opacity(strs_app app, strs_transform transform, float opacity) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  dbg_assert(transform < intern_app->transform_count && intern_app->transform_nodes[transform].used);
+  capture_call(intern_app, STRS_CALL_TRANSFORM_SET_OPACITY, (uint64_t[]){transform}, 1, &opacity, sizeof(float));
+  // Read by update_layers, which rewrites the composites only when the node owns a drawn layer
+  intern_app->transform_nodes[transform].opacity = opacity;
+}
+
+// Draw items never span two nodes, build_draw_commands cuts its batches at their edges
+void strs_app_set_transform(strs_app app, strs_transform transform) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_SET_TRANSFORM, (uint64_t[]){transform}, 1, NULL, 0);
+  if (intern_app->current_transform != transform) {
+    close_draw_item(intern_app);
+    intern_app->current_transform = transform;
+  }
+}
+
+strs_transform strs_app_get_transform(strs_app app) {
+  return ((internal_strs_app*)app)->current_transform;
+}
+
+STRS_INTERN bool same_region(const clip_region *a, const clip_region *b) {
+  if (memcmp(a->bounds, b->bounds, sizeof(a->bounds)) != 0 || a->masked != b->masked) {
+    return false;
+  }
+  return !a->masked || (memcmp(a->mask_inverse, b->mask_inverse, sizeof(a->mask_inverse)) == 0 &&
+                        memcmp(a->mask_half_size, b->mask_half_size, sizeof(a->mask_half_size)) == 0 &&
+                        a->mask_radius == b->mask_radius);
+}
+
+// Regions are shared by every clip that ends up the same, so pushing the clips of a scene again each frame
+// does not grow the table
+STRS_INTERN void push_clip_region(internal_strs_app *app, clip_region region) {
+  if (app->clip_stack_count > 0) {
+    const clip_region *parent = &app->clip_regions[app->clip_stack[app->clip_stack_count - 1] - 1];
+    region.bounds[0] = fmaxf(region.bounds[0], parent->bounds[0]);
+    region.bounds[1] = fmaxf(region.bounds[1], parent->bounds[1]);
+    region.bounds[2] = fminf(region.bounds[2], parent->bounds[2]);
+    region.bounds[3] = fminf(region.bounds[3], parent->bounds[3]);
+    if (!region.masked && parent->masked) {
+      region.masked = true;
+      memcpy(region.mask_inverse, parent->mask_inverse, sizeof(region.mask_inverse));
+      memcpy(region.mask_half_size, parent->mask_half_size, sizeof(region.mask_half_size));
+      region.mask_radius = parent->mask_radius;
+    }
+  }
+
+  uint32_t index = 0;
+  for (uint64_t i = 0; i < app->clip_region_count && index == 0; i++) {
+    if (same_region(&app->clip_regions[i], &region)) {
+      index = (uint32_t) i + 1;
+    }
+  }
+  if (index == 0) {
+    app->clip_regions = strs_grow_array(app->clip_regions, &app->clip_region_capacity, app->clip_region_count + 1,
+                                   sizeof(clip_region));
+    app->clip_regions[app->clip_region_count++] = region;
+    index = (uint32_t) app->clip_region_count;
+    mark_scene_dirty(app, SCENE_CLIPS, sizeof(clip_region) * (index - 1), sizeof(clip_region) * index);
+  }
+
+  close_draw_item(app);
+  app->clip_stack = strs_grow_array(app->clip_stack, &app->clip_stack_capacity, app->clip_stack_count + 1,
+                               sizeof(uint32_t));
+  app->clip_stack[app->clip_stack_count++] = index;
+}
+
+STRS_LIB void strs_push_clip(strs_app app, const strs_rect *rect) {
+  capture_call((internal_strs_app*)app, STRS_CALL_PUSH_CLIP, NULL, 0, rect, sizeof(strs_rect));
+  clip_region region = {
+    .bounds = {rect->x, rect->y, rect->x + rect->width, rect->y + rect->height}};
+  push_clip_region((internal_strs_app*)app, region);
+}
+
+STRS_LIB void strs_push_clip_mask(strs_app app, const strs_rect *rect, float radius, const float affine[6]) {
+  const float identity[] = {1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f};
+  const float *a = affine != NULL ? affine : identity;
+  const float values[] = {rect->x, rect->y, rect->width, rect->height, radius, a[0], a[1], a[2], a[3], a[4], a[5]};
+  capture_call((internal_strs_app*)app, STRS_CALL_PUSH_CLIP_MASK, NULL, 0, values,
+               affine != NULL ? sizeof(values) : sizeof(float) * 5);
+  float half_width = rect->width * 0.5f;
+  float half_height = rect->height * 0.5f;
+  clip_region region = {
+    .bounds = {FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX}};
+
+  for (uint32_t corner = 0; corner < 4; corner++) {
+    float x = rect->x + (corner & 1 ? rect->width : 0.0f);
+    float y = rect->y + (corner & 2 ? rect->height : 0.0f);
+    float px = a[0] * x + a[2] * y + a[4];
+    float py = a[1] * x + a[3] * y + a[5];
+    region.bounds[0] = fminf(region.bounds[0], px);
+    region.bounds[1] = fminf(region.bounds[1], py);
+    region.bounds[2] = fmaxf(region.bounds[2], px);
+    region.bounds[3] = fmaxf(region.bounds[3], py);
+  }
+
+  float determinant = a[0] * a[3] - a[2] * a[1];
+  radius = fminf(fmaxf(radius, 0.0f), fminf(half_width, half_height));
+  if (determinant == 0.0f) {
+    memset(region.bounds, 0, sizeof(region.bounds));
+  } else if (radius > 0.0f || a[1] != 0.0f || a[2] != 0.0f) {
+    // Axis aligned clips without corners are left to the scissor alone
+    float inverse[] = {a[3] / determinant, -a[1] / determinant, -a[2] / determinant, a[0] / determinant};
+    float center[] = {rect->x + half_width, rect->y + half_height};
+    region.masked = true;
+    region.mask_inverse[0] = inverse[0];
+    region.mask_inverse[1] = inverse[1];
+    region.mask_inverse[2] = inverse[2];
+    region.mask_inverse[3] = inverse[3];
+    region.mask_inverse[4] = -(inverse[0] * a[4] + inverse[2] * a[5]) - center[0];
+    region.mask_inverse[5] = -(inverse[1] * a[4] + inverse[3] * a[5]) - center[1];
+    region.mask_half_size[0] = half_width;
+    region.mask_half_size[1] = half_height;
+    region.mask_radius = radius;
+  }
+  push_clip_region((internal_strs_app*)app, region);
+}
+
+STRS_LIB void strs_pop_clip(strs_app app) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_POP_CLIP, NULL, 0, NULL, 0);
+  close_draw_item(intern_app);
+  if (intern_app->clip_stack_count > 0) {
+    intern_app->clip_stack_count--;
+  }
+}
+
+// Called with latency_lock held
+STRS_INTERN void record_latency(internal_strs_app *app, uint64_t latency_ns) {
+  app->latency_samples[app->latency_sample_count % STRS_LATENCY_SAMPLE_COUNT] = latency_ns;
+  app->latency_sample_count++;
+}
+
+// Only runs with present_wait, every queued frame is waited for in present order
+STRS_INTERN void *latency_waiter(void *data) {
+  internal_strs_app *app = (internal_strs_app*)data;
+
+  pthread_mutex_lock(&app->latency_lock);
+  while (!app->latency_stop) {
+    if (app->latency_frame_count == 0) {
+      pthread_cond_wait(&app->latency_cond, &app->latency_lock);
+      continue;
+    }
+    latency_frame frame = app->latency_frames[app->latency_frame_first];
+    app->latency_frame_first = (app->latency_frame_first + 1) % LATENCY_QUEUE_SIZE;
+    app->latency_frame_count--;
+    pthread_mutex_unlock(&app->latency_lock);
+
+    // Frames of a swap chain that was recreated in the meantime are dropped
+    VkResult result = VK_ERROR_OUT_OF_DATE_KHR;
+    pthread_mutex_lock(&app->present_lock);
+    if (frame.swap_chain == app->swap_chain) {
+      result = app->wait_for_present(app->logical_device, frame.swap_chain, frame.present_id,
+                                     LATENCY_PRESENT_TIMEOUT_NS);
+    }
+    uint64_t presented = strs_clock_now_ns();
+    pthread_mutex_unlock(&app->present_lock);
+
+    pthread_mutex_lock(&app->latency_lock);
+    if (result == VK_SUCCESS) {
+      record_latency(app, presented - frame.input_ns);
+    }
+  }
+  pthread_mutex_unlock(&app->latency_lock);
+
+  return NULL;
+}
+
+// Samples the pointer as late as possible and writes it past the rest of the uniform buffer.
+// Returns the oldest input the frame shows, 0 if there is none.
+STRS_INTERN uint64_t latch_input(internal_strs_app *app, uint32_t image) {
+  PFN_strs_sample_pointer sample;
+  void *user_data;
+  float pointer[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  uint64_t input_ns;
+
+  uint64_t sampled = 0;
+
+  pthread_mutex_lock(&app->latency_lock);
+  sample = app->sample_pointer;
+  user_data = app->sample_pointer_data;
+  pointer[0] = app->pointer[0];
+  pointer[1] = app->pointer[1];
+  pthread_mutex_unlock(&app->latency_lock);
+
+  if (sample != NULL) {
+    sampled = strs_clock_now_ns();
+    sample(&pointer[0], &pointer[1], user_data);
+  }
+
+  pthread_mutex_lock(&app->latency_lock);
+  if (sample != NULL) {
+    // A sampled move counts as input that happened when it was sampled
+    if ((pointer[0] != app->pointer[0] || pointer[1] != app->pointer[1]) && app->pending_input_ns == 0) {
+      app->pending_input_ns = sampled;
+    }
+    app->pointer[0] = pointer[0];
+    app->pointer[1] = pointer[1];
+  } else {
+    pointer[0] = app->pointer[0];
+    pointer[1] = app->pointer[1];
+  }
+  input_ns = app->pending_input_ns;
+  app->pending_input_ns = 0;
+  pthread_mutex_unlock(&app->latency_lock);
+
+  void *data;
+  vkMapMemory(app->logical_device, app->uniform_buffers_memory[image],
+              offsetof(UniformBufferObject, pointer), sizeof(pointer), 0, &data);
+  memcpy(data, pointer, sizeof(pointer));
+  vkUnmapMemory(app->logical_device, app->uniform_buffers_memory[image]);
+
+  return input_ns;
+}
+
+// Drains what was pushed since the last frame. Moves and scrolls in a row are merged into one
+// event before the handler sees them, the history gets every one of them.
+STRS_INTERN void dispatch_input(internal_strs_app *app) {
+  strs_input_event *history = NULL;
+  strs_input_event *events = NULL;
+  uint32_t historyCount = 0;
+  uint32_t eventCount = 0;
+  strs_input_event event;
+
+  // Bounded, so producers that keep pushing can not stall the frame
+  while (historyCount < STRS_INPUT_RING_SIZE && strs_input_ring_pop(&app->input, &event)) {
+    if (history == NULL) {
+      history = strs_arena_alloc(build_arena(app), sizeof(strs_input_event) * STRS_INPUT_RING_SIZE);
+      events = strs_arena_alloc(build_arena(app), sizeof(strs_input_event) * STRS_INPUT_RING_SIZE);
+    }
+    history[historyCount++] = event;
+
+    strs_input_event *last = eventCount > 0 ? &events[eventCount - 1] : NULL;
+    if (last != NULL && last->type == event.type && event.type == STRS_INPUT_POINTER_MOVE) {
+      last->x = event.x;
+      last->y = event.y;
+      last->timestamp_ns = event.timestamp_ns;
+      last->coalesced++;
+    } else if (last != NULL && last->type == event.type && event.type == STRS_INPUT_SCROLL) {
+      last->x += event.x;
+      last->y += event.y;
+      last->timestamp_ns = event.timestamp_ns;
+      last->coalesced++;
+    } else {
+      events[eventCount++] = event;
+    }
+  }
+  if (historyCount == 0) {
+    return;
+  }
+
+  pthread_mutex_lock(&app->latency_lock);
+  for (uint32_t i = 0; i < historyCount; i++) {
+    if (history[i].type != STRS_INPUT_POINTER_MOVE) {
+      continue;
+    }
+    app->pointer[0] = history[i].x;
+    app->pointer[1] = history[i].y;
+    if (app->pending_input_ns == 0) {
+      app->pending_input_ns = history[i].timestamp_ns;
+    }
+  }
+  PFN_strs_input_handler handler = app->input_handler;
+  PFN_strs_input_history historyHandler = app->input_history;
+  void *userData = app->input_data;
+  pthread_mutex_unlock(&app->latency_lock);
+
+  if (historyHandler != NULL) {
+    historyHandler((strs_app)app, history, historyCount, userData);
+  }
+  if (handler != NULL) {
+    for (uint32_t i = 0; i < eventCount; i++) {
+      handler((strs_app)app, &events[i], userData);
+    }
+  }
+}
+
+STRS_LIB bool strs_app_push_input(strs_app app, const strs_input_event *event) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_INPUT, NULL, 0, event, sizeof(strs_input_event));
+  return strs_input_ring_push(&intern_app->input, event);
+}
+
+STRS_LIB void strs_app_set_input_handler(strs_app app, PFN_strs_input_handler handler,
+                                         PFN_strs_input_history history, void *user_data) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  pthread_mutex_lock(&intern_app->latency_lock);
+  intern_app->input_handler = handler;
+  intern_app->input_history = history;
+  intern_app->input_data = user_data;
+  pthread_mutex_unlock(&intern_app->latency_lock);
+}
+
+void strs_app_push_pointer(strs_app app, float x, float y, uint64_t timestamp_ns) {
+  strs_input_event event = {
+    .type = STRS_INPUT_POINTER_MOVE,
+    .timestamp_ns = timestamp_ns,
+    .x = x,
+    .y = y};
+  strs_app_push_input(app, &event);
+}
+
+STRS_INTERN int compare_latency(const void *a, const void *b) {
+  uint64_t left = *(const uint64_t*)a;
+  uint64_t right = *(const uint64_t*)b;
+  return left < right ? -1 : left > right;
+}
+
+void strs_app_get_latency_stats(strs_app app, strs_latency_stats *stats) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  uint64_t samples[STRS_LATENCY_SAMPLE_COUNT];
+  uint64_t count;
+
+  pthread_mutex_lock(&intern_app->latency_lock);
+  count = intern_app->latency_sample_count < STRS_LATENCY_SAMPLE_COUNT
+          ? intern_app->latency_sample_count : STRS_LATENCY_SAMPLE_COUNT;
+  memcpy(samples, intern_app->latency_samples, sizeof(uint64_t) * count);
+  pthread_mutex_unlock(&intern_app->latency_lock);
+
+  memset(stats, 0, sizeof(strs_latency_stats));
+  stats->samples = count;
+  stats->present_wait = intern_app->present_wait;
+  stats->dropped_input = __atomic_load_n(&intern_app->input.dropped, __ATOMIC_RELAXED);
+  if (count == 0) {
+    return;
+  }
+
+  qsort(samples, count, sizeof(uint64_t), compare_latency);
+  stats->p50_ns = samples[(count - 1) * 50 / 100];
+  stats->p90_ns = samples[(count - 1) * 90 / 100];
+  stats->p99_ns = samples[(count - 1) * 99 / 100];
+  stats->max_ns = samples[count - 1];
+}
+
+void strs_app_reset_latency_stats(strs_app app) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  pthread_mutex_lock(&intern_app->latency_lock);
+  intern_app->latency_sample_count = 0;
+  pthread_mutex_unlock(&intern_app->latency_lock);
+}
+
+void strs_app_set_late_latch(strs_app app, PFN_strs_sample_pointer sample, void *user_data) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  pthread_mutex_lock(&intern_app->latency_lock);
+  intern_app->sample_pointer = sample;
+  intern_app->sample_pointer_data = user_data;
+  pthread_mutex_unlock(&intern_app->latency_lock);
+}
+
+static void resize_callback(strs_window window, uint32_t width, uint32_t height) {
+  internal_strs_app *app = strs_window_get_user_pointer(window);
+  capture_call(app, STRS_CALL_RESIZE, (uint64_t[]){width, height}, 2, NULL, 0);
+  app->frame_buffer_resized = true;
+}
+
+STRS_INTERN void run_startup_stage(internal_strs_app *app, strs_startup_stage stage, startup_step step) {
+  uint64_t begin = strs_clock_now_ns();
+  step(app);
+  app->startup_timings.stage_ns[stage] = strs_clock_now_ns() - begin;
+}
+
+// Everything that depends on the surface format, overlaps with shader module creation
+STRS_INTERN void create_presentation_chain(void *data) {
+  internal_strs_app *app = (internal_strs_app*)data;
+
+  run_startup_stage(app, STRS_STARTUP_STAGE_SWAP_CHAIN, create_swap_chain);
+  run_startup_stage(app, STRS_STARTUP_STAGE_IMAGE_VIEWS, create_image_views);
+  run_startup_stage(app, STRS_STARTUP_STAGE_RENDER_PASS, create_render_pass);
+}
+
+STRS_LIB strs_app strs_app_create(int width, int height, strs_string *title) {
+  return strs_app_create_ex(width, height, title, NULL);
+}
+
+STRS_LIB strs_app strs_app_create_ex(int width, int height, strs_string *title, const strs_app_options *options) {
+  internal_strs_app *app = calloc(1, sizeof(internal_strs_app));
+  strs_job presentation_chain;
+  uint64_t begin;
+
+  app->startup_begin = strs_clock_now_ns();
+  if (options != NULL) {
+    app->vertex_format = options->vertex_format;
+    app->index_width = options->index_width;
+    app->gpu_culling = options->gpu_culling;
+    app->manual_publish = options->manual_publish;
+    app->layer_promote_frames = options->layer_promote_frames;
+    app->texture_cache = options->texture_cache != NULL ? strdup(options->texture_cache) : NULL;
+    app->capture = options->capture;
+  }
+  capture_call(app, STRS_CALL_RESIZE, (uint64_t[]){(uint64_t) width, (uint64_t) height}, 2, NULL, 0);
+  app->animation_free = STRS_ANIMATION_NONE;
+  app->preferred_device = options != NULL ? options->device : NULL;
+  if (options != NULL && options->context != NULL) {
+    app->context = (internal_strs_context*)options->context;
+  } else {
+    app->context = (internal_strs_context*)strs_context_create();
+    app->context->implicit = true;
+  }
+  app->host_allocator = app->context->host_allocator;
+  pthread_mutex_lock(&app->context->apps_lock);
+  app->context->apps = strs_grow_array(app->context->apps, &app->context->app_capacity, app->context->app_count + 1,
+                                  sizeof(void*));
+  app->context->apps[app->context->app_count++] = app;
+  pthread_mutex_unlock(&app->context->apps_lock);
+  app->frame_arenas = calloc(MAX_FRAMES_IN_FLIGHT, sizeof(strs_arena));
+  create_root_transform(app);
+  pthread_mutex_init(&app->latency_lock, NULL);
+  pthread_cond_init(&app->latency_cond, NULL);
+  pthread_mutex_init(&app->present_lock, NULL);
+  pthread_mutex_init(&app->task_lock, NULL);
+  pthread_mutex_init(&app->texture_lock, NULL);
+  strs_pool_init(&app->texture_upload_pool, sizeof(texture_upload), 16);
+  app->texture_free = UINT32_MAX;
+  strs_input_ring_init(&app->input);
+  app->cull_viewport[0] = -FLT_MAX;
+  app->cull_viewport[1] = -FLT_MAX;
+  app->cull_viewport[2] = FLT_MAX;
+  app->cull_viewport[3] = FLT_MAX;
+  app->vertex_stride = strs_vertex_format_size(app->vertex_format);
+
+  app->shader_loader = strs_jobs_spawn(app->context->jobs, load_shader_code, app, NULL, 0);
+
+  begin = strs_clock_now_ns();
+  app->window = strs_window_create(width, height, title);
+  strs_window_set_user_pointer(app->window, app);
+  strs_window_set_resize_callback(app->window, resize_callback);
+  app->startup_timings.stage_ns[STRS_STARTUP_STAGE_WINDOW] = strs_clock_now_ns() - begin;
+
+  run_startup_stage(app, STRS_STARTUP_STAGE_INSTANCE, create_instance);
+  run_startup_stage(app, STRS_STARTUP_STAGE_SURFACE, create_surface);
+  run_startup_stage(app, STRS_STARTUP_STAGE_PHYSICAL_DEVICE, pick_physical_device);
+  run_startup_stage(app, STRS_STARTUP_STAGE_LOGICAL_DEVICE, create_logical_device);
+
+  presentation_chain = strs_jobs_spawn(app->context->jobs, create_presentation_chain, app, NULL, 0);
+
+  run_startup_stage(app, STRS_STARTUP_STAGE_SHADER_MODULES, create_shader_modules);
+  run_startup_stage(app, STRS_STARTUP_STAGE_DESCRIPTOR_SET_LAYOUT, create_descriptor_set_layout);
+  run_startup_stage(app, STRS_STARTUP_STAGE_COMMAND_POOL, create_command_pool);
+  create_texture_set(app);
+  if (app->gpu_culling) {
+    create_cull_pipeline(app);
+  }
+
+  strs_jobs_wait(app->context->jobs, presentation_chain);
+
+  fill_config_info(app);
+  fill_shape_config_info(app);
+  run_startup_stage(app, STRS_STARTUP_STAGE_GRAPHICS_PIPELINE, create_graphics_pipeline);
+  run_startup_stage(app, STRS_STARTUP_STAGE_FRAME_BUFFERS, create_frame_buffers);
+  run_startup_stage(app, STRS_STARTUP_STAGE_UNIFORM_BUFFERS, create_uniform_buffers);
+  run_startup_stage(app, STRS_STARTUP_STAGE_DESCRIPTOR_POOL, create_descriptor_pool);
+  run_startup_stage(app, STRS_STARTUP_STAGE_DESCRIPTOR_SETS, create_descriptor_sets);
+  run_startup_stage(app, STRS_STARTUP_STAGE_SYNC_OBJECTS, create_sync_objects);
+  run_startup_stage(app, STRS_STARTUP_STAGE_COMMAND_BUFFERS, create_command_buffers);
+
+  app->startup_timings.create_ns = strs_clock_now_ns() - app->startup_begin;
+
+  if (app->present_wait) {
+    pthread_create(&app->latency_thread, NULL, latency_waiter, app);
+  }
 
   return (strs_app)app;
 }
 
+STRS_LIB void strs_app_get_startup_timings(strs_app app, strs_startup_timings *timings) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  *timings = intern_app->startup_timings;
+}
+
+STRS_LIB void strs_app_get_device_capabilities(strs_app app, strs_device_capabilities *capabilities) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  *capabilities = intern_app->context->capabilities;
+}
+
+STRS_LIB const char *strs_startup_stage_name(strs_startup_stage stage) {
+  static const char *names[STRS_STARTUP_STAGE_COUNT] = {
+    "window",
+    "instance",
+    "surface",
+    "physical device",
+    "logical device",
+    "shader load",
+    "swap chain",
+    "image views",
+    "render pass",
+    "shader modules",
+    "descriptor set layout",
+    "command pool",
+    "graphics pipeline",
+    "frame buffers",
+    "uniform buffers",
+    "descriptor pool",
+    "descriptor sets",
+    "sync objects",
+    "command buffers",
+    "geometry buffers"};
+
+  if (stage >= STRS_STARTUP_STAGE_COUNT) {
+    return "unknown";
+  }
+  return names[stage];
+}
+
+STRS_INTERN bool app_closing(internal_strs_app *app) {
+  return __atomic_load_n(&app->close_requested, __ATOMIC_ACQUIRE) || strs_window_closing(app->window);
+}
+
 void *main_loop(void *arg) {
   internal_strs_app *app = (internal_strs_app*)arg;
-  while (!strs_window_closing(app->window)) {
+  while (!app_closing(app)) {
     strs_window_poll_events(app->window);
     draw_frame(app);
   }
-  vkDeviceWaitIdle(app->logical_device);
+  device_wait_idle(app);
 
   return NULL;
 }
 
 STRS_LIB void strs_app_run(strs_app app) {
   internal_strs_app *intern_app = (internal_strs_app*)app;
+  intern_app->own_thread = true;
   pthread_create(&intern_app->thread, NULL, main_loop, intern_app);
 }
 
+STRS_LIB void strs_app_close(strs_app app) {
+  __atomic_store_n(&((internal_strs_app*)app)->close_requested, true, __ATOMIC_RELEASE);
+}
+
+STRS_LIB strs_context strs_context_create(void) {
+  internal_strs_context *context = calloc(1, sizeof(internal_strs_context));
+  context->host_allocator = (VkAllocationCallbacks){
+    .pUserData = context,
+    .pfnAllocation = host_allocate,
+    .pfnReallocation = host_reallocate,
+    .pfnFree = host_free};
+  pthread_mutex_init(&context->queue_lock, NULL);
+  pthread_mutex_init(&context->apps_lock, NULL);
+  pthread_cond_init(&context->apps_cond, NULL);
+#ifndef STRS_NOT_MULTI_THREADED
+  context->jobs = strs_jobs_create(strs_jobs_default_worker_count());
+#else
+  context->jobs = strs_jobs_create(0);
+#endif
+  return (strs_context)context;
+}
+
+// Draws the windows of the context round robin until all of them were closed
+STRS_INTERN void *context_loop(void *arg) {
+  internal_strs_context *context = arg;
+  pthread_mutex_lock(&context->apps_lock);
+  bool drawing = true;
+  while (drawing) {
+    drawing = false;
+    for (uint64_t i = 0; i < context->app_count; i++) {
+      internal_strs_app *app = context->apps[i];
+      if (app->own_thread || app->closed) {
+        continue;
+      }
+      if (app_closing(app)) {
+        app->closed = true;
+        pthread_cond_broadcast(&context->apps_cond);
+        continue;
+      }
+      drawing = true;
+      // A window that is still open is not removed from the list, so the lock is not needed to draw it
+      pthread_mutex_unlock(&context->apps_lock);
+      strs_window_poll_events(app->window);
+      draw_frame(app);
+      pthread_mutex_lock(&context->apps_lock);
+    }
+  }
+  context->running = false;
+  pthread_cond_broadcast(&context->apps_cond);
+  pthread_mutex_unlock(&context->apps_lock);
+  return NULL;
+}
+
+STRS_LIB void strs_context_run(strs_context context) {
+  internal_strs_context *intern_context = (internal_strs_context*)context;
+  intern_context->started = true;
+  intern_context->running = true;
+  pthread_create(&intern_context->thread, NULL, context_loop, intern_context);
+}
+
+STRS_LIB void strs_context_free(strs_context context) {
+  internal_strs_context *intern_context = (internal_strs_context*)context;
+  dbg_assert(intern_context->app_count == 0);
+  if (intern_context->started) {
+    pthread_join(intern_context->thread, NULL);
+  }
+
+  VkDevice device = intern_context->logical_device;
+  const VkAllocationCallbacks *allocator = &intern_context->host_allocator;
+  if (device != VK_NULL_HANDLE) {
+    for (int i = 0; i < VERTEX_FORMAT_COUNT; i++) {
+      vkDestroyShaderModule(device, intern_context->vert_shader_modules[i], allocator);
+      vkDestroyShaderModule(device, intern_context->frag_shader_modules[i], allocator);
+    }
+    vkDestroyShaderModule(device, intern_context->shape_vert_shader_module, allocator);
+    vkDestroyShaderModule(device, intern_context->shape_frag_shader_module, allocator);
+    vkDestroyShaderModule(device, intern_context->cull_shader_module, allocator);
+    vkDestroyPipelineCache(device, intern_context->pipeline_cache, allocator);
+    vkDestroyDevice(device, allocator);
+  }
+  if (intern_context->instance != VK_NULL_HANDLE) {
+    vkDestroyInstance(intern_context->instance, allocator);
+  }
+
+  pthread_mutex_destroy(&intern_context->queue_lock);
+  pthread_mutex_destroy(&intern_context->apps_lock);
+  pthread_cond_destroy(&intern_context->apps_cond);
+  strs_jobs_free(intern_context->jobs);
+  free(intern_context->apps);
+  free(intern_context);
+}
+
+STRS_INTERN strs_widget_batch widget_batch(widget_pool *pool, uint32_t type, uint32_t first, uint32_t count) {
+  return (strs_widget_batch){
+    .type = type,
+    .count = count,
+    .rects = pool->rects + first,
+    .colors = pool->colors + first,
+    .flags = pool->flags + first,
+    .data = pool->data != NULL ? pool->data + pool->info.data_size * first : NULL};
+}
+
+// Returns NULL when the handle is stale
+STRS_INTERN widget_pool *find_widget(internal_strs_app *app, strs_widget_handle widget, uint32_t *entry) {
+  uint32_t type = (uint32_t) (widget >> 48);
+  uint32_t slot = (uint32_t) widget;
+  if (type >= app->widget_pool_count) {
+    return NULL;
+  }
+  widget_pool *pool = &app->widget_pools[type];
+  if (slot >= pool->slot_count || pool->slot_generations[slot] != (uint16_t) (widget >> 32)) {
+    return NULL;
+  }
+  *entry = pool->slot_entries[slot];
+  return pool;
+}
+
+STRS_INTERN void run_widget_passes(internal_strs_app *app) {
+  for (uint32_t type = 0; type < app->widget_pool_count; type++) {
+    widget_pool *pool = &app->widget_pools[type];
+    if (pool->info.update != NULL && pool->count > 0) {
+      strs_widget_batch batch = widget_batch(pool, type, 0, pool->count);
+      pool->info.update((strs_app)app, &batch, pool->info.user_data);
+    }
+  }
+  for (uint32_t type = 0; type < app->widget_pool_count; type++) {
+    widget_pool *pool = &app->widget_pools[type];
+    if (pool->info.style != NULL && pool->count > 0) {
+      strs_widget_batch batch = widget_batch(pool, type, 0, pool->count);
+      pool->info.style((strs_app)app, &batch, pool->info.user_data);
+    }
+  }
+  for (uint32_t type = 0; type < app->widget_pool_count; type++) {
+    widget_pool *pool = &app->widget_pools[type];
+    if (!pool->dirty) {
+      continue;
+    }
+    if (pool->info.geometry != NULL) {
+      strs_widget_batch batch = widget_batch(pool, type, 0, pool->count);
+      pool->info.geometry((strs_app)app, &batch, pool->info.user_data);
+    }
+    for (uint32_t i = 0; i < pool->count; i++) {
+      pool->flags[i] &= ~STRS_WIDGET_DIRTY;
+    }
+    pool->dirty = false;
+  }
+}
+
+STRS_LIB uint32_t strs_widget_type_register(strs_app app, const strs_widget_type_info *info) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  uint32_t type = info->name != NULL ? strs_widget_type_find(app, info->name) : STRS_WIDGET_TYPE_NONE;
+  if (type != STRS_WIDGET_TYPE_NONE) {
+    return type;
+  }
+
+  type = (uint32_t) intern_app->widget_pool_count;
+  dbg_assert(type < UINT16_MAX);
+  intern_app->widget_pools = strs_grow_array(intern_app->widget_pools, &intern_app->widget_pool_capacity,
+                                        intern_app->widget_pool_count + 1, sizeof(widget_pool));
+  widget_pool *pool = &intern_app->widget_pools[intern_app->widget_pool_count++];
+  *pool = (widget_pool){
+    .info = *info,
+    .free_slot = UINT32_MAX};
+  if (info->name != NULL) {
+    size_t length = strlen(info->name) + 1;
+    pool->name = malloc(length);
+    memcpy(pool->name, info->name, length);
+  }
+  pool->info.name = pool->name;
+  return type;
+}
+
+STRS_LIB uint32_t strs_widget_type_find(strs_app app, const char *name) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  for (uint32_t type = 0; type < intern_app->widget_pool_count; type++) {
+    if (intern_app->widget_pools[type].name != NULL && strcmp(intern_app->widget_pools[type].name, name) == 0) {
+      return type;
+    }
+  }
+  return STRS_WIDGET_TYPE_NONE;
+}
+
+STRS_LIB strs_widget_handle strs_widget_create(strs_app app, uint32_t type, const strs_rect *rect, const vec3 color,
+                                               const void *data) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  dbg_assert(type < intern_app->widget_pool_count);
+  widget_pool *pool = &intern_app->widget_pools[type];
+  size_t dataSize = pool->info.data_size;
+
+  if (pool->count == pool->capacity) {
+    uint64_t capacity = pool->capacity;
+    pool->rects = strs_grow_array(pool->rects, &capacity, pool->count + 1, sizeof(strs_rect));
+    pool->colors = realloc(pool->colors, sizeof(vec3) * capacity);
+    pool->flags = realloc(pool->flags, sizeof(uint32_t) * capacity);
+    pool->entry_slots = realloc(pool->entry_slots, sizeof(uint32_t) * capacity);
+    if (dataSize > 0) {
+      pool->data = realloc(pool->data, dataSize * capacity);
+    }
+    pool->capacity = capacity;
+  }
+
+  uint32_t slot = pool->free_slot;
+  if (slot != UINT32_MAX) {
+    pool->free_slot = pool->slot_entries[slot];
+  } else {
+    uint64_t slotCapacity = pool->slot_capacity;
+    pool->slot_entries = strs_grow_array(pool->slot_entries, &slotCapacity, pool->slot_count + 1, sizeof(uint32_t));
+    pool->slot_generations = realloc(pool->slot_generations, sizeof(uint16_t) * slotCapacity);
+    pool->slot_capacity = slotCapacity;
+    slot = pool->slot_count++;
+    pool->slot_generations[slot] = 1;
+  }
+
+  uint32_t entry = pool->count++;
+  pool->slot_entries[slot] = entry;
+  pool->entry_slots[entry] = slot;
+  pool->rects[entry] = *rect;
+  memcpy(pool->colors[entry], color, sizeof(vec3));
+  pool->flags[entry] = STRS_WIDGET_DIRTY;
+  if (dataSize > 0 && data != NULL) {
+    memcpy(pool->data + dataSize * entry, data, dataSize);
+  } else if (dataSize > 0) {
+    memset(pool->data + dataSize * entry, 0, dataSize);
+  }
+  pool->dirty = true;
+  return WIDGET_HANDLE(type, slot, pool->slot_generations[slot]);
+}
+
+STRS_LIB void strs_widget_destroy(strs_app app, strs_widget_handle widget) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  uint32_t entry;
+  widget_pool *pool = find_widget(intern_app, widget, &entry);
+  if (pool == NULL) {
+    return;
+  }
+  uint32_t type = (uint32_t) (widget >> 48);
+  if (pool->info.destroy != NULL) {
+    strs_widget_batch batch = widget_batch(pool, type, entry, 1);
+    pool->info.destroy(app, &batch, pool->info.user_data);
+  }
+
+  uint32_t last = --pool->count;
+  if (entry != last) {
+    size_t dataSize = pool->info.data_size;
+    pool->rects[entry] = pool->rects[last];
+    memcpy(pool->colors[entry], pool->colors[last], sizeof(vec3));
+    pool->flags[entry] = pool->flags[last];
+    if (dataSize > 0) {
+      memcpy(pool->data + dataSize * entry, pool->data + dataSize * last, dataSize);
+    }
+    pool->entry_slots[entry] = pool->entry_slots[last];
+    pool->slot_entries[pool->entry_slots[entry]] = entry;
+  }
+
+  uint32_t slot = (uint32_t) widget;
+  pool->slot_generations[slot] = pool->slot_generations[slot] == UINT16_MAX ? 1 : pool->slot_generations[slot] + 1;
+  pool->slot_entries[slot] = pool->free_slot;
+  pool->free_slot = slot;
+}
+
+STRS_LIB bool strs_widget_alive(strs_app app, strs_widget_handle widget) {
+  uint32_t entry;
+  return find_widget((internal_strs_app*)app, widget, &entry) != NULL;
+}
+
+STRS_LIB void strs_widget_set_rect(strs_app app, strs_widget_handle widget, const strs_rect *rect) {
+  uint32_t entry;
+  widget_pool *pool = find_widget((internal_strs_app*)app, widget, &entry);
+  dbg_assert(pool != NULL);
+  pool->rects[entry] = *rect;
+  pool->flags[entry] |= STRS_WIDGET_DIRTY;
+  pool->dirty = true;
+}
+
+STRS_LIB void strs_widget_set_color(strs_app app, strs_widget_handle widget, const vec3 color) {
+  uint32_t entry;
+  widget_pool *pool = find_widget((internal_strs_app*)app, widget, &entry);
+  dbg_assert(pool != NULL);
+  memcpy(pool->colors[entry], color, sizeof(vec3));
+  pool->flags[entry] |= STRS_WIDGET_DIRTY;
+  pool->dirty = true;
+}
+
+STRS_LIB void strs_widget_set_flags(strs_app app, strs_widget_handle widget, uint32_t flags) {
+  uint32_t entry;
+  widget_pool *pool = find_widget((internal_strs_app*)app, widget, &entry);
+  dbg_assert(pool != NULL);
+  if ((pool->flags[entry] ^ flags) & STRS_WIDGET_HIDDEN) {
+    flags |= STRS_WIDGET_DIRTY;
+  }
+  pool->flags[entry] = flags;
+  pool->dirty |= (flags & STRS_WIDGET_DIRTY) != 0;
+}
+
+STRS_LIB uint32_t strs_widget_get_flags(strs_app app, strs_widget_handle widget) {
+  uint32_t entry;
+  widget_pool *pool = find_widget((internal_strs_app*)app, widget, &entry);
+  dbg_assert(pool != NULL);
+  return pool->flags[entry];
+}
+
+STRS_LIB strs_rect strs_widget_get_rect(strs_app app, strs_widget_handle widget) {
+  uint32_t entry;
+  widget_pool *pool = find_widget((internal_strs_app*)app, widget, &entry);
+  dbg_assert(pool != NULL);
+  return pool->rects[entry];
+}
+
+STRS_LIB void *strs_widget_data(strs_app app, strs_widget_handle widget) {
+  uint32_t entry;
+  widget_pool *pool = find_widget((internal_strs_app*)app, widget, &entry);
+  if (pool == NULL || pool->data == NULL) {
+    return NULL;
+  }
+  return pool->data + pool->info.data_size * entry;
+}
+
 STRS_LIB void strs_app_add(strs_app app, strs_widget *widget) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  capture_call(intern_app, STRS_CALL_APP_ADD, NULL, 0, NULL, 0);
+  close_draw_item(intern_app);
   widget->create_widget(app, widget->pointer);
+  close_draw_item(intern_app);
+  capture_call(intern_app, STRS_CALL_APP_ADD, NULL, 0, NULL, 0);
+}
+
+STRS_LIB void strs_app_set_cull_viewport(strs_app app, float x, float y, float width, float height) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  const float viewport[] = {x, y, width, height};
+  capture_call(intern_app, STRS_CALL_SET_CULL_VIEWPORT, NULL, 0, viewport, sizeof(viewport));
+  intern_app->cull_viewport[0] = x;
+  intern_app->cull_viewport[1] = y;
+  intern_app->cull_viewport[2] = x + width;
+  intern_app->cull_viewport[3] = y + height;
+}
+
+STRS_LIB void strs_app_get_cull_stats(strs_app app, strs_cull_stats *stats) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  *stats = intern_app->cull_stats;
+}
+
+STRS_LIB void strs_app_get_layer_stats(strs_app app, strs_layer_stats *stats) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  *stats = intern_app->layer_stats;
+}
+
+STRS_LIB void strs_app_get_clip_stats(strs_app app, strs_clip_stats *stats) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  *stats = intern_app->clip_stats;
+}
+
+STRS_LIB void strs_app_get_memory_stats(strs_app app, strs_memory_stats *stats) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  *stats = (strs_memory_stats){
+    .allocation_count = intern_app->memory_allocation_count,
+    .budget_bytes = intern_app->memory_budget,
+    .evicted_bytes = intern_app->memory_evicted,
+    .device_budget = intern_app->memory_budget_ext,
+    .device_budget_bytes = intern_app->device_budget_bytes,
+    .device_usage_bytes = intern_app->device_usage_bytes,
+    .pressure = intern_app->memory_pressure,
+    .driver_host_bytes = __atomic_load_n(&intern_app->context->host_bytes, __ATOMIC_RELAXED),
+    .driver_host_allocations = __atomic_load_n(&intern_app->context->host_allocations, __ATOMIC_RELAXED),
+    .driver_host_allocation_calls = __atomic_load_n(&intern_app->context->host_allocation_calls, __ATOMIC_RELAXED)};
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    uint64_t peak = intern_app->frame_arenas[i].peak;
+    stats->frame_arena_peak_bytes = peak > stats->frame_arena_peak_bytes ? peak : stats->frame_arena_peak_bytes;
+  }
+  for (uint32_t i = 0; i < STRS_MEMORY_CATEGORY_COUNT; i++) {
+    stats->category_bytes[i] = intern_app->memory_bytes[i];
+    stats->total_bytes += intern_app->memory_bytes[i];
+  }
+}
+
+STRS_LIB void *strs_app_frame_alloc(strs_app app, size_t size) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  return strs_arena_alloc(build_arena(intern_app), size);
+}
+
+STRS_LIB void strs_app_set_memory_budget(strs_app app, uint64_t budget_bytes,
+                                         PFN_strs_memory_pressure callback, void *user_data) {
+  internal_strs_app *intern_app = (internal_strs_app*)app;
+  intern_app->memory_budget = budget_bytes;
+  intern_app->memory_pressure_callback = callback;
+  intern_app->memory_pressure_data = user_data;
 }
 
 STRS_LIB void strs_app_free(strs_app application) {
   internal_strs_app *app = (internal_strs_app*)application;
-  pthread_join(app->thread, NULL);
+  internal_strs_context *context = app->context;
+  if (app->own_thread) {
+    pthread_join(app->thread, NULL);
+  }
 
-  cleanup_swap_chain(app);
+  pthread_mutex_lock(&context->apps_lock);
+  while (context->running && !app->closed) {
+    pthread_cond_wait(&context->apps_cond, &context->apps_lock);
+  }
+  for (uint64_t i = 0; i < context->app_count; i++) {
+    if (context->apps[i] == app) {
+      context->apps[i] = context->apps[--context->app_count];
+      break;
+    }
+  }
+  pthread_mutex_unlock(&context->apps_lock);
 
-  //  vkDestroyImage(app->logical_device, app->texture_image, NULL);
-  //  vkFreeMemory(app->logical_device, app->texture_image_memory, NULL);
+  while (__atomic_load_n(&app->running_tasks, __ATOMIC_ACQUIRE) > 0) {
+    if (!strs_jobs_help(context->jobs)) {
+      sched_yield();
+    }
+  }
+  complete_tasks(app);
+  device_wait_idle(app);
+
+  if (app->present_wait) {
+    pthread_mutex_lock(&app->latency_lock);
+    app->latency_stop = true;
+    pthread_cond_signal(&app->latency_cond);
+    pthread_mutex_unlock(&app->latency_lock);
+    pthread_join(app->latency_thread, NULL);
+  }
 
-  vkUnmapMemory(app->logical_device, app->vertex_buffer.stagingBufferMemory);
-  vkUnmapMemory(app->logical_device, app->index_buffer.stagingBufferMemory);
+  cleanup_swap_chain(app);
 
-  vkDestroyDescriptorSetLayout(app->logical_device, app->descriptor_set_layout, NULL);
+  destroy_layer_composites(app);
+  free(app->layers);
+  free(app->transform_layers);
+  destroy_textures(app);
 
-  for (size_t i = 0; i < app->number_of_images; i++) {
-    vkDestroyBuffer(app->logical_device, app->uniform_buffers[i], NULL);
-    vkFreeMemory(app->logical_device, app->uniform_buffers_memory[i], NULL);
+  if (app->vertex_buffer.stagingBufferMemory != VK_NULL_HANDLE) {
+    vkUnmapMemory(app->logical_device, app->vertex_buffer.stagingBufferMemory);
+  }
+  if (app->index_buffer.stagingBufferMemory != VK_NULL_HANDLE) {
+    vkUnmapMemory(app->logical_device, app->index_buffer.stagingBufferMemory);
   }
 
-  vkDestroyBuffer(app->logical_device, app->vertex_buffer.stagingBuffer, NULL);
-  vkFreeMemory(app->logical_device, app->vertex_buffer.stagingBufferMemory, NULL);
+  vkDestroyDescriptorSetLayout(app->logical_device, app->descriptor_set_layout, &app->host_allocator);
 
-  vkDestroyBuffer(app->logical_device, app->index_buffer.stagingBuffer, NULL);
-  vkFreeMemory(app->logical_device, app->index_buffer.stagingBufferMemory, NULL);
+  vkDestroyBuffer(app->logical_device, app->vertex_buffer.stagingBuffer, &app->host_allocator);
+  free_memory(app, app->vertex_buffer.stagingBufferMemory);
 
-  vkDestroyBuffer(app->logical_device, app->index_buffer.buffer, NULL);
-  vkFreeMemory(app->logical_device, app->index_buffer.bufferMemory, NULL);
+  vkDestroyBuffer(app->logical_device, app->index_buffer.stagingBuffer, &app->host_allocator);
+  free_memory(app, app->index_buffer.stagingBufferMemory);
 
-  vkDestroyBuffer(app->logical_device, app->vertex_buffer.buffer, NULL);
-  vkFreeMemory(app->logical_device, app->vertex_buffer.bufferMemory, NULL);
+  vkDestroyBuffer(app->logical_device, app->index_buffer.buffer, &app->host_allocator);
+  free_memory(app, app->index_buffer.bufferMemory);
+
+  vkDestroyBuffer(app->logical_device, app->vertex_buffer.buffer, &app->host_allocator);
+  free_memory(app, app->vertex_buffer.bufferMemory);
+
+  if (app->shape_buffer.buffer != VK_NULL_HANDLE) {
+    destroy_buffer(app, &app->shape_buffer);
+  }
+  destroy_buffer(app, &app->animation_head_buffer);
+  destroy_buffer(app, &app->animation_track_buffer);
+  destroy_buffer(app, &app->transform_buffer);
+
+  destroy_indirect_buffer(app);
+  destroy_cull_buffers(app);
+  if (app->gpu_culling) {
+    vkDestroyPipeline(app->logical_device, app->cull_pipeline, &app->host_allocator);
+    vkDestroyPipelineLayout(app->logical_device, app->cull_pipeline_layout, &app->host_allocator);
+    vkDestroyDescriptorSetLayout(app->logical_device, app->cull_descriptor_set_layout, &app->host_allocator);
+  }
 
   for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-    vkDestroySemaphore(app->logical_device, app->render_finished_semaphores[i], NULL);
-    vkDestroySemaphore(app->logical_device, app->image_available_semaphores[i], NULL);
-    vkDestroyFence(app->logical_device, app->in_flight_fences[i], NULL);
-  }
-  vkDestroyCommandPool(app->logical_device, app->command_pool, NULL);
-  vkDestroyShaderModule(app->logical_device, app->vert_shader_module, NULL);
-  vkDestroyShaderModule(app->logical_device, app->frag_shader_module, NULL);
-  vkDestroyDevice(app->logical_device, NULL);
-  vkDestroySurfaceKHR(app->instance, app->surface, NULL);
-  vkDestroyInstance(app->instance, NULL);
+    vkDestroySemaphore(app->logical_device, app->render_finished_semaphores[i], &app->host_allocator);
+    vkDestroySemaphore(app->logical_device, app->image_available_semaphores[i], &app->host_allocator);
+    vkDestroyFence(app->logical_device, app->in_flight_fences[i], &app->host_allocator);
+  }
+  vkDestroyCommandPool(app->logical_device, app->command_pool, &app->host_allocator);
+  vkDestroySurfaceKHR(app->instance, app->surface, &app->host_allocator);
   strs_window_free(app->window);
 
   free(app->image_available_semaphores);
   free(app->render_finished_semaphores);
   free(app->in_flight_fences);
   free(app->images_in_flight);
+  free(app->frame_input_ns);
+
+  free(app->vertices);
+  free(app->indices);
+  free(app->shapes);
+  free(app->animation_tracks);
+  free(app->animation_heads);
+  free(app->transform_nodes);
+  free(app->transform_worlds);
+  free(app->transform_dirty);
+  for (uint64_t i = 0; i < app->widget_pool_count; i++) {
+    widget_pool *pool = &app->widget_pools[i];
+    if (pool->info.release != NULL) {
+      pool->info.release(pool->info.user_data);
+    }
+    free(pool->name);
+    free(pool->rects);
+    free(pool->colors);
+    free(pool->flags);
+    free(pool->data);
+    free(pool->entry_slots);
+    free(pool->slot_entries);
+    free(pool->slot_generations);
+  }
+  free(app->widget_pools);
+  release_snapshot(app->pending_snapshot);
+  release_snapshot(app->drawn_snapshot);
+  for (uint32_t i = 0; i < SCENE_STREAM_COUNT; i++) {
+    release_stream(&app->published_streams[i]);
+    free(app->scene_copies[i]);
+  }
+  strs_arena_free(&app->publish_arena);
+  free(app->draw_commands);
+  free(app->draw_items);
+  free(app->clip_regions);
+  free(app->clip_stack);
+  free(app->draw_batches);
+  free(app->scissor_runs);
+  free(app->cull_records);
+  free(app->memory_allocations);
+  for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+    strs_arena_free(&app->frame_arenas[i]);
+  }
+  free(app->frame_arenas);
+  strs_arena_free(&app->swap_chain_arena);
 
-  free(app->uniform_buffers);
-  free(app->uniform_buffers_memory);
-
-  free(app->descriptor_sets);
+  pthread_mutex_destroy(&app->latency_lock);
+  pthread_cond_destroy(&app->latency_cond);
+  pthread_mutex_destroy(&app->present_lock);
+  pthread_mutex_destroy(&app->task_lock);
+  strs_pool_free(&app->texture_upload_pool);
+  pthread_mutex_destroy(&app->texture_lock);
 
   free(app);
   app = NULL;
+  if (context->implicit) {
+    strs_context_free((strs_context)context);
+  }
 }
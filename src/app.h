@@ -3,6 +3,7 @@
 
 // LIB
 #include "steros.h"
+#include "jobs.h"
 #include "windowing/window.h"
 
 // Vulkan
@@ -12,6 +13,7 @@
 
 // STD
 #include <stdbool.h>
+#include <stddef.h>
 
 // NTD
 #define STRS_IMPL_STR
@@ -24,14 +26,396 @@ typedef struct {
   vec3 color;
 } strs_vertex;
 
+// Compact positions are signed fixed point with this many fractional bits,
+// which covers +-4096 units at 1/8 sub pixel precision
+#define STRS_VERTEX_COMPACT_SUBPIXEL_BITS 3
+#define STRS_VERTEX_COMPACT_SCALE ((float) (1 << STRS_VERTEX_COMPACT_SUBPIXEL_BITS))
+
+typedef struct {
+  int16_t pos[2];
+  uint8_t color[4];
+} strs_vertex_compact;
+
+typedef struct {
+  int16_t pos[2];
+  uint8_t color[4];
+  uint16_t uv[2];
+} strs_vertex_compact_uv;
+
+typedef struct {
+  float x;
+  float y;
+  float width;
+  float height;
+} strs_rect;
+
+#define STRS_RECT_VERTEX_COUNT 4
+#define STRS_RECT_INDEX_COUNT 6
+
+// 0 is no texture
+typedef uint32_t strs_texture;
+#define STRS_TEXTURE_NONE 0
+// Textures alive at once
+#define STRS_TEXTURE_CAPACITY 4096
+
+// A rounded rect with an optional border and drop shadow, drawn as one quad whose
+// coverage is computed from a signed distance field. Colors are straight alpha RGBA.
+typedef struct {
+  float x;
+  float y;
+  float width;
+  float height;
+  float fill_color[4];
+  float border_color[4];
+  float shadow_color[4];
+  float shadow_offset[2];
+  // Clamped to half the shorter side
+  float corner_radius;
+  // Drawn inside the shape, 0 for none
+  float border_width;
+  float shadow_blur;
+  // strs_transform node the shape is placed in, 0 is the root
+  uint32_t transform;
+  // Multiplies the fill color, white until it is ready
+  strs_texture texture;
+  // Part of the texture stretched over the shape, u0, v0, u1, v1. All 0 is the whole texture.
+  float uv[4];
+} strs_shape;
+
+typedef enum {
+  STRS_EASING_LINEAR,
+  STRS_EASING_EASE_IN,
+  STRS_EASING_EASE_OUT,
+  STRS_EASING_EASE_IN_OUT,
+  // Holds the value until the next keyframe
+  STRS_EASING_STEP
+} strs_easing;
+
+typedef enum {
+  // x, y are added to the shape position
+  STRS_ANIMATION_OFFSET,
+  // x, y replace width and height, the shape keeps its center
+  STRS_ANIMATION_SIZE,
+  STRS_ANIMATION_FILL_COLOR,
+  STRS_ANIMATION_BORDER_COLOR,
+  // x replaces the corner radius
+  STRS_ANIMATION_CORNER_RADIUS,
+  // x multiplies the alpha of every color of the shape
+  STRS_ANIMATION_OPACITY
+} strs_animation_property;
+
+#define STRS_ANIMATION_MAX_KEYFRAMES 8
+
+typedef struct {
+  // Seconds since the animation started, increasing
+  float time;
+  float value[4];
+  // Curve towards the next keyframe
+  strs_easing easing;
+} strs_keyframe;
+
+typedef struct {
+  // Index returned by strs_push_shapes
+  uint32_t shape;
+  strs_animation_property property;
+  const strs_keyframe *keyframes;
+  // At most STRS_ANIMATION_MAX_KEYFRAMES
+  uint32_t keyframe_count;
+  // Wraps around at the last keyframe, otherwise the last value is held
+  bool loop;
+  // Seconds between strs_animation_start and the first keyframe
+  float delay;
+} strs_animation_info;
+
+typedef uint32_t strs_animation;
+#define STRS_ANIMATION_NONE UINT32_MAX
+
+// A node of the transform hierarchy. Every node holds a 2x3 affine relative to its parent,
+// {xx, yx, xy, yy, x0, y0} maps (x, y) to (xx * x + xy * y + x0, yx * x + yy * y + y0).
+typedef uint32_t strs_transform;
+#define STRS_TRANSFORM_ROOT 0
+#define STRS_TRANSFORM_NONE UINT32_MAX
+
+typedef enum {
+  // strs_vertex, 20 bytes
+  STRS_VERTEX_FORMAT_DEFAULT,
+  // strs_vertex_compact, 8 bytes
+  STRS_VERTEX_FORMAT_COMPACT,
+  // strs_vertex_compact_uv, 12 bytes
+  STRS_VERTEX_FORMAT_COMPACT_UV
+} strs_vertex_format;
+
+typedef enum {
+  // 16 bit while every index fits, then 32 bit if the device can address them,
+  // otherwise 16 bit batches with base vertex offsets
+  STRS_INDEX_WIDTH_AUTO,
+  // Always 16 bit, larger scenes are split into batches. Only a triangle whose corners are more than 16 bits
+  // of vertices apart switches the scene to 32 bit.
+  STRS_INDEX_WIDTH_16,
+  STRS_INDEX_WIDTH_32
+} strs_index_width;
+
+// Owns the instance, the device and its queues, the shader modules and the pipeline cache.
+// Windows created in the same context share them, each keeps its own surface, swap chain and geometry.
+typedef struct {
+	uint32_t not_used;
+} *strs_context;
+
+// Log the calls of an app are written to, see capture.h
+typedef struct {
+  uint32_t not_used;
+} *strs_capture;
+
+// Same values as VkPhysicalDeviceType
+typedef enum {
+  STRS_DEVICE_TYPE_OTHER,
+  STRS_DEVICE_TYPE_INTEGRATED,
+  STRS_DEVICE_TYPE_DISCRETE,
+  STRS_DEVICE_TYPE_VIRTUAL,
+  STRS_DEVICE_TYPE_CPU
+} strs_device_type;
+
+// The GPU a context picked and what it supports, the fast paths are only used where it does
+typedef struct {
+  char name[256];
+  uint32_t vendor_id;
+  uint32_t device_id;
+  strs_device_type type;
+  uint32_t api_version;
+  uint64_t device_local_bytes;
+  // The device with the highest score is picked unless one was asked for
+  uint64_t score;
+  bool dedicated_transfer_queue;
+  bool multi_draw_indirect;
+  bool draw_indirect_count;
+  bool draw_indirect_first_instance;
+  bool present_wait;
+  bool memory_budget;
+  bool incremental_present;
+  bool timeline_semaphore;
+  bool descriptor_indexing;
+  bool texture_compression_bc;
+} strs_device_capabilities;
+
+typedef struct {
+  strs_vertex_format vertex_format;
+  strs_index_width index_width;
+  // Test every widget's bounds against the cull viewport in a compute pass
+  // and only draw the ones that are visible
+  bool gpu_culling;
+  // NULL gives the app a context of its own, freed with it
+  strs_context context;
+  // Index or part of the name of the GPU to use instead of the best scoring one.
+  // STRS_DEVICE in the environment takes precedence, both only matter for the first window of a context.
+  const char *device;
+  // The render thread only draws what strs_app_publish hands it, so a scene built over several calls is never
+  // shown half done. Input dispatch and the widget passes then run in strs_app_publish.
+  bool manual_publish;
+  // Directory decoded JPEG and PNG textures are kept in so later launches skip decoding them, created if
+  // missing. NULL always decodes.
+  const char *texture_cache;
+  // Children of the root that draw the same for this many frames are cached like layers until something in
+  // them changes, 0 never caches them
+  uint32_t layer_promote_frames;
+  // Every call that builds the scene is logged into it with its time, to be replayed later. NULL logs nothing.
+  strs_capture capture;
+} strs_app_options;
+
+typedef enum {
+  STRS_TEXTURE_LOADING,
+  STRS_TEXTURE_READY,
+  STRS_TEXTURE_FAILED
+} strs_texture_state;
+
+typedef struct {
+  strs_texture_state state;
+  uint32_t width;
+  uint32_t height;
+  uint32_t mip_levels;
+  VkFormat format;
+  // BC1 to BC7, uploaded as they were stored
+  bool compressed;
+  // Read from the texture cache instead of decoding the source
+  bool cached;
+  // Device memory of the image with all its mips
+  uint64_t bytes;
+} strs_texture_info;
+
+typedef struct {
+  uint64_t total_draws;
+  // Read back from the GPU, lags a frame or two behind
+  uint64_t visible_draws;
+} strs_cull_stats;
+
+typedef struct {
+  // Layers composited from their image
+  uint64_t layer_count;
+  // Frames a layer was composited without drawing its subtree, and times it was drawn into its image
+  uint64_t hits;
+  uint64_t misses;
+  // Device memory of the layer images
+  uint64_t bytes;
+} strs_layer_stats;
+
+typedef struct {
+  // Of the command buffers recorded last
+  uint64_t batches;
+  uint64_t scissor_changes;
+  // Runs of batches drawn with a rounded or transformed mask
+  uint64_t masked_runs;
+  // Batches moved ahead of earlier ones to share their scissor
+  uint64_t reordered;
+  // Batches whose clip is empty, they are not drawn at all
+  uint64_t clipped;
+} strs_clip_stats;
+
+// Input to present latency over the last STRS_LATENCY_SAMPLE_COUNT frames that showed new input
+#define STRS_LATENCY_SAMPLE_COUNT 1024
+
+typedef struct {
+  uint64_t samples;
+  uint64_t p50_ns;
+  uint64_t p90_ns;
+  uint64_t p99_ns;
+  uint64_t max_ns;
+  // Measured up to the present reported by VK_KHR_present_wait,
+  // otherwise only up to the end of the GPU work of the frame
+  bool present_wait;
+  // Events strs_app_push_input could not fit into the ring since the app was created
+  uint64_t dropped_input;
+} strs_latency_stats;
+
+typedef struct {
+  uint64_t published;
+  // Replaced by a newer snapshot before the render thread took them
+  uint64_t dropped;
+  uint64_t taken;
+  // From strs_app_publish to the start of the frame that took the snapshot
+  uint64_t last_latency_ns;
+  uint64_t max_latency_ns;
+  // Copied by strs_app_publish, or shared with the snapshot before because nothing changed them
+  uint64_t copied_bytes;
+  uint64_t shared_bytes;
+} strs_snapshot_stats;
+
+// Called right before a frame is submitted, writes the current pointer position
+typedef void (*PFN_strs_sample_pointer)(float *x, float *y, void *user_data);
+
+// Events pushed from any thread wait here until the render thread dispatches them, once per frame
+#define STRS_INPUT_RING_SIZE 1024
+
+typedef enum {
+  STRS_INPUT_POINTER_MOVE,
+  STRS_INPUT_POINTER_DOWN,
+  STRS_INPUT_POINTER_UP,
+  STRS_INPUT_SCROLL,
+  STRS_INPUT_KEY_DOWN,
+  STRS_INPUT_KEY_UP
+} strs_input_type;
+
+typedef struct {
+  strs_input_type type;
+  // From strs_clock_now_ns. For coalesced events the time of the latest one.
+  uint64_t timestamp_ns;
+  // Pointer position, or the scroll delta
+  float x;
+  float y;
+  // Button or key
+  uint32_t code;
+  // How many pushed events this one stands for, consecutive moves and scrolls of a frame are merged
+  uint32_t coalesced;
+} strs_input_event;
+
+typedef enum {
+  // Vertex, index, shape, animation and transform buffers, indirect and culling buffers
+  STRS_MEMORY_GEOMETRY,
+  // Host visible copies the geometry is uploaded from, reclaimable
+  STRS_MEMORY_STAGING,
+  STRS_MEMORY_TEXTURES,
+  STRS_MEMORY_UNIFORMS,
+  // Owned by the driver, estimated from the extent and the image count
+  STRS_MEMORY_SWAPCHAIN,
+  STRS_MEMORY_CATEGORY_COUNT
+} strs_memory_category;
+
+typedef struct {
+  uint64_t category_bytes[STRS_MEMORY_CATEGORY_COUNT];
+  uint64_t total_bytes;
+  uint64_t allocation_count;
+  // Zero when unlimited
+  uint64_t budget_bytes;
+  // Reclaimed since the app was created
+  uint64_t evicted_bytes;
+  // Device local heaps as reported by VK_EXT_memory_budget, for every process on the GPU
+  bool device_budget;
+  uint64_t device_budget_bytes;
+  uint64_t device_usage_bytes;
+  bool pressure;
+  // Host memory the driver allocated through the context's VkAllocationCallbacks, for every window of the context.
+  // calls counts every allocation made.
+  uint64_t driver_host_bytes;
+  uint64_t driver_host_allocations;
+  uint64_t driver_host_allocation_calls;
+  // Most transient memory one frame used
+  uint64_t frame_arena_peak_bytes;
+} strs_memory_stats;
+
 typedef struct {
 	uint32_t not_used;
 } *strs_app;
 
-typedef void (*PFN_strs_create_widget)(strs_app *app, void *pointer);
-typedef void (*PFN_strs_update_widget)(strs_app *app, void *pointer);
-typedef void (*PFN_strs_while_selected)(strs_app *app, void *pointer);
-typedef void (*PFN_strs_on_action)(strs_app *app, void *pointer);
+// Called on the render thread when the app goes over its budget, after the reclaimable caches were evicted
+typedef void (*PFN_strs_memory_pressure)(strs_app app, const strs_memory_stats *stats, void *user_data);
+
+// Called on the render thread once per event after coalescing
+typedef void (*PFN_strs_input_handler)(strs_app app, const strs_input_event *event, void *user_data);
+// Called on the render thread once per frame before the handler, with every event as it was pushed
+typedef void (*PFN_strs_input_history)(strs_app app, const strs_input_event *events, uint32_t count,
+                                       void *user_data);
+
+// Runs on a worker of the context's scheduler, what it returns is handed to the completion
+typedef void *(*PFN_strs_app_task)(void *data);
+// Called on the thread that builds the scene, right after the input was dispatched
+typedef void (*PFN_strs_app_complete)(strs_app app, void *result, void *user_data);
+
+typedef void (*PFN_strs_create_widget)(strs_app app, void *pointer);
+typedef void (*PFN_strs_update_widget)(strs_app app, void *pointer);
+typedef void (*PFN_strs_while_selected)(strs_app app, void *pointer);
+typedef void (*PFN_strs_on_action)(strs_app app, void *pointer);
+
+typedef enum {
+  STRS_STARTUP_STAGE_WINDOW,
+  STRS_STARTUP_STAGE_INSTANCE,
+  STRS_STARTUP_STAGE_SURFACE,
+  STRS_STARTUP_STAGE_PHYSICAL_DEVICE,
+  STRS_STARTUP_STAGE_LOGICAL_DEVICE,
+  STRS_STARTUP_STAGE_SHADER_LOAD,
+  STRS_STARTUP_STAGE_SWAP_CHAIN,
+  STRS_STARTUP_STAGE_IMAGE_VIEWS,
+  STRS_STARTUP_STAGE_RENDER_PASS,
+  STRS_STARTUP_STAGE_SHADER_MODULES,
+  STRS_STARTUP_STAGE_DESCRIPTOR_SET_LAYOUT,
+  STRS_STARTUP_STAGE_COMMAND_POOL,
+  STRS_STARTUP_STAGE_GRAPHICS_PIPELINE,
+  STRS_STARTUP_STAGE_FRAME_BUFFERS,
+  STRS_STARTUP_STAGE_UNIFORM_BUFFERS,
+  STRS_STARTUP_STAGE_DESCRIPTOR_POOL,
+  STRS_STARTUP_STAGE_DESCRIPTOR_SETS,
+  STRS_STARTUP_STAGE_SYNC_OBJECTS,
+  STRS_STARTUP_STAGE_COMMAND_BUFFERS,
+  // Deferred until the first frame that has geometry to upload
+  STRS_STARTUP_STAGE_GEOMETRY_BUFFERS,
+  STRS_STARTUP_STAGE_COUNT
+} strs_startup_stage;
+
+// All times are in nanoseconds. Stages that ran on a worker thread overlap
+// with others, so their sum can be larger than create_ns.
+typedef struct {
+  uint64_t stage_ns[STRS_STARTUP_STAGE_COUNT];
+  uint64_t create_ns;
+  // From the start of strs_app_create to the first successful present, 0 until then
+  uint64_t first_frame_ns;
+} strs_startup_timings;
 
 struct strs_widget{
   void *pointer;
@@ -41,8 +425,52 @@ struct strs_widget{
   PFN_strs_on_action on_action;
 };
 
+// Pooled widgets. Every type keeps its widgets in parallel arrays, so its passes run once per frame
+// over contiguous memory instead of once per widget. Handles stay valid until the widget is destroyed.
+typedef uint64_t strs_widget_handle;
+#define STRS_WIDGET_NONE 0
+#define STRS_WIDGET_TYPE_NONE UINT32_MAX
+
+// Flags below STRS_WIDGET_USER_FLAGS are the app's, the rest are left to the type
+#define STRS_WIDGET_HIDDEN 1u
+// The geometry pass has to write the widget again, set by the app when the rect or the color changed
+#define STRS_WIDGET_DIRTY 2u
+#define STRS_WIDGET_USER_FLAGS 0x10000u
+
+// Every widget of a type, the arrays have count entries and may move when widgets are created
+typedef struct {
+  uint32_t type;
+  uint32_t count;
+  strs_rect *rects;
+  vec3 *colors;
+  uint32_t *flags;
+  // data_size bytes per widget
+  void *data;
+} strs_widget_batch;
+
+typedef void (*PFN_strs_widget_pass)(strs_app app, strs_widget_batch *batch, void *user_data);
+typedef void (*PFN_strs_widget_release)(void *user_data);
+
+typedef struct {
+  // Registering the same name again returns the existing type
+  const char *name;
+  size_t data_size;
+  // Each may be NULL. Update and style run every frame, update for all types first.
+  PFN_strs_widget_pass update;
+  PFN_strs_widget_pass style;
+  // Only runs in frames where a widget of the type is STRS_WIDGET_DIRTY, the flag is cleared afterwards
+  PFN_strs_widget_pass geometry;
+  // Gets a batch of the one widget that is about to be removed
+  PFN_strs_widget_pass destroy;
+  void *user_data;
+  // May be NULL, called by strs_app_free to free the user_data
+  PFN_strs_widget_release release;
+} strs_widget_type_info;
+
 STRS_LIB int strs_init();
 STRS_LIB strs_app strs_app_create(int width, int height, strs_string *title);
+// options may be NULL, in which case the defaults are used
+STRS_LIB strs_app strs_app_create_ex(int width, int height, strs_string *title, const strs_app_options *options);
 #ifndef STRS_NOT_MULTI_THREADED
 STRS_LIB void strs_app_run(strs_app app);
 #else
@@ -50,15 +478,188 @@ typedef void (*PFN_strsExecAsync)();
 STRS_LIB void strsAppRun(strs_app *app, PFN_strsExecAsync strsExecAsync);
 #endif
 STRS_LIB void strs_app_add(strs_app app, strs_widget *widget);
+// Stops drawing the app as if its window had been closed, so strs_app_free returns. From any thread.
+STRS_LIB void strs_app_close(strs_app app);
 STRS_LIB void strs_app_free(strs_app app);
+
+// Apps are created in a context from one thread at a time. The device is created with the first window.
+STRS_LIB strs_context strs_context_create(void);
+// Draws every window of the context that was not started with strs_app_run on a single thread, returns right away.
+// strs_app_free then waits for the window to be closed, the same as with strs_app_run.
+STRS_LIB void strs_context_run(strs_context context);
+// Only once every app of the context was freed
+STRS_LIB void strs_context_free(strs_context context);
 STRS_LIB void strs_terminate();
 
-STRS_LIB void strs_push_vertices(strs_app app, const strs_vertex *vertices, uint64_t count);
+STRS_LIB void strs_app_get_startup_timings(strs_app app, strs_startup_timings *timings);
+STRS_LIB void strs_app_get_device_capabilities(strs_app app, strs_device_capabilities *capabilities);
+
+// The viewport is in the space the transform nodes map to, by default nothing is culled
+STRS_LIB void strs_app_set_cull_viewport(strs_app app, float x, float y, float width, float height);
+STRS_LIB void strs_app_get_cull_stats(strs_app app, strs_cull_stats *stats);
+STRS_LIB void strs_app_get_layer_stats(strs_app app, strs_layer_stats *stats);
+STRS_LIB void strs_app_get_clip_stats(strs_app app, strs_clip_stats *stats);
+
+// Lock free, from any thread. A timestamp_ns of 0 stamps the event on arrival.
+// Returns false when the ring is full and the event was dropped.
+STRS_LIB bool strs_app_push_input(strs_app app, const strs_input_event *event);
+// Either may be NULL. The history is only kept for the frame, so tools that need every sample copy it out.
+STRS_LIB void strs_app_set_input_handler(strs_app app, PFN_strs_input_handler handler,
+                                         PFN_strs_input_history history, void *user_data);
+// Pushes a pointer move, see strs_app_push_input. Every frame measures the oldest event it is the first to show.
+STRS_LIB void strs_app_push_pointer(strs_app app, float x, float y, uint64_t timestamp_ns);
+STRS_LIB void strs_app_get_latency_stats(strs_app app, strs_latency_stats *stats);
+STRS_LIB void strs_app_reset_latency_stats(strs_app app);
+// Late latching, the pointer is sampled right before submit instead of when events are polled.
+// NULL goes back to the last pushed position.
+STRS_LIB void strs_app_set_late_latch(strs_app app, PFN_strs_sample_pointer sample, void *user_data);
+STRS_LIB const char *strs_startup_stage_name(strs_startup_stage stage);
+
+STRS_LIB void strs_app_get_memory_stats(strs_app app, strs_memory_stats *stats);
+// Scratch memory that stays valid until the same frame slot comes around again, it is never freed
+// individually. Only from the thread that draws, e.g. in widget callbacks. With manual_publish it comes
+// from the thread calling strs_app_publish instead and lasts until the next publish.
+STRS_LIB void *strs_app_frame_alloc(strs_app app, size_t size);
+// The app is under pressure while its own allocations exceed budget_bytes, or the device local heaps exceed
+// the budget VK_EXT_memory_budget reports. 0 only keeps the device budget. callback may be NULL.
+STRS_LIB void strs_app_set_memory_budget(strs_app app, uint64_t budget_bytes,
+                                         PFN_strs_memory_pressure callback, void *user_data);
+
+// Only with strs_app_options.manual_publish, otherwise every frame draws the scene as it is. Hands the render
+// thread an immutable copy of the scene, it keeps drawing the last one until it takes the next. From the one
+// thread that builds the scene. Animations and transform nodes still apply right away.
+STRS_LIB void strs_app_publish(strs_app app);
+STRS_LIB void strs_app_get_snapshot_stats(strs_app app, strs_snapshot_stats *stats);
+
+// KTX2 files holding BC1 to BC7 or RGBA8 data are uploaded as they are, with the mips they carry. Anything
+// stb_image reads is decoded, through the texture cache, and gets its mips blitted on the GPU. Both happen
+// on the job system, the texture is ready a few frames later.
+// Without descriptor indexing textures share an sRGB atlas without mips, BC and UNORM textures fail there.
+STRS_LIB strs_texture strs_texture_load(strs_app app, const char *path);
+// rgba is copied, width * height pixels
+STRS_LIB strs_texture strs_texture_create(strs_app app, uint32_t width, uint32_t height, const uint8_t *rgba,
+                                          bool mipmaps);
+STRS_LIB void strs_texture_free(strs_app app, strs_texture texture);
+STRS_LIB void strs_texture_get_info(strs_app app, strs_texture texture, strs_texture_info *info);
+// With STRS_VERTEX_FORMAT_COMPACT_UV the vertex colors are multiplied by this texture at the vertex UVs, 0 is
+// white. Any thread, layers that are cached keep the texture they were drawn with until they are drawn again.
+STRS_LIB void strs_set_vertex_texture(strs_app app, strs_texture texture);
+
+// Every window of a context shares one scheduler, its workers also do the library's own background work
+STRS_LIB strs_jobs strs_app_jobs(strs_app app);
+// task starts once the dependencies finished, complete may be NULL. Completions that are still due
+// when the app is freed are called by strs_app_free.
+STRS_LIB strs_job strs_app_spawn(strs_app app, PFN_strs_app_task task, void *data,
+                                 const strs_job *dependencies, uint32_t dependency_count,
+                                 PFN_strs_app_complete complete, void *user_data);
+
+// Indices are absolute, the push functions return the index of the first vertex they stored
+STRS_LIB uint32_t strs_push_vertices(strs_app app, const strs_vertex *vertices, uint64_t count);
 STRS_LIB void strs_pop_back_vertices(strs_app app, uint64_t count);
 STRS_LIB void strs_pop_front_vertices(strs_app app, uint64_t count);
 STRS_LIB void strs_erase_vertices(strs_app app, uint64_t index);
+// Vertices in a format other than the app's are converted while they are stored
+STRS_LIB uint32_t strs_push_vertices_compact(strs_app app, const strs_vertex_compact *vertices, uint64_t count);
+STRS_LIB uint32_t strs_push_vertices_compact_uv(strs_app app, const strs_vertex_compact_uv *vertices, uint64_t count);
+
+STRS_LIB size_t strs_vertex_format_size(strs_vertex_format format);
+STRS_LIB void strs_vertex_to_compact(const strs_vertex *src, strs_vertex_compact *dst, uint64_t count);
+STRS_LIB void strs_vertex_to_compact_uv(const strs_vertex *src, strs_vertex_compact_uv *dst, uint64_t count);
+STRS_LIB void strs_vertex_from_compact(const strs_vertex_compact *src, strs_vertex *dst, uint64_t count);
+// Converts count vertices between any two formats, UVs missing in the source become 0
+STRS_LIB void strs_vertex_convert(strs_vertex_format src_format, const void *src,
+                                  strs_vertex_format dst_format, void *dst, uint64_t count);
 
 STRS_LIB void strs_push_indices(strs_app app, const uint16_t *indices, uint64_t count);
+STRS_LIB void strs_push_indices32(strs_app app, const uint32_t *indices, uint64_t count);
+
+// Appends count rects in one call, colors may be NULL. Returns the first vertex of the batch,
+// every rect takes STRS_RECT_VERTEX_COUNT vertices and STRS_RECT_INDEX_COUNT indices.
+// The bulk path for many plain rects: the streams grow once, the SIMD kernels fill them and the rects share
+// draw items, where strs_app_add makes one per widget.
+STRS_LIB uint32_t strs_push_rects(strs_app app, const strs_rect *rects, const vec3 *colors, uint64_t count);
+
+// Shapes are drawn under the vertex geometry in the order they were pushed,
+// returns the index of the first shape stored
+STRS_LIB uint32_t strs_push_shapes(strs_app app, const strs_shape *shapes, uint64_t count);
+STRS_LIB void strs_write_shapes(strs_app app, uint64_t first, const strs_shape *shapes, uint64_t count);
+STRS_LIB void strs_pop_back_shapes(strs_app app, uint64_t count);
+STRS_LIB uint64_t strs_app_shape_count(strs_app app);
+
+// Animations are evaluated by the GPU from the frame time, the CPU only uploads them when they
+// start or stop. Stopping returns the property to the value stored in the shape.
+STRS_LIB strs_animation strs_animation_start(strs_app app, const strs_animation_info *info);
+STRS_LIB void strs_animation_stop(strs_app app, strs_animation animation);
+// Seconds since the app was created, the clock animations run on
+STRS_LIB double strs_app_time(strs_app app);
+
+// Nodes start out as the identity. Changing a node only uploads the world transforms of its
+// subtree, the vertices placed in it are never touched.
+STRS_LIB strs_transform strs_transform_create(strs_app app, strs_transform parent);
+// The children of the node move to its parent, nothing may be placed in the node afterwards
+STRS_LIB void strs_transform_destroy(strs_app app, strs_transform transform);
+STRS_LIB void strs_transform_set(strs_app app, strs_transform transform, const float affine[6]);
+// Shorthand for panning and zooming, {scale, 0, 0, scale, x, y}
+STRS_LIB void strs_transform_set_translate_scale(strs_app app, strs_transform transform,
+                                                 float x, float y, float scale);
+STRS_LIB void strs_transform_get(strs_app app, strs_transform transform, float affine[6]);
+// The node and its subtree are moved by the pointer position latched for the frame, for drags
+// that have to stay under the cursor. The local transform is then the offset from the pointer.
+STRS_LIB void strs_transform_follow_pointer(strs_app app, strs_transform transform, bool follow);
+// The subtree is drawn into an image of its own, only again when something in it changes, and frames
+// composite the image as one textured quad under the geometry that is drawn directly. bounds are in the
+// node's space, what falls outside is cut off, NULL draws the subtree directly again. Layers need descriptor
+// indexing and never hold shapes or nodes that follow the pointer, those subtrees are drawn directly.
+STRS_LIB void strs_transform_set_layer(strs_app app, strs_transform transform, const strs_rect *bounds);
+// Alpha the node's layer image is composited with, 1 by default
+STRS_LIB void strs_transform_set_opacity(strs_app app, strs_transform transform, float opacity);
+// Vertex geometry pushed after this call is placed in the node, shapes name theirs in strs_shape
+STRS_LIB void strs_app_set_transform(strs_app app, strs_transform transform);
+STRS_LIB strs_transform strs_app_get_transform(strs_app app);
+
+// Vertex geometry pushed until the matching strs_pop_clip is cut off outside rect, in framebuffer pixels.
+// Nested clips are intersected. Batches become scissors, and ones whose clips can not overlap are reordered
+// so runs of the same scissor are drawn together. Cached layers draw their subtree unclipped.
+STRS_LIB void strs_push_clip(strs_app app, const strs_rect *rect);
+// A clip with rounded corners, placed in the framebuffer by affine ({xx, yx, xy, yy, x0, y0} like the
+// transform nodes, NULL for none). The fragment shader masks it, the scissor is its bounding box. Of nested
+// masks only the innermost is applied, the others still clip to their bounds.
+STRS_LIB void strs_push_clip_mask(strs_app app, const strs_rect *rect, float radius, const float affine[6]);
+STRS_LIB void strs_pop_clip(strs_app app);
+
+// Rect kernels behind strs_push_rects, the scalar versions are the reference and the fallback
+STRS_LIB void strs_rects_fill_vertices(strs_vertex_format format, const strs_rect *rects, const vec3 *colors,
+                                       uint64_t count, void *dst);
+STRS_LIB void strs_rects_fill_vertices_scalar(strs_vertex_format format, const strs_rect *rects, const vec3 *colors,
+                                              uint64_t count, void *dst);
+STRS_LIB void strs_rects_fill_indices(uint32_t first_vertex, uint64_t count, uint32_t *dst);
+STRS_LIB void strs_rects_fill_indices_scalar(uint32_t first_vertex, uint64_t count, uint32_t *dst);
+// Writes min x, min y, max x, max y
+STRS_LIB void strs_rects_bounds(const strs_rect *rects, uint64_t count, float *bounds);
+STRS_LIB void strs_rects_bounds_scalar(const strs_rect *rects, uint64_t count, float *bounds);
+
+STRS_LIB uint32_t strs_widget_type_register(strs_app app, const strs_widget_type_info *info);
+STRS_LIB uint32_t strs_widget_type_find(strs_app app, const char *name);
+// data may be NULL, then the type's data starts zeroed
+STRS_LIB strs_widget_handle strs_widget_create(strs_app app, uint32_t type, const strs_rect *rect, const vec3 color,
+                                               const void *data);
+STRS_LIB void strs_widget_destroy(strs_app app, strs_widget_handle widget);
+STRS_LIB bool strs_widget_alive(strs_app app, strs_widget_handle widget);
+STRS_LIB void strs_widget_set_rect(strs_app app, strs_widget_handle widget, const strs_rect *rect);
+STRS_LIB void strs_widget_set_color(strs_app app, strs_widget_handle widget, const vec3 color);
+// Changing STRS_WIDGET_HIDDEN makes the widget dirty
+STRS_LIB void strs_widget_set_flags(strs_app app, strs_widget_handle widget, uint32_t flags);
+STRS_LIB uint32_t strs_widget_get_flags(strs_app app, strs_widget_handle widget);
+STRS_LIB strs_rect strs_widget_get_rect(strs_app app, strs_widget_handle widget);
+// Only valid until the next widget of the type is created or destroyed
+STRS_LIB void *strs_widget_data(strs_app app, strs_widget_handle widget);
+
+STRS_LIB uint64_t strs_app_vertex_count(strs_app app);
+STRS_LIB uint64_t strs_app_index_count(strs_app app);
+
+// Overwrite geometry that was pushed before, used by widgets that recycle their vertices
+STRS_LIB void strs_write_vertices(strs_app app, uint64_t first, const strs_vertex *vertices, uint64_t count);
+STRS_LIB void strs_write_indices32(strs_app app, uint64_t first, const uint32_t *indices, uint64_t count);
 STRS_LIB void strs_pop_back_indices(strs_app app, uint64_t count);
 STRS_LIB void strs_pop_front_indices(strs_app app, uint64_t count);
 STRS_LIB void strs_erase_indices(strs_app app, uint64_t index);
@@ -0,0 +1,706 @@
+// STD
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// LIB
+#include "capture.h"
+#include "helper/alloc.h"
+#include "helper/clock.h"
+#include "helper/scene.h"
+
+#define CAPTURE_MAGIC 0x50414353u
+#define CAPTURE_VERSION 1
+// Records pile up in memory up to this many bytes before they are written out
+#define CAPTURE_FLUSH_BYTES (1u << 20)
+// The most bytes a record can take besides its data, the call, the time, the arguments and the size
+#define CAPTURE_RECORD_HEADER (2 + 10 * (STRS_CALL_MAX_ARGS + 2))
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+} capture_header;
+
+typedef struct {
+  FILE *file;
+  pthread_mutex_t lock;
+  uint8_t *buffer;
+  uint64_t size;
+  uint64_t capacity;
+  uint64_t last_ns;
+} internal_strs_capture;
+
+// What the headless replay keeps of a transform node, linked like the app's
+typedef struct {
+  strs_tree_links links;
+  float local[6];
+  bool used;
+} replay_node;
+
+typedef struct {
+  FILE *file;
+  uint8_t *data;
+  uint64_t data_capacity;
+  uint64_t time_ns;
+  // The node every node of the log was created as by strs_replay_apply
+  strs_transform *transform_map;
+  uint64_t transform_map_capacity;
+
+  // Headless streams, vertices in the default format and the node every index was pushed in
+  strs_vertex *vertices;
+  uint64_t vertex_count;
+  uint64_t vertex_capacity;
+  uint32_t *indices;
+  strs_transform *index_transforms;
+  uint64_t index_count;
+  uint64_t index_capacity;
+  uint64_t index_transform_capacity;
+  strs_shape *shapes;
+  uint64_t shape_count;
+  uint64_t shape_capacity;
+  replay_node *nodes;
+  uint64_t node_count;
+  uint64_t node_capacity;
+  strs_transform current_transform;
+  float (*worlds)[6];
+  uint64_t world_capacity;
+  strs_soft_range *ranges;
+  uint64_t range_capacity;
+  uint32_t width;
+  uint32_t height;
+  strs_replay_stats stats;
+} internal_strs_replay;
+
+STRS_INTERN uint8_t *write_varint(uint8_t *dst, uint64_t value) {
+  while (value >= 0x80) {
+    *dst++ = (uint8_t) (value | 0x80);
+    value >>= 7;
+  }
+  *dst++ = (uint8_t) value;
+  return dst;
+}
+
+STRS_INTERN bool read_varint(FILE *file, uint64_t *value) {
+  *value = 0;
+  for (uint32_t shift = 0; shift < 64; shift += 7) {
+    int byte = getc(file);
+    if (byte == EOF) {
+      return false;
+    }
+    *value |= (uint64_t) (byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+STRS_INTERN void flush_capture(internal_strs_capture *capture) {
+  if (capture->size > 0) {
+    fwrite(capture->buffer, 1, capture->size, capture->file);
+    capture->size = 0;
+  }
+}
+
+STRS_LIB strs_capture strs_capture_create(const char *path) {
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    return NULL;
+  }
+  capture_header header = {CAPTURE_MAGIC, CAPTURE_VERSION};
+  fwrite(&header, sizeof(header), 1, file);
+
+  internal_strs_capture *capture = calloc(1, sizeof(internal_strs_capture));
+  capture->file = file;
+  capture->last_ns = strs_clock_now_ns();
+  pthread_mutex_init(&capture->lock, NULL);
+  return (strs_capture)capture;
+}
+
+STRS_LIB void strs_capture_free(strs_capture capture) {
+  internal_strs_capture *intern_capture = (internal_strs_capture*)capture;
+  flush_capture(intern_capture);
+  fclose(intern_capture->file);
+  pthread_mutex_destroy(&intern_capture->lock);
+  free(intern_capture->buffer);
+  free(intern_capture);
+}
+
+STRS_LIB void strs_capture_call(strs_capture capture, strs_call call, const uint64_t *args, uint32_t arg_count,
+                                const void *data, uint64_t size) {
+  internal_strs_capture *intern_capture = (internal_strs_capture*)capture;
+  arg_count = arg_count < STRS_CALL_MAX_ARGS ? arg_count : STRS_CALL_MAX_ARGS;
+
+  pthread_mutex_lock(&intern_capture->lock);
+  uint64_t now = strs_clock_now_ns();
+  uint64_t elapsed = now > intern_capture->last_ns ? now - intern_capture->last_ns : 0;
+  intern_capture->last_ns = now > intern_capture->last_ns ? now : intern_capture->last_ns;
+
+  intern_capture->buffer = strs_grow_array(intern_capture->buffer, &intern_capture->capacity,
+                                      intern_capture->size + CAPTURE_RECORD_HEADER + size, 1);
+  uint8_t *dst = intern_capture->buffer + intern_capture->size;
+  *dst++ = (uint8_t) call;
+  dst = write_varint(dst, elapsed);
+  *dst++ = (uint8_t) arg_count;
+  for (uint32_t i = 0; i < arg_count; i++) {
+    dst = write_varint(dst, args[i]);
+  }
+  dst = write_varint(dst, size);
+  if (size > 0) {
+    memcpy(dst, data, size);
+    dst += size;
+  }
+  intern_capture->size = dst - intern_capture->buffer;
+
+  if (intern_capture->size >= CAPTURE_FLUSH_BYTES) {
+    flush_capture(intern_capture);
+  }
+  pthread_mutex_unlock(&intern_capture->lock);
+}
+
+STRS_LIB const char *strs_call_name(strs_call call) {
+  static const char *names[STRS_CALL_COUNT] = {
+    "app_add",
+    "push_vertices",
+    "write_vertices",
+    "pop_back_vertices",
+    "pop_front_vertices",
+    "erase_vertices",
+    "push_indices",
+    "push_indices32",
+    "write_indices32",
+    "pop_back_indices",
+    "pop_front_indices",
+    "erase_indices",
+    "push_rects",
+    "push_shapes",
+    "write_shapes",
+    "pop_back_shapes",
+    "transform_create",
+    "transform_destroy",
+    "transform_set",
+    "transform_set_opacity",
+    "transform_set_layer",
+    "transform_follow_pointer",
+    "set_transform",
+    "push_clip",
+    "push_clip_mask",
+    "pop_clip",
+    "set_cull_viewport",
+    "input",
+    "resize",
+    "frame"};
+  return call < STRS_CALL_COUNT ? names[call] : "unknown";
+}
+
+STRS_LIB strs_replay strs_replay_open(const char *path) {
+  FILE *file = fopen(path, "rb");
+  if (file == NULL) {
+    return NULL;
+  }
+  capture_header header;
+  if (fread(&header, sizeof(header), 1, file) != 1 || header.magic != CAPTURE_MAGIC ||
+      header.version != CAPTURE_VERSION) {
+    fclose(file);
+    return NULL;
+  }
+
+  internal_strs_replay *replay = calloc(1, sizeof(internal_strs_replay));
+  replay->file = file;
+  replay->nodes = strs_grow_array(NULL, &replay->node_capacity, 1, sizeof(replay_node));
+  replay->nodes[STRS_TRANSFORM_ROOT] = (replay_node){
+    .links = {STRS_TRANSFORM_NONE, STRS_TRANSFORM_NONE, STRS_TRANSFORM_NONE},
+    .local = {1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f},
+    .used = true};
+  replay->node_count = 1;
+  return (strs_replay)replay;
+}
+
+STRS_LIB void strs_replay_free(strs_replay replay) {
+  internal_strs_replay *intern_replay = (internal_strs_replay*)replay;
+  fclose(intern_replay->file);
+  free(intern_replay->data);
+  free(intern_replay->transform_map);
+  free(intern_replay->vertices);
+  free(intern_replay->indices);
+  free(intern_replay->index_transforms);
+  free(intern_replay->shapes);
+  free(intern_replay->nodes);
+  free(intern_replay->worlds);
+  free(intern_replay->ranges);
+  free(intern_replay);
+}
+
+STRS_LIB bool strs_replay_next(strs_replay replay, strs_call_record *record) {
+  internal_strs_replay *intern_replay = (internal_strs_replay*)replay;
+  FILE *file = intern_replay->file;
+  int call = getc(file);
+  uint64_t elapsed;
+  if (call == EOF || call >= STRS_CALL_COUNT || !read_varint(file, &elapsed)) {
+    return false;
+  }
+  int arg_count = getc(file);
+  if (arg_count == EOF || arg_count > STRS_CALL_MAX_ARGS) {
+    return false;
+  }
+  memset(record, 0, sizeof(*record));
+  for (int i = 0; i < arg_count; i++) {
+    if (!read_varint(file, &record->args[i])) {
+      return false;
+    }
+  }
+  if (!read_varint(file, &record->size) || record->size > UINT32_MAX) {
+    return false;
+  }
+  intern_replay->data = strs_grow_array(intern_replay->data, &intern_replay->data_capacity, record->size, 1);
+  if (record->size > 0 && fread(intern_replay->data, record->size, 1, file) != 1) {
+    return false;
+  }
+
+  intern_replay->time_ns += elapsed;
+  intern_replay->stats.records++;
+  record->call = (strs_call) call;
+  record->time_ns = intern_replay->time_ns;
+  record->arg_count = (uint32_t) arg_count;
+  record->data = intern_replay->data;
+  return true;
+}
+
+// Vertices of a push record, none when the format is unknown
+STRS_INTERN uint64_t pushed_vertex_count(const strs_call_record *record) {
+  if (record->args[0] > STRS_VERTEX_FORMAT_COMPACT_UV) {
+    return 0;
+  }
+  return record->size / strs_vertex_format_size((strs_vertex_format) record->args[0]);
+}
+
+// False when the data of a record is not the size its call records, the replay would read past it otherwise
+STRS_INTERN bool record_size_valid(const strs_call_record *record) {
+  const uint64_t *args = record->args;
+  uint64_t size = record->size;
+
+  switch (record->call) {
+    case STRS_CALL_PUSH_VERTICES:
+      return args[0] <= STRS_VERTEX_FORMAT_COMPACT_UV &&
+             size % strs_vertex_format_size((strs_vertex_format) args[0]) == 0;
+    case STRS_CALL_WRITE_VERTICES:
+      return size % sizeof(strs_vertex) == 0;
+    case STRS_CALL_PUSH_INDICES:
+      return size % sizeof(uint16_t) == 0;
+    case STRS_CALL_PUSH_INDICES32:
+    case STRS_CALL_WRITE_INDICES32:
+      return size % sizeof(uint32_t) == 0;
+    case STRS_CALL_PUSH_RECTS: {
+      // The rects, then a color per rect when args[1] is set
+      uint64_t rect_size = sizeof(strs_rect) + (args[1] ? sizeof(vec3) : 0);
+      return args[0] <= size / rect_size && size == args[0] * rect_size;
+    }
+    case STRS_CALL_PUSH_SHAPES:
+    case STRS_CALL_WRITE_SHAPES:
+      return size % sizeof(strs_shape) == 0;
+    case STRS_CALL_TRANSFORM_SET:
+      return size == sizeof(float) * 6;
+    case STRS_CALL_TRANSFORM_SET_OPACITY:
+      return size == sizeof(float);
+    case STRS_CALL_TRANSFORM_SET_LAYER:
+      return size == 0 || size == sizeof(strs_rect);
+    case STRS_CALL_PUSH_CLIP:
+      return size == sizeof(strs_rect);
+    case STRS_CALL_PUSH_CLIP_MASK:
+      // The rect and the radius, then the affine if there was one
+      return size == sizeof(float) * 5 || size == sizeof(float) * 11;
+    case STRS_CALL_SET_CULL_VIEWPORT:
+      return size == sizeof(float) * 4;
+    case STRS_CALL_INPUT:
+      return size == sizeof(strs_input_event);
+    default:
+      // Every other call only has arguments
+      return size == 0;
+  }
+}
+
+STRS_INTERN strs_transform map_transform(internal_strs_replay *replay, uint64_t transform) {
+  if (transform == STRS_TRANSFORM_ROOT || transform >= replay->transform_map_capacity) {
+    return STRS_TRANSFORM_ROOT;
+  }
+  return replay->transform_map[transform];
+}
+
+STRS_INTERN void create_nothing(strs_app app, void *pointer) {
+  (void) app;
+  (void) pointer;
+}
+
+STRS_LIB void strs_replay_apply(strs_replay replay, strs_app app, const strs_call_record *record) {
+  internal_strs_replay *intern_replay = (internal_strs_replay*)replay;
+  const uint64_t *args = record->args;
+  const float *values = (const float*)record->data;
+
+  if (!record_size_valid(record)) {
+    intern_replay->stats.skipped++;
+    return;
+  }
+
+  switch (record->call) {
+    case STRS_CALL_APP_ADD: {
+      strs_widget widget = {.create_widget = create_nothing};
+      strs_app_add(app, &widget);
+      break;
+    }
+    case STRS_CALL_PUSH_VERTICES: {
+      uint64_t count = pushed_vertex_count(record);
+      if (args[0] == STRS_VERTEX_FORMAT_COMPACT) {
+        strs_push_vertices_compact(app, record->data, count);
+      } else if (args[0] == STRS_VERTEX_FORMAT_COMPACT_UV) {
+        strs_push_vertices_compact_uv(app, record->data, count);
+      } else {
+        strs_push_vertices(app, record->data, count);
+      }
+      break;
+    }
+    case STRS_CALL_WRITE_VERTICES:
+      strs_write_vertices(app, args[0], record->data, record->size / sizeof(strs_vertex));
+      break;
+    case STRS_CALL_POP_BACK_VERTICES:
+      strs_pop_back_vertices(app, args[0]);
+      break;
+    case STRS_CALL_POP_FRONT_VERTICES:
+      strs_pop_front_vertices(app, args[0]);
+      break;
+    case STRS_CALL_ERASE_VERTICES:
+      strs_erase_vertices(app, args[0]);
+      break;
+    case STRS_CALL_PUSH_INDICES:
+      strs_push_indices(app, record->data, record->size / sizeof(uint16_t));
+      break;
+    case STRS_CALL_PUSH_INDICES32:
+      strs_push_indices32(app, record->data, record->size / sizeof(uint32_t));
+      break;
+    case STRS_CALL_WRITE_INDICES32:
+      strs_write_indices32(app, args[0], record->data, record->size / sizeof(uint32_t));
+      break;
+    case STRS_CALL_POP_BACK_INDICES:
+      strs_pop_back_indices(app, args[0]);
+      break;
+    case STRS_CALL_POP_FRONT_INDICES:
+      strs_pop_front_indices(app, args[0]);
+      break;
+    case STRS_CALL_ERASE_INDICES:
+      strs_erase_indices(app, args[0]);
+      break;
+    case STRS_CALL_PUSH_RECTS: {
+      const strs_rect *rects = record->data;
+      strs_push_rects(app, rects, args[1] ? (const vec3*)(rects + args[0]) : NULL, args[0]);
+      break;
+    }
+    case STRS_CALL_PUSH_SHAPES:
+      strs_push_shapes(app, record->data, record->size / sizeof(strs_shape));
+      break;
+    case STRS_CALL_WRITE_SHAPES:
+      strs_write_shapes(app, args[0], record->data, record->size / sizeof(strs_shape));
+      break;
+    case STRS_CALL_POP_BACK_SHAPES:
+      strs_pop_back_shapes(app, args[0]);
+      break;
+    case STRS_CALL_TRANSFORM_CREATE:
+      intern_replay->transform_map = strs_grow_array(intern_replay->transform_map, &intern_replay->transform_map_capacity,
+                                                args[1] + 1, sizeof(strs_transform));
+      intern_replay->transform_map[args[1]] = strs_transform_create(app, map_transform(intern_replay, args[0]));
+      break;
+    case STRS_CALL_TRANSFORM_DESTROY:
+      strs_transform_destroy(app, map_transform(intern_replay, args[0]));
+      break;
+    case STRS_CALL_TRANSFORM_SET:
+      strs_transform_set(app, map_transform(intern_replay, args[0]), values);
+      break;
+    case STRS_CALL_TRANSFORM_SET_OPACITY:
+      strs_transform_set_opacity(app, map_transform(intern_replay, args[0]), values[0]);
+      break;
+    case STRS_CALL_TRANSFORM_SET_LAYER:
+      strs_transform_set_layer(app, map_transform(intern_replay, args[0]), record->size > 0 ? record->data : NULL);
+      break;
+    case STRS_CALL_TRANSFORM_FOLLOW_POINTER:
+      strs_transform_follow_pointer(app, map_transform(intern_replay, args[0]), args[1] != 0);
+      break;
+    case STRS_CALL_SET_TRANSFORM:
+      strs_app_set_transform(app, map_transform(intern_replay, args[0]));
+      break;
+    case STRS_CALL_PUSH_CLIP:
+      strs_push_clip(app, record->data);
+      break;
+    case STRS_CALL_PUSH_CLIP_MASK:
+      // The rect, the radius, then the affine if there was one
+      strs_push_clip_mask(app, record->data, values[4], record->size > sizeof(float) * 5 ? values + 5 : NULL);
+      break;
+    case STRS_CALL_POP_CLIP:
+      strs_pop_clip(app);
+      break;
+    case STRS_CALL_SET_CULL_VIEWPORT:
+      strs_app_set_cull_viewport(app, values[0], values[1], values[2], values[3]);
+      break;
+    case STRS_CALL_INPUT: {
+      // Stamped again when it is pushed, so the latency stats measure the replay
+      strs_input_event event = *(const strs_input_event*)record->data;
+      event.timestamp_ns = 0;
+      strs_app_push_input(app, &event);
+      break;
+    }
+    case STRS_CALL_RESIZE:
+      // The window is sized by the host, not by the app
+      break;
+    case STRS_CALL_FRAME:
+      intern_replay->stats.frames++;
+      strs_app_publish(app);
+      break;
+    default:
+      break;
+  }
+}
+
+STRS_INTERN void push_headless_indices(internal_strs_replay *replay, const uint16_t *indices16,
+                                       const uint32_t *indices32, uint64_t count) {
+  replay->indices = strs_grow_array(replay->indices, &replay->index_capacity, replay->index_count + count,
+                               sizeof(uint32_t));
+  replay->index_transforms = strs_grow_array(replay->index_transforms, &replay->index_transform_capacity,
+                                        replay->index_count + count, sizeof(strs_transform));
+  for (uint64_t i = 0; i < count; i++) {
+    replay->indices[replay->index_count + i] = indices16 != NULL ? indices16[i] : indices32[i];
+    replay->index_transforms[replay->index_count + i] = replay->current_transform;
+  }
+  replay->index_count += count;
+}
+
+// The node of every index is a stream beside the indices, edited the same way
+STRS_INTERN void erase_headless_indices(internal_strs_replay *replay, uint64_t first, uint64_t count) {
+  uint64_t transform_count = replay->index_count;
+  strs_stream_erase(replay->indices, &replay->index_count, sizeof(uint32_t), first, count);
+  strs_stream_erase(replay->index_transforms, &transform_count, sizeof(strs_transform), first, count);
+}
+
+STRS_INTERN void store_headless_vertices(internal_strs_replay *replay, strs_vertex_format format, const void *src,
+                                         uint64_t count) {
+  replay->vertices = strs_grow_array(replay->vertices, &replay->vertex_capacity, replay->vertex_count + count,
+                                sizeof(strs_vertex));
+  strs_vertex_convert(format, src, STRS_VERTEX_FORMAT_DEFAULT, replay->vertices + replay->vertex_count, count);
+  replay->vertex_count += count;
+}
+
+STRS_INTERN void create_headless_node(internal_strs_replay *replay, uint64_t parent, uint64_t transform) {
+  if (parent >= replay->node_count || !replay->nodes[parent].used ||
+      (transform < replay->node_count && replay->nodes[transform].used)) {
+    return;
+  }
+  replay->nodes = strs_grow_array(replay->nodes, &replay->node_capacity, transform + 1, sizeof(replay_node));
+  for (uint64_t i = replay->node_count; i < transform; i++) {
+    replay->nodes[i].used = false;
+  }
+  replay->node_count = transform + 1 > replay->node_count ? transform + 1 : replay->node_count;
+  replay->nodes[transform] = (replay_node){
+    .links = {.first_child = STRS_TRANSFORM_NONE},
+    .local = {1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f},
+    .used = true};
+  strs_tree_attach(replay->nodes, sizeof(replay_node), (uint32_t) transform, (uint32_t) parent);
+}
+
+STRS_INTERN void destroy_headless_node(internal_strs_replay *replay, uint64_t transform) {
+  if (transform == STRS_TRANSFORM_ROOT || transform >= replay->node_count || !replay->nodes[transform].used) {
+    return;
+  }
+  strs_tree_detach(replay->nodes, sizeof(replay_node), (uint32_t) transform);
+  replay->nodes[transform].used = false;
+  if (replay->current_transform == transform) {
+    replay->current_transform = replay->nodes[transform].links.parent;
+  }
+}
+
+STRS_LIB void strs_replay_apply_headless(strs_replay replay, const strs_call_record *record) {
+  internal_strs_replay *intern_replay = (internal_strs_replay*)replay;
+  const uint64_t *args = record->args;
+  uint64_t count = args[0];
+
+  if (!record_size_valid(record)) {
+    intern_replay->stats.skipped++;
+    return;
+  }
+
+  switch (record->call) {
+    case STRS_CALL_APP_ADD:
+      break;
+    case STRS_CALL_PUSH_VERTICES:
+      store_headless_vertices(intern_replay, (strs_vertex_format) args[0], record->data, pushed_vertex_count(record));
+      break;
+    case STRS_CALL_WRITE_VERTICES:
+      count = record->size / sizeof(strs_vertex);
+      if (args[0] + count <= intern_replay->vertex_count) {
+        memcpy(intern_replay->vertices + args[0], record->data, sizeof(strs_vertex) * count);
+      }
+      break;
+    case STRS_CALL_POP_BACK_VERTICES:
+      strs_stream_pop_back(&intern_replay->vertex_count, count);
+      break;
+    case STRS_CALL_POP_FRONT_VERTICES:
+      strs_stream_erase(intern_replay->vertices, &intern_replay->vertex_count, sizeof(strs_vertex), 0, count);
+      break;
+    case STRS_CALL_ERASE_VERTICES:
+      strs_stream_erase(intern_replay->vertices, &intern_replay->vertex_count, sizeof(strs_vertex), args[0], 1);
+      break;
+    case STRS_CALL_PUSH_INDICES:
+      push_headless_indices(intern_replay, record->data, NULL, record->size / sizeof(uint16_t));
+      break;
+    case STRS_CALL_PUSH_INDICES32:
+      push_headless_indices(intern_replay, NULL, record->data, record->size / sizeof(uint32_t));
+      break;
+    case STRS_CALL_WRITE_INDICES32:
+      count = record->size / sizeof(uint32_t);
+      if (args[0] + count <= intern_replay->index_count) {
+        memcpy(intern_replay->indices + args[0], record->data, sizeof(uint32_t) * count);
+      }
+      break;
+    case STRS_CALL_POP_BACK_INDICES:
+      strs_stream_pop_back(&intern_replay->index_count, count);
+      break;
+    case STRS_CALL_POP_FRONT_INDICES:
+      erase_headless_indices(intern_replay, 0, count);
+      break;
+    case STRS_CALL_ERASE_INDICES:
+      erase_headless_indices(intern_replay, args[0], 1);
+      break;
+    case STRS_CALL_PUSH_RECTS: {
+      const strs_rect *rects = record->data;
+      uint32_t first_vertex = (uint32_t) intern_replay->vertex_count;
+      uint64_t first_index = intern_replay->index_count;
+      intern_replay->vertices = strs_grow_array(intern_replay->vertices, &intern_replay->vertex_capacity,
+                                           intern_replay->vertex_count + count * STRS_RECT_VERTEX_COUNT,
+                                           sizeof(strs_vertex));
+      strs_rects_fill_vertices(STRS_VERTEX_FORMAT_DEFAULT, rects, args[1] ? (const vec3*)(rects + count) : NULL,
+                               count, intern_replay->vertices + first_vertex);
+      intern_replay->vertex_count += count * STRS_RECT_VERTEX_COUNT;
+      intern_replay->indices = strs_grow_array(intern_replay->indices, &intern_replay->index_capacity,
+                                          first_index + count * STRS_RECT_INDEX_COUNT, sizeof(uint32_t));
+      strs_rects_fill_indices(first_vertex, count, intern_replay->indices + first_index);
+      intern_replay->index_transforms = strs_grow_array(intern_replay->index_transforms,
+                                                   &intern_replay->index_transform_capacity,
+                                                   first_index + count * STRS_RECT_INDEX_COUNT,
+                                                   sizeof(strs_transform));
+      for (uint64_t i = first_index; i < first_index + count * STRS_RECT_INDEX_COUNT; i++) {
+        intern_replay->index_transforms[i] = intern_replay->current_transform;
+      }
+      intern_replay->index_count += count * STRS_RECT_INDEX_COUNT;
+      break;
+    }
+    case STRS_CALL_PUSH_SHAPES:
+      count = record->size / sizeof(strs_shape);
+      intern_replay->shapes = strs_grow_array(intern_replay->shapes, &intern_replay->shape_capacity,
+                                         intern_replay->shape_count + count, sizeof(strs_shape));
+      memcpy(intern_replay->shapes + intern_replay->shape_count, record->data, sizeof(strs_shape) * count);
+      intern_replay->shape_count += count;
+      break;
+    case STRS_CALL_WRITE_SHAPES:
+      count = record->size / sizeof(strs_shape);
+      if (args[0] + count <= intern_replay->shape_count) {
+        memcpy(intern_replay->shapes + args[0], record->data, sizeof(strs_shape) * count);
+      }
+      break;
+    case STRS_CALL_POP_BACK_SHAPES:
+      strs_stream_pop_back(&intern_replay->shape_count, count);
+      break;
+    case STRS_CALL_TRANSFORM_CREATE:
+      create_headless_node(intern_replay, args[0], args[1]);
+      break;
+    case STRS_CALL_TRANSFORM_DESTROY:
+      destroy_headless_node(intern_replay, args[0]);
+      break;
+    case STRS_CALL_TRANSFORM_SET:
+      if (args[0] < intern_replay->node_count) {
+        memcpy(intern_replay->nodes[args[0]].local, record->data, sizeof(float) * 6);
+      }
+      break;
+    case STRS_CALL_SET_TRANSFORM:
+      intern_replay->current_transform = args[0] < intern_replay->node_count ? (strs_transform) args[0]
+                                                                              : STRS_TRANSFORM_ROOT;
+      break;
+    case STRS_CALL_RESIZE:
+      intern_replay->width = (uint32_t) args[0];
+      intern_replay->height = (uint32_t) args[1];
+      break;
+    case STRS_CALL_FRAME:
+      intern_replay->stats.frames++;
+      break;
+    default:
+      intern_replay->stats.skipped++;
+      break;
+  }
+}
+
+// Parents before children whatever order the nodes were created in
+STRS_INTERN void compose_world(internal_strs_replay *replay, uint64_t transform, bool *done) {
+  if (done[transform]) {
+    return;
+  }
+  done[transform] = true;
+  const float *l = replay->nodes[transform].local;
+  uint32_t parent = replay->nodes[transform].links.parent;
+  if (parent == STRS_TRANSFORM_NONE || parent >= replay->node_count) {
+    memcpy(replay->worlds[transform], l, sizeof(float) * 6);
+    return;
+  }
+  compose_world(replay, parent, done);
+  const float *p = replay->worlds[parent];
+  float *w = replay->worlds[transform];
+  w[0] = p[0] * l[0] + p[2] * l[1];
+  w[1] = p[1] * l[0] + p[3] * l[1];
+  w[2] = p[0] * l[2] + p[2] * l[3];
+  w[3] = p[1] * l[2] + p[3] * l[3];
+  w[4] = p[0] * l[4] + p[2] * l[5] + p[4];
+  w[5] = p[1] * l[4] + p[3] * l[5] + p[5];
+}
+
+STRS_LIB void strs_replay_draw(strs_replay replay, strs_soft soft, const float clear_color[4]) {
+  internal_strs_replay *intern_replay = (internal_strs_replay*)replay;
+
+  intern_replay->worlds = strs_grow_array(intern_replay->worlds, &intern_replay->world_capacity,
+                                     intern_replay->node_count, sizeof(float) * 6);
+  bool *done = calloc(intern_replay->node_count, sizeof(bool));
+  for (uint64_t i = 0; i < intern_replay->node_count; i++) {
+    compose_world(intern_replay, i, done);
+  }
+  free(done);
+
+  // One range for every run of indices pushed in the same node
+  uint64_t range_count = 0;
+  for (uint64_t i = 0; i < intern_replay->index_count; i++) {
+    strs_transform transform = intern_replay->index_transforms[i];
+    if (range_count == 0 || intern_replay->ranges[range_count - 1].transform != transform) {
+      intern_replay->ranges = strs_grow_array(intern_replay->ranges, &intern_replay->range_capacity, range_count + 1,
+                                         sizeof(strs_soft_range));
+      intern_replay->ranges[range_count++] = (strs_soft_range){(uint32_t) i, 0, transform};
+    }
+    intern_replay->ranges[range_count - 1].index_count++;
+  }
+
+  strs_soft_scene scene = {
+    .vertex_format = STRS_VERTEX_FORMAT_DEFAULT,
+    .vertices = intern_replay->vertices,
+    .vertex_count = intern_replay->vertex_count,
+    .indices = intern_replay->indices,
+    .index_count = intern_replay->index_count,
+    .draws = intern_replay->ranges,
+    .draw_count = range_count,
+    .shapes = intern_replay->shapes,
+    .shape_count = intern_replay->shape_count,
+    .transforms = (const float (*)[6])intern_replay->worlds,
+    .transform_count = intern_replay->node_count,
+    .clear_color = {clear_color[0], clear_color[1], clear_color[2], clear_color[3]}};
+  strs_soft_draw(soft, &scene);
+}
+
+STRS_LIB void strs_replay_size(strs_replay replay, uint32_t *width, uint32_t *height) {
+  internal_strs_replay *intern_replay = (internal_strs_replay*)replay;
+  *width = intern_replay->width;
+  *height = intern_replay->height;
+}
+
+STRS_LIB void strs_replay_get_stats(strs_replay replay, strs_replay_stats *stats) {
+  *stats = ((internal_strs_replay*)replay)->stats;
+}
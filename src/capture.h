@@ -0,0 +1,108 @@
+#ifndef STEROS_CAPTURE_H
+#define STEROS_CAPTURE_H
+
+#include "steros.h"
+#include "app.h"
+#include "soft.h"
+
+// STD
+#include <stdbool.h>
+#include <stdint.h>
+
+// Logs of the calls a scene is built with, to replay real sessions against other builds of the library.
+// An app captures into strs_app_options.capture. Every record is the call, the time since the one before
+// as a varint, up to STRS_CALL_MAX_ARGS varint arguments and the bytes the call was passed, as they were.
+typedef enum {
+  // Both sides of strs_app_add, the calls the widget makes are captured between them
+  STRS_CALL_APP_ADD,
+  // format, the vertices
+  STRS_CALL_PUSH_VERTICES,
+  STRS_CALL_WRITE_VERTICES,
+  STRS_CALL_POP_BACK_VERTICES,
+  STRS_CALL_POP_FRONT_VERTICES,
+  STRS_CALL_ERASE_VERTICES,
+  STRS_CALL_PUSH_INDICES,
+  STRS_CALL_PUSH_INDICES32,
+  STRS_CALL_WRITE_INDICES32,
+  STRS_CALL_POP_BACK_INDICES,
+  STRS_CALL_POP_FRONT_INDICES,
+  STRS_CALL_ERASE_INDICES,
+  // count, whether colors follow the rects
+  STRS_CALL_PUSH_RECTS,
+  STRS_CALL_PUSH_SHAPES,
+  STRS_CALL_WRITE_SHAPES,
+  STRS_CALL_POP_BACK_SHAPES,
+  // parent, the node created
+  STRS_CALL_TRANSFORM_CREATE,
+  STRS_CALL_TRANSFORM_DESTROY,
+  STRS_CALL_TRANSFORM_SET,
+  STRS_CALL_TRANSFORM_SET_OPACITY,
+  // node, the bounds or nothing
+  STRS_CALL_TRANSFORM_SET_LAYER,
+  STRS_CALL_TRANSFORM_FOLLOW_POINTER,
+  STRS_CALL_SET_TRANSFORM,
+  STRS_CALL_PUSH_CLIP,
+  // the rect, the radius and the affine, if one was passed
+  STRS_CALL_PUSH_CLIP_MASK,
+  STRS_CALL_POP_CLIP,
+  STRS_CALL_SET_CULL_VIEWPORT,
+  STRS_CALL_INPUT,
+  // width, height. The first record of every capture.
+  STRS_CALL_RESIZE,
+  // The scene handed to the render thread, by draw_frame or by strs_app_publish with manual_publish
+  STRS_CALL_FRAME,
+  STRS_CALL_COUNT
+} strs_call;
+
+#define STRS_CALL_MAX_ARGS 4
+
+// Appends to a buffer that is written out once it fills up and on strs_capture_free. Any thread may
+// record, the records of each thread stay in order.
+STRS_LIB strs_capture strs_capture_create(const char *path);
+// After the app capturing into it is freed
+STRS_LIB void strs_capture_free(strs_capture capture);
+STRS_LIB void strs_capture_call(strs_capture capture, strs_call call, const uint64_t *args, uint32_t arg_count,
+                                const void *data, uint64_t size);
+STRS_LIB const char *strs_call_name(strs_call call);
+
+typedef struct {
+  uint32_t not_used;
+} *strs_replay;
+
+typedef struct {
+  strs_call call;
+  // Since the first record
+  uint64_t time_ns;
+  uint64_t args[STRS_CALL_MAX_ARGS];
+  uint32_t arg_count;
+  // Valid until the next record is read
+  const void *data;
+  uint64_t size;
+} strs_call_record;
+
+typedef struct {
+  uint64_t records;
+  uint64_t frames;
+  // Records whose data is not the size of their call, and the ones the headless scene has nothing to draw for,
+  // clips, layers and input
+  uint64_t skipped;
+} strs_replay_stats;
+
+// NULL when the file is missing or not a capture
+STRS_LIB strs_replay strs_replay_open(const char *path);
+STRS_LIB void strs_replay_free(strs_replay replay);
+// False at the end of the log and at a record cut short
+STRS_LIB bool strs_replay_next(strs_replay replay, strs_call_record *record);
+// Makes the call the record stands for on app, with the transform nodes created in the log mapped to the
+// ones created while replaying
+STRS_LIB void strs_replay_apply(strs_replay replay, strs_app app, const strs_call_record *record);
+
+// Applies the record to streams the replay keeps on the CPU instead, so logs replay without a window or a
+// GPU. strs_replay_draw draws them with the CPU renderer the way the app would have.
+STRS_LIB void strs_replay_apply_headless(strs_replay replay, const strs_call_record *record);
+STRS_LIB void strs_replay_draw(strs_replay replay, strs_soft soft, const float clear_color[4]);
+// Framebuffer size of the last resize record, 0 before one was read
+STRS_LIB void strs_replay_size(strs_replay replay, uint32_t *width, uint32_t *height);
+STRS_LIB void strs_replay_get_stats(strs_replay replay, strs_replay_stats *stats);
+
+#endif //STEROS_CAPTURE_H
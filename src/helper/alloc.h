@@ -0,0 +1,138 @@
+#ifndef STEROS_ALLOC_H
+#define STEROS_ALLOC_H
+
+// STD
+#include <stdint.h>
+#include <stdlib.h>
+
+#define STRS_ALLOC_ALIGNMENT 16
+
+static inline size_t strs_align_up(size_t size, size_t alignment) {
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+// Reallocates array to the next power of two from 64 that holds required elements, does nothing when
+// capacity already does
+static inline void *strs_grow_array(void *array, uint64_t *capacity, uint64_t required, size_t element_size) {
+  if (required <= *capacity) {
+    return array;
+  }
+  uint64_t new_capacity = *capacity == 0 ? 64 : *capacity;
+  while (new_capacity < required) {
+    new_capacity *= 2;
+  }
+  *capacity = new_capacity;
+  return realloc(array, new_capacity * element_size);
+}
+
+// Bump allocator for memory that is thrown away all at once. Allocations that do not fit
+// fall back to malloc until the next reset, which grows the block to what was used.
+typedef struct strs_arena_overflow strs_arena_overflow;
+
+struct strs_arena_overflow {
+  strs_arena_overflow *next;
+};
+
+typedef struct {
+  uint8_t *base;
+  size_t capacity;
+  size_t used;
+  // Including the overflow, since the last reset
+  size_t requested;
+  size_t peak;
+  strs_arena_overflow *overflow;
+} strs_arena;
+
+static inline void *strs_arena_alloc(strs_arena *arena, size_t size) {
+  size = strs_align_up(size, STRS_ALLOC_ALIGNMENT);
+  arena->requested += size;
+  arena->peak = arena->requested > arena->peak ? arena->requested : arena->peak;
+  if (arena->used + size <= arena->capacity) {
+    void *memory = arena->base + arena->used;
+    arena->used += size;
+    return memory;
+  }
+
+  strs_arena_overflow *overflow = malloc(STRS_ALLOC_ALIGNMENT + size);
+  overflow->next = arena->overflow;
+  arena->overflow = overflow;
+  return (uint8_t*)overflow + STRS_ALLOC_ALIGNMENT;
+}
+
+static inline void strs_arena_reset(strs_arena *arena) {
+  while (arena->overflow != NULL) {
+    strs_arena_overflow *next = arena->overflow->next;
+    free(arena->overflow);
+    arena->overflow = next;
+  }
+  if (arena->requested > arena->capacity) {
+    size_t capacity = arena->capacity == 0 ? 4096 : arena->capacity;
+    while (capacity < arena->requested) {
+      capacity *= 2;
+    }
+    free(arena->base);
+    arena->base = malloc(capacity);
+    arena->capacity = capacity;
+  }
+  arena->used = 0;
+  arena->requested = 0;
+}
+
+static inline void strs_arena_free(strs_arena *arena) {
+  strs_arena_reset(arena);
+  free(arena->base);
+  arena->base = NULL;
+  arena->capacity = 0;
+}
+
+// Fixed size objects carved out of chunks, released objects are handed out again first
+typedef struct {
+  size_t element_size;
+  uint32_t chunk_elements;
+  // Released elements link through their first bytes, chunks through their header
+  void *free_list;
+  void *chunks;
+  uint64_t live;
+} strs_pool;
+
+static inline void strs_pool_init(strs_pool *pool, size_t element_size, uint32_t chunk_elements) {
+  *pool = (strs_pool){
+    .element_size = strs_align_up(element_size < sizeof(void*) ? sizeof(void*) : element_size, sizeof(void*)),
+    .chunk_elements = chunk_elements};
+}
+
+static inline void *strs_pool_alloc(strs_pool *pool) {
+  if (pool->free_list == NULL) {
+    uint8_t *chunk = malloc(STRS_ALLOC_ALIGNMENT + pool->element_size * pool->chunk_elements);
+    *(void**)chunk = pool->chunks;
+    pool->chunks = chunk;
+    for (uint32_t i = pool->chunk_elements; i > 0; i--) {
+      void *element = chunk + STRS_ALLOC_ALIGNMENT + pool->element_size * (i - 1);
+      *(void**)element = pool->free_list;
+      pool->free_list = element;
+    }
+  }
+
+  void *element = pool->free_list;
+  pool->free_list = *(void**)element;
+  pool->live++;
+  return element;
+}
+
+static inline void strs_pool_release(strs_pool *pool, void *element) {
+  *(void**)element = pool->free_list;
+  pool->free_list = element;
+  pool->live--;
+}
+
+static inline void strs_pool_free(strs_pool *pool) {
+  while (pool->chunks != NULL) {
+    void *next = *(void**)pool->chunks;
+    free(pool->chunks);
+    pool->chunks = next;
+  }
+  pool->free_list = NULL;
+  pool->live = 0;
+}
+
+#endif //STEROS_ALLOC_H
@@ -0,0 +1,14 @@
+#ifndef STEROS_CLOCK_H
+#define STEROS_CLOCK_H
+
+// STD
+#include <stdint.h>
+#include <time.h>
+
+static inline uint64_t strs_clock_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+#endif //STEROS_CLOCK_H
@@ -0,0 +1,78 @@
+#ifndef STEROS_INPUT_RING_H
+#define STEROS_INPUT_RING_H
+
+// STD
+#include <stdbool.h>
+#include <stdint.h>
+
+// LIB
+#include "app.h"
+#include "helper/clock.h"
+
+// Bounded multi producer, single consumer queue. A slot's sequence equals the write position when it is
+// free and the position + 1 once the event in it is published.
+typedef struct {
+  uint64_t sequence;
+  strs_input_event event;
+} strs_input_slot;
+
+typedef struct {
+  strs_input_slot slots[STRS_INPUT_RING_SIZE];
+  uint64_t head;
+  // Only the consumer moves the tail
+  uint64_t tail;
+  uint64_t dropped;
+} strs_input_ring;
+
+static inline void strs_input_ring_init(strs_input_ring *ring) {
+  for (uint64_t i = 0; i < STRS_INPUT_RING_SIZE; i++) {
+    ring->slots[i].sequence = i;
+  }
+  ring->head = 0;
+  ring->tail = 0;
+  ring->dropped = 0;
+}
+
+// Any thread, false and counted in dropped when the ring is full. Events without a timestamp are stamped.
+static inline bool strs_input_ring_push(strs_input_ring *ring, const strs_input_event *event) {
+  strs_input_slot *slot;
+
+  uint64_t position = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+  while (true) {
+    slot = &ring->slots[position % STRS_INPUT_RING_SIZE];
+    int64_t difference = (int64_t) (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - position);
+    if (difference == 0) {
+      if (__atomic_compare_exchange_n(&ring->head, &position, position + 1, true,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        break;
+      }
+    } else if (difference < 0) {
+      __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+      return false;
+    } else {
+      position = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    }
+  }
+
+  slot->event = *event;
+  if (slot->event.timestamp_ns == 0) {
+    slot->event.timestamp_ns = strs_clock_now_ns();
+  }
+  slot->event.coalesced = 1;
+  __atomic_store_n(&slot->sequence, position + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+// Only the consumer thread, false when no published event is next
+static inline bool strs_input_ring_pop(strs_input_ring *ring, strs_input_event *event) {
+  strs_input_slot *slot = &ring->slots[ring->tail % STRS_INPUT_RING_SIZE];
+  if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != ring->tail + 1) {
+    return false;
+  }
+  *event = slot->event;
+  __atomic_store_n(&slot->sequence, ring->tail + STRS_INPUT_RING_SIZE, __ATOMIC_RELEASE);
+  ring->tail++;
+  return true;
+}
+
+#endif //STEROS_INPUT_RING_H
@@ -0,0 +1,75 @@
+#ifndef STEROS_SCENE_H
+#define STEROS_SCENE_H
+
+// STD
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Edits the app and the headless replay both make to the streams and the transform tree of a scene, so a
+// replayed log ends up with the scene the app had.
+
+// Removes count elements at first from a stream of stride byte elements, the ones behind move down. Clamped
+// to the elements there are, returns how many were removed.
+static inline uint64_t strs_stream_erase(void *stream, uint64_t *size, size_t stride, uint64_t first,
+                                         uint64_t count) {
+  if (first >= *size) {
+    return 0;
+  }
+  count = count < *size - first ? count : *size - first;
+  memmove((uint8_t*)stream + stride * first, (uint8_t*)stream + stride * (first + count),
+          stride * (*size - first - count));
+  *size -= count;
+  return count;
+}
+
+static inline uint64_t strs_stream_pop_back(uint64_t *size, uint64_t count) {
+  count = count < *size ? count : *size;
+  *size -= count;
+  return count;
+}
+
+// A node array is of any struct that starts with its links, stride bytes apart. STRS_TREE_NONE is the same
+// as STRS_TRANSFORM_NONE.
+#define STRS_TREE_NONE UINT32_MAX
+
+typedef struct {
+  uint32_t parent;
+  uint32_t first_child;
+  // Links the free list once the node is destroyed
+  uint32_t next_sibling;
+} strs_tree_links;
+
+static inline strs_tree_links *strs_tree_at(void *nodes, size_t stride, uint32_t node) {
+  return (strs_tree_links*)((uint8_t*)nodes + stride * node);
+}
+
+// Makes node the first child of parent
+static inline void strs_tree_attach(void *nodes, size_t stride, uint32_t node, uint32_t parent) {
+  strs_tree_links *links = strs_tree_at(nodes, stride, node);
+  strs_tree_links *parent_links = strs_tree_at(nodes, stride, parent);
+  links->parent = parent;
+  links->next_sibling = parent_links->first_child;
+  parent_links->first_child = node;
+}
+
+// Unlinks node from its parent, its children are attached to the parent instead and keep their local
+// transforms relative to it. The node is left without children.
+static inline void strs_tree_detach(void *nodes, size_t stride, uint32_t node) {
+  strs_tree_links *links = strs_tree_at(nodes, stride, node);
+  uint32_t *link = &strs_tree_at(nodes, stride, links->parent)->first_child;
+  while (*link != node) {
+    link = &strs_tree_at(nodes, stride, *link)->next_sibling;
+  }
+  *link = links->next_sibling;
+
+  uint32_t child = links->first_child;
+  while (child != STRS_TREE_NONE) {
+    uint32_t next = strs_tree_at(nodes, stride, child)->next_sibling;
+    strs_tree_attach(nodes, stride, child, links->parent);
+    child = next;
+  }
+  links->first_child = STRS_TREE_NONE;
+}
+
+#endif //STEROS_SCENE_H
@@ -0,0 +1,392 @@
+// STD
+#include <pthread.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <unistd.h>
+
+// LIB
+#include "jobs.h"
+#include "helper/alloc.h"
+
+#define JOB_SLOT_MASK (STRS_JOB_CAPACITY - 1)
+#define JOB_NO_SLOT UINT32_MAX
+
+typedef struct job_link job_link;
+
+struct job_link {
+  uint32_t slot;
+  job_link *next;
+};
+
+typedef struct {
+  PFN_strs_job function;
+  void *data;
+  // Bumped when the job finishes, handles carry the generation they were spawned with
+  uint32_t generation;
+  // Unfinished dependencies, plus one until strs_jobs_spawn registered all of them
+  uint32_t pending;
+  // Guards generation changes and the dependents
+  bool locked;
+  job_link *dependents;
+  uint32_t next_free;
+} job;
+
+// Chase-Lev deque. Only the owner moves bottom, thieves race for top. It can hold every job at once.
+typedef struct {
+  int64_t top;
+  int64_t bottom;
+  uint32_t slots[STRS_JOB_CAPACITY];
+} job_deque;
+
+typedef struct internal_strs_jobs internal_strs_jobs;
+
+typedef struct {
+  internal_strs_jobs *jobs;
+  uint32_t index;
+  pthread_t thread;
+  job_deque deque;
+} job_worker;
+
+struct internal_strs_jobs {
+  job jobs[STRS_JOB_CAPACITY];
+  pthread_mutex_t free_lock;
+  uint32_t free_slot;
+  // The links of the dependents, any thread takes and returns them under the lock
+  pthread_mutex_t link_lock;
+  strs_pool links;
+
+  // Jobs spawned outside the workers, lock also guards the sleeping threads
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  uint32_t shared[STRS_JOB_CAPACITY];
+  uint64_t shared_first;
+  uint64_t shared_count;
+  // Bumped whenever a job becomes ready or finishes, a thread only sleeps if it did not change
+  // since it last looked for work
+  uint64_t epoch;
+  uint32_t sleepers;
+  bool stopping;
+
+  job_worker *workers;
+  uint32_t worker_count;
+};
+
+// The worker the calling thread is, NULL outside the workers
+static __thread job_worker *current_worker;
+
+STRS_INTERN void job_lock(job *j) {
+  while (__atomic_test_and_set(&j->locked, __ATOMIC_ACQUIRE)) {
+    sched_yield();
+  }
+}
+
+STRS_INTERN void job_unlock(job *j) {
+  __atomic_clear(&j->locked, __ATOMIC_RELEASE);
+}
+
+STRS_INTERN void deque_push(job_deque *deque, uint32_t slot) {
+  int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+  __atomic_store_n(&deque->slots[bottom & JOB_SLOT_MASK], slot, __ATOMIC_RELAXED);
+  __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELEASE);
+}
+
+STRS_INTERN bool deque_pop(job_deque *deque, uint32_t *slot) {
+  int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+  __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+  if (top > bottom) {
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return false;
+  }
+
+  *slot = __atomic_load_n(&deque->slots[bottom & JOB_SLOT_MASK], __ATOMIC_RELAXED);
+  if (top < bottom) {
+    return true;
+  }
+  // The last job, a thief may be taking it at the same time
+  bool won = __atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+  __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+  return won;
+}
+
+STRS_INTERN bool deque_steal(job_deque *deque, uint32_t *slot) {
+  int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+  if (top >= bottom) {
+    return false;
+  }
+  *slot = __atomic_load_n(&deque->slots[top & JOB_SLOT_MASK], __ATOMIC_RELAXED);
+  return __atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+STRS_INTERN void notify(internal_strs_jobs *jobs, bool everyone) {
+  __atomic_add_fetch(&jobs->epoch, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&jobs->sleepers, __ATOMIC_SEQ_CST) > 0) {
+    pthread_mutex_lock(&jobs->lock);
+    if (everyone) {
+      pthread_cond_broadcast(&jobs->cond);
+    } else {
+      pthread_cond_signal(&jobs->cond);
+    }
+    pthread_mutex_unlock(&jobs->lock);
+  }
+}
+
+STRS_INTERN void sleep_until_notified(internal_strs_jobs *jobs, uint64_t epoch) {
+  pthread_mutex_lock(&jobs->lock);
+  __atomic_add_fetch(&jobs->sleepers, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&jobs->epoch, __ATOMIC_SEQ_CST) == epoch && !jobs->stopping) {
+    pthread_cond_wait(&jobs->cond, &jobs->lock);
+  }
+  __atomic_sub_fetch(&jobs->sleepers, 1, __ATOMIC_SEQ_CST);
+  pthread_mutex_unlock(&jobs->lock);
+}
+
+// Workers keep ready jobs to themselves, everyone else hands them to the shared queue
+STRS_INTERN void schedule(internal_strs_jobs *jobs, uint32_t slot) {
+  if (current_worker != NULL && current_worker->jobs == jobs) {
+    deque_push(&current_worker->deque, slot);
+  } else {
+    pthread_mutex_lock(&jobs->lock);
+    jobs->shared[(jobs->shared_first + jobs->shared_count) & JOB_SLOT_MASK] = slot;
+    __atomic_store_n(&jobs->shared_count, jobs->shared_count + 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&jobs->lock);
+  }
+  notify(jobs, false);
+}
+
+STRS_INTERN bool find_job(internal_strs_jobs *jobs, uint32_t *slot) {
+  job_worker *self = current_worker != NULL && current_worker->jobs == jobs ? current_worker : NULL;
+  if (self != NULL && deque_pop(&self->deque, slot)) {
+    return true;
+  }
+
+  if (__atomic_load_n(&jobs->shared_count, __ATOMIC_RELAXED) > 0) {
+    bool found = false;
+    pthread_mutex_lock(&jobs->lock);
+    if (jobs->shared_count > 0) {
+      *slot = jobs->shared[jobs->shared_first & JOB_SLOT_MASK];
+      jobs->shared_first++;
+      __atomic_store_n(&jobs->shared_count, jobs->shared_count - 1, __ATOMIC_RELAXED);
+      found = true;
+    }
+    pthread_mutex_unlock(&jobs->lock);
+    if (found) {
+      return true;
+    }
+  }
+
+  // Victims start after the thief so they do not all go for the same deque
+  uint32_t first = self != NULL ? self->index + 1 : 0;
+  for (uint32_t i = 0; i < jobs->worker_count; i++) {
+    job_worker *victim = &jobs->workers[(first + i) % jobs->worker_count];
+    if (victim != self && deque_steal(&victim->deque, slot)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+STRS_INTERN void run_job(internal_strs_jobs *jobs, uint32_t slot) {
+  job *j = &jobs->jobs[slot];
+  j->function(j->data);
+
+  job_lock(j);
+  __atomic_add_fetch(&j->generation, 1, __ATOMIC_SEQ_CST);
+  job_link *dependents = j->dependents;
+  j->dependents = NULL;
+  job_unlock(j);
+
+  for (job_link *link = dependents; link != NULL; link = link->next) {
+    if (__atomic_sub_fetch(&jobs->jobs[link->slot].pending, 1, __ATOMIC_ACQ_REL) == 0) {
+      schedule(jobs, link->slot);
+    }
+  }
+  if (dependents != NULL) {
+    pthread_mutex_lock(&jobs->link_lock);
+    while (dependents != NULL) {
+      job_link *next = dependents->next;
+      strs_pool_release(&jobs->links, dependents);
+      dependents = next;
+    }
+    pthread_mutex_unlock(&jobs->link_lock);
+  }
+
+  pthread_mutex_lock(&jobs->free_lock);
+  j->next_free = jobs->free_slot;
+  jobs->free_slot = slot;
+  pthread_mutex_unlock(&jobs->free_lock);
+  // Waiters sleep on the same condition as idle workers
+  notify(jobs, true);
+}
+
+STRS_INTERN void *worker_loop(void *data) {
+  job_worker *worker = (job_worker*)data;
+  internal_strs_jobs *jobs = worker->jobs;
+  current_worker = worker;
+
+  for (;;) {
+    uint64_t epoch = __atomic_load_n(&jobs->epoch, __ATOMIC_SEQ_CST);
+    uint32_t slot;
+    if (find_job(jobs, &slot)) {
+      run_job(jobs, slot);
+      continue;
+    }
+    if (__atomic_load_n(&jobs->stopping, __ATOMIC_ACQUIRE)) {
+      break;
+    }
+    sleep_until_notified(jobs, epoch);
+  }
+  current_worker = NULL;
+  return NULL;
+}
+
+STRS_LIB uint32_t strs_jobs_default_worker_count(void) {
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  return cores > 1 ? (uint32_t) (cores - 1) : 0;
+}
+
+STRS_LIB strs_jobs strs_jobs_create(uint32_t worker_count) {
+  internal_strs_jobs *jobs = calloc(1, sizeof(internal_strs_jobs));
+  pthread_mutex_init(&jobs->free_lock, NULL);
+  pthread_mutex_init(&jobs->link_lock, NULL);
+  strs_pool_init(&jobs->links, sizeof(job_link), 256);
+  pthread_mutex_init(&jobs->lock, NULL);
+  pthread_cond_init(&jobs->cond, NULL);
+  for (uint32_t i = 0; i < STRS_JOB_CAPACITY; i++) {
+    jobs->jobs[i].generation = 1;
+    jobs->jobs[i].next_free = i + 1 < STRS_JOB_CAPACITY ? i + 1 : JOB_NO_SLOT;
+  }
+  jobs->free_slot = 0;
+
+  jobs->worker_count = worker_count;
+  jobs->workers = calloc(worker_count > 0 ? worker_count : 1, sizeof(job_worker));
+  for (uint32_t i = 0; i < worker_count; i++) {
+    jobs->workers[i].jobs = jobs;
+    jobs->workers[i].index = i;
+    pthread_create(&jobs->workers[i].thread, NULL, worker_loop, &jobs->workers[i]);
+  }
+  return (strs_jobs)jobs;
+}
+
+STRS_LIB void strs_jobs_free(strs_jobs jobs) {
+  internal_strs_jobs *intern_jobs = (internal_strs_jobs*)jobs;
+  while (strs_jobs_help(jobs)) {
+  }
+
+  pthread_mutex_lock(&intern_jobs->lock);
+  __atomic_store_n(&intern_jobs->stopping, true, __ATOMIC_RELEASE);
+  pthread_cond_broadcast(&intern_jobs->cond);
+  pthread_mutex_unlock(&intern_jobs->lock);
+  for (uint32_t i = 0; i < intern_jobs->worker_count; i++) {
+    pthread_join(intern_jobs->workers[i].thread, NULL);
+  }
+
+  pthread_mutex_destroy(&intern_jobs->free_lock);
+  pthread_mutex_destroy(&intern_jobs->link_lock);
+  strs_pool_free(&intern_jobs->links);
+  pthread_mutex_destroy(&intern_jobs->lock);
+  pthread_cond_destroy(&intern_jobs->cond);
+  free(intern_jobs->workers);
+  free(intern_jobs);
+}
+
+STRS_LIB uint32_t strs_jobs_worker_count(strs_jobs jobs) {
+  return ((internal_strs_jobs*)jobs)->worker_count;
+}
+
+// Keeps the dependent from starting until the dependency finished, false when it already has
+STRS_INTERN bool add_dependent(internal_strs_jobs *jobs, strs_job dependency, uint32_t slot) {
+  job *j = &jobs->jobs[dependency & JOB_SLOT_MASK];
+  pthread_mutex_lock(&jobs->link_lock);
+  job_link *link = strs_pool_alloc(&jobs->links);
+  pthread_mutex_unlock(&jobs->link_lock);
+  link->slot = slot;
+
+  job_lock(j);
+  if (j->generation != (uint32_t) (dependency >> 32)) {
+    job_unlock(j);
+    pthread_mutex_lock(&jobs->link_lock);
+    strs_pool_release(&jobs->links, link);
+    pthread_mutex_unlock(&jobs->link_lock);
+    return false;
+  }
+  __atomic_add_fetch(&jobs->jobs[slot].pending, 1, __ATOMIC_ACQ_REL);
+  link->next = j->dependents;
+  j->dependents = link;
+  job_unlock(j);
+  return true;
+}
+
+STRS_LIB strs_job strs_jobs_spawn(strs_jobs jobs, PFN_strs_job function, void *data,
+                                  const strs_job *dependencies, uint32_t dependency_count) {
+  internal_strs_jobs *intern_jobs = (internal_strs_jobs*)jobs;
+  uint32_t slot;
+
+  // Every slot in use, the caller helps until one is free
+  for (;;) {
+    pthread_mutex_lock(&intern_jobs->free_lock);
+    slot = intern_jobs->free_slot;
+    if (slot != JOB_NO_SLOT) {
+      intern_jobs->free_slot = intern_jobs->jobs[slot].next_free;
+    }
+    pthread_mutex_unlock(&intern_jobs->free_lock);
+    if (slot != JOB_NO_SLOT) {
+      break;
+    }
+    if (!strs_jobs_help(jobs)) {
+      sched_yield();
+    }
+  }
+
+  job *j = &intern_jobs->jobs[slot];
+  j->function = function;
+  j->data = data;
+  j->pending = 1;
+  j->dependents = NULL;
+  strs_job handle = (uint64_t) __atomic_load_n(&j->generation, __ATOMIC_RELAXED) << 32 | slot;
+
+  for (uint32_t i = 0; i < dependency_count; i++) {
+    if (dependencies[i] != STRS_JOB_NONE) {
+      add_dependent(intern_jobs, dependencies[i], slot);
+    }
+  }
+  if (__atomic_sub_fetch(&j->pending, 1, __ATOMIC_ACQ_REL) == 0) {
+    schedule(intern_jobs, slot);
+  }
+  return handle;
+}
+
+STRS_LIB bool strs_jobs_done(strs_jobs jobs, strs_job job) {
+  internal_strs_jobs *intern_jobs = (internal_strs_jobs*)jobs;
+  if (job == STRS_JOB_NONE) {
+    return true;
+  }
+  uint32_t generation = __atomic_load_n(&intern_jobs->jobs[job & JOB_SLOT_MASK].generation, __ATOMIC_SEQ_CST);
+  return generation != (uint32_t) (job >> 32);
+}
+
+STRS_LIB void strs_jobs_wait(strs_jobs jobs, strs_job job) {
+  internal_strs_jobs *intern_jobs = (internal_strs_jobs*)jobs;
+  for (;;) {
+    uint64_t epoch = __atomic_load_n(&intern_jobs->epoch, __ATOMIC_SEQ_CST);
+    if (strs_jobs_done(jobs, job)) {
+      return;
+    }
+    if (!strs_jobs_help(jobs)) {
+      sleep_until_notified(intern_jobs, epoch);
+    }
+  }
+}
+
+STRS_LIB bool strs_jobs_help(strs_jobs jobs) {
+  internal_strs_jobs *intern_jobs = (internal_strs_jobs*)jobs;
+  uint32_t slot;
+  if (!find_job(intern_jobs, &slot)) {
+    return false;
+  }
+  run_job(intern_jobs, slot);
+  return true;
+}
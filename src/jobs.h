@@ -0,0 +1,42 @@
+#ifndef STEROS_JOBS_H
+#define STEROS_JOBS_H
+
+#include "steros.h"
+
+// STD
+#include <stdbool.h>
+#include <stdint.h>
+
+// Work stealing scheduler. Every worker owns a deque it pushes and pops at one end while idle workers
+// steal from the other, jobs spawned by other threads go through a shared queue.
+typedef struct {
+  uint32_t not_used;
+} *strs_jobs;
+
+// Stays valid after the job finished, a finished job just never matches again
+typedef uint64_t strs_job;
+#define STRS_JOB_NONE 0
+
+// Jobs that were spawned and have not finished yet, spawning more waits for some of them to finish
+#define STRS_JOB_CAPACITY 4096
+
+typedef void (*PFN_strs_job)(void *data);
+
+// One worker per core but the calling one
+STRS_LIB uint32_t strs_jobs_default_worker_count(void);
+// With 0 workers jobs only run in strs_jobs_wait and strs_jobs_help
+STRS_LIB strs_jobs strs_jobs_create(uint32_t worker_count);
+// Runs what is left before the workers stop
+STRS_LIB void strs_jobs_free(strs_jobs jobs);
+STRS_LIB uint32_t strs_jobs_worker_count(strs_jobs jobs);
+
+// The job runs once all dependencies finished, STRS_JOB_NONE and finished ones are skipped
+STRS_LIB strs_job strs_jobs_spawn(strs_jobs jobs, PFN_strs_job function, void *data,
+                                  const strs_job *dependencies, uint32_t dependency_count);
+STRS_LIB bool strs_jobs_done(strs_jobs jobs, strs_job job);
+// Runs other jobs on the calling thread until job finished
+STRS_LIB void strs_jobs_wait(strs_jobs jobs, strs_job job);
+// Runs one job that is ready on the calling thread, false when there was none
+STRS_LIB bool strs_jobs_help(strs_jobs jobs);
+
+#endif //STEROS_JOBS_H
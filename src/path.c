@@ -0,0 +1,849 @@
+// STD
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// LIB
+#include "path.h"
+#include "helper/alloc.h"
+
+// Flattening error in units at the scale a path is drawn at
+#define PATH_TOLERANCE 0.25f
+#define PATH_MAX_SEGMENTS 256
+#define PATH_DEFAULT_MITER_LIMIT 4.0f
+#define PATH_CACHE_BUCKETS 1024
+#define PATH_ENTRY_NONE UINT32_MAX
+
+typedef enum {
+  PATH_MOVE,
+  PATH_LINE,
+  PATH_QUAD,
+  PATH_CUBIC,
+  PATH_CLOSE
+} path_verb;
+
+typedef struct {
+  uint8_t *verbs;
+  uint64_t verb_count;
+  uint64_t verb_capacity;
+  float *coords;
+  uint64_t coord_count;
+  uint64_t coord_capacity;
+  // FNV-1a of the verbs and coordinates so far, what the cache keys meshes by
+  uint64_t hash;
+} internal_strs_path;
+
+// Every subpath flattened to points, fills close them all
+typedef struct {
+  uint64_t first;
+  uint64_t count;
+  bool closed;
+} path_contour;
+
+typedef struct {
+  float *points;
+  uint64_t point_count;
+  uint64_t point_capacity;
+  path_contour *contours;
+  uint64_t contour_count;
+  uint64_t contour_capacity;
+} path_polyline;
+
+// y0 < y1, winding is +1 for edges that went down and -1 for edges that went up
+typedef struct {
+  float x0;
+  float y0;
+  float x1;
+  float y1;
+  int32_t winding;
+} path_edge;
+
+// Where an edge crosses the middle of a slab
+typedef struct {
+  float x;
+  float slope;
+  int32_t winding;
+} slab_crossing;
+
+typedef struct {
+  strs_path_mesh *mesh;
+  uint64_t vertex_capacity;
+  uint64_t index_capacity;
+  const float *color;
+} mesh_builder;
+
+// A miss on its way through the jobs, with its own copy of the path
+typedef struct {
+  internal_strs_path path;
+  strs_path_style style;
+  float scale;
+  strs_path_mesh mesh;
+} path_task;
+
+typedef struct {
+  uint64_t key;
+  // Links the bucket, or the free list once the entry is dropped
+  uint32_t next;
+  bool used;
+  strs_job job;
+  // Until the mesh was taken from the job
+  path_task *task;
+  // What the key was hashed from, a hit compares them as well. The path moves here from the task.
+  internal_strs_path path;
+  strs_path_style style;
+  int32_t bucket;
+  strs_path_mesh mesh;
+  uint64_t bytes;
+  uint64_t last_used;
+} path_entry;
+
+typedef struct {
+  strs_jobs jobs;
+  uint64_t budget_bytes;
+  // The tasks of the misses, only the thread using the cache takes and returns them
+  strs_pool tasks;
+  path_entry *entries;
+  uint64_t entry_count;
+  uint64_t entry_capacity;
+  uint32_t free_entry;
+  uint32_t buckets[PATH_CACHE_BUCKETS];
+  // strs_push_path rebases the mesh indices in here, the app's frame arena belongs to the render thread
+  uint32_t *indices;
+  uint64_t index_capacity;
+  uint64_t clock;
+  strs_path_cache_stats stats;
+} internal_strs_path_cache;
+
+STRS_INTERN uint64_t hash_bytes(uint64_t hash, const void *data, size_t size) {
+  const uint8_t *bytes = (const uint8_t*)data;
+  for (size_t i = 0; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 1099511628211ull;
+  }
+  return hash;
+}
+
+STRS_INTERN void path_append(internal_strs_path *path, path_verb verb, const float *coords, uint32_t count) {
+  uint8_t byte = (uint8_t) verb;
+  path->verbs = strs_grow_array(path->verbs, &path->verb_capacity, path->verb_count + 1, sizeof(uint8_t));
+  path->verbs[path->verb_count++] = byte;
+  path->hash = hash_bytes(path->hash, &byte, 1);
+  // Closes have no coordinates
+  if (count == 0) {
+    return;
+  }
+  path->coords = strs_grow_array(path->coords, &path->coord_capacity, path->coord_count + count, sizeof(float));
+  memcpy(path->coords + path->coord_count, coords, sizeof(float) * count);
+  path->coord_count += count;
+  path->hash = hash_bytes(path->hash, coords, sizeof(float) * count);
+}
+
+STRS_LIB strs_path strs_path_create(void) {
+  internal_strs_path *path = calloc(1, sizeof(internal_strs_path));
+  path->hash = 14695981039346656037ull;
+  return (strs_path)path;
+}
+
+STRS_LIB void strs_path_free(strs_path path) {
+  internal_strs_path *intern_path = (internal_strs_path*)path;
+  free(intern_path->verbs);
+  free(intern_path->coords);
+  free(intern_path);
+}
+
+STRS_LIB void strs_path_reset(strs_path path) {
+  internal_strs_path *intern_path = (internal_strs_path*)path;
+  intern_path->verb_count = 0;
+  intern_path->coord_count = 0;
+  intern_path->hash = 14695981039346656037ull;
+}
+
+STRS_LIB void strs_path_move_to(strs_path path, float x, float y) {
+  const float coords[] = {x, y};
+  path_append((internal_strs_path*)path, PATH_MOVE, coords, 2);
+}
+
+STRS_LIB void strs_path_line_to(strs_path path, float x, float y) {
+  const float coords[] = {x, y};
+  path_append((internal_strs_path*)path, PATH_LINE, coords, 2);
+}
+
+STRS_LIB void strs_path_quad_to(strs_path path, float cx, float cy, float x, float y) {
+  const float coords[] = {cx, cy, x, y};
+  path_append((internal_strs_path*)path, PATH_QUAD, coords, 4);
+}
+
+STRS_LIB void strs_path_cubic_to(strs_path path, float c1x, float c1y, float c2x, float c2y, float x, float y) {
+  const float coords[] = {c1x, c1y, c2x, c2y, x, y};
+  path_append((internal_strs_path*)path, PATH_CUBIC, coords, 6);
+}
+
+STRS_LIB void strs_path_close(strs_path path) {
+  path_append((internal_strs_path*)path, PATH_CLOSE, NULL, 0);
+}
+
+STRS_INTERN void polyline_begin(path_polyline *poly) {
+  poly->contours = strs_grow_array(poly->contours, &poly->contour_capacity, poly->contour_count + 1,
+                              sizeof(path_contour));
+  poly->contours[poly->contour_count++] = (path_contour){.first = poly->point_count};
+}
+
+// Repeated points are dropped, they have no direction to stroke
+STRS_INTERN void polyline_add(path_polyline *poly, float x, float y) {
+  path_contour *contour = &poly->contours[poly->contour_count - 1];
+  if (contour->count > 0) {
+    const float *last = &poly->points[poly->point_count * 2 - 2];
+    if (last[0] == x && last[1] == y) {
+      return;
+    }
+  }
+  poly->points = strs_grow_array(poly->points, &poly->point_capacity, poly->point_count * 2 + 2, sizeof(float));
+  poly->points[poly->point_count * 2] = x;
+  poly->points[poly->point_count * 2 + 1] = y;
+  poly->point_count++;
+  contour->count++;
+}
+
+// Segments that keep a curve whose control polygon bends by second differences of length d within
+// tolerance, factor is 1/4 for quadratics and 3/4 for cubics
+STRS_INTERN uint32_t curve_segments(float d, float factor, float tolerance) {
+  float n = ceilf(sqrtf(d * factor / tolerance));
+  return n < 1.0f ? 1 : n > PATH_MAX_SEGMENTS ? PATH_MAX_SEGMENTS : (uint32_t) n;
+}
+
+STRS_INTERN void flatten_path(const internal_strs_path *path, float tolerance, path_polyline *poly) {
+  const float *c = path->coords;
+  float cursor[2] = {0.0f, 0.0f};
+  float start[2] = {0.0f, 0.0f};
+  bool open = false;
+
+  for (uint64_t v = 0; v < path->verb_count; v++) {
+    path_verb verb = (path_verb) path->verbs[v];
+    if (verb == PATH_CLOSE) {
+      if (open) {
+        poly->contours[poly->contour_count - 1].closed = true;
+      }
+      open = false;
+      cursor[0] = start[0];
+      cursor[1] = start[1];
+      continue;
+    }
+    if (verb == PATH_MOVE || !open) {
+      polyline_begin(poly);
+      open = true;
+      if (verb == PATH_MOVE) {
+        cursor[0] = c[0];
+        cursor[1] = c[1];
+        c += 2;
+      }
+      start[0] = cursor[0];
+      start[1] = cursor[1];
+      polyline_add(poly, cursor[0], cursor[1]);
+      if (verb == PATH_MOVE) {
+        continue;
+      }
+    }
+
+    if (verb == PATH_LINE) {
+      polyline_add(poly, c[0], c[1]);
+      cursor[0] = c[0];
+      cursor[1] = c[1];
+      c += 2;
+    } else if (verb == PATH_QUAD) {
+      float dx = cursor[0] - 2.0f * c[0] + c[2];
+      float dy = cursor[1] - 2.0f * c[1] + c[3];
+      uint32_t n = curve_segments(sqrtf(dx * dx + dy * dy), 0.25f, tolerance);
+      for (uint32_t i = 1; i <= n; i++) {
+        float t = (float) i / (float) n;
+        float u = 1.0f - t;
+        polyline_add(poly, u * u * cursor[0] + 2.0f * u * t * c[0] + t * t * c[2],
+                     u * u * cursor[1] + 2.0f * u * t * c[1] + t * t * c[3]);
+      }
+      cursor[0] = c[2];
+      cursor[1] = c[3];
+      c += 4;
+    } else if (verb == PATH_CUBIC) {
+      float ax = cursor[0] - 2.0f * c[0] + c[2];
+      float ay = cursor[1] - 2.0f * c[1] + c[3];
+      float bx = c[0] - 2.0f * c[2] + c[4];
+      float by = c[1] - 2.0f * c[3] + c[5];
+      float a = sqrtf(ax * ax + ay * ay);
+      float b = sqrtf(bx * bx + by * by);
+      uint32_t n = curve_segments(a > b ? a : b, 0.75f, tolerance);
+      for (uint32_t i = 1; i <= n; i++) {
+        float t = (float) i / (float) n;
+        float u = 1.0f - t;
+        float w0 = u * u * u;
+        float w1 = 3.0f * u * u * t;
+        float w2 = 3.0f * u * t * t;
+        float w3 = t * t * t;
+        polyline_add(poly, w0 * cursor[0] + w1 * c[0] + w2 * c[2] + w3 * c[4],
+                     w0 * cursor[1] + w1 * c[1] + w2 * c[3] + w3 * c[5]);
+      }
+      cursor[0] = c[4];
+      cursor[1] = c[5];
+      c += 6;
+    }
+  }
+}
+
+STRS_INTERN uint32_t mesh_vertex(mesh_builder *builder, float x, float y) {
+  strs_path_mesh *mesh = builder->mesh;
+  mesh->vertices = strs_grow_array(mesh->vertices, &builder->vertex_capacity, mesh->vertex_count + 1,
+                              sizeof(strs_vertex));
+  strs_vertex *vertex = &mesh->vertices[mesh->vertex_count];
+  vertex->pos[0] = x;
+  vertex->pos[1] = y;
+  memcpy(vertex->color, builder->color, sizeof(vec3));
+  return (uint32_t) mesh->vertex_count++;
+}
+
+STRS_INTERN void mesh_triangle(mesh_builder *builder, uint32_t a, uint32_t b, uint32_t c) {
+  strs_path_mesh *mesh = builder->mesh;
+  mesh->indices = strs_grow_array(mesh->indices, &builder->index_capacity, mesh->index_count + 3, sizeof(uint32_t));
+  mesh->indices[mesh->index_count++] = a;
+  mesh->indices[mesh->index_count++] = b;
+  mesh->indices[mesh->index_count++] = c;
+}
+
+STRS_INTERN void mesh_quad(mesh_builder *builder, const float *corners) {
+  uint32_t first = mesh_vertex(builder, corners[0], corners[1]);
+  mesh_vertex(builder, corners[2], corners[3]);
+  mesh_vertex(builder, corners[4], corners[5]);
+  mesh_vertex(builder, corners[6], corners[7]);
+  mesh_triangle(builder, first, first + 1, first + 2);
+  mesh_triangle(builder, first + 2, first + 3, first);
+}
+
+STRS_INTERN int compare_edges(const void *a, const void *b) {
+  float y0 = ((const path_edge*)a)->y0;
+  float y1 = ((const path_edge*)b)->y0;
+  return y0 < y1 ? -1 : y0 > y1;
+}
+
+STRS_INTERN int compare_floats(const void *a, const void *b) {
+  float x = *(const float*)a;
+  float y = *(const float*)b;
+  return x < y ? -1 : x > y;
+}
+
+STRS_INTERN int compare_crossings(const void *a, const void *b) {
+  return compare_floats(&((const slab_crossing*)a)->x, &((const slab_crossing*)b)->x);
+}
+
+STRS_INTERN float edge_x(const path_edge *edge, float y) {
+  return edge->x0 + (y - edge->y0) * (edge->x1 - edge->x0) / (edge->y1 - edge->y0);
+}
+
+// Where the edges cross strictly inside both of them
+STRS_INTERN bool edge_intersection(const path_edge *a, const path_edge *b, float *y) {
+  float ax = a->x1 - a->x0;
+  float ay = a->y1 - a->y0;
+  float bx = b->x1 - b->x0;
+  float by = b->y1 - b->y0;
+  float denominator = ax * by - ay * bx;
+  if (denominator == 0.0f) {
+    return false;
+  }
+  float t = ((b->x0 - a->x0) * by - (b->y0 - a->y0) * bx) / denominator;
+  float u = ((b->x0 - a->x0) * ay - (b->y0 - a->y0) * ax) / denominator;
+  if (t <= 0.0f || t >= 1.0f || u <= 0.0f || u >= 1.0f) {
+    return false;
+  }
+  *y = a->y0 + t * ay;
+  return true;
+}
+
+// Cuts the plane into slabs at every vertex and crossing, so no two edges cross inside a slab. Every span
+// between edges the fill rule counts as inside becomes a trapezoid.
+STRS_INTERN void fill_polyline(const path_polyline *poly, strs_fill_rule rule, mesh_builder *builder) {
+  path_edge *edges = malloc(sizeof(path_edge) * (poly->point_count + 1));
+  uint64_t edge_count = 0;
+  for (uint64_t c = 0; c < poly->contour_count; c++) {
+    const path_contour *contour = &poly->contours[c];
+    for (uint64_t i = 0; i < contour->count; i++) {
+      const float *a = &poly->points[(contour->first + i) * 2];
+      const float *b = &poly->points[(contour->first + (i + 1) % contour->count) * 2];
+      if (a[1] == b[1]) {
+        continue;
+      }
+      edges[edge_count++] = a[1] < b[1]
+                            ? (path_edge){a[0], a[1], b[0], b[1], 1}
+                            : (path_edge){b[0], b[1], a[0], a[1], -1};
+    }
+  }
+  // Empty paths and flat ones have nothing to fill, ys would stay NULL
+  if (edge_count == 0) {
+    free(edges);
+    return;
+  }
+  qsort(edges, edge_count, sizeof(path_edge), compare_edges);
+
+  float *ys = NULL;
+  uint64_t y_count = 0;
+  uint64_t y_capacity = 0;
+  for (uint64_t i = 0; i < edge_count; i++) {
+    ys = strs_grow_array(ys, &y_capacity, y_count + 2, sizeof(float));
+    ys[y_count++] = edges[i].y0;
+    ys[y_count++] = edges[i].y1;
+    for (uint64_t j = i + 1; j < edge_count && edges[j].y0 < edges[i].y1; j++) {
+      float y;
+      if (edge_intersection(&edges[i], &edges[j], &y)) {
+        ys = strs_grow_array(ys, &y_capacity, y_count + 1, sizeof(float));
+        ys[y_count++] = y;
+      }
+    }
+  }
+  qsort(ys, y_count, sizeof(float), compare_floats);
+
+  uint32_t *active = malloc(sizeof(uint32_t) * (edge_count + 1));
+  slab_crossing *crossings = malloc(sizeof(slab_crossing) * (edge_count + 1));
+  uint64_t active_count = 0;
+  uint64_t next = 0;
+  for (uint64_t s = 0; s + 1 < y_count; s++) {
+    float y0 = ys[s];
+    float y1 = ys[s + 1];
+    if (y1 <= y0) {
+      continue;
+    }
+
+    uint64_t kept = 0;
+    for (uint64_t i = 0; i < active_count; i++) {
+      if (edges[active[i]].y1 > y0) {
+        active[kept++] = active[i];
+      }
+    }
+    active_count = kept;
+    while (next < edge_count && edges[next].y0 <= y0) {
+      active[active_count++] = (uint32_t) next++;
+    }
+
+    float middle = (y0 + y1) * 0.5f;
+    uint64_t crossing_count = 0;
+    for (uint64_t i = 0; i < active_count; i++) {
+      const path_edge *edge = &edges[active[i]];
+      if (edge->y1 >= y1) {
+        float slope = (edge->x1 - edge->x0) / (edge->y1 - edge->y0);
+        crossings[crossing_count++] = (slab_crossing){edge_x(edge, middle), slope, edge->winding};
+      }
+    }
+    qsort(crossings, crossing_count, sizeof(slab_crossing), compare_crossings);
+
+    int32_t winding = 0;
+    float left = 0.0f;
+    float left_slope = 0.0f;
+    for (uint64_t i = 0; i < crossing_count; i++) {
+      bool was_inside = rule == STRS_FILL_NONZERO ? winding != 0 : (winding & 1) != 0;
+      winding += crossings[i].winding;
+      bool inside = rule == STRS_FILL_NONZERO ? winding != 0 : (winding & 1) != 0;
+      float slope = crossings[i].slope;
+      if (!was_inside && inside) {
+        left = crossings[i].x;
+        left_slope = slope;
+      } else if (was_inside && !inside) {
+        float h = (y1 - y0) * 0.5f;
+        const float corners[] = {
+          left - left_slope * h, y0,
+          crossings[i].x - slope * h, y0,
+          crossings[i].x + slope * h, y1,
+          left + left_slope * h, y1};
+        mesh_quad(builder, corners);
+      }
+    }
+  }
+
+  free(crossings);
+  free(active);
+  free(ys);
+  free(edges);
+}
+
+STRS_INTERN void stroke_fan(mesh_builder *builder, float cx, float cy, float radius, float start, float sweep,
+                            float tolerance) {
+  float step = radius > tolerance ? 2.0f * acosf(1.0f - tolerance / radius) : (float) M_PI_2;
+  float n = ceilf(fabsf(sweep) / step);
+  uint32_t segments = n < 1.0f ? 1 : n > PATH_MAX_SEGMENTS ? PATH_MAX_SEGMENTS : (uint32_t) n;
+  uint32_t center = mesh_vertex(builder, cx, cy);
+  uint32_t previous = mesh_vertex(builder, cx + cosf(start) * radius, cy + sinf(start) * radius);
+  for (uint32_t i = 1; i <= segments; i++) {
+    float angle = start + sweep * (float) i / (float) segments;
+    uint32_t vertex = mesh_vertex(builder, cx + cosf(angle) * radius, cy + sinf(angle) * radius);
+    mesh_triangle(builder, center, previous, vertex);
+    previous = vertex;
+  }
+}
+
+// d is the unit direction pointing away from the line
+STRS_INTERN void stroke_cap(mesh_builder *builder, const float *p, float dx, float dy, float half_width,
+                            strs_line_cap cap, float tolerance) {
+  float nx = -dy * half_width;
+  float ny = dx * half_width;
+  if (cap == STRS_LINE_CAP_SQUARE) {
+    const float corners[] = {
+      p[0] + nx, p[1] + ny,
+      p[0] + nx + dx * half_width, p[1] + ny + dy * half_width,
+      p[0] - nx + dx * half_width, p[1] - ny + dy * half_width,
+      p[0] - nx, p[1] - ny};
+    mesh_quad(builder, corners);
+  } else if (cap == STRS_LINE_CAP_ROUND) {
+    stroke_fan(builder, p[0], p[1], half_width, atan2f(ny, nx), (float) -M_PI, tolerance);
+  }
+}
+
+// The outer side of the corner at p between the unit directions d0 and d1
+STRS_INTERN void stroke_join(mesh_builder *builder, const float *p, const float *d0, const float *d1,
+                             float half_width, const strs_path_style *style, float tolerance) {
+  float cross = d0[0] * d1[1] - d0[1] * d1[0];
+  float dot = d0[0] * d1[0] + d0[1] * d1[1];
+  if (fabsf(cross) < 1e-6f && dot > 0.0f) {
+    return;
+  }
+  float side = cross > 0.0f ? -1.0f : 1.0f;
+  float n0[2] = {-d0[1] * half_width * side, d0[0] * half_width * side};
+  float n1[2] = {-d1[1] * half_width * side, d1[0] * half_width * side};
+
+  if (style->join == STRS_LINE_JOIN_ROUND) {
+    float start = atan2f(n0[1], n0[0]);
+    float sweep = atan2f(n1[1], n1[0]) - start;
+    sweep = sweep > (float) M_PI ? sweep - 2.0f * (float) M_PI : sweep;
+    sweep = sweep <= (float) -M_PI ? sweep + 2.0f * (float) M_PI : sweep;
+    stroke_fan(builder, p[0], p[1], half_width, start, sweep, tolerance);
+    return;
+  }
+
+  uint32_t center = mesh_vertex(builder, p[0], p[1]);
+  uint32_t outer0 = mesh_vertex(builder, p[0] + n0[0], p[1] + n0[1]);
+  uint32_t outer1 = mesh_vertex(builder, p[0] + n1[0], p[1] + n1[1]);
+  float limit = style->miter_limit > 0.0f ? style->miter_limit : PATH_DEFAULT_MITER_LIMIT;
+  if (style->join == STRS_LINE_JOIN_MITER && 1.0f + dot > 1e-6f) {
+    float mx = (n0[0] + n1[0]) / (1.0f + dot);
+    float my = (n0[1] + n1[1]) / (1.0f + dot);
+    if (mx * mx + my * my <= limit * limit * half_width * half_width) {
+      uint32_t tip = mesh_vertex(builder, p[0] + mx, p[1] + my);
+      mesh_triangle(builder, center, outer0, tip);
+      mesh_triangle(builder, center, tip, outer1);
+      return;
+    }
+  }
+  mesh_triangle(builder, center, outer0, outer1);
+}
+
+STRS_INTERN void direction(const float *a, const float *b, float *d) {
+  float dx = b[0] - a[0];
+  float dy = b[1] - a[1];
+  float length = sqrtf(dx * dx + dy * dy);
+  d[0] = dx / length;
+  d[1] = dy / length;
+}
+
+// A quad per segment, with joins between them and caps on open ends
+STRS_INTERN void stroke_polyline(const path_polyline *poly, const strs_path_style *style, float tolerance,
+                                 mesh_builder *builder) {
+  float half_width = style->stroke_width * 0.5f;
+  for (uint64_t c = 0; c < poly->contour_count; c++) {
+    const path_contour *contour = &poly->contours[c];
+    const float *p = &poly->points[contour->first * 2];
+    uint64_t n = contour->count;
+    // A closing segment back onto the start point is left out, the join covers it
+    if (n > 1 && p[0] == p[(n - 1) * 2] && p[1] == p[(n - 1) * 2 + 1]) {
+      n--;
+    }
+    if (n < 2) {
+      continue;
+    }
+    bool closed = contour->closed && n > 2;
+    uint64_t segments = closed ? n : n - 1;
+
+    for (uint64_t i = 0; i < segments; i++) {
+      const float *a = &p[i * 2];
+      const float *b = &p[((i + 1) % n) * 2];
+      float d[2];
+      direction(a, b, d);
+      float nx = -d[1] * half_width;
+      float ny = d[0] * half_width;
+      const float corners[] = {
+        a[0] + nx, a[1] + ny,
+        b[0] + nx, b[1] + ny,
+        b[0] - nx, b[1] - ny,
+        a[0] - nx, a[1] - ny};
+      mesh_quad(builder, corners);
+    }
+
+    for (uint64_t i = closed ? 0 : 1; i < (closed ? n : n - 1); i++) {
+      float d0[2];
+      float d1[2];
+      direction(&p[((i + n - 1) % n) * 2], &p[i * 2], d0);
+      direction(&p[i * 2], &p[((i + 1) % n) * 2], d1);
+      stroke_join(builder, &p[i * 2], d0, d1, half_width, style, tolerance);
+    }
+
+    if (!closed) {
+      float d[2];
+      direction(&p[2], &p[0], d);
+      stroke_cap(builder, &p[0], d[0], d[1], half_width, style->cap, tolerance);
+      direction(&p[(n - 2) * 2], &p[(n - 1) * 2], d);
+      stroke_cap(builder, &p[(n - 1) * 2], d[0], d[1], half_width, style->cap, tolerance);
+    }
+  }
+}
+
+STRS_LIB void strs_path_tessellate(strs_path path, const strs_path_style *style, float scale, strs_path_mesh *mesh) {
+  internal_strs_path *intern_path = (internal_strs_path*)path;
+  path_polyline poly = {0};
+  float tolerance = PATH_TOLERANCE / (scale > 1e-6f ? scale : 1e-6f);
+
+  *mesh = (strs_path_mesh){0};
+  flatten_path(intern_path, tolerance, &poly);
+
+  mesh_builder builder = {.mesh = mesh};
+  if (style->fill) {
+    builder.color = style->fill_color;
+    fill_polyline(&poly, style->fill_rule, &builder);
+  }
+  if (style->stroke_width > 0.0f) {
+    builder.color = style->stroke_color;
+    stroke_polyline(&poly, style, tolerance, &builder);
+  }
+
+  free(poly.points);
+  free(poly.contours);
+}
+
+STRS_LIB void strs_path_mesh_free(strs_path_mesh *mesh) {
+  free(mesh->vertices);
+  free(mesh->indices);
+  *mesh = (strs_path_mesh){0};
+}
+
+STRS_LIB strs_path_cache strs_path_cache_create(strs_jobs jobs, uint64_t budget_bytes) {
+  internal_strs_path_cache *cache = calloc(1, sizeof(internal_strs_path_cache));
+  cache->jobs = jobs;
+  cache->budget_bytes = budget_bytes;
+  strs_pool_init(&cache->tasks, sizeof(path_task), 32);
+  cache->free_entry = PATH_ENTRY_NONE;
+  for (uint32_t i = 0; i < PATH_CACHE_BUCKETS; i++) {
+    cache->buckets[i] = PATH_ENTRY_NONE;
+  }
+  return (strs_path_cache)cache;
+}
+
+STRS_INTERN void free_path_task(internal_strs_path_cache *cache, path_task *task) {
+  free(task->path.verbs);
+  free(task->path.coords);
+  strs_path_mesh_free(&task->mesh);
+  strs_pool_release(&cache->tasks, task);
+}
+
+STRS_LIB void strs_path_cache_free(strs_path_cache cache) {
+  internal_strs_path_cache *intern_cache = (internal_strs_path_cache*)cache;
+  for (uint64_t i = 0; i < intern_cache->entry_count; i++) {
+    path_entry *entry = &intern_cache->entries[i];
+    if (entry->task != NULL) {
+      strs_jobs_wait(intern_cache->jobs, entry->job);
+      free_path_task(intern_cache, entry->task);
+    }
+    free(entry->path.verbs);
+    free(entry->path.coords);
+    strs_path_mesh_free(&entry->mesh);
+  }
+  strs_pool_free(&intern_cache->tasks);
+  free(intern_cache->indices);
+  free(intern_cache->entries);
+  free(intern_cache);
+}
+
+STRS_INTERN void tessellate_task(void *data) {
+  path_task *task = (path_task*)data;
+  strs_path_tessellate((strs_path)&task->path, &task->style, task->scale, &task->mesh);
+}
+
+// The scale is rounded up to a quarter octave, a mesh is never coarser than the scale asks for
+STRS_INTERN int32_t scale_bucket(float scale) {
+  return (int32_t) ceilf(log2f(scale > 1e-3f ? scale : 1e-3f) * 4.0f);
+}
+
+STRS_INTERN uint64_t path_key(const internal_strs_path *path, const strs_path_style *style, int32_t bucket) {
+  uint64_t hash = path->hash;
+  hash = hash_bytes(hash, &style->fill, sizeof(style->fill));
+  if (style->fill) {
+    hash = hash_bytes(hash, &style->fill_rule, sizeof(style->fill_rule));
+    hash = hash_bytes(hash, style->fill_color, sizeof(vec3));
+  }
+  hash = hash_bytes(hash, &style->stroke_width, sizeof(style->stroke_width));
+  if (style->stroke_width > 0.0f) {
+    hash = hash_bytes(hash, style->stroke_color, sizeof(vec3));
+    hash = hash_bytes(hash, &style->join, sizeof(style->join));
+    hash = hash_bytes(hash, &style->cap, sizeof(style->cap));
+    hash = hash_bytes(hash, &style->miter_limit, sizeof(style->miter_limit));
+  }
+  return hash_bytes(hash, &bucket, sizeof(bucket));
+}
+
+STRS_INTERN bool same_bytes(const void *a, const void *b, size_t size) {
+  return size == 0 || memcmp(a, b, size) == 0;
+}
+
+// Compares what path_key hashes of the styles
+STRS_INTERN bool same_style(const strs_path_style *a, const strs_path_style *b) {
+  if (a->fill != b->fill || !same_bytes(&a->stroke_width, &b->stroke_width, sizeof(a->stroke_width))) {
+    return false;
+  }
+  if (a->fill && (a->fill_rule != b->fill_rule || !same_bytes(a->fill_color, b->fill_color, sizeof(vec3)))) {
+    return false;
+  }
+  return a->stroke_width <= 0.0f ||
+         (same_bytes(a->stroke_color, b->stroke_color, sizeof(vec3)) && a->join == b->join && a->cap == b->cap &&
+          same_bytes(&a->miter_limit, &b->miter_limit, sizeof(a->miter_limit)));
+}
+
+// Keys that are equal are only candidates, two different paths or styles may hash alike
+STRS_INTERN bool entry_matches(const path_entry *entry, uint64_t key, const internal_strs_path *path,
+                               const strs_path_style *style, int32_t bucket) {
+  const internal_strs_path *stored = entry->task != NULL ? &entry->task->path : &entry->path;
+  return entry->key == key && entry->bucket == bucket && stored->verb_count == path->verb_count &&
+         stored->coord_count == path->coord_count && same_bytes(stored->verbs, path->verbs, path->verb_count) &&
+         same_bytes(stored->coords, path->coords, sizeof(float) * path->coord_count) &&
+         same_style(&entry->style, style);
+}
+
+STRS_INTERN void remove_entry(internal_strs_path_cache *cache, uint32_t index) {
+  path_entry *entry = &cache->entries[index];
+  uint32_t *link = &cache->buckets[entry->key % PATH_CACHE_BUCKETS];
+  while (*link != index) {
+    link = &cache->entries[*link].next;
+  }
+  *link = entry->next;
+
+  cache->stats.bytes -= entry->bytes;
+  cache->stats.mesh_count--;
+  cache->stats.evictions++;
+  free(entry->path.verbs);
+  free(entry->path.coords);
+  strs_path_mesh_free(&entry->mesh);
+  *entry = (path_entry){.next = cache->free_entry};
+  cache->free_entry = index;
+}
+
+// Drops the least recently used meshes until the cache fits its budget again, keep stays
+STRS_INTERN void evict_entries(internal_strs_path_cache *cache, uint32_t keep) {
+  while (cache->stats.bytes > cache->budget_bytes) {
+    uint32_t oldest = PATH_ENTRY_NONE;
+    for (uint32_t i = 0; i < cache->entry_count; i++) {
+      const path_entry *entry = &cache->entries[i];
+      if (entry->used && entry->task == NULL && i != keep &&
+          (oldest == PATH_ENTRY_NONE || entry->last_used < cache->entries[oldest].last_used)) {
+        oldest = i;
+      }
+    }
+    if (oldest == PATH_ENTRY_NONE) {
+      return;
+    }
+    remove_entry(cache, oldest);
+  }
+}
+
+// Takes the mesh from the job once it finished, wait helps the jobs until it did
+STRS_INTERN void adopt_mesh(internal_strs_path_cache *cache, uint32_t index, bool wait) {
+  path_entry *entry = &cache->entries[index];
+  if (entry->task == NULL) {
+    return;
+  }
+  if (wait) {
+    strs_jobs_wait(cache->jobs, entry->job);
+  } else if (!strs_jobs_done(cache->jobs, entry->job)) {
+    return;
+  }
+  entry->mesh = entry->task->mesh;
+  entry->path = entry->task->path;
+  entry->task->mesh = (strs_path_mesh){0};
+  entry->task->path = (internal_strs_path){0};
+  free_path_task(cache, entry->task);
+  entry->task = NULL;
+  entry->job = STRS_JOB_NONE;
+  entry->bytes = sizeof(strs_vertex) * entry->mesh.vertex_count + sizeof(uint32_t) * entry->mesh.index_count +
+                 entry->path.verb_count + sizeof(float) * entry->path.coord_count;
+  cache->stats.bytes += entry->bytes;
+  evict_entries(cache, index);
+}
+
+STRS_INTERN uint32_t request_mesh(internal_strs_path_cache *cache, const internal_strs_path *path,
+                                  const strs_path_style *style, float scale) {
+  int32_t bucket = scale_bucket(scale);
+  uint64_t key = path_key(path, style, bucket);
+  uint32_t index = cache->buckets[key % PATH_CACHE_BUCKETS];
+  while (index != PATH_ENTRY_NONE && !entry_matches(&cache->entries[index], key, path, style, bucket)) {
+    index = cache->entries[index].next;
+  }
+  if (index != PATH_ENTRY_NONE) {
+    cache->stats.hits++;
+    cache->entries[index].last_used = ++cache->clock;
+    adopt_mesh(cache, index, false);
+    return index;
+  }
+
+  cache->stats.misses++;
+  if (cache->free_entry != PATH_ENTRY_NONE) {
+    index = cache->free_entry;
+    cache->free_entry = cache->entries[index].next;
+  } else {
+    cache->entries = strs_grow_array(cache->entries, &cache->entry_capacity, cache->entry_count + 1, sizeof(path_entry));
+    index = (uint32_t) cache->entry_count++;
+  }
+
+  path_task *task = strs_pool_alloc(&cache->tasks);
+  *task = (path_task){0};
+  task->path.verbs = malloc(path->verb_count + 1);
+  task->path.verb_count = path->verb_count;
+  task->path.coords = malloc(sizeof(float) * (path->coord_count + 1));
+  task->path.coord_count = path->coord_count;
+  // An empty path has no arrays yet
+  if (path->verb_count > 0) {
+    memcpy(task->path.verbs, path->verbs, path->verb_count);
+  }
+  if (path->coord_count > 0) {
+    memcpy(task->path.coords, path->coords, sizeof(float) * path->coord_count);
+  }
+  task->style = *style;
+  task->scale = exp2f((float) bucket / 4.0f);
+
+  cache->entries[index] = (path_entry){
+    .key = key,
+    .next = cache->buckets[key % PATH_CACHE_BUCKETS],
+    .used = true,
+    .task = task,
+    .style = *style,
+    .bucket = bucket,
+    .last_used = ++cache->clock};
+  cache->buckets[key % PATH_CACHE_BUCKETS] = index;
+  cache->stats.mesh_count++;
+  cache->entries[index].job = strs_jobs_spawn(cache->jobs, tessellate_task, task, NULL, 0);
+  return index;
+}
+
+STRS_LIB void strs_path_cache_prefetch(strs_path_cache cache, strs_path path, const strs_path_style *style,
+                                       float scale) {
+  request_mesh((internal_strs_path_cache*)cache, (internal_strs_path*)path, style, scale);
+}
+
+STRS_LIB void strs_path_cache_get_stats(strs_path_cache cache, strs_path_cache_stats *stats) {
+  *stats = ((internal_strs_path_cache*)cache)->stats;
+}
+
+STRS_LIB uint32_t strs_push_path(strs_app app, strs_path_cache cache, strs_path path, const strs_path_style *style,
+                                 float scale) {
+  internal_strs_path_cache *intern_cache = (internal_strs_path_cache*)cache;
+  uint32_t index = request_mesh(intern_cache, (internal_strs_path*)path, style, scale);
+  adopt_mesh(intern_cache, index, true);
+
+  const strs_path_mesh *mesh = &intern_cache->entries[index].mesh;
+  if (mesh->vertex_count == 0) {
+    return (uint32_t) strs_app_vertex_count(app);
+  }
+  uint32_t first = strs_push_vertices(app, mesh->vertices, mesh->vertex_count);
+  intern_cache->indices = strs_grow_array(intern_cache->indices, &intern_cache->index_capacity, mesh->index_count,
+                                     sizeof(uint32_t));
+  for (uint64_t i = 0; i < mesh->index_count; i++) {
+    intern_cache->indices[i] = first + mesh->indices[i];
+  }
+  strs_push_indices32(app, intern_cache->indices, mesh->index_count);
+  return first;
+}
@@ -0,0 +1,100 @@
+#ifndef STEROS_PATH_H
+#define STEROS_PATH_H
+
+#include "steros.h"
+#include "app.h"
+#include "jobs.h"
+
+// STD
+#include <stdbool.h>
+#include <stdint.h>
+
+// Vector paths, tessellated into the same triangles as the rest of the geometry. Curves are flattened to
+// a tolerance of a quarter unit at the scale the path is drawn at.
+typedef struct {
+  uint32_t not_used;
+} *strs_path;
+
+typedef enum {
+  STRS_FILL_NONZERO,
+  STRS_FILL_EVEN_ODD
+} strs_fill_rule;
+
+typedef enum {
+  STRS_LINE_JOIN_MITER,
+  STRS_LINE_JOIN_BEVEL,
+  STRS_LINE_JOIN_ROUND
+} strs_line_join;
+
+typedef enum {
+  STRS_LINE_CAP_BUTT,
+  STRS_LINE_CAP_SQUARE,
+  STRS_LINE_CAP_ROUND
+} strs_line_cap;
+
+typedef struct {
+  bool fill;
+  strs_fill_rule fill_rule;
+  vec3 fill_color;
+  // 0 for no stroke, drawn over the fill
+  float stroke_width;
+  vec3 stroke_color;
+  strs_line_join join;
+  strs_line_cap cap;
+  // Miter joins longer than this many stroke widths are beveled, 4 when 0
+  float miter_limit;
+} strs_path_style;
+
+// Indices are relative to the first vertex
+typedef struct {
+  strs_vertex *vertices;
+  uint64_t vertex_count;
+  uint32_t *indices;
+  uint64_t index_count;
+} strs_path_mesh;
+
+STRS_LIB strs_path strs_path_create(void);
+STRS_LIB void strs_path_free(strs_path path);
+STRS_LIB void strs_path_reset(strs_path path);
+// Every subpath starts with a move, drawing without one starts at 0, 0
+STRS_LIB void strs_path_move_to(strs_path path, float x, float y);
+STRS_LIB void strs_path_line_to(strs_path path, float x, float y);
+STRS_LIB void strs_path_quad_to(strs_path path, float cx, float cy, float x, float y);
+STRS_LIB void strs_path_cubic_to(strs_path path, float c1x, float c1y, float c2x, float c2y, float x, float y);
+STRS_LIB void strs_path_close(strs_path path);
+
+// Fills with trapezoids between the edges, so self intersecting paths follow the fill rule exactly.
+// scale is the world scale the mesh is drawn at.
+STRS_LIB void strs_path_tessellate(strs_path path, const strs_path_style *style, float scale, strs_path_mesh *mesh);
+STRS_LIB void strs_path_mesh_free(strs_path_mesh *mesh);
+
+// Meshes keyed by the path's commands, the style and the scale rounded up to a quarter octave. Misses are
+// tessellated on the jobs and the least recently used meshes are dropped once they exceed budget_bytes.
+// From one thread at a time, like the rest of the scene building.
+typedef struct {
+  uint32_t not_used;
+} *strs_path_cache;
+
+typedef struct {
+  uint64_t mesh_count;
+  uint64_t bytes;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+} strs_path_cache_stats;
+
+STRS_LIB strs_path_cache strs_path_cache_create(strs_jobs jobs, uint64_t budget_bytes);
+// Waits for the tessellations that are still running
+STRS_LIB void strs_path_cache_free(strs_path_cache cache);
+// Starts tessellating the mesh unless it is cached, so a batch of paths is tessellated in parallel
+// before strs_push_path needs them
+STRS_LIB void strs_path_cache_prefetch(strs_path_cache cache, strs_path path, const strs_path_style *style,
+                                       float scale);
+STRS_LIB void strs_path_cache_get_stats(strs_path_cache cache, strs_path_cache_stats *stats);
+
+// Pushes the path's mesh into the current transform node, helping the jobs until it is tessellated on a
+// miss. Returns the first vertex stored.
+STRS_LIB uint32_t strs_push_path(strs_app app, strs_path_cache cache, strs_path path, const strs_path_style *style,
+                                 float scale);
+
+#endif //STEROS_PATH_H
@@ -0,0 +1,251 @@
+// STD
+#include <math.h>
+#include <float.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define STRS_RECTS_SSE2
+#endif
+
+// LIB
+#include "app.h"
+
+// Every rect becomes four corners in the order top left, top right, bottom right, bottom left
+// and two triangles 0 1 2 / 2 3 0, the same layout the button uses
+static const uint32_t RECT_INDEX_PATTERN[STRS_RECT_INDEX_COUNT] = {0, 1, 2, 2, 3, 0};
+
+STRS_INTERN uint8_t rect_channel(float value) {
+  if (value <= 0.0f) {
+    return 0;
+  }
+  if (value >= 1.0f) {
+    return 255;
+  }
+  return (uint8_t) (value * 255.0f + 0.5f);
+}
+
+STRS_INTERN int16_t rect_position(float value) {
+  // lrintf rounds like the SSE conversion so both kernels produce identical output
+  long scaled = lrintf(value * STRS_VERTEX_COMPACT_SCALE);
+  if (scaled > INT16_MAX) {
+    return INT16_MAX;
+  }
+  if (scaled < INT16_MIN) {
+    return INT16_MIN;
+  }
+  return (int16_t) scaled;
+}
+
+STRS_LIB void strs_rects_fill_vertices_scalar(strs_vertex_format format, const strs_rect *rects, const vec3 *colors,
+                                              uint64_t count, void *dst) {
+  for (uint64_t i = 0; i < count; i++) {
+    const strs_rect *rect = &rects[i];
+    float xs[4] = {rect->x, rect->x + rect->width, rect->x + rect->width, rect->x};
+    float ys[4] = {rect->y, rect->y, rect->y + rect->height, rect->y + rect->height};
+    float color[3] = {0.0f, 0.0f, 0.0f};
+    if (colors != NULL) {
+      memcpy(color, colors[i], sizeof(color));
+    }
+
+    switch (format) {
+      case STRS_VERTEX_FORMAT_DEFAULT: {
+        strs_vertex *vertices = (strs_vertex*)dst + i * STRS_RECT_VERTEX_COUNT;
+        for (uint32_t k = 0; k < STRS_RECT_VERTEX_COUNT; k++) {
+          vertices[k].pos[0] = xs[k];
+          vertices[k].pos[1] = ys[k];
+          memcpy(vertices[k].color, color, sizeof(color));
+        }
+        break;
+      }
+      case STRS_VERTEX_FORMAT_COMPACT: {
+        strs_vertex_compact *vertices = (strs_vertex_compact*)dst + i * STRS_RECT_VERTEX_COUNT;
+        for (uint32_t k = 0; k < STRS_RECT_VERTEX_COUNT; k++) {
+          vertices[k].pos[0] = rect_position(xs[k]);
+          vertices[k].pos[1] = rect_position(ys[k]);
+          vertices[k].color[0] = rect_channel(color[0]);
+          vertices[k].color[1] = rect_channel(color[1]);
+          vertices[k].color[2] = rect_channel(color[2]);
+          vertices[k].color[3] = 255;
+        }
+        break;
+      }
+      case STRS_VERTEX_FORMAT_COMPACT_UV: {
+        strs_vertex_compact_uv *vertices = (strs_vertex_compact_uv*)dst + i * STRS_RECT_VERTEX_COUNT;
+        for (uint32_t k = 0; k < STRS_RECT_VERTEX_COUNT; k++) {
+          vertices[k].pos[0] = rect_position(xs[k]);
+          vertices[k].pos[1] = rect_position(ys[k]);
+          vertices[k].color[0] = rect_channel(color[0]);
+          vertices[k].color[1] = rect_channel(color[1]);
+          vertices[k].color[2] = rect_channel(color[2]);
+          vertices[k].color[3] = 255;
+          vertices[k].uv[0] = (k == 1 || k == 2) ? UINT16_MAX : 0;
+          vertices[k].uv[1] = (k >= 2) ? UINT16_MAX : 0;
+        }
+        break;
+      }
+    }
+  }
+}
+
+STRS_LIB void strs_rects_fill_indices_scalar(uint32_t first_vertex, uint64_t count, uint32_t *dst) {
+  for (uint64_t i = 0; i < count; i++) {
+    uint32_t base = first_vertex + (uint32_t) (i * STRS_RECT_VERTEX_COUNT);
+    for (uint32_t k = 0; k < STRS_RECT_INDEX_COUNT; k++) {
+      dst[i * STRS_RECT_INDEX_COUNT + k] = base + RECT_INDEX_PATTERN[k];
+    }
+  }
+}
+
+STRS_LIB void strs_rects_bounds_scalar(const strs_rect *rects, uint64_t count, float *bounds) {
+  bounds[0] = FLT_MAX;
+  bounds[1] = FLT_MAX;
+  bounds[2] = -FLT_MAX;
+  bounds[3] = -FLT_MAX;
+  for (uint64_t i = 0; i < count; i++) {
+    float right = rects[i].x + rects[i].width;
+    float bottom = rects[i].y + rects[i].height;
+    bounds[0] = rects[i].x < bounds[0] ? rects[i].x : bounds[0];
+    bounds[1] = rects[i].y < bounds[1] ? rects[i].y : bounds[1];
+    bounds[2] = right > bounds[2] ? right : bounds[2];
+    bounds[3] = bottom > bounds[3] ? bottom : bounds[3];
+  }
+}
+
+#if defined(STRS_RECTS_SSE2)
+
+// Lane order of the result is a, b, c, d, the first two taken from x and the last two from y
+#define RECT_SHUFFLE(x, y, a, b, c, d) _mm_shuffle_ps(x, y, _MM_SHUFFLE(d, c, b, a))
+
+// Corners of the rect as x, y, x + width, y + height
+STRS_INTERN inline __m128 rect_corners(const strs_rect *rect) {
+  __m128 r = _mm_loadu_ps(&rect->x);
+  return _mm_add_ps(_mm_movelh_ps(r, r), _mm_movelh_ps(_mm_setzero_ps(), _mm_movehl_ps(r, r)));
+}
+
+STRS_INTERN inline __m128 rect_color(const vec3 *colors, uint64_t i, float alpha) {
+  if (colors == NULL) {
+    return _mm_set_ps(alpha, 0.0f, 0.0f, 0.0f);
+  }
+  return _mm_set_ps(alpha, colors[i][2], colors[i][1], colors[i][0]);
+}
+
+// Four strs_vertex are 20 floats, written as five unaligned stores
+STRS_INTERN void rects_fill_default(const strs_rect *rects, const vec3 *colors, uint64_t count, float *dst) {
+  for (uint64_t i = 0; i < count; i++, dst += 20) {
+    __m128 p = rect_corners(&rects[i]);
+    __m128 c = rect_color(colors, i, 0.0f);
+
+    __m128 f0 = RECT_SHUFFLE(p, c, 0, 1, 0, 1);
+    __m128 f1 = RECT_SHUFFLE(RECT_SHUFFLE(c, p, 2, 2, 2, 2), RECT_SHUFFLE(p, c, 1, 1, 0, 0), 0, 2, 0, 2);
+    __m128 f2 = RECT_SHUFFLE(c, p, 1, 2, 2, 3);
+    __m128 f3 = RECT_SHUFFLE(c, RECT_SHUFFLE(c, p, 2, 2, 0, 0), 0, 1, 0, 2);
+    __m128 f4 = RECT_SHUFFLE(RECT_SHUFFLE(p, c, 3, 3, 0, 0), c, 0, 2, 1, 2);
+
+    _mm_storeu_ps(dst, f0);
+    _mm_storeu_ps(dst + 4, f1);
+    _mm_storeu_ps(dst + 8, f2);
+    _mm_storeu_ps(dst + 12, f3);
+    _mm_storeu_ps(dst + 16, f4);
+  }
+}
+
+// Four strs_vertex_compact are 32 bytes, positions are packed to int16 pairs and interleaved with the color
+STRS_INTERN void rects_fill_compact(const strs_rect *rects, const vec3 *colors, uint64_t count, uint8_t *dst) {
+  const __m128 scale = _mm_set1_ps(STRS_VERTEX_COMPACT_SCALE);
+  const __m128 channel_scale = _mm_set1_ps(255.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 low = _mm_set1_ps(INT16_MIN);
+  const __m128 high = _mm_set1_ps(INT16_MAX);
+
+  for (uint64_t i = 0; i < count; i++, dst += 32) {
+    __m128 scaled = _mm_min_ps(_mm_max_ps(_mm_mul_ps(rect_corners(&rects[i]), scale), low), high);
+    __m128i p = _mm_cvtps_epi32(scaled);
+    // x, y, x1, y1 as int16, then x1, y, x, y1 so every corner is one 32 bit lane
+    p = _mm_packs_epi32(p, p);
+    __m128i q = _mm_shufflelo_epi16(p, _MM_SHUFFLE(3, 0, 1, 2));
+    __m128i positions = _mm_unpacklo_epi32(p, q);
+
+    __m128 c = _mm_min_ps(_mm_max_ps(rect_color(colors, i, 1.0f), zero), one);
+    __m128i channels = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(c, channel_scale), half));
+    channels = _mm_packs_epi32(channels, channels);
+    channels = _mm_packus_epi16(channels, channels);
+    __m128i color = _mm_shuffle_epi32(channels, _MM_SHUFFLE(0, 0, 0, 0));
+
+    _mm_storeu_si128((__m128i*)dst, _mm_unpacklo_epi32(positions, color));
+    _mm_storeu_si128((__m128i*)(dst + 16), _mm_unpackhi_epi32(positions, color));
+  }
+}
+
+// Two rects per iteration produce twelve indices, three stores
+STRS_INTERN void rects_fill_indices(uint32_t first_vertex, uint64_t count, uint32_t *dst) {
+  const __m128i step = _mm_set1_epi32(2 * STRS_RECT_VERTEX_COUNT);
+  __m128i base = _mm_set1_epi32((int32_t) first_vertex);
+  __m128i a = _mm_add_epi32(base, _mm_setr_epi32(0, 1, 2, 2));
+  __m128i b = _mm_add_epi32(base, _mm_setr_epi32(3, 0, 4, 5));
+  __m128i c = _mm_add_epi32(base, _mm_setr_epi32(6, 6, 7, 4));
+  uint64_t i = 0;
+
+  for (; i + 2 <= count; i += 2, dst += 2 * STRS_RECT_INDEX_COUNT) {
+    _mm_storeu_si128((__m128i*)dst, a);
+    _mm_storeu_si128((__m128i*)(dst + 4), b);
+    _mm_storeu_si128((__m128i*)(dst + 8), c);
+    a = _mm_add_epi32(a, step);
+    b = _mm_add_epi32(b, step);
+    c = _mm_add_epi32(c, step);
+  }
+  if (i < count) {
+    strs_rects_fill_indices_scalar(first_vertex + (uint32_t) (i * STRS_RECT_VERTEX_COUNT), count - i, dst);
+  }
+}
+
+STRS_INTERN void rects_bounds(const strs_rect *rects, uint64_t count, float *bounds) {
+  // Lanes hold min x, min y, -max x, -max y so a single min covers all four
+  const __m128 sign = _mm_set_ps(-0.0f, -0.0f, 0.0f, 0.0f);
+  __m128 result = _mm_set1_ps(FLT_MAX);
+
+  for (uint64_t i = 0; i < count; i++) {
+    __m128 corners = _mm_xor_ps(rect_corners(&rects[i]), sign);
+    result = _mm_min_ps(result, corners);
+  }
+
+  result = _mm_xor_ps(result, sign);
+  _mm_storeu_ps(bounds, result);
+}
+
+#endif
+
+STRS_LIB void strs_rects_fill_vertices(strs_vertex_format format, const strs_rect *rects, const vec3 *colors,
+                                       uint64_t count, void *dst) {
+#if defined(STRS_RECTS_SSE2)
+  if (format == STRS_VERTEX_FORMAT_DEFAULT) {
+    rects_fill_default(rects, colors, count, (float*)dst);
+    return;
+  }
+  if (format == STRS_VERTEX_FORMAT_COMPACT) {
+    rects_fill_compact(rects, colors, count, (uint8_t*)dst);
+    return;
+  }
+#endif
+  strs_rects_fill_vertices_scalar(format, rects, colors, count, dst);
+}
+
+STRS_LIB void strs_rects_fill_indices(uint32_t first_vertex, uint64_t count, uint32_t *dst) {
+#if defined(STRS_RECTS_SSE2)
+  rects_fill_indices(first_vertex, count, dst);
+#else
+  strs_rects_fill_indices_scalar(first_vertex, count, dst);
+#endif
+}
+
+STRS_LIB void strs_rects_bounds(const strs_rect *rects, uint64_t count, float *bounds) {
+#if defined(STRS_RECTS_SSE2)
+  if (count > 0) {
+    rects_bounds(rects, count, bounds);
+    return;
+  }
+#endif
+  strs_rects_bounds_scalar(rects, count, bounds);
+}
@@ -0,0 +1,651 @@
+// STD
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define STRS_SOFT_SSE2
+#endif
+
+// LIB
+#include "soft.h"
+#include "helper/alloc.h"
+#include "helper/clock.h"
+
+// XCB
+#include <xcb/shm.h>
+
+// Tiles are drawn into a buffer of their own on the stack, a multiple of 4 wide for the SIMD spans
+#define SOFT_TILE_SIZE 64
+// Weights of pixels on an edge that is not a top or left one are pushed below 0 by this much
+#define SOFT_EDGE_BIAS 1e-6f
+
+// Edges are a * x + b * y + c, scaled so they are the barycentric weight of the opposite vertex
+typedef struct {
+  float edges[3][3];
+  float colors[3][3];
+  int32_t bounds[4];
+} soft_triangle;
+
+// A strs_shape set up for the pixels, inverse maps them into the shape's space centered on its rect
+typedef struct {
+  float inverse[6];
+  float half_size[2];
+  float radius;
+  float border_width;
+  float shadow_blur;
+  float shadow_offset[2];
+  float fill_color[4];
+  float border_color[4];
+  float shadow_color[4];
+  // Width of one pixel in shape units
+  float aa;
+  int32_t bounds[4];
+} soft_shape;
+
+// What lands in a tile, in drawing order
+typedef struct {
+  uint32_t *shapes;
+  uint64_t shape_count;
+  uint64_t shape_capacity;
+  uint32_t *triangles;
+  uint64_t triangle_count;
+  uint64_t triangle_capacity;
+} soft_tile;
+
+typedef struct {
+  void *soft;
+  uint32_t tile;
+} soft_tile_job;
+
+typedef struct {
+  strs_jobs jobs;
+  uint32_t width;
+  uint32_t height;
+  uint32_t *pixels;
+  uint32_t tiles_x;
+  uint32_t tiles_y;
+  soft_tile *tiles;
+  soft_tile_job *tile_jobs;
+  strs_job *tile_handles;
+  uint32_t clear_pixel;
+  strs_vertex *vertices;
+  uint64_t vertex_capacity;
+  soft_triangle *triangles;
+  uint64_t triangle_count;
+  uint64_t triangle_capacity;
+  soft_shape *shapes;
+  uint64_t shape_count;
+  uint64_t shape_capacity;
+  strs_soft_stats stats;
+  // Once presented through MIT-SHM the pixels live in a segment the server of shm_connection has attached
+  xcb_connection_t *shm_connection;
+  xcb_shm_seg_t shm_seg;
+  // The server is read from the segment once this round trip is answered
+  xcb_get_input_focus_cookie_t shm_sync;
+  bool shm_pending;
+  // Has no MIT-SHM or could not attach a segment, presents to it take the PutImage path
+  xcb_connection_t *shm_refused;
+} internal_strs_soft;
+
+STRS_INTERN float clamp01(float value) {
+  return value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+}
+
+STRS_INTERN uint32_t pack_pixel(float r, float g, float b, float a) {
+  return (uint32_t) (clamp01(a) * 255.0f + 0.5f) << 24 | (uint32_t) (clamp01(r) * 255.0f + 0.5f) << 16 |
+         (uint32_t) (clamp01(g) * 255.0f + 0.5f) << 8 | (uint32_t) (clamp01(b) * 255.0f + 0.5f);
+}
+
+STRS_LIB void strs_soft_fill_span_scalar(uint32_t *row, int32_t x0, int32_t x1, float y, const float edges[3][3],
+                                         const float colors[3][3]) {
+  for (int32_t x = x0; x < x1; x++) {
+    float px = (float) x + 0.5f;
+    float w[3];
+    for (uint32_t i = 0; i < 3; i++) {
+      w[i] = edges[i][0] * px + edges[i][1] * y + edges[i][2];
+    }
+    if (w[0] < 0.0f || w[1] < 0.0f || w[2] < 0.0f) {
+      continue;
+    }
+    row[x] = pack_pixel(w[0] * colors[0][0] + w[1] * colors[1][0] + w[2] * colors[2][0],
+                        w[0] * colors[0][1] + w[1] * colors[1][1] + w[2] * colors[2][1],
+                        w[0] * colors[0][2] + w[1] * colors[1][2] + w[2] * colors[2][2], 1.0f);
+  }
+}
+
+STRS_LIB void strs_soft_blend_scalar(uint32_t *pixel, const float src[4]) {
+  float inverse = 1.0f - src[3];
+  float b = (float) (*pixel & 0xFF) / 255.0f;
+  float g = (float) (*pixel >> 8 & 0xFF) / 255.0f;
+  float r = (float) (*pixel >> 16 & 0xFF) / 255.0f;
+  float a = (float) (*pixel >> 24) / 255.0f;
+  *pixel = pack_pixel(src[0] + r * inverse, src[1] + g * inverse, src[2] + b * inverse, src[3] + a * inverse);
+}
+
+#if defined(STRS_SOFT_SSE2)
+
+// Four pixels at a time, the edge functions of all of them in one register each
+STRS_INTERN void fill_span_sse2(uint32_t *row, int32_t x0, int32_t x1, float y, const float edges[3][3],
+                                const float colors[3][3]) {
+  __m128 a[3];
+  __m128 rows[3];
+  for (uint32_t i = 0; i < 3; i++) {
+    a[i] = _mm_set1_ps(edges[i][0]);
+    rows[i] = _mm_set1_ps(edges[i][1] * y + edges[i][2]);
+  }
+  const __m128 centers = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 scale = _mm_set1_ps(255.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128i opaque = _mm_set1_epi32((int32_t) 0xFF000000u);
+
+  int32_t x = x0;
+  for (; x + 4 <= x1; x += 4) {
+    __m128 px = _mm_add_ps(_mm_set1_ps((float) x), centers);
+    __m128 w0 = _mm_add_ps(_mm_mul_ps(a[0], px), rows[0]);
+    __m128 w1 = _mm_add_ps(_mm_mul_ps(a[1], px), rows[1]);
+    __m128 w2 = _mm_add_ps(_mm_mul_ps(a[2], px), rows[2]);
+    __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)), _mm_cmpge_ps(w2, zero));
+    if (_mm_movemask_ps(inside) == 0) {
+      continue;
+    }
+
+    __m128i pixel = opaque;
+    for (uint32_t c = 0; c < 3; c++) {
+      __m128 value = _mm_add_ps(_mm_add_ps(_mm_mul_ps(w0, _mm_set1_ps(colors[0][c])),
+                                           _mm_mul_ps(w1, _mm_set1_ps(colors[1][c]))),
+                                _mm_mul_ps(w2, _mm_set1_ps(colors[2][c])));
+      value = _mm_add_ps(_mm_mul_ps(_mm_min_ps(_mm_max_ps(value, zero), one), scale), half);
+      // Red goes to bits 16 to 23, green to 8 to 15 and blue to 0 to 7
+      __m128i channel = _mm_cvttps_epi32(value);
+      pixel = _mm_or_si128(pixel, c == 0 ? _mm_slli_epi32(channel, 16)
+                                         : c == 1 ? _mm_slli_epi32(channel, 8) : channel);
+    }
+
+    __m128i mask = _mm_castps_si128(inside);
+    __m128i old = _mm_loadu_si128((const __m128i*)(row + x));
+    _mm_storeu_si128((__m128i*)(row + x), _mm_or_si128(_mm_and_si128(mask, pixel), _mm_andnot_si128(mask, old)));
+  }
+  strs_soft_fill_span_scalar(row, x, x1, y, edges, colors);
+}
+
+// The pixel's channels widened to one float lane each, in memory order B, G, R, A
+STRS_INTERN void blend_sse2(uint32_t *pixel, const float src[4]) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i bytes = _mm_cvtsi32_si128((int32_t) *pixel);
+  __m128i lanes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes, zero), zero);
+  __m128 dst = _mm_mul_ps(_mm_cvtepi32_ps(lanes), _mm_set1_ps(1.0f / 255.0f));
+  __m128 color = _mm_set_ps(src[3], src[0], src[1], src[2]);
+  __m128 result = _mm_add_ps(color, _mm_mul_ps(dst, _mm_set1_ps(1.0f - src[3])));
+  result = _mm_add_ps(_mm_mul_ps(result, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f));
+  __m128i packed = _mm_cvttps_epi32(_mm_max_ps(result, _mm_setzero_ps()));
+  packed = _mm_packs_epi32(packed, packed);
+  *pixel = (uint32_t) _mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+}
+
+#endif
+
+STRS_LIB void strs_soft_fill_span(uint32_t *row, int32_t x0, int32_t x1, float y, const float edges[3][3],
+                                  const float colors[3][3]) {
+#if defined(STRS_SOFT_SSE2)
+  fill_span_sse2(row, x0, x1, y, edges, colors);
+#else
+  strs_soft_fill_span_scalar(row, x0, x1, y, edges, colors);
+#endif
+}
+
+STRS_LIB void strs_soft_blend(uint32_t *pixel, const float src[4]) {
+#if defined(STRS_SOFT_SSE2)
+  blend_sse2(pixel, src);
+#else
+  strs_soft_blend_scalar(pixel, src);
+#endif
+}
+
+// Returns once the server has read the last frame presented from the segment, it is drawn over after this
+STRS_INTERN void wait_shm_present(internal_strs_soft *soft) {
+  if (soft->shm_pending) {
+    free(xcb_get_input_focus_reply(soft->shm_connection, soft->shm_sync, NULL));
+    soft->shm_pending = false;
+  }
+}
+
+STRS_INTERN void free_pixels(internal_strs_soft *soft) {
+  if (soft->shm_connection == NULL) {
+    free(soft->pixels);
+    return;
+  }
+  wait_shm_present(soft);
+  xcb_shm_detach(soft->shm_connection, soft->shm_seg);
+  xcb_flush(soft->shm_connection);
+  shmdt(soft->pixels);
+  soft->shm_connection = NULL;
+}
+
+// Moves the pixels into a segment the server of connection attaches, false when it can't. The segment is
+// marked for removal as soon as both sides are attached, so it goes away with the last of them.
+STRS_INTERN bool attach_shm(internal_strs_soft *soft, xcb_connection_t *connection) {
+  const xcb_query_extension_reply_t *extension = xcb_get_extension_data(connection, &xcb_shm_id);
+  if (extension == NULL || !extension->present) {
+    return false;
+  }
+  size_t size = ((size_t) soft->width * soft->height + 1) * sizeof(uint32_t);
+  int id = shmget(IPC_PRIVATE, size, IPC_CREAT | 0600);
+  if (id < 0) {
+    return false;
+  }
+  uint32_t *pixels = shmat(id, NULL, 0);
+  if (pixels == (void*)-1) {
+    shmctl(id, IPC_RMID, NULL);
+    return false;
+  }
+  xcb_shm_seg_t seg = xcb_generate_id(connection);
+  // Fails on servers that don't share memory with this process, remote ones
+  xcb_generic_error_t *error = xcb_request_check(connection, xcb_shm_attach_checked(connection, seg, id, 0));
+  shmctl(id, IPC_RMID, NULL);
+  if (error != NULL) {
+    free(error);
+    shmdt(pixels);
+    return false;
+  }
+
+  memcpy(pixels, soft->pixels, size);
+  free_pixels(soft);
+  soft->pixels = pixels;
+  soft->shm_connection = connection;
+  soft->shm_seg = seg;
+  return true;
+}
+
+STRS_INTERN void free_tiles(internal_strs_soft *soft) {
+  for (uint32_t i = 0; soft->tiles != NULL && i < soft->tiles_x * soft->tiles_y; i++) {
+    free(soft->tiles[i].shapes);
+    free(soft->tiles[i].triangles);
+  }
+  free(soft->tiles);
+  free(soft->tile_jobs);
+  free(soft->tile_handles);
+  free_pixels(soft);
+}
+
+STRS_LIB void strs_soft_resize(strs_soft soft, uint32_t width, uint32_t height) {
+  internal_strs_soft *intern_soft = (internal_strs_soft*)soft;
+  free_tiles(intern_soft);
+  intern_soft->width = width;
+  intern_soft->height = height;
+  intern_soft->pixels = calloc((size_t) width * height + 1, sizeof(uint32_t));
+  intern_soft->tiles_x = (width + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+  intern_soft->tiles_y = (height + SOFT_TILE_SIZE - 1) / SOFT_TILE_SIZE;
+  uint32_t tile_count = intern_soft->tiles_x * intern_soft->tiles_y;
+  intern_soft->tiles = calloc(tile_count + 1, sizeof(soft_tile));
+  intern_soft->tile_jobs = calloc(tile_count + 1, sizeof(soft_tile_job));
+  intern_soft->tile_handles = calloc(tile_count + 1, sizeof(strs_job));
+  for (uint32_t i = 0; i < tile_count; i++) {
+    intern_soft->tile_jobs[i] = (soft_tile_job){intern_soft, i};
+  }
+}
+
+STRS_LIB strs_soft strs_soft_create(strs_jobs jobs, uint32_t width, uint32_t height) {
+  internal_strs_soft *soft = calloc(1, sizeof(internal_strs_soft));
+  soft->jobs = jobs;
+  strs_soft_resize((strs_soft)soft, width, height);
+  return (strs_soft)soft;
+}
+
+STRS_LIB void strs_soft_free(strs_soft soft) {
+  internal_strs_soft *intern_soft = (internal_strs_soft*)soft;
+  free_tiles(intern_soft);
+  free(intern_soft->vertices);
+  free(intern_soft->triangles);
+  free(intern_soft->shapes);
+  free(intern_soft);
+}
+
+STRS_INTERN const float *node_affine(const strs_soft_scene *scene, strs_transform transform) {
+  static const float identity[6] = {1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f};
+  return scene->transforms != NULL && transform < scene->transform_count ? scene->transforms[transform] : identity;
+}
+
+// Clamps pixel bounds x0, y0, x1, y1 to the framebuffer, false when nothing is left
+STRS_INTERN bool clamp_bounds(internal_strs_soft *soft, float x0, float y0, float x1, float y1, int32_t *bounds) {
+  bounds[0] = x0 > 0.0f ? (int32_t) floorf(x0) : 0;
+  bounds[1] = y0 > 0.0f ? (int32_t) floorf(y0) : 0;
+  bounds[2] = x1 < (float) soft->width ? (int32_t) ceilf(x1) : (int32_t) soft->width;
+  bounds[3] = y1 < (float) soft->height ? (int32_t) ceilf(y1) : (int32_t) soft->height;
+  return bounds[2] > bounds[0] && bounds[3] > bounds[1];
+}
+
+// Edge a -> b, positive on the side of the triangle once the winding is counter clockwise on screen
+STRS_INTERN void setup_edge(const float *a, const float *b, float area, float *edge) {
+  float dx = b[0] - a[0];
+  float dy = b[1] - a[1];
+  edge[0] = -dy / area;
+  edge[1] = dx / area;
+  edge[2] = (dy * a[0] - dx * a[1]) / area;
+  // Pixel centers exactly on an edge belong to the triangle on its top or left side only
+  if (!(dy < 0.0f || (dy == 0.0f && dx > 0.0f))) {
+    edge[2] -= SOFT_EDGE_BIAS;
+  }
+}
+
+STRS_INTERN void setup_triangle(internal_strs_soft *soft, const strs_vertex *vertices, const uint32_t *indices,
+                                const float *affine) {
+  float p[3][2];
+  const float *colors[3];
+  for (uint32_t k = 0; k < 3; k++) {
+    const strs_vertex *vertex = &vertices[indices[k]];
+    p[k][0] = affine[0] * vertex->pos[0] + affine[2] * vertex->pos[1] + affine[4];
+    p[k][1] = affine[1] * vertex->pos[0] + affine[3] * vertex->pos[1] + affine[5];
+    colors[k] = vertex->color;
+  }
+
+  float area = (p[1][0] - p[0][0]) * (p[2][1] - p[0][1]) - (p[1][1] - p[0][1]) * (p[2][0] - p[0][0]);
+  if (area == 0.0f || isnan(area)) {
+    return;
+  }
+  uint32_t order[3] = {0, area > 0.0f ? 1 : 2, area > 0.0f ? 2 : 1};
+  area = fabsf(area);
+
+  int32_t bounds[4];
+  float x0 = fminf(p[0][0], fminf(p[1][0], p[2][0]));
+  float y0 = fminf(p[0][1], fminf(p[1][1], p[2][1]));
+  float x1 = fmaxf(p[0][0], fmaxf(p[1][0], p[2][0]));
+  float y1 = fmaxf(p[0][1], fmaxf(p[1][1], p[2][1]));
+  if (!clamp_bounds(soft, x0, y0, x1, y1, bounds)) {
+    return;
+  }
+
+  soft->triangles = strs_grow_array(soft->triangles, &soft->triangle_capacity, soft->triangle_count + 1,
+                               sizeof(soft_triangle));
+  soft_triangle *triangle = &soft->triangles[soft->triangle_count++];
+  for (uint32_t k = 0; k < 3; k++) {
+    setup_edge(p[order[(k + 1) % 3]], p[order[(k + 2) % 3]], area, triangle->edges[k]);
+    memcpy(triangle->colors[k], colors[order[k]], sizeof(triangle->colors[k]));
+  }
+  memcpy(triangle->bounds, bounds, sizeof(bounds));
+}
+
+STRS_INTERN void setup_shape(internal_strs_soft *soft, const strs_shape *shape, const float *a) {
+  float determinant = a[0] * a[3] - a[2] * a[1];
+  if (determinant == 0.0f) {
+    return;
+  }
+  soft_shape setup = {
+    .half_size = {shape->width * 0.5f, shape->height * 0.5f},
+    .border_width = shape->border_width,
+    .shadow_blur = shape->shadow_blur,
+    .shadow_offset = {shape->shadow_offset[0], shape->shadow_offset[1]}};
+  memcpy(setup.fill_color, shape->fill_color, sizeof(setup.fill_color));
+  memcpy(setup.border_color, shape->border_color, sizeof(setup.border_color));
+  memcpy(setup.shadow_color, shape->shadow_color, sizeof(setup.shadow_color));
+  setup.radius = fminf(fmaxf(shape->corner_radius, 0.0f), fminf(setup.half_size[0], setup.half_size[1]));
+
+  float inverse[] = {a[3] / determinant, -a[1] / determinant, -a[2] / determinant, a[0] / determinant};
+  float center[] = {shape->x + setup.half_size[0], shape->y + setup.half_size[1]};
+  memcpy(setup.inverse, inverse, sizeof(inverse));
+  setup.inverse[4] = -(inverse[0] * a[4] + inverse[2] * a[5]) - center[0];
+  setup.inverse[5] = -(inverse[1] * a[4] + inverse[3] * a[5]) - center[1];
+  setup.aa = fmaxf((sqrtf(inverse[0] * inverse[0] + inverse[1] * inverse[1]) +
+                    sqrtf(inverse[2] * inverse[2] + inverse[3] * inverse[3])) * 0.5f, 1e-4f);
+
+  // The rect grown by its shadow and an antialiased edge, mapped to pixels
+  float shadow = setup.shadow_color[3] > 0.0f ? fmaxf(setup.shadow_blur, setup.aa) : 0.0f;
+  float margin[2] = {
+    fmaxf(setup.aa, fabsf(setup.shadow_offset[0]) + shadow) + setup.aa,
+    fmaxf(setup.aa, fabsf(setup.shadow_offset[1]) + shadow) + setup.aa};
+  float bounds[4] = {FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX};
+  for (uint32_t corner = 0; corner < 4; corner++) {
+    float x = center[0] + (corner & 1 ? 1.0f : -1.0f) * (setup.half_size[0] + margin[0]);
+    float y = center[1] + (corner & 2 ? 1.0f : -1.0f) * (setup.half_size[1] + margin[1]);
+    float px = a[0] * x + a[2] * y + a[4];
+    float py = a[1] * x + a[3] * y + a[5];
+    bounds[0] = fminf(bounds[0], px);
+    bounds[1] = fminf(bounds[1], py);
+    bounds[2] = fmaxf(bounds[2], px);
+    bounds[3] = fmaxf(bounds[3], py);
+  }
+  if (!clamp_bounds(soft, bounds[0], bounds[1], bounds[2], bounds[3], setup.bounds)) {
+    return;
+  }
+
+  soft->shapes = strs_grow_array(soft->shapes, &soft->shape_capacity, soft->shape_count + 1, sizeof(soft_shape));
+  soft->shapes[soft->shape_count++] = setup;
+}
+
+STRS_INTERN void bin(internal_strs_soft *soft, const int32_t *bounds, uint32_t item, bool shape) {
+  uint32_t tx0 = (uint32_t) bounds[0] / SOFT_TILE_SIZE;
+  uint32_t ty0 = (uint32_t) bounds[1] / SOFT_TILE_SIZE;
+  uint32_t tx1 = (uint32_t) (bounds[2] - 1) / SOFT_TILE_SIZE;
+  uint32_t ty1 = (uint32_t) (bounds[3] - 1) / SOFT_TILE_SIZE;
+  for (uint32_t ty = ty0; ty <= ty1; ty++) {
+    for (uint32_t tx = tx0; tx <= tx1; tx++) {
+      soft_tile *tile = &soft->tiles[ty * soft->tiles_x + tx];
+      if (shape) {
+        tile->shapes = strs_grow_array(tile->shapes, &tile->shape_capacity, tile->shape_count + 1, sizeof(uint32_t));
+        tile->shapes[tile->shape_count++] = item;
+      } else {
+        tile->triangles = strs_grow_array(tile->triangles, &tile->triangle_capacity, tile->triangle_count + 1,
+                                     sizeof(uint32_t));
+        tile->triangles[tile->triangle_count++] = item;
+      }
+    }
+  }
+}
+
+// Signed distance to a rounded box centered on the origin, negative inside. The same as shape.frag.
+STRS_INTERN float rounded_box(float x, float y, const float *half_size, float radius) {
+  float qx = fabsf(x) - half_size[0] + radius;
+  float qy = fabsf(y) - half_size[1] + radius;
+  float outside = sqrtf(fmaxf(qx, 0.0f) * fmaxf(qx, 0.0f) + fmaxf(qy, 0.0f) * fmaxf(qy, 0.0f));
+  return outside + fminf(fmaxf(qx, qy), 0.0f) - radius;
+}
+
+STRS_INTERN float smoothstep(float edge0, float edge1, float x) {
+  float t = clamp01((x - edge0) / (edge1 - edge0));
+  return t * t * (3.0f - 2.0f * t);
+}
+
+// Coverage, border and shadow the way shape.frag computes them, without the texture
+STRS_INTERN void shade_shape(const soft_shape *shape, float px, float py, float *out) {
+  const float *m = shape->inverse;
+  float x = m[0] * px + m[2] * py + m[4];
+  float y = m[1] * px + m[3] * py + m[5];
+
+  float d = rounded_box(x, y, shape->half_size, shape->radius);
+  float coverage = clamp01(0.5f - d / shape->aa);
+  float border = shape->border_width > 0.0f ? clamp01(0.5f + (d + shape->border_width) / shape->aa) : 0.0f;
+  float color[4];
+  for (uint32_t c = 0; c < 4; c++) {
+    color[c] = shape->fill_color[c] + (shape->border_color[c] - shape->fill_color[c]) * border;
+  }
+  float alpha = color[3] * coverage;
+
+  float shadow_distance = rounded_box(x - shape->shadow_offset[0], y - shape->shadow_offset[1], shape->half_size,
+                                      shape->radius);
+  float blur = fmaxf(shape->shadow_blur, shape->aa);
+  float shadow = (1.0f - smoothstep(-blur, blur, shadow_distance)) * shape->shadow_color[3] * (1.0f - alpha);
+
+  for (uint32_t c = 0; c < 3; c++) {
+    out[c] = color[c] * alpha + shape->shadow_color[c] * shadow;
+  }
+  out[3] = alpha + shadow;
+}
+
+// Shapes first, then the vertex geometry over them, into a tile sized buffer copied out at the end
+STRS_INTERN void draw_tile(void *data) {
+  soft_tile_job *job = (soft_tile_job*)data;
+  internal_strs_soft *soft = (internal_strs_soft*)job->soft;
+  const soft_tile *tile = &soft->tiles[job->tile];
+  int32_t x0 = (int32_t) (job->tile % soft->tiles_x) * SOFT_TILE_SIZE;
+  int32_t y0 = (int32_t) (job->tile / soft->tiles_x) * SOFT_TILE_SIZE;
+  int32_t width = (int32_t) soft->width - x0 < SOFT_TILE_SIZE ? (int32_t) soft->width - x0 : SOFT_TILE_SIZE;
+  int32_t height = (int32_t) soft->height - y0 < SOFT_TILE_SIZE ? (int32_t) soft->height - y0 : SOFT_TILE_SIZE;
+  uint32_t pixels[SOFT_TILE_SIZE * SOFT_TILE_SIZE];
+
+  for (uint32_t i = 0; i < SOFT_TILE_SIZE * SOFT_TILE_SIZE; i++) {
+    pixels[i] = soft->clear_pixel;
+  }
+
+  for (uint64_t s = 0; s < tile->shape_count; s++) {
+    const soft_shape *shape = &soft->shapes[tile->shapes[s]];
+    int32_t sx0 = shape->bounds[0] > x0 ? shape->bounds[0] - x0 : 0;
+    int32_t sy0 = shape->bounds[1] > y0 ? shape->bounds[1] - y0 : 0;
+    int32_t sx1 = shape->bounds[2] - x0 < width ? shape->bounds[2] - x0 : width;
+    int32_t sy1 = shape->bounds[3] - y0 < height ? shape->bounds[3] - y0 : height;
+    for (int32_t y = sy0; y < sy1; y++) {
+      for (int32_t x = sx0; x < sx1; x++) {
+        float color[4];
+        shade_shape(shape, (float) (x0 + x) + 0.5f, (float) (y0 + y) + 0.5f, color);
+        if (color[3] > 0.0f) {
+          strs_soft_blend(&pixels[y * SOFT_TILE_SIZE + x], color);
+        }
+      }
+    }
+  }
+
+  for (uint64_t t = 0; t < tile->triangle_count; t++) {
+    const soft_triangle *triangle = &soft->triangles[tile->triangles[t]];
+    // The edges moved into the tile's own coordinates
+    float edges[3][3];
+    for (uint32_t i = 0; i < 3; i++) {
+      edges[i][0] = triangle->edges[i][0];
+      edges[i][1] = triangle->edges[i][1];
+      edges[i][2] = triangle->edges[i][2] + triangle->edges[i][0] * (float) x0 + triangle->edges[i][1] * (float) y0;
+    }
+    int32_t tx0 = triangle->bounds[0] > x0 ? triangle->bounds[0] - x0 : 0;
+    int32_t ty0 = triangle->bounds[1] > y0 ? triangle->bounds[1] - y0 : 0;
+    int32_t tx1 = triangle->bounds[2] - x0 < width ? triangle->bounds[2] - x0 : width;
+    int32_t ty1 = triangle->bounds[3] - y0 < height ? triangle->bounds[3] - y0 : height;
+    for (int32_t y = ty0; y < ty1; y++) {
+      strs_soft_fill_span(&pixels[y * SOFT_TILE_SIZE], tx0, tx1, (float) y + 0.5f, edges, triangle->colors);
+    }
+  }
+
+  for (int32_t y = 0; y < height; y++) {
+    memcpy(&soft->pixels[(size_t) (y0 + y) * soft->width + x0], &pixels[y * SOFT_TILE_SIZE],
+           sizeof(uint32_t) * width);
+  }
+}
+
+STRS_LIB void strs_soft_draw(strs_soft soft, const strs_soft_scene *scene) {
+  internal_strs_soft *intern_soft = (internal_strs_soft*)soft;
+  uint64_t begin = strs_clock_now_ns();
+  uint32_t tile_count = intern_soft->tiles_x * intern_soft->tiles_y;
+  const float *clear = scene->clear_color;
+  wait_shm_present(intern_soft);
+  intern_soft->clear_pixel = pack_pixel(clear[0] * clear[3], clear[1] * clear[3], clear[2] * clear[3], clear[3]);
+
+  for (uint32_t i = 0; i < tile_count; i++) {
+    intern_soft->tiles[i].shape_count = 0;
+    intern_soft->tiles[i].triangle_count = 0;
+  }
+  intern_soft->shape_count = 0;
+  intern_soft->triangle_count = 0;
+
+  for (uint64_t i = 0; i < scene->shape_count; i++) {
+    uint64_t count = intern_soft->shape_count;
+    setup_shape(intern_soft, &scene->shapes[i], node_affine(scene, scene->shapes[i].transform));
+    if (intern_soft->shape_count > count) {
+      bin(intern_soft, intern_soft->shapes[count].bounds, (uint32_t) count, true);
+    }
+  }
+
+  const strs_vertex *vertices = (const strs_vertex*)scene->vertices;
+  if (scene->vertex_format != STRS_VERTEX_FORMAT_DEFAULT) {
+    intern_soft->vertices = strs_grow_array(intern_soft->vertices, &intern_soft->vertex_capacity, scene->vertex_count,
+                                       sizeof(strs_vertex));
+    strs_vertex_convert(scene->vertex_format, scene->vertices, STRS_VERTEX_FORMAT_DEFAULT, intern_soft->vertices,
+                        scene->vertex_count);
+    vertices = intern_soft->vertices;
+  }
+  strs_soft_range whole = {0, (uint32_t) scene->index_count, STRS_TRANSFORM_ROOT};
+  const strs_soft_range *draws = scene->draws != NULL ? scene->draws : &whole;
+  uint64_t draw_count = scene->draws != NULL ? scene->draw_count : 1;
+  for (uint64_t d = 0; d < draw_count; d++) {
+    const float *affine = node_affine(scene, draws[d].transform);
+    uint64_t end = (uint64_t) draws[d].first_index + draws[d].index_count;
+    end = end < scene->index_count ? end : scene->index_count;
+    for (uint64_t i = draws[d].first_index; i + 3 <= end; i += 3) {
+      const uint32_t *indices = &scene->indices[i];
+      if (indices[0] >= scene->vertex_count || indices[1] >= scene->vertex_count ||
+          indices[2] >= scene->vertex_count) {
+        continue;
+      }
+      uint64_t count = intern_soft->triangle_count;
+      setup_triangle(intern_soft, vertices, indices, affine);
+      if (intern_soft->triangle_count > count) {
+        bin(intern_soft, intern_soft->triangles[count].bounds, (uint32_t) count, false);
+      }
+    }
+  }
+
+  uint32_t busy = 0;
+  for (uint32_t i = 0; i < tile_count; i++) {
+    busy += intern_soft->tiles[i].shape_count + intern_soft->tiles[i].triangle_count > 0;
+    if (intern_soft->jobs != NULL) {
+      intern_soft->tile_handles[i] = strs_jobs_spawn(intern_soft->jobs, draw_tile, &intern_soft->tile_jobs[i], NULL, 0);
+    } else {
+      draw_tile(&intern_soft->tile_jobs[i]);
+    }
+  }
+  for (uint32_t i = 0; intern_soft->jobs != NULL && i < tile_count; i++) {
+    strs_jobs_wait(intern_soft->jobs, intern_soft->tile_handles[i]);
+  }
+
+  intern_soft->stats = (strs_soft_stats){
+    .frame_ns = strs_clock_now_ns() - begin,
+    .triangles = intern_soft->triangle_count,
+    .shapes = intern_soft->shape_count,
+    .tiles = tile_count,
+    .busy_tiles = busy};
+}
+
+STRS_LIB const uint8_t *strs_soft_pixels(strs_soft soft) {
+  return (const uint8_t*)((internal_strs_soft*)soft)->pixels;
+}
+
+STRS_LIB void strs_soft_present_xcb(strs_soft soft, xcb_connection_t *connection, xcb_window_t window,
+                                    xcb_gcontext_t gc, uint8_t depth) {
+  internal_strs_soft *intern_soft = (internal_strs_soft*)soft;
+  uint32_t row_bytes = intern_soft->width * sizeof(uint32_t);
+  if (row_bytes == 0 || intern_soft->height == 0) {
+    return;
+  }
+  if (connection != intern_soft->shm_connection && connection != intern_soft->shm_refused &&
+      !attach_shm(intern_soft, connection)) {
+    intern_soft->shm_refused = connection;
+  }
+  if (connection == intern_soft->shm_connection) {
+    wait_shm_present(intern_soft);
+    xcb_shm_put_image(connection, window, gc, (uint16_t) intern_soft->width, (uint16_t) intern_soft->height, 0, 0,
+                      (uint16_t) intern_soft->width, (uint16_t) intern_soft->height, 0, 0, depth,
+                      XCB_IMAGE_FORMAT_Z_PIXMAP, 0, intern_soft->shm_seg, 0);
+    intern_soft->shm_sync = xcb_get_input_focus(connection);
+    intern_soft->shm_pending = true;
+    xcb_flush(connection);
+    return;
+  }
+
+  // The request length is counted in 4 byte units, the PutImage header takes 24 bytes of it
+  uint64_t request_bytes = (uint64_t) xcb_get_maximum_request_length(connection) * 4 - 24;
+  uint32_t rows = request_bytes / row_bytes > 0 ? (uint32_t) (request_bytes / row_bytes) : 1;
+
+  for (uint32_t y = 0; y < intern_soft->height; y += rows) {
+    uint32_t count = intern_soft->height - y < rows ? intern_soft->height - y : rows;
+    xcb_put_image(connection, XCB_IMAGE_FORMAT_Z_PIXMAP, window, gc, (uint16_t) intern_soft->width,
+                  (uint16_t) count, 0, (int16_t) y, 0, depth, count * row_bytes,
+                  (const uint8_t*)&intern_soft->pixels[(size_t) y * intern_soft->width]);
+  }
+  xcb_flush(connection);
+}
+
+STRS_LIB void strs_soft_get_stats(strs_soft soft, strs_soft_stats *stats) {
+  *stats = ((internal_strs_soft*)soft)->stats;
+}
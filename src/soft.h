@@ -0,0 +1,84 @@
+#ifndef STEROS_SOFT_H
+#define STEROS_SOFT_H
+
+#include "steros.h"
+#include "app.h"
+#include "jobs.h"
+
+// STD
+#include <stdint.h>
+
+// LIB
+#include <xcb/xcb.h>
+
+// CPU renderer for hosts without a GPU. It draws the streams the app uploads, the shapes under the vertex
+// geometry, into a framebuffer cut into tiles that are rasterized in parallel on the jobs. The space the
+// transform nodes map to is taken as framebuffer pixels. Textures are not sampled and animations are not
+// evaluated, shapes are drawn with the values they were pushed with.
+typedef struct {
+  uint32_t not_used;
+} *strs_soft;
+
+// A run of indices placed in one transform node
+typedef struct {
+  uint32_t first_index;
+  uint32_t index_count;
+  strs_transform transform;
+} strs_soft_range;
+
+typedef struct {
+  strs_vertex_format vertex_format;
+  const void *vertices;
+  uint64_t vertex_count;
+  // Absolute, every 3 are a triangle. Both windings are drawn.
+  const uint32_t *indices;
+  uint64_t index_count;
+  // NULL draws every index in the root
+  const strs_soft_range *draws;
+  uint64_t draw_count;
+  const strs_shape *shapes;
+  uint64_t shape_count;
+  // World affine of every node, {xx, yx, xy, yy, x0, y0}. Nodes past transform_count are the identity.
+  const float (*transforms)[6];
+  uint64_t transform_count;
+  // Straight alpha
+  float clear_color[4];
+} strs_soft_scene;
+
+typedef struct {
+  uint64_t frame_ns;
+  uint64_t triangles;
+  uint64_t shapes;
+  uint32_t tiles;
+  // Tiles something was drawn into, the others were only cleared
+  uint32_t busy_tiles;
+} strs_soft_stats;
+
+// jobs may be NULL, the tiles are then drawn on the calling thread
+STRS_LIB strs_soft strs_soft_create(strs_jobs jobs, uint32_t width, uint32_t height);
+STRS_LIB void strs_soft_free(strs_soft soft);
+STRS_LIB void strs_soft_resize(strs_soft soft, uint32_t width, uint32_t height);
+// Returns once every tile is drawn
+STRS_LIB void strs_soft_draw(strs_soft soft, const strs_soft_scene *scene);
+// width * height pixels of B, G, R, A bytes with premultiplied alpha, the layout of 24 and 32 bit X visuals
+STRS_LIB const uint8_t *strs_soft_pixels(strs_soft soft);
+// Puts the framebuffer into a window of a 24 or 32 bit visual. The first present to a connection moves the
+// pixels into a MIT-SHM segment the server reads them from, without them going through the socket. Servers
+// without the extension or remote ones get as few PutImage requests as they take instead. Free the soft
+// before disconnecting.
+STRS_LIB void strs_soft_present_xcb(strs_soft soft, xcb_connection_t *connection, xcb_window_t window,
+                                    xcb_gcontext_t gc, uint8_t depth);
+STRS_LIB void strs_soft_get_stats(strs_soft soft, strs_soft_stats *stats);
+
+// Row kernels behind the rasterizer, the scalar versions are the reference and the fallback. Fill the
+// pixels of one row whose pixel centers lie inside the triangle given by its three edge functions
+// a * x + b * y + c, with colors interpolated from the per pixel weights of the three vertices.
+STRS_LIB void strs_soft_fill_span(uint32_t *row, int32_t x0, int32_t x1, float y, const float edges[3][3],
+                                  const float colors[3][3]);
+STRS_LIB void strs_soft_fill_span_scalar(uint32_t *row, int32_t x0, int32_t x1, float y, const float edges[3][3],
+                                         const float colors[3][3]);
+// Premultiplied src over the pixel
+STRS_LIB void strs_soft_blend(uint32_t *pixel, const float src[4]);
+STRS_LIB void strs_soft_blend_scalar(uint32_t *pixel, const float src[4]);
+
+#endif //STEROS_SOFT_H
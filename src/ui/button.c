@@ -1,72 +1,124 @@
 #include "button.h"
 
-const uint8_t VERTEX_COUNT = 4;
-const uint8_t INDEX_COUNT = 6;
+#include <stdlib.h>
+#include <string.h>
 
-STRS_INTERN void buttonFillVertices(float x, float y, float width, float height, strs_vertex *vertices) {
-  vertices[0] = (strs_vertex){
-    .pos[0] = x,
-    .pos[1] = y
-  };
-  vertices[0] = (strs_vertex){
-    .pos[0] = x + width,
-    .pos[1] = y
-  };
-  vertices[0] = (strs_vertex){
-    .pos[0] = x,
-    .pos[1] = y + height
-  };
-  vertices[0] = (strs_vertex){
-    .pos[0] = x + width,
-    .pos[1] = y + height
-  };
-}
+// The rects of destroyed buttons, handed to the next ones created instead of growing the vertices
+typedef struct {
+  uint32_t *firstVertices;
+  uint32_t count;
+  uint32_t capacity;
+} buttonFreeRects;
 
-STRS_INTERN void buttonFillIndices(uint16_t *indices) {
-  indices[0] = 0;
-  indices[1] = 1;
-  indices[2] = 2;
-  indices[3] = 2;
-  indices[4] = 3;
-  indices[5] = 0;
+STRS_INTERN strs_rect buttonVisibleRect(const strs_widget_batch *batch, uint32_t i) {
+  strs_rect rect = batch->rects[i];
+  if (batch->flags[i] & STRS_WIDGET_HIDDEN) {
+    rect.width = 0.0f;
+    rect.height = 0.0f;
+  }
+  return rect;
 }
 
-STRS_INTERN void buttonCreateWidget(strs_app *app, void *pointer) {
-  strs_vertex vertices[VERTEX_COUNT];
-  uint16_t indices[INDEX_COUNT];
-  strs_button *button;
+// Buttons seen for the first time are pushed in one call, moved or recolored ones are written in place
+STRS_INTERN void buttonGeometry(strs_app app, strs_widget_batch *batch, void *user_data) {
+  buttonFreeRects *freeRects = user_data;
+  strs_button *buttons = batch->data;
+  strs_vertex vertices[STRS_RECT_VERTEX_COUNT];
+  uint32_t newCount = 0;
 
-  button = (strs_button*)pointer;
+  for (uint32_t i = 0; i < batch->count; i++) {
+    if (!(batch->flags[i] & STRS_WIDGET_DIRTY)) {
+      continue;
+    }
+    if (buttons[i].first_vertex == UINT32_MAX && freeRects->count > 0) {
+      buttons[i].first_vertex = freeRects->firstVertices[--freeRects->count];
+    } else if (buttons[i].first_vertex == UINT32_MAX) {
+      newCount++;
+      continue;
+    }
+    strs_rect rect = buttonVisibleRect(batch, i);
+    strs_rects_fill_vertices(STRS_VERTEX_FORMAT_DEFAULT, &rect, &batch->colors[i], 1, vertices);
+    strs_write_vertices(app, buttons[i].first_vertex, vertices, STRS_RECT_VERTEX_COUNT);
+  }
+  if (newCount == 0) {
+    return;
+  }
 
-  buttonFillVertices(button->x, button->y, button->width, button->height, vertices);
-  buttonFillIndices(indices);
+  strs_rect *rects = strs_app_frame_alloc(app, sizeof(strs_rect) * newCount);
+  vec3 *colors = strs_app_frame_alloc(app, sizeof(vec3) * newCount);
+  uint32_t *placed = strs_app_frame_alloc(app, sizeof(uint32_t) * newCount);
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < batch->count; i++) {
+    if ((batch->flags[i] & STRS_WIDGET_DIRTY) && buttons[i].first_vertex == UINT32_MAX) {
+      rects[count] = buttonVisibleRect(batch, i);
+      memcpy(colors[count], batch->colors[i], sizeof(vec3));
+      placed[count++] = i;
+    }
+  }
 
-  strs_push_vertices(app, vertices, VERTEX_COUNT);
-  strs_push_indices(app, indices, INDEX_COUNT);
+  uint32_t firstVertex = strs_push_rects(app, rects, colors, count);
+  for (uint32_t i = 0; i < count; i++) {
+    buttons[placed[i]].first_vertex = firstVertex + i * STRS_RECT_VERTEX_COUNT;
+  }
 }
 
-STRS_INTERN void buttonUpdateWidget(strs_app *app, void *pointer) {
+// The rect is collapsed so nothing is drawn until the next button created takes it over
+STRS_INTERN void buttonDestroy(strs_app app, strs_widget_batch *batch, void *user_data) {
+  buttonFreeRects *freeRects = user_data;
+  strs_button *button = batch->data;
+  strs_vertex vertices[STRS_RECT_VERTEX_COUNT];
+  if (button->first_vertex == UINT32_MAX) {
+    return;
+  }
+  strs_rect rect = {.x = batch->rects[0].x, .y = batch->rects[0].y};
+  strs_rects_fill_vertices(STRS_VERTEX_FORMAT_DEFAULT, &rect, batch->colors, 1, vertices);
+  strs_write_vertices(app, button->first_vertex, vertices, STRS_RECT_VERTEX_COUNT);
 
+  if (freeRects->count == freeRects->capacity) {
+    freeRects->capacity = freeRects->capacity == 0 ? 64 : freeRects->capacity * 2;
+    freeRects->firstVertices = realloc(freeRects->firstVertices, sizeof(uint32_t) * freeRects->capacity);
+  }
+  freeRects->firstVertices[freeRects->count++] = button->first_vertex;
 }
 
-STRS_INTERN void buttonWhileSelected(strs_app *app, void *pointer) {
+STRS_INTERN void buttonRelease(void *user_data) {
+  buttonFreeRects *freeRects = user_data;
+  free(freeRects->firstVertices);
+  free(freeRects);
+}
 
+uint32_t strs_button_type(strs_app app) {
+  uint32_t type = strs_widget_type_find(app, "strs_button");
+  if (type != STRS_WIDGET_TYPE_NONE) {
+    return type;
+  }
+  strs_widget_type_info info = {
+    .name = "strs_button",
+    .data_size = sizeof(strs_button),
+    .geometry = buttonGeometry,
+    .destroy = buttonDestroy,
+    .user_data = calloc(1, sizeof(buttonFreeRects)),
+    .release = buttonRelease
+  };
+  return strs_widget_type_register(app, &info);
 }
 
-strs_button strs_button_create(float x, float y, float width, float height) {
-  strs_button button = {
+strs_widget_handle strs_button_create(strs_app app, float x, float y, float width, float height) {
+  strs_rect rect = {
     .x = x,
     .y = y,
     .width = width,
-    .height = height,
-    .widget = (strs_widget){
-      .create_widget = buttonCreateWidget,
-      .update_widget = buttonUpdateWidget,
-      .while_selected = buttonWhileSelected
-    }
+    .height = height
+  };
+  vec3 color = {0.8f, 0.8f, 0.8f};
+  strs_button button = {
+    .first_vertex = UINT32_MAX
   };
 
-  button.widget.pointer = &button;
+  return strs_widget_create(app, strs_button_type(app), &rect, color, &button);
+}
 
-  return button;
-}
\ No newline at end of file
+void strs_button_on_action(strs_app app, strs_widget_handle button, PFN_strs_on_action onAction) {
+  strs_button *data = strs_widget_data(app, button);
+  data->on_action = onAction;
+}
@@ -6,16 +6,17 @@
 
 typedef struct strs_button_tag strs_button;
 
+// The data of a button in the app's button pool, its rect and color live in the pool's arrays
 struct strs_button_tag {
   strs_string title;
-  float x;
-  float y;
-  float width;
-  float height;
-  strs_widget widget;
+  PFN_strs_on_action on_action;
+  // Internal, UINT32_MAX until the geometry pass pushed the rect
+  uint32_t first_vertex;
 };
 
-STRS_LIB strs_button strs_button_create(float x, float y, float width, float height);
-STRS_LIB void strs_button_on_action(strs_button *button, PFN_strs_on_action onAction);
+// Registers the button type with the app the first time
+STRS_LIB uint32_t strs_button_type(strs_app app);
+STRS_LIB strs_widget_handle strs_button_create(strs_app app, float x, float y, float width, float height);
+STRS_LIB void strs_button_on_action(strs_app app, strs_widget_handle button, PFN_strs_on_action onAction);
 
 #endif //STEROS_BUTTON_H
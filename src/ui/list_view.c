@@ -0,0 +1,419 @@
+#include "list_view.h"
+
+// STD
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define ROWS_PER_BLOCK 256
+#define DEFAULT_ROW_HEIGHT 20.0f
+#define DEFAULT_ROW_VERTICES 4
+#define DEFAULT_ROW_INDICES 6
+// Rows are rebuilt around the scroll offset once it moves this far from their origin
+#define REBASE_DISTANCE 4096.0
+
+STRS_INTERN float listRowHeight(strs_list_view *list, uint64_t row) {
+  if (list->row_height_callback == NULL) {
+    return list->row_height;
+  }
+  return list->row_height_callback(list, row, list->user_data);
+}
+
+// Sums the heights of the rows in [first_block, last_block) and rebuilds the prefix from first_block on
+STRS_INTERN void listUpdateBlocks(strs_list_view *list, uint64_t first_block, uint64_t last_block) {
+  for (uint64_t block = first_block; block < last_block; block++) {
+    uint64_t first_row = block * ROWS_PER_BLOCK;
+    uint64_t last_row = first_row + ROWS_PER_BLOCK < list->row_count ? first_row + ROWS_PER_BLOCK : list->row_count;
+    double sum = 0.0;
+
+    for (uint64_t row = first_row; row < last_row; row++) {
+      float height = listRowHeight(list, row);
+      if (height < list->min_row_height) {
+        list->min_row_height = height;
+      }
+      sum += height;
+    }
+    list->block_heights[block] = sum;
+  }
+
+  for (uint64_t block = first_block; block < list->block_count; block++) {
+    list->block_offsets[block + 1] = list->block_offsets[block] + list->block_heights[block];
+  }
+}
+
+STRS_INTERN void listBuildIndex(strs_list_view *list) {
+  if (list->row_height_callback == NULL) {
+    list->min_row_height = list->row_height;
+    return;
+  }
+
+  list->block_count = (list->row_count + ROWS_PER_BLOCK - 1) / ROWS_PER_BLOCK;
+  list->block_heights = calloc(list->block_count, sizeof(double));
+  list->block_offsets = calloc(list->block_count + 1, sizeof(double));
+  list->min_row_height = INFINITY;
+  listUpdateBlocks(list, 0, list->block_count);
+}
+
+STRS_LIB double strs_list_view_content_height(strs_list_view *list) {
+  if (list->row_height_callback == NULL) {
+    return (double) list->row_height * list->row_count;
+  }
+  return list->block_offsets[list->block_count];
+}
+
+STRS_LIB double strs_list_view_row_offset(strs_list_view *list, uint64_t row) {
+  if (list->row_height_callback == NULL) {
+    return (double) list->row_height * row;
+  }
+
+  uint64_t block = row / ROWS_PER_BLOCK;
+  double offset = list->block_offsets[block];
+  for (uint64_t i = block * ROWS_PER_BLOCK; i < row; i++) {
+    offset += listRowHeight(list, i);
+  }
+  return offset;
+}
+
+STRS_LIB uint64_t strs_list_view_row_at(strs_list_view *list, double offset) {
+  if (list->row_count == 0 || offset <= 0.0) {
+    return 0;
+  }
+
+  if (list->row_height_callback == NULL) {
+    uint64_t row = (uint64_t) (offset / list->row_height);
+    return row < list->row_count ? row : list->row_count - 1;
+  }
+
+  // Last block that starts at or before offset
+  uint64_t low = 0;
+  uint64_t high = list->block_count;
+  while (high - low > 1) {
+    uint64_t middle = low + (high - low) / 2;
+    if (list->block_offsets[middle] <= offset) {
+      low = middle;
+    } else {
+      high = middle;
+    }
+  }
+
+  double position = list->block_offsets[low];
+  uint64_t last_row = (low + 1) * ROWS_PER_BLOCK < list->row_count ? (low + 1) * ROWS_PER_BLOCK : list->row_count;
+  for (uint64_t row = low * ROWS_PER_BLOCK; row < last_row; row++) {
+    position += listRowHeight(list, row);
+    if (position > offset) {
+      return row;
+    }
+  }
+  return last_row - 1;
+}
+
+// Writes the slot's vertices moved to where its row is relative to the origin
+STRS_INTERN void listWriteSlotVertices(strs_list_view *list, uint32_t slot, strs_vertex *scratch) {
+  uint32_t count = list->slot_vertex_counts[slot];
+  if (count == 0) {
+    return;
+  }
+
+  float top = (float) (list->y + strs_list_view_row_offset(list, list->slots[slot].row) - list->origin);
+  memcpy(scratch, list->slot_vertices + (uint64_t) slot * list->max_vertices_per_row, sizeof(strs_vertex) * count);
+  for (uint32_t i = 0; i < count; i++) {
+    scratch[i].pos[1] += top;
+  }
+  strs_write_vertices(list->app, list->slots[slot].first_vertex, scratch, count);
+}
+
+STRS_INTERN void listClearSlot(strs_list_view *list, uint32_t slot) {
+  uint32_t base = list->slots[slot].first_vertex;
+  for (uint32_t i = 0; i < list->max_indices_per_row; i++) {
+    list->scratch_indices[i] = base;
+  }
+  strs_write_indices32(list->app, list->slots[slot].first_index, list->scratch_indices, list->max_indices_per_row);
+  list->slots[slot].used = false;
+  list->slot_vertex_counts[slot] = 0;
+}
+
+STRS_INTERN void listBuildSlot(strs_list_view *list, uint32_t slot, uint64_t row, strs_vertex *scratch) {
+  strs_vertex *vertices = list->slot_vertices + (uint64_t) slot * list->max_vertices_per_row;
+  uint32_t base = list->slots[slot].first_vertex;
+  float top = (float) (list->y + strs_list_view_row_offset(list, row) - list->origin);
+  strs_list_row out = {
+    .vertices = vertices,
+    .vertex_count = 0,
+    .max_vertices = list->max_vertices_per_row,
+    .indices = list->scratch_indices,
+    .index_count = 0,
+    .max_indices = list->max_indices_per_row
+  };
+
+  list->build_row(list, row, list->x, top, list->width, listRowHeight(list, row), &out, list->user_data);
+
+  if (out.vertex_count > list->max_vertices_per_row) {
+    out.vertex_count = list->max_vertices_per_row;
+  }
+  if (out.index_count > list->max_indices_per_row) {
+    out.index_count = list->max_indices_per_row;
+  }
+
+  // Keep the vertices relative to the row so a new origin only moves them
+  for (uint32_t i = 0; i < out.vertex_count; i++) {
+    vertices[i].pos[1] -= top;
+  }
+  for (uint32_t i = 0; i < list->max_indices_per_row; i++) {
+    bool valid = i < out.index_count && list->scratch_indices[i] < out.vertex_count;
+    list->scratch_indices[i] = valid ? base + list->scratch_indices[i] : base;
+  }
+
+  list->slots[slot].row = row;
+  list->slots[slot].used = true;
+  list->slot_vertex_counts[slot] = out.vertex_count;
+
+  listWriteSlotVertices(list, slot, scratch);
+  strs_write_indices32(list->app, list->slots[slot].first_index, list->scratch_indices, list->max_indices_per_row);
+}
+
+// Only rows that enter the window are built, rows that stay are moved when relayout is set.
+// Plain scrolling never sets it, the transform node carries the offset.
+STRS_INTERN void listUpdateWindow(strs_list_view *list, bool relayout) {
+  if (list->app == NULL || list->slot_count == 0) {
+    return;
+  }
+
+  strs_vertex *scratch = malloc(sizeof(strs_vertex) * list->max_vertices_per_row);
+  double top = list->scroll - list->overscan;
+  double bottom = list->scroll + list->height + list->overscan;
+  uint64_t first = strs_list_view_row_at(list, top);
+  uint64_t last = strs_list_view_row_at(list, bottom) + 1;
+  if (last > list->row_count) {
+    last = list->row_count;
+  }
+  if (last - first > list->slot_count) {
+    last = first + list->slot_count;
+  }
+
+  for (uint32_t slot = 0; slot < list->slot_count; slot++) {
+    strs_list_slot *entry = &list->slots[slot];
+    if (!entry->used) {
+      continue;
+    }
+    if (entry->row < first || entry->row >= last) {
+      listClearSlot(list, slot);
+    } else if (relayout) {
+      listWriteSlotVertices(list, slot, scratch);
+    }
+  }
+
+  for (uint64_t row = first; row < last; row++) {
+    uint32_t slot = (uint32_t) (row % list->slot_count);
+    if (!list->slots[slot].used || list->slots[slot].row != row) {
+      listBuildSlot(list, slot, row, scratch);
+    }
+  }
+
+  free(scratch);
+}
+
+STRS_INTERN void listPlace(strs_list_view *list) {
+  strs_transform_set_translate_scale(list->app, list->transform, 0.0f, (float) (list->origin - list->scroll), 1.0f);
+}
+
+// Enough slots for the viewport and the overscan filled with rows of the smallest height
+STRS_INTERN uint32_t listSlotsNeeded(strs_list_view *list) {
+  if (list->row_count == 0 || list->min_row_height <= 0.0f) {
+    return list->row_count == 0 ? 0 : 1;
+  }
+  double visible = (list->height + 2.0 * list->overscan) / list->min_row_height;
+  uint64_t slots = (uint64_t) ceil(visible) + 2;
+  return (uint32_t) (slots < list->row_count ? slots : list->row_count);
+}
+
+// Grows the slot pool to slot_count. The new slots are pushed as their own draw item, clipped to the list rect
+// like the first ones. Rows map to slots by row % slot_count, so every built row is cleared to be built again.
+STRS_INTERN void listReserveSlots(strs_list_view *list, uint32_t slot_count) {
+  uint32_t old_count = list->slot_count;
+  if (list->app == NULL || slot_count <= old_count) {
+    return;
+  }
+
+  for (uint32_t slot = 0; slot < old_count; slot++) {
+    if (list->slots[slot].used) {
+      listClearSlot(list, slot);
+    }
+  }
+
+  uint32_t added = slot_count - old_count;
+  list->slots = realloc(list->slots, sizeof(strs_list_slot) * slot_count);
+  list->slot_vertex_counts = realloc(list->slot_vertex_counts, sizeof(uint32_t) * slot_count);
+  list->slot_vertices = realloc(list->slot_vertices,
+                                sizeof(strs_vertex) * (uint64_t) slot_count * list->max_vertices_per_row);
+  memset(list->slot_vertex_counts + old_count, 0, sizeof(uint32_t) * added);
+  if (list->scratch_indices == NULL) {
+    list->scratch_indices = malloc(sizeof(uint32_t) * list->max_indices_per_row);
+  }
+
+  // The corners of the list rect give the widget its bounds,
+  // stretched by how far the node can move before the rows are rebased.
+  uint64_t vertex_count = (uint64_t) added * list->max_vertices_per_row;
+  uint64_t index_count = (uint64_t) added * list->max_indices_per_row;
+  strs_vertex *vertices = calloc(vertex_count, sizeof(strs_vertex));
+  for (uint64_t i = 0; i < vertex_count; i++) {
+    vertices[i].pos[0] = list->x + ((i & 1) ? list->width : 0.0f);
+    vertices[i].pos[1] = (i & 2) ? list->y + list->height + (float) REBASE_DISTANCE : list->y - (float) REBASE_DISTANCE;
+  }
+
+  strs_transform parent = strs_app_get_transform(list->app);
+  const strs_rect clip = {list->x, list->y, list->width, list->height};
+  strs_app_set_transform(list->app, list->transform);
+  strs_push_clip(list->app, &clip);
+  uint32_t first_index = (uint32_t) strs_app_index_count(list->app);
+  uint32_t first_vertex = strs_push_vertices(list->app, vertices, vertex_count);
+
+  uint32_t *indices = malloc(sizeof(uint32_t) * index_count);
+  for (uint64_t i = 0; i < index_count; i++) {
+    indices[i] = first_vertex;
+  }
+  strs_push_indices32(list->app, indices, index_count);
+  strs_pop_clip(list->app);
+  strs_app_set_transform(list->app, parent);
+
+  for (uint32_t i = 0; i < added; i++) {
+    list->slots[old_count + i] = (strs_list_slot){
+      .first_vertex = first_vertex + i * list->max_vertices_per_row,
+      .first_index = first_index + i * list->max_indices_per_row
+    };
+  }
+  list->slot_count = slot_count;
+
+  free(vertices);
+  free(indices);
+}
+
+STRS_INTERN void listCreateWidget(strs_app app, void *pointer) {
+  strs_list_view *list = (strs_list_view*)pointer;
+  strs_transform parent;
+
+  list->app = app;
+  listBuildIndex(list);
+
+  parent = strs_app_get_transform(list->app);
+  list->transform = strs_transform_create(list->app, parent);
+  list->origin = list->scroll;
+  listPlace(list);
+
+  // Reserve every slot up front, more are only added when later rows are lower than all of these
+  listReserveSlots(list, listSlotsNeeded(list));
+  listUpdateWindow(list, false);
+}
+
+STRS_INTERN void listUpdateWidget(strs_app app, void *pointer) {
+
+}
+
+STRS_INTERN void listWhileSelected(strs_app app, void *pointer) {
+
+}
+
+STRS_LIB strs_list_view *strs_list_view_create(float x, float y, float width, float height,
+                                               uint64_t row_count, PFN_strs_list_build_row build_row,
+                                               void *user_data) {
+  strs_list_view *list = calloc(1, sizeof(strs_list_view));
+
+  list->x = x;
+  list->y = y;
+  list->width = width;
+  list->height = height;
+  list->row_count = row_count;
+  list->row_height = DEFAULT_ROW_HEIGHT;
+  list->build_row = build_row;
+  list->user_data = user_data;
+  list->max_vertices_per_row = DEFAULT_ROW_VERTICES;
+  list->max_indices_per_row = DEFAULT_ROW_INDICES;
+  list->widget = (strs_widget){
+    .pointer = list,
+    .create_widget = listCreateWidget,
+    .update_widget = listUpdateWidget,
+    .while_selected = listWhileSelected
+  };
+
+  return list;
+}
+
+STRS_LIB void strs_list_view_free(strs_list_view *list) {
+  if (list->app != NULL) {
+    strs_transform_destroy(list->app, list->transform);
+  }
+  free(list->slots);
+  free(list->slot_vertices);
+  free(list->slot_vertex_counts);
+  free(list->scratch_indices);
+  free(list->block_heights);
+  free(list->block_offsets);
+  free(list);
+}
+
+STRS_LIB void strs_list_view_set_row_height(strs_list_view *list, float row_height) {
+  list->row_height = row_height;
+}
+
+STRS_LIB void strs_list_view_set_row_height_callback(strs_list_view *list, PFN_strs_list_row_height callback) {
+  list->row_height_callback = callback;
+}
+
+STRS_LIB void strs_list_view_set_overscan(strs_list_view *list, float overscan) {
+  list->overscan = overscan;
+}
+
+STRS_LIB void strs_list_view_set_row_capacity(strs_list_view *list, uint32_t max_vertices, uint32_t max_indices) {
+  list->max_vertices_per_row = max_vertices;
+  list->max_indices_per_row = max_indices;
+}
+
+STRS_LIB void strs_list_view_scroll_to(strs_list_view *list, double offset) {
+  double max_scroll = strs_list_view_content_height(list) - list->height;
+  if (offset > max_scroll) {
+    offset = max_scroll;
+  }
+  if (offset < 0.0) {
+    offset = 0.0;
+  }
+  if (offset == list->scroll) {
+    return;
+  }
+
+  list->scroll = offset;
+  if (list->app == NULL) {
+    return;
+  }
+
+  bool rebase = fabs(list->scroll - list->origin) > REBASE_DISTANCE;
+  if (rebase) {
+    list->origin = list->scroll;
+  }
+  listPlace(list);
+  listUpdateWindow(list, rebase);
+}
+
+STRS_LIB void strs_list_view_scroll_by(strs_list_view *list, double delta) {
+  strs_list_view_scroll_to(list, list->scroll + delta);
+}
+
+STRS_LIB void strs_list_view_invalidate_rows(strs_list_view *list, uint64_t first, uint64_t count) {
+  if (first >= list->row_count) {
+    return;
+  }
+  if (count > list->row_count - first) {
+    count = list->row_count - first;
+  }
+
+  if (list->row_height_callback != NULL && list->block_count > 0) {
+    listUpdateBlocks(list, first / ROWS_PER_BLOCK, (first + count + ROWS_PER_BLOCK - 1) / ROWS_PER_BLOCK);
+    listReserveSlots(list, listSlotsNeeded(list));
+  }
+
+  // Cleared rather than only marked unused, a row that leaves the window must not keep its old geometry
+  for (uint32_t slot = 0; slot < list->slot_count; slot++) {
+    if (list->slots[slot].used && list->slots[slot].row >= first && list->slots[slot].row < first + count) {
+      listClearSlot(list, slot);
+    }
+  }
+  listUpdateWindow(list, true);
+}
@@ -0,0 +1,88 @@
+#ifndef STEROS_LIST_VIEW_H
+#define STEROS_LIST_VIEW_H
+
+#include "steros.h"
+#include "app.h"
+
+typedef struct strs_list_view_tag strs_list_view;
+
+// Geometry of one row. Vertex positions are absolute, indices are relative to
+// the row's first vertex. Unused index slots are turned into degenerate triangles.
+typedef struct {
+  strs_vertex *vertices;
+  uint32_t vertex_count;
+  uint32_t max_vertices;
+  uint32_t *indices;
+  uint32_t index_count;
+  uint32_t max_indices;
+} strs_list_row;
+
+typedef void (*PFN_strs_list_build_row)(strs_list_view *list, uint64_t row,
+                                        float x, float y, float width, float height,
+                                        strs_list_row *out, void *user_data);
+typedef float (*PFN_strs_list_row_height)(strs_list_view *list, uint64_t row, void *user_data);
+
+typedef struct {
+  uint64_t row;
+  bool used;
+  // Where the slot's reserved geometry starts, slots added when rows shrink get their own ranges
+  uint32_t first_vertex;
+  uint32_t first_index;
+} strs_list_slot;
+
+struct strs_list_view_tag {
+  float x;
+  float y;
+  float width;
+  float height;
+  uint64_t row_count;
+  // Used when row_height_callback is NULL
+  float row_height;
+  PFN_strs_list_row_height row_height_callback;
+  PFN_strs_list_build_row build_row;
+  void *user_data;
+  // Rows this far above and below the viewport are built ahead of time
+  float overscan;
+  uint32_t max_vertices_per_row;
+  uint32_t max_indices_per_row;
+  double scroll;
+
+  // Internal
+  strs_app app;
+  // Scrolling only moves this node, rows are placed relative to origin so their floats stay small
+  strs_transform transform;
+  double origin;
+  uint32_t slot_count;
+  strs_list_slot *slots;
+  strs_vertex *slot_vertices;
+  uint32_t *slot_vertex_counts;
+  uint32_t *scratch_indices;
+  float min_row_height;
+  // Prefix sums of the row heights, one entry per block of rows
+  double *block_heights;
+  double *block_offsets;
+  uint64_t block_count;
+  strs_widget widget;
+};
+
+STRS_LIB strs_list_view *strs_list_view_create(float x, float y, float width, float height,
+                                               uint64_t row_count, PFN_strs_list_build_row build_row,
+                                               void *user_data);
+STRS_LIB void strs_list_view_free(strs_list_view *list);
+
+// Configuration, only valid before the list is added to an app
+STRS_LIB void strs_list_view_set_row_height(strs_list_view *list, float row_height);
+STRS_LIB void strs_list_view_set_row_height_callback(strs_list_view *list, PFN_strs_list_row_height callback);
+STRS_LIB void strs_list_view_set_overscan(strs_list_view *list, float overscan);
+STRS_LIB void strs_list_view_set_row_capacity(strs_list_view *list, uint32_t max_vertices, uint32_t max_indices);
+
+STRS_LIB void strs_list_view_scroll_to(strs_list_view *list, double offset);
+STRS_LIB void strs_list_view_scroll_by(strs_list_view *list, double delta);
+STRS_LIB double strs_list_view_content_height(strs_list_view *list);
+STRS_LIB uint64_t strs_list_view_row_at(strs_list_view *list, double offset);
+STRS_LIB double strs_list_view_row_offset(strs_list_view *list, uint64_t row);
+// Call after the heights or the contents of rows changed, visible rows are rebuilt.
+// Rows lower than any before add slots, their geometry is pushed as a new draw item.
+STRS_LIB void strs_list_view_invalidate_rows(strs_list_view *list, uint64_t first, uint64_t count);
+
+#endif //STEROS_LIST_VIEW_H
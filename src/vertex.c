@@ -0,0 +1,146 @@
+// STD
+#include <math.h>
+#include <string.h>
+
+// LIB
+#include "app.h"
+
+typedef struct {
+  float pos[2];
+  uint8_t color[4];
+  uint16_t uv[2];
+} unpacked_vertex;
+
+STRS_INTERN int16_t pack_position(float value) {
+  float scaled = roundf(value * STRS_VERTEX_COMPACT_SCALE);
+  if (scaled > INT16_MAX) {
+    return INT16_MAX;
+  }
+  if (scaled < INT16_MIN) {
+    return INT16_MIN;
+  }
+  return (int16_t) scaled;
+}
+
+STRS_INTERN uint8_t pack_channel(float value) {
+  if (value <= 0.0f) {
+    return 0;
+  }
+  if (value >= 1.0f) {
+    return 255;
+  }
+  return (uint8_t) (value * 255.0f + 0.5f);
+}
+
+STRS_INTERN void unpack_vertex(strs_vertex_format format, const void *src, uint64_t i, unpacked_vertex *out) {
+  switch (format) {
+    case STRS_VERTEX_FORMAT_DEFAULT: {
+      const strs_vertex *vertex = (const strs_vertex*)src + i;
+      out->pos[0] = vertex->pos[0];
+      out->pos[1] = vertex->pos[1];
+      out->color[0] = pack_channel(vertex->color[0]);
+      out->color[1] = pack_channel(vertex->color[1]);
+      out->color[2] = pack_channel(vertex->color[2]);
+      out->color[3] = 255;
+      out->uv[0] = 0;
+      out->uv[1] = 0;
+      break;
+    }
+    case STRS_VERTEX_FORMAT_COMPACT: {
+      const strs_vertex_compact *vertex = (const strs_vertex_compact*)src + i;
+      out->pos[0] = vertex->pos[0] / STRS_VERTEX_COMPACT_SCALE;
+      out->pos[1] = vertex->pos[1] / STRS_VERTEX_COMPACT_SCALE;
+      memcpy(out->color, vertex->color, sizeof(out->color));
+      out->uv[0] = 0;
+      out->uv[1] = 0;
+      break;
+    }
+    case STRS_VERTEX_FORMAT_COMPACT_UV: {
+      const strs_vertex_compact_uv *vertex = (const strs_vertex_compact_uv*)src + i;
+      out->pos[0] = vertex->pos[0] / STRS_VERTEX_COMPACT_SCALE;
+      out->pos[1] = vertex->pos[1] / STRS_VERTEX_COMPACT_SCALE;
+      memcpy(out->color, vertex->color, sizeof(out->color));
+      out->uv[0] = vertex->uv[0];
+      out->uv[1] = vertex->uv[1];
+      break;
+    }
+    default:
+      memset(out, 0, sizeof(*out));
+      break;
+  }
+}
+
+STRS_INTERN void pack_vertex(strs_vertex_format format, const unpacked_vertex *in, void *dst, uint64_t i) {
+  switch (format) {
+    case STRS_VERTEX_FORMAT_DEFAULT: {
+      strs_vertex *vertex = (strs_vertex*)dst + i;
+      vertex->pos[0] = in->pos[0];
+      vertex->pos[1] = in->pos[1];
+      vertex->color[0] = in->color[0] / 255.0f;
+      vertex->color[1] = in->color[1] / 255.0f;
+      vertex->color[2] = in->color[2] / 255.0f;
+      break;
+    }
+    case STRS_VERTEX_FORMAT_COMPACT: {
+      strs_vertex_compact *vertex = (strs_vertex_compact*)dst + i;
+      vertex->pos[0] = pack_position(in->pos[0]);
+      vertex->pos[1] = pack_position(in->pos[1]);
+      memcpy(vertex->color, in->color, sizeof(vertex->color));
+      break;
+    }
+    case STRS_VERTEX_FORMAT_COMPACT_UV: {
+      strs_vertex_compact_uv *vertex = (strs_vertex_compact_uv*)dst + i;
+      vertex->pos[0] = pack_position(in->pos[0]);
+      vertex->pos[1] = pack_position(in->pos[1]);
+      memcpy(vertex->color, in->color, sizeof(vertex->color));
+      vertex->uv[0] = in->uv[0];
+      vertex->uv[1] = in->uv[1];
+      break;
+    }
+  }
+}
+
+STRS_LIB size_t strs_vertex_format_size(strs_vertex_format format) {
+  switch (format) {
+    case STRS_VERTEX_FORMAT_COMPACT:
+      return sizeof(strs_vertex_compact);
+    case STRS_VERTEX_FORMAT_COMPACT_UV:
+      return sizeof(strs_vertex_compact_uv);
+    default:
+      return sizeof(strs_vertex);
+  }
+}
+
+STRS_LIB void strs_vertex_convert(strs_vertex_format src_format, const void *src,
+                                  strs_vertex_format dst_format, void *dst, uint64_t count) {
+  unpacked_vertex vertex;
+
+  if (src_format == dst_format) {
+    memcpy(dst, src, strs_vertex_format_size(src_format) * count);
+    return;
+  }
+
+  for (uint64_t i = 0; i < count; i++) {
+    unpack_vertex(src_format, src, i, &vertex);
+    pack_vertex(dst_format, &vertex, dst, i);
+  }
+}
+
+STRS_LIB void strs_vertex_to_compact(const strs_vertex *src, strs_vertex_compact *dst, uint64_t count) {
+  for (uint64_t i = 0; i < count; i++) {
+    dst[i].pos[0] = pack_position(src[i].pos[0]);
+    dst[i].pos[1] = pack_position(src[i].pos[1]);
+    dst[i].color[0] = pack_channel(src[i].color[0]);
+    dst[i].color[1] = pack_channel(src[i].color[1]);
+    dst[i].color[2] = pack_channel(src[i].color[2]);
+    dst[i].color[3] = 255;
+  }
+}
+
+STRS_LIB void strs_vertex_to_compact_uv(const strs_vertex *src, strs_vertex_compact_uv *dst, uint64_t count) {
+  strs_vertex_convert(STRS_VERTEX_FORMAT_DEFAULT, src, STRS_VERTEX_FORMAT_COMPACT_UV, dst, count);
+}
+
+STRS_LIB void strs_vertex_from_compact(const strs_vertex_compact *src, strs_vertex *dst, uint64_t count) {
+  strs_vertex_convert(STRS_VERTEX_FORMAT_COMPACT, src, STRS_VERTEX_FORMAT_DEFAULT, dst, count);
+}
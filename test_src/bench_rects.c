@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <app.h>
+#include <helper/clock.h>
+
+#define RECT_COUNT 200000
+#define ITERATIONS 20
+
+typedef void (*fill_vertices)(strs_vertex_format format, const strs_rect *rects, const vec3 *colors,
+                              uint64_t count, void *dst);
+typedef void (*fill_indices)(uint32_t first_vertex, uint64_t count, uint32_t *dst);
+
+static double bench(strs_vertex_format format, fill_vertices vertices_kernel, fill_indices indices_kernel,
+                    const strs_rect *rects, const vec3 *colors, void *vertices, uint32_t *indices) {
+  uint64_t best = UINT64_MAX;
+  for (int i = 0; i < ITERATIONS; i++) {
+    uint64_t begin = strs_clock_now_ns();
+    vertices_kernel(format, rects, colors, RECT_COUNT, vertices);
+    indices_kernel(0, RECT_COUNT, indices);
+    uint64_t elapsed = strs_clock_now_ns() - begin;
+    best = elapsed < best ? elapsed : best;
+  }
+  return best / 1e6;
+}
+
+int main(void) {
+  const strs_vertex_format formats[] = {
+    STRS_VERTEX_FORMAT_DEFAULT, STRS_VERTEX_FORMAT_COMPACT, STRS_VERTEX_FORMAT_COMPACT_UV};
+  const char *names[] = {"default", "compact", "compact_uv"};
+  size_t vertex_bytes = sizeof(strs_vertex) * STRS_RECT_VERTEX_COUNT * RECT_COUNT;
+  size_t index_count = (size_t) STRS_RECT_INDEX_COUNT * RECT_COUNT;
+  strs_rect *rects = malloc(sizeof(strs_rect) * RECT_COUNT);
+  vec3 *colors = malloc(sizeof(vec3) * RECT_COUNT);
+  void *scalar_vertices = malloc(vertex_bytes);
+  void *simd_vertices = malloc(vertex_bytes);
+  uint32_t *scalar_indices = malloc(sizeof(uint32_t) * index_count);
+  uint32_t *simd_indices = malloc(sizeof(uint32_t) * index_count);
+  int failed = 0;
+
+  // A grid of cells, roughly what a large table looks like
+  for (uint32_t i = 0; i < RECT_COUNT; i++) {
+    rects[i] = (strs_rect){
+      .x = (float) (i % 400) * 10.25f,
+      .y = (float) (i / 400) * 8.5f,
+      .width = 9.75f,
+      .height = 8.0f};
+    colors[i][0] = (float) (i % 7) / 6.0f;
+    colors[i][1] = (float) (i % 11) / 10.0f;
+    colors[i][2] = (float) (i % 13) / 12.0f;
+  }
+
+  for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+    size_t bytes = strs_vertex_format_size(formats[f]) * STRS_RECT_VERTEX_COUNT * RECT_COUNT;
+    double scalar = bench(formats[f], strs_rects_fill_vertices_scalar, strs_rects_fill_indices_scalar,
+                          rects, colors, scalar_vertices, scalar_indices);
+    double simd = bench(formats[f], strs_rects_fill_vertices, strs_rects_fill_indices,
+                        rects, colors, simd_vertices, simd_indices);
+
+    if (memcmp(scalar_vertices, simd_vertices, bytes) != 0 ||
+        memcmp(scalar_indices, simd_indices, sizeof(uint32_t) * index_count) != 0) {
+      printf("%s: kernels disagree\n", names[f]);
+      failed = 1;
+    }
+    printf("%-10s %d rects  scalar %8.3f ms  simd %8.3f ms  %.2fx\n",
+           names[f], RECT_COUNT, scalar, simd, scalar / simd);
+  }
+
+  float scalar_bounds[4];
+  float simd_bounds[4];
+  strs_rects_bounds_scalar(rects, RECT_COUNT, scalar_bounds);
+  strs_rects_bounds(rects, RECT_COUNT, simd_bounds);
+  if (memcmp(scalar_bounds, simd_bounds, sizeof(scalar_bounds)) != 0) {
+    printf("bounds disagree\n");
+    failed = 1;
+  }
+
+  free(rects);
+  free(colors);
+  free(scalar_vertices);
+  free(simd_vertices);
+  free(scalar_indices);
+  free(simd_indices);
+  return failed;
+}
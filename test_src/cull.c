@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <time.h>
+
+#include <app.h>
+#include <helper/clock.h>
+
+// Draws rects inside and outside of the cull viewport with GPU culling on and checks how many draws the
+// compute pass kept. Needs a window and a Vulkan device, lavapipe under Xvfb will do.
+// Exits with 77, which ctest counts as skipped, when the device can't cull on the GPU.
+
+#define CULL_TIMEOUT_NS 10000000000ull
+
+typedef struct {
+  strs_rect rect;
+  bool visible;
+} cull_case;
+
+int main(void) {
+  const cull_case cases[] = {
+    {{10.0f, 10.0f, 50.0f, 50.0f}, true},
+    {{400.0f, 300.0f, 20.0f, 20.0f}, true},
+    {{700.0f, 500.0f, 99.0f, 99.0f}, true},
+    // Crosses the right edge, partly visible is visible
+    {{780.0f, 100.0f, 50.0f, 50.0f}, true},
+    {{-200.0f, 100.0f, 50.0f, 50.0f}, false},
+    {{900.0f, 100.0f, 50.0f, 50.0f}, false},
+    {{100.0f, -300.0f, 50.0f, 50.0f}, false},
+    {{100.0f, 700.0f, 50.0f, 50.0f}, false},
+    {{5000.0f, 5000.0f, 10.0f, 10.0f}, false},
+    {{-5000.0f, -5000.0f, 10.0f, 10.0f}, false}};
+  const uint64_t case_count = sizeof(cases) / sizeof(cases[0]);
+
+  strs_string title = strs_string_create_from_cstr("steros_test_cull", 17);
+  strs_app_options options = {.gpu_culling = true};
+  strs_app app = strs_app_create_ex(800, 600, &title, &options);
+
+  strs_device_capabilities capabilities;
+  strs_app_get_device_capabilities(app, &capabilities);
+  if (!capabilities.draw_indirect_first_instance) {
+    printf("skipped, the device has no firstInstance in indirect draws\n");
+    strs_app_close(app);
+    strs_app_free(app);
+    return 77;
+  }
+
+  // One draw item, so one cull record, per push
+  uint64_t expected = 0;
+  for (uint64_t i = 0; i < case_count; i++) {
+    const vec3 color = {1.0f, (float) i / (float) case_count, 0.0f};
+    strs_push_rects(app, &cases[i].rect, &color, 1);
+    expected += cases[i].visible;
+  }
+  strs_app_set_cull_viewport(app, 0.0f, 0.0f, 800.0f, 600.0f);
+  strs_app_run(app);
+
+  // The counts are read back a frame or two after they were written
+  strs_cull_stats stats = {0};
+  uint64_t deadline = strs_clock_now_ns() + CULL_TIMEOUT_NS;
+  while (strs_clock_now_ns() < deadline) {
+    strs_app_get_cull_stats(app, &stats);
+    if (stats.total_draws == case_count && stats.visible_draws == expected) {
+      break;
+    }
+    struct timespec wait = {.tv_nsec = 10000000};
+    nanosleep(&wait, NULL);
+  }
+  strs_app_close(app);
+  strs_app_free(app);
+
+  printf("%llu of %llu draws visible, expected %llu of %llu\n", (unsigned long long) stats.visible_draws,
+         (unsigned long long) stats.total_draws, (unsigned long long) expected, (unsigned long long) case_count);
+  return stats.total_draws == case_count && stats.visible_draws == expected ? 0 : 1;
+}
@@ -0,0 +1,250 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <jobs.h>
+#include <helper/input_ring.h>
+
+// Stresses the job scheduler and the input ring from many threads at once. Runs without a window or a GPU,
+// a lost job or event, a job that ran before its dependency and a hang in strs_jobs_wait all fail it.
+
+#define PRODUCER_COUNT 8
+#define JOBS_PER_PRODUCER 20000
+#define CHAIN_LENGTH (STRS_JOB_CAPACITY * 3)
+#define FAN_IN 64
+#define TREE_DEPTH 12
+#define EVENTS_PER_PRODUCER 100000
+
+typedef struct {
+  strs_jobs jobs;
+  uint64_t counter;
+  strs_job *spawned;
+} producer_test;
+
+typedef struct {
+  uint64_t *counter;
+  uint64_t seen;
+} fan_in_test;
+
+typedef struct {
+  uint64_t step;
+  uint64_t errors;
+} chain_test;
+
+typedef struct {
+  chain_test *chain;
+  uint64_t index;
+} chain_link;
+
+typedef struct {
+  strs_jobs jobs;
+  uint32_t depth;
+  uint64_t *leaves;
+} tree_node;
+
+typedef struct {
+  strs_input_ring *ring;
+  uint32_t producer;
+  // Pushes that found the ring full, each is tried again until it fits
+  uint64_t refused;
+  uint32_t *finished;
+} input_producer;
+
+STRS_INTERN void count_job(void *data) {
+  __atomic_add_fetch((uint64_t*)data, 1, __ATOMIC_RELAXED);
+}
+
+STRS_INTERN void *spawn_from_thread(void *data) {
+  producer_test *test = (producer_test*)data;
+  for (uint64_t i = 0; i < JOBS_PER_PRODUCER; i++) {
+    test->spawned[i] = strs_jobs_spawn(test->jobs, count_job, &test->counter, NULL, 0);
+  }
+  return NULL;
+}
+
+// Spawns from threads the scheduler does not own, all through the shared queue
+STRS_INTERN bool test_producers(strs_jobs jobs) {
+  pthread_t threads[PRODUCER_COUNT];
+  producer_test producers[PRODUCER_COUNT];
+  uint64_t ran = 0;
+  strs_job *spawned = malloc(sizeof(strs_job) * PRODUCER_COUNT * JOBS_PER_PRODUCER);
+
+  for (uint32_t i = 0; i < PRODUCER_COUNT; i++) {
+    producers[i] = (producer_test){.jobs = jobs, .spawned = spawned + (uint64_t) i * JOBS_PER_PRODUCER};
+    pthread_create(&threads[i], NULL, spawn_from_thread, &producers[i]);
+  }
+  for (uint32_t i = 0; i < PRODUCER_COUNT; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  for (uint64_t i = 0; i < (uint64_t) PRODUCER_COUNT * JOBS_PER_PRODUCER; i++) {
+    strs_jobs_wait(jobs, spawned[i]);
+  }
+  for (uint32_t i = 0; i < PRODUCER_COUNT; i++) {
+    ran += producers[i].counter;
+  }
+  free(spawned);
+
+  printf("  producers: %llu of %llu jobs ran\n", (unsigned long long) ran,
+         (unsigned long long) PRODUCER_COUNT * JOBS_PER_PRODUCER);
+  return ran == (uint64_t) PRODUCER_COUNT * JOBS_PER_PRODUCER;
+}
+
+STRS_INTERN void chain_job(void *data) {
+  chain_link *link = (chain_link*)data;
+  if (link->chain->step != link->index) {
+    link->chain->errors++;
+  }
+  link->chain->step = link->index + 1;
+}
+
+STRS_INTERN void fan_in_job(void *data) {
+  fan_in_test *test = (fan_in_test*)data;
+  test->seen = __atomic_load_n(test->counter, __ATOMIC_RELAXED);
+}
+
+// A chain longer than STRS_JOB_CAPACITY, so spawning it has to wait for the front to finish,
+// then one job that depends on many
+STRS_INTERN bool test_dependencies(strs_jobs jobs) {
+  chain_test chain = {0};
+  chain_link *links = malloc(sizeof(chain_link) * CHAIN_LENGTH);
+  strs_job previous = STRS_JOB_NONE;
+
+  for (uint64_t i = 0; i < CHAIN_LENGTH; i++) {
+    links[i] = (chain_link){.chain = &chain, .index = i};
+    previous = strs_jobs_spawn(jobs, chain_job, &links[i], &previous, 1);
+  }
+  strs_jobs_wait(jobs, previous);
+
+  uint64_t counter = 0;
+  strs_job fan[FAN_IN];
+  for (uint32_t i = 0; i < FAN_IN; i++) {
+    fan[i] = strs_jobs_spawn(jobs, count_job, &counter, NULL, 0);
+  }
+  // Every job it depends on must have counted by the time it reads the counter
+  fan_in_test fan_in = {.counter = &counter};
+  strs_jobs_wait(jobs, strs_jobs_spawn(jobs, fan_in_job, &fan_in, fan, FAN_IN));
+  bool fan_ok = fan_in.seen == FAN_IN;
+  free(links);
+
+  printf("  dependencies: %llu of %u links in order, fan in %s\n",
+         (unsigned long long) (CHAIN_LENGTH - chain.errors), CHAIN_LENGTH, fan_ok ? "ok" : "failed");
+  return chain.errors == 0 && chain.step == CHAIN_LENGTH && fan_ok;
+}
+
+STRS_INTERN void tree_job(void *data) {
+  tree_node *node = (tree_node*)data;
+  if (node->depth == 0) {
+    __atomic_add_fetch(node->leaves, 1, __ATOMIC_RELAXED);
+    return;
+  }
+
+  tree_node children[2];
+  strs_job spawned[2];
+  for (uint32_t i = 0; i < 2; i++) {
+    children[i] = (tree_node){.jobs = node->jobs, .depth = node->depth - 1, .leaves = node->leaves};
+    spawned[i] = strs_jobs_spawn(node->jobs, tree_job, &children[i], NULL, 0);
+  }
+  // The children live on this stack, so this job must not return before they ran
+  strs_jobs_wait(node->jobs, spawned[0]);
+  strs_jobs_wait(node->jobs, spawned[1]);
+}
+
+// Jobs that spawn children and wait for them, more than STRS_JOB_CAPACITY in all
+STRS_INTERN bool test_nested_wait(strs_jobs jobs) {
+  uint64_t leaves = 0;
+  tree_node root = {.jobs = jobs, .depth = TREE_DEPTH, .leaves = &leaves};
+  strs_jobs_wait(jobs, strs_jobs_spawn(jobs, tree_job, &root, NULL, 0));
+
+  printf("  nested wait: %llu of %u leaves\n", (unsigned long long) leaves, 1u << TREE_DEPTH);
+  return leaves == 1u << TREE_DEPTH;
+}
+
+STRS_INTERN void *push_events(void *data) {
+  input_producer *producer = (input_producer*)data;
+  for (uint64_t i = 0; i < EVENTS_PER_PRODUCER; i++) {
+    strs_input_event event = {
+      .type = STRS_INPUT_POINTER_MOVE,
+      .x = (float) producer->producer,
+      .y = (float) i};
+    while (!strs_input_ring_push(producer->ring, &event)) {
+      producer->refused++;
+      sched_yield();
+    }
+  }
+  __atomic_add_fetch(producer->finished, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+// Producers push while this thread pops. Every event comes out once, in the order its producer pushed it,
+// and every push that found the ring full is counted as dropped.
+STRS_INTERN bool test_input_ring(void) {
+  strs_input_ring *ring = malloc(sizeof(strs_input_ring));
+  pthread_t threads[PRODUCER_COUNT];
+  input_producer producers[PRODUCER_COUNT];
+  float next[PRODUCER_COUNT] = {0};
+  uint64_t popped = 0;
+  uint64_t errors = 0;
+  uint32_t finished = 0;
+  bool draining = false;
+  strs_input_event event;
+
+  strs_input_ring_init(ring);
+  for (uint32_t i = 0; i < PRODUCER_COUNT; i++) {
+    producers[i] = (input_producer){.ring = ring, .producer = i, .finished = &finished};
+    pthread_create(&threads[i], NULL, push_events, &producers[i]);
+  }
+
+  while (true) {
+    if (!strs_input_ring_pop(ring, &event)) {
+      // Once every producer finished one more pass empties the ring
+      if (draining) {
+        break;
+      }
+      draining = __atomic_load_n(&finished, __ATOMIC_ACQUIRE) == PRODUCER_COUNT;
+      continue;
+    }
+    uint32_t producer = (uint32_t) event.x;
+    if (producer >= PRODUCER_COUNT || event.y != next[producer] || event.coalesced != 1 ||
+        event.timestamp_ns == 0) {
+      errors++;
+    } else {
+      next[producer] = event.y + 1.0f;
+    }
+    popped++;
+  }
+  for (uint32_t i = 0; i < PRODUCER_COUNT; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  uint64_t refused = 0;
+  for (uint32_t i = 0; i < PRODUCER_COUNT; i++) {
+    refused += producers[i].refused;
+  }
+  uint64_t dropped = ring->dropped;
+  free(ring);
+
+  printf("  input ring: %llu of %llu popped, %llu out of order, %llu of %llu refused pushes dropped\n",
+         (unsigned long long) popped, (unsigned long long) PRODUCER_COUNT * EVENTS_PER_PRODUCER,
+         (unsigned long long) errors, (unsigned long long) dropped, (unsigned long long) refused);
+  return errors == 0 && popped == (uint64_t) PRODUCER_COUNT * EVENTS_PER_PRODUCER && dropped == refused;
+}
+
+int main(void) {
+  // Without workers jobs only run while some thread waits or spawns into a full scheduler
+  const uint32_t worker_counts[] = {0, 1, 4, strs_jobs_default_worker_count()};
+  bool ok = true;
+
+  for (uint32_t i = 0; i < sizeof(worker_counts) / sizeof(worker_counts[0]); i++) {
+    printf("%u workers\n", worker_counts[i]);
+    strs_jobs jobs = strs_jobs_create(worker_counts[i]);
+    ok &= test_producers(jobs);
+    ok &= test_dependencies(jobs);
+    ok &= test_nested_wait(jobs);
+    strs_jobs_free(jobs);
+  }
+  ok &= test_input_ring();
+
+  printf("%s\n", ok ? "passed" : "failed");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,197 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <app.h>
+#include <capture.h>
+#include <jobs.h>
+#include <soft.h>
+#include <helper/clock.h>
+
+// Replays a capture without a window, drawing every frame with the CPU renderer, and prints how long the
+// frames took. Usage: steros_replay capture [--paced] [--frames] [--app]
+//   --paced   waits out the time between the records like the session did, frames are timed without the waits
+//   --frames  prints every frame and not only the summary
+//   --app     makes the calls on an app with a window instead, a frame is the calls up to and including its
+//             strs_app_publish
+
+typedef struct {
+  uint64_t *ns;
+  uint64_t count;
+  uint64_t capacity;
+  uint64_t total_ns;
+} frame_times;
+
+static int compare_ns(const void *a, const void *b) {
+  uint64_t left = *(const uint64_t*)a;
+  uint64_t right = *(const uint64_t*)b;
+  return left < right ? -1 : left > right;
+}
+
+static void add_frame(frame_times *frames, uint64_t ns) {
+  if (frames->count == frames->capacity) {
+    frames->capacity = frames->capacity == 0 ? 1024 : frames->capacity * 2;
+    frames->ns = realloc(frames->ns, sizeof(uint64_t) * frames->capacity);
+  }
+  frames->ns[frames->count++] = ns;
+  frames->total_ns += ns;
+}
+
+static void print_summary(strs_replay replay, frame_times *frames, uint32_t width, uint32_t height) {
+  strs_replay_stats stats;
+  strs_replay_get_stats(replay, &stats);
+  printf("%llu records  %llu frames  %llu not drawn headless  %ux%u\n", (unsigned long long) stats.records,
+         (unsigned long long) frames->count, (unsigned long long) stats.skipped, width, height);
+  if (frames->count > 0) {
+    uint64_t count = frames->count;
+    qsort(frames->ns, count, sizeof(uint64_t), compare_ns);
+    printf("frame ms  mean %.3f  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+           frames->total_ns / 1e6 / count, frames->ns[count / 2] / 1e6, frames->ns[count * 95 / 100] / 1e6,
+           frames->ns[count * 99 / 100] / 1e6, frames->ns[count - 1] / 1e6);
+  }
+  free(frames->ns);
+}
+
+static void sleep_until(uint64_t deadline_ns) {
+  uint64_t now = strs_clock_now_ns();
+  if (deadline_ns > now) {
+    struct timespec wait = {
+      .tv_sec = (time_t) ((deadline_ns - now) / 1000000000ull),
+      .tv_nsec = (long) ((deadline_ns - now) % 1000000000ull)};
+    nanosleep(&wait, NULL);
+  }
+}
+
+// The calls go to the app through strs_replay_apply, the render thread draws what every frame record publishes
+static int replay_app(strs_replay replay, bool paced, bool print_frames) {
+  strs_call_record record;
+  // The first record of every capture is the size of the window
+  if (!strs_replay_next(replay, &record) || record.call != STRS_CALL_RESIZE) {
+    printf("the capture does not start with a resize\n");
+    return 1;
+  }
+  uint32_t width = (uint32_t) record.args[0];
+  uint32_t height = (uint32_t) record.args[1];
+  strs_string title = strs_string_create_from_cstr("steros_replay", 14);
+  strs_app_options options = {.manual_publish = true};
+  strs_app app = strs_app_create_ex((int) width, (int) height, &title, &options);
+  strs_app_run(app);
+
+  frame_times frames = {0};
+  uint64_t frame_apply = 0;
+  uint64_t start = strs_clock_now_ns();
+  while (strs_replay_next(replay, &record)) {
+    if (paced) {
+      sleep_until(start + record.time_ns);
+    }
+    uint64_t begin = strs_clock_now_ns();
+    strs_replay_apply(replay, app, &record);
+    frame_apply += strs_clock_now_ns() - begin;
+    if (record.call != STRS_CALL_FRAME) {
+      continue;
+    }
+    add_frame(&frames, frame_apply);
+    if (print_frames) {
+      printf("frame %6llu  at %10.3f ms  apply %8.3f ms  %llu vertices  %llu indices\n",
+             (unsigned long long) frames.count, record.time_ns / 1e6, frame_apply / 1e6,
+             (unsigned long long) strs_app_vertex_count(app), (unsigned long long) strs_app_index_count(app));
+    }
+    frame_apply = 0;
+  }
+
+  strs_app_close(app);
+  strs_app_free(app);
+  print_summary(replay, &frames, width, height);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  const char *path = NULL;
+  bool paced = false;
+  bool print_frames = false;
+  bool use_app = false;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--paced") == 0) {
+      paced = true;
+    } else if (strcmp(argv[i], "--frames") == 0) {
+      print_frames = true;
+    } else if (strcmp(argv[i], "--app") == 0) {
+      use_app = true;
+    } else {
+      path = argv[i];
+    }
+  }
+  if (path == NULL) {
+    printf("usage: %s capture [--paced] [--frames] [--app]\n", argv[0]);
+    return 1;
+  }
+
+  strs_replay replay = strs_replay_open(path);
+  if (replay == NULL) {
+    printf("%s: not a capture\n", path);
+    return 1;
+  }
+  if (use_app) {
+    int result = replay_app(replay, paced, print_frames);
+    strs_replay_free(replay);
+    return result;
+  }
+
+  strs_jobs jobs = strs_jobs_create(strs_jobs_default_worker_count());
+  strs_soft soft = NULL;
+  uint32_t width = 0;
+  uint32_t height = 0;
+  const float clear_color[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+
+  frame_times frames = {0};
+  uint64_t frame_apply = 0;
+  uint64_t start = strs_clock_now_ns();
+  strs_call_record record;
+
+  while (strs_replay_next(replay, &record)) {
+    if (paced) {
+      sleep_until(start + record.time_ns);
+    }
+    uint64_t begin = strs_clock_now_ns();
+    strs_replay_apply_headless(replay, &record);
+
+    if (record.call == STRS_CALL_RESIZE) {
+      uint32_t new_width;
+      uint32_t new_height;
+      strs_replay_size(replay, &new_width, &new_height);
+      if (soft == NULL) {
+        soft = strs_soft_create(jobs, new_width, new_height);
+      } else if (new_width != width || new_height != height) {
+        strs_soft_resize(soft, new_width, new_height);
+      }
+      width = new_width;
+      height = new_height;
+    }
+    frame_apply += strs_clock_now_ns() - begin;
+    if (record.call != STRS_CALL_FRAME || soft == NULL) {
+      continue;
+    }
+
+    uint64_t draw_begin = strs_clock_now_ns();
+    strs_replay_draw(replay, soft, clear_color);
+    uint64_t draw = strs_clock_now_ns() - draw_begin;
+    add_frame(&frames, frame_apply + draw);
+    if (print_frames) {
+      strs_soft_stats stats;
+      strs_soft_get_stats(soft, &stats);
+      printf("frame %6llu  at %10.3f ms  apply %8.3f ms  draw %8.3f ms  %llu triangles  %llu shapes\n",
+             (unsigned long long) frames.count, record.time_ns / 1e6, frame_apply / 1e6, draw / 1e6,
+             (unsigned long long) stats.triangles, (unsigned long long) stats.shapes);
+    }
+    frame_apply = 0;
+  }
+
+  print_summary(replay, &frames, width, height);
+  if (soft != NULL) {
+    strs_soft_free(soft);
+  }
+  strs_jobs_free(jobs);
+  strs_replay_free(replay);
+  return 0;
+}